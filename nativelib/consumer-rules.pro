@@ -0,0 +1,2 @@
+-keep class com.sqsong.nativelib.OutlineStroke { *; }
+-keep class com.sqsong.nativelib.OutlineContours { <init>(...); }
@@ -5,36 +5,16 @@
 //  Created by 张慧 on 2019/12/31.
 //  Copyright © 2019 Apowersoft. All rights reserved.
 //
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include "LibAlpha.h"
 #include "enhance_foreground.h"
-
-int gauss_smooth(uint8_t *alpha, int width, int height, int alpha_type) {
-    int max_ = MAX(width, height);
-    int blur_size = 3;
-    if (max_ > 1000)
-        blur_size = 5;
-    int data_type = CV_8UC1;
-    switch (alpha_type) {
-        case 1:
-            data_type = CV_8UC1;
-            break;
-        case 3:
-            data_type = CV_8UC3;
-            break;
-        case 4:
-            data_type = CV_8UC4;
-            break;
-
-        default:
-            return -1;
-            break;
-    }
-    cv::Mat src_img(height, width, data_type, alpha);
-    cv::GaussianBlur(src_img, src_img, cv::Size(blur_size, blur_size), 0);
-
-    return 0;
-}
+#include "outline_stroke.h"
+#include "feather_mask.h"
+#include "image_util.h"
 
 uint8_t *smooth_step_table(int a, int b) {
     uint8_t *smooth_table = new uint8_t[256];
@@ -64,6 +44,177 @@ uint8_t *smooth_step_table(int a, int b) {
 
 static uint8_t *alpha_table = smooth_step_table(60, 220);
 
+// 读取一行的第 0 通道到 row[2, width + 2)，两端按 BORDER_REFLECT_101 各补 2 个像素
+static void load_alpha_row(uint8_t *row, const uint8_t *src, int width, int nb_channel) {
+    uint8_t *out = row + 2;
+    int j = 0;
+    if (nb_channel == 1) {
+        memcpy(out, src, width);
+        j = width;
+    }
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    cv::v_uint8 c0, c1, c2, c3;
+    if (nb_channel == 4) {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_load_deinterleave(src + j * 4, c0, c1, c2, c3);
+            cv::v_store(out + j, c0);
+        }
+    } else if (nb_channel == 3) {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_load_deinterleave(src + j * 3, c0, c1, c2);
+            cv::v_store(out + j, c0);
+        }
+    }
+#endif
+    for (; j < width; j++)
+        out[j] = src[j * nb_channel];
+    for (int k = 1; k <= 2; k++) {
+        out[-k] = out[image_util::reflect_101(-k, width)];
+        out[width - 1 + k] = out[image_util::reflect_101(width - 1 + k, width)];
+    }
+}
+
+// 水平方向的高斯核：3x3 为 [1 2 1]，5x5 为 [1 4 6 4 1]，结果未归一化
+static void blur_row_h(uint16_t *dst, const uint8_t *row, int width, int blur_size) {
+    const uint8_t *p = row + 2;
+    int j = 0;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint16>::vlanes();
+    if (blur_size == 5) {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_uint16 c = cv::vx_load_expand(p + j);
+            cv::v_uint16 s = cv::v_add(cv::vx_load_expand(p + j - 2), cv::vx_load_expand(p + j + 2));
+            s = cv::v_add(s, cv::v_shl<2>(cv::v_add(cv::vx_load_expand(p + j - 1),
+                                                    cv::vx_load_expand(p + j + 1))));
+            s = cv::v_add(s, cv::v_add(cv::v_shl<2>(c), cv::v_shl<1>(c)));
+            cv::v_store(dst + j, s);
+        }
+    } else {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_uint16 s = cv::v_add(cv::vx_load_expand(p + j - 1), cv::vx_load_expand(p + j + 1));
+            s = cv::v_add(s, cv::v_shl<1>(cv::vx_load_expand(p + j)));
+            cv::v_store(dst + j, s);
+        }
+    }
+#endif
+    if (blur_size == 5) {
+        for (; j < width; j++)
+            dst[j] = p[j - 2] + 4 * (p[j - 1] + p[j + 1]) + 6 * p[j] + p[j + 2];
+    } else {
+        for (; j < width; j++)
+            dst[j] = p[j - 1] + 2 * p[j] + p[j + 1];
+    }
+}
+
+// 垂直方向合并 blur_size 行水平结果并四舍五入，核的总权重为 16 (3x3) 或 256 (5x5)，
+// 二项式核在定点下没有误差，结果与 cv::GaussianBlur 对 8 位图的定点实现逐位一致
+static void blur_rows_v(uint8_t *dst, uint16_t *const *rows, int width, int blur_size) {
+    int j = 0;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint16>::vlanes();
+    if (blur_size == 5) {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_uint16 c = cv::vx_load(rows[2] + j);
+            cv::v_uint16 s = cv::v_add(cv::vx_load(rows[0] + j), cv::vx_load(rows[4] + j));
+            s = cv::v_add(s, cv::v_shl<2>(cv::v_add(cv::vx_load(rows[1] + j),
+                                                    cv::vx_load(rows[3] + j))));
+            s = cv::v_add(s, cv::v_add(cv::v_shl<2>(c), cv::v_shl<1>(c)));
+            cv::v_rshr_pack_store<8>(dst + j, s);
+        }
+    } else {
+        for (; j <= width - lanes; j += lanes) {
+            cv::v_uint16 s = cv::v_add(cv::vx_load(rows[0] + j), cv::vx_load(rows[2] + j));
+            s = cv::v_add(s, cv::v_shl<1>(cv::vx_load(rows[1] + j)));
+            cv::v_rshr_pack_store<4>(dst + j, s);
+        }
+    }
+#endif
+    if (blur_size == 5) {
+        for (; j < width; j++) {
+            uint32_t s = rows[0][j] + 4 * (rows[1][j] + rows[3][j]) + 6 * rows[2][j] + rows[4][j];
+            dst[j] = (uint8_t) ((s + 128) >> 8);
+        }
+    } else {
+        for (; j < width; j++)
+            dst[j] = (uint8_t) ((rows[0][j] + 2 * rows[1][j] + rows[2][j] + 8) >> 4);
+    }
+}
+
+// 写回一行：前 3 个通道为 alpha，第 4 个通道保持原图
+static void store_alpha_row(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width, int nb_channel) {
+    if (nb_channel == 1) {
+        memcpy(dst, alpha, width);
+        return;
+    }
+    int j = 0;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    cv::v_uint8 c0, c1, c2, c3;
+    for (; j <= width - lanes; j += lanes) {
+        cv::v_uint8 a = cv::vx_load(alpha + j);
+        if (nb_channel == 4) {
+            cv::v_load_deinterleave(src + j * 4, c0, c1, c2, c3);
+            cv::v_store_interleave(dst + j * 4, a, a, a, c3);
+        } else {
+            cv::v_store_interleave(dst + j * 3, a, a, a);
+        }
+    }
+#endif
+    for (; j < width; j++) {
+        uint8_t *d = dst + j * nb_channel;
+        d[0] = d[1] = d[2] = alpha[j];
+        if (nb_channel == 4)
+            d[3] = src[j * 4 + 3];
+    }
+}
+
+#if CV_SIMD
+// 从 pixels 开始的 lanes 个像素中，第 channel 通道是否有非零值
+static inline bool any_nonzero(const uint8_t *pixels, int nb_channel, int channel) {
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    if (nb_channel == 1)
+        return cv::v_check_any(cv::v_ne(cv::vx_load(pixels), cv::vx_setzero_u8()));
+    if (nb_channel == 4) {
+        // 按 32 位读取 4 个通道，只保留第 channel 通道的字节
+        const cv::v_uint32 mask = cv::vx_setall_u32(0xffu << (8 * channel));
+        cv::v_uint32 bits = cv::v_reinterpret_as_u32(cv::vx_load(pixels));
+        for (int k = 1; k < 4; k++)
+            bits = cv::v_or(bits, cv::v_reinterpret_as_u32(cv::vx_load(pixels + k * lanes)));
+        return cv::v_check_any(cv::v_ne(cv::v_and(bits, mask), cv::vx_setzero_u32()));
+    }
+    cv::v_uint8 c[3];
+    cv::v_load_deinterleave(pixels, c[0], c[1], c[2]);
+    return cv::v_check_any(cv::v_ne(c[channel], cv::vx_setzero_u8()));
+}
+#endif
+
+// 一行中 [begin, end) 范围内第 channel 通道第一个非零像素的位置，没有则返回 end
+static int first_nonzero(const uint8_t *row, int begin, int end, int nb_channel, int channel) {
+    int j = begin;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    while (j <= end - lanes && !any_nonzero(row + j * nb_channel, nb_channel, channel))
+        j += lanes;
+#endif
+    while (j < end && row[j * nb_channel + channel] == 0)
+        j++;
+    return j;
+}
+
+// 一行中 [begin, end) 范围内第 channel 通道最后一个非零像素的位置，没有则返回 begin - 1
+static int last_nonzero(const uint8_t *row, int begin, int end, int nb_channel, int channel) {
+    int j = end;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    while (j - lanes >= begin && !any_nonzero(row + (j - lanes) * nb_channel, nb_channel, channel))
+        j -= lanes;
+#endif
+    while (j > begin && row[(j - 1) * nb_channel + channel] == 0)
+        j--;
+    return j - 1;
+}
+
 int WXAdjustAlpha(uint8_t *dst, uint8_t *src, int width, int height, int nb_channel, int stride, int *rect) {
     if (nb_channel != 1 && nb_channel != 3 && nb_channel != 4)
         return -1;
@@ -82,45 +233,82 @@ int WXAdjustAlpha(uint8_t *dst, uint8_t *src, int width, int height, int nb_chan
     if (NULL != dst)
         badjust = true;
 
-    if (badjust) {
-        if (src != dst) {
-            memcpy(dst, src, stride * height);
-        }
-        gauss_smooth(dst, width, height, nb_channel);
+    // 与原来的 cv::GaussianBlur 相同的核大小
+    const int blur_size = MAX(width, height) > 1000 ? 5 : 3;
+    const int radius = blur_size / 2;
+    // 条带开头需要多算 blur_size - 1 行水平模糊，所以条带不宜太小
+    const double nstripes = image_util::stripes(height);
+
+    // 原地处理时，其它线程写回的行会被相邻条带的模糊读到，所以先把第 0 通道拷贝出来
+    std::vector<uint8_t> plane;
+    if (badjust && dst == src) {
+        plane.resize((size_t) width * height);
+        cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range) {
+            std::vector<uint8_t> row(width + 4);
+            for (int i = range.start; i < range.end; i++) {
+                load_alpha_row(row.data(), src + (size_t) i * stride, width, nb_channel);
+                memcpy(plane.data() + (size_t) i * width, row.data() + 2, width);
+            }
+        }, nstripes);
     }
 
+    std::mutex rect_mutex;
     int minx = width, miny = height, maxx = 0, maxy = 0;
-    int src_row_index = 0;// , dst_row_index = 0;
-    int src_index = 0;
-    uint8_t alpha = 0;
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            alpha = src[src_index] & 0xff;
+    // 按行分条并行：每个条带只模糊第 0 通道，查 alpha_table，写回并统计外接矩形
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range) {
+        std::vector<uint8_t> row(width + 4);
+        std::vector<uint8_t> alpha(width);
+        std::vector<uint16_t> ring(badjust ? (size_t) blur_size * width : 0);
+        uint16_t *rows[5];
+        auto blur_source_row = [&](int i) {
+            i = image_util::reflect_101(i, height);
+            if (plane.empty())
+                load_alpha_row(row.data(), src + (size_t) i * stride, width, nb_channel);
+            else
+                load_alpha_row(row.data(), plane.data() + (size_t) i * width, width, 1);
+            // i + blur_size >= 0，环形缓冲按行号取模
+            uint16_t *h = ring.data() + (size_t) ((i + blur_size) % blur_size) * width;
+            blur_row_h(h, row.data(), width, blur_size);
+        };
+
+        int local_minx = width, local_miny = height, local_maxx = 0, local_maxy = 0;
+        if (badjust) {
+            for (int i = range.start - radius; i < range.start + radius; i++)
+                blur_source_row(i);
+        }
+        for (int i = range.start; i < range.end; i++) {
             if (badjust) {
-                alpha = alpha_table[alpha];
-                for (int c = 0; c < nb_channel; c++) {
-                    if (c == 3)
-                        dst[src_index + 3] = src[src_index + 3];
-                    else
-                        dst[src_index + c] = alpha;
+                blur_source_row(i + radius);
+                for (int k = 0; k < blur_size; k++) {
+                    int r = image_util::reflect_101(i - radius + k, height);
+                    rows[k] = ring.data() + (size_t) ((r + blur_size) % blur_size) * width;
                 }
+                blur_rows_v(alpha.data(), rows, width, blur_size);
+                for (int j = 0; j < width; j++)
+                    alpha[j] = alpha_table[alpha[j]];
+                store_alpha_row(dst + (size_t) i * stride, src + (size_t) i * stride, alpha.data(), width, nb_channel);
+            } else {
+                load_alpha_row(row.data(), src + (size_t) i * stride, width, nb_channel);
+                memcpy(alpha.data(), row.data() + 2, width);
             }
-            src_index += nb_channel;
             //求外接矩形
-            if (brect && alpha > 0) {
-                if (i < miny)
-                    miny = i;
-                if (j < minx)
-                    minx = j;
-                if (i > maxy)
-                    maxy = i;
-                if (j > maxx)
-                    maxx = j;
+            int first = brect ? first_nonzero(alpha.data(), 0, width, 1, 0) : width;
+            if (first < width) {
+                local_miny = MIN(local_miny, i);
+                local_maxy = i;
+                local_minx = MIN(local_minx, first);
+                local_maxx = MAX(local_maxx, last_nonzero(alpha.data(), first, width, 1, 0));
             }
         }
-        src_row_index += stride;
-        src_index = src_row_index;
-    }
+        if (brect && local_miny < height) {
+            std::lock_guard<std::mutex> lock(rect_mutex);
+            minx = MIN(minx, local_minx);
+            miny = MIN(miny, local_miny);
+            maxx = MAX(maxx, local_maxx);
+            maxy = MAX(maxy, local_maxy);
+        }
+    }, nstripes);
+
     //外接矩形：x,y,w,h
     if (brect) {
         //外接矩形：x,y,w,h
@@ -139,60 +327,115 @@ int WXAdjustAlpha(uint8_t *dst, uint8_t *src, int width, int height, int nb_chan
     return 0;
 }
 
+// 合并一行：rgb 取自原图（单通道原图复制到 rgb），alpha 取自黑白图的第 0 通道
+// 通道数为模板参数，(4,1)、(4,4)、(3,1) 等组合各自展开成无分支的 SIMD 循环，dst 与 src 可以是同一行
+template<int src_nb_channel, int alpha_nb_channel>
+static void merge_row(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width) {
+    int j = 0;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    cv::v_uint8 r, g, b, a, unused0, unused1, unused2;
+    for (; j <= width - lanes; j += lanes) {
+        if (alpha_nb_channel == 1)
+            a = cv::vx_load(alpha + j);
+        else if (alpha_nb_channel == 4)
+            cv::v_load_deinterleave(alpha + j * 4, a, unused0, unused1, unused2);
+        else
+            cv::v_load_deinterleave(alpha + j * 3, a, unused0, unused1);
+
+        if (src_nb_channel == 4)
+            cv::v_load_deinterleave(src + j * 4, r, g, b, unused0);
+        else if (src_nb_channel == 3)
+            cv::v_load_deinterleave(src + j * 3, r, g, b);
+        else
+            r = g = b = cv::vx_load(src + j);
+        cv::v_store_interleave(dst + j * 4, r, g, b, a);
+    }
+#endif
+    for (; j < width; j++) {
+        const uint8_t *s = src + j * src_nb_channel;
+        uint8_t *d = dst + j * 4;
+        if (src_nb_channel == 1) {
+            d[0] = d[1] = d[2] = s[0];
+        } else {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+        }
+        d[3] = alpha[j * alpha_nb_channel];
+    }
+}
+
+typedef void (*merge_row_func)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+
+template<int src_nb_channel>
+static merge_row_func select_merge_row(int alpha_nb_channel) {
+    switch (alpha_nb_channel) {
+        case 1:
+            return merge_row<src_nb_channel, 1>;
+        case 3:
+            return merge_row<src_nb_channel, 3>;
+        default:
+            return merge_row<src_nb_channel, 4>;
+    }
+}
+
+static merge_row_func select_merge_row(int src_nb_channel, int alpha_nb_channel) {
+    switch (src_nb_channel) {
+        case 1:
+            return select_merge_row<1>(alpha_nb_channel);
+        case 3:
+            return select_merge_row<3>(alpha_nb_channel);
+        default:
+            return select_merge_row<4>(alpha_nb_channel);
+    }
+}
+
 int WXMergeRGBA(uint8_t *dst, uint8_t *src, uint8_t *alpha, int width, int height, int src_nb_channel, int src_stride, int dst_stride, int alpha_nb_channel, int alpha_stride) {
-    if (src_nb_channel != 1 && src_nb_channel != 3 && src_nb_channel != 4)
+    if (NULL == dst || width <= 0 || height <= 0 || dst_stride < width * 4)
+        return -1;
+    if (NULL == src || (src_nb_channel != 1 && src_nb_channel != 3 && src_nb_channel != 4) ||
+        src_stride < width * src_nb_channel)
         return -2;
-    if (alpha_nb_channel != 1 && alpha_nb_channel != 3 && alpha_nb_channel != 4)
+    if (NULL == alpha || (alpha_nb_channel != 1 && alpha_nb_channel != 3 && alpha_nb_channel != 4) ||
+        alpha_stride < width * alpha_nb_channel)
         return -3;
 
-    int src_row_index = 0, dst_row_index = 0, alpha_row_index = 0;
-    int src_index = 0, dst_index = 0, alpha_index = 0;
-    if (src_nb_channel == 1) {
-        uint8_t temp = 0;
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                temp = src[src_index];
-                dst[dst_index] = temp;
-                dst[dst_index + 1] = temp;
-                dst[dst_index + 2] = temp;
-
-                dst[dst_index + 3] = alpha[alpha_index];
-                dst_index += 4;
-                src_index += src_nb_channel;
-                alpha_index += alpha_nb_channel;
-            }
-            src_row_index += src_stride;
-            dst_row_index += dst_stride;
-            alpha_row_index += alpha_stride;
-            src_index = src_row_index;
-            dst_index = dst_row_index;
-            alpha_index = alpha_row_index;
-        }
-    } else {
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                dst[dst_index] = src[src_index];
-                dst[dst_index + 1] = src[src_index + 1];
-                dst[dst_index + 2] = src[src_index + 2];
-
-                dst[dst_index + 3] = alpha[alpha_index];
-                dst_index += 4;
-                src_index += src_nb_channel;
-                alpha_index += alpha_nb_channel;
-            }
-            src_row_index += src_stride;
-            dst_row_index += dst_stride;
-            alpha_row_index += alpha_stride;
-            src_index = src_row_index;
-            dst_index = dst_row_index;
-            alpha_index = alpha_row_index;
+    // 按行分条并行，各行互不依赖
+    merge_row_func merge = select_merge_row(src_nb_channel, alpha_nb_channel);
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; i++)
+            merge(dst + (size_t) i * dst_stride, src + (size_t) i * src_stride, alpha + (size_t) i * alpha_stride, width);
+    }, image_util::stripes(height));
+    return 0;
+}
+
+int WXMergeAlphaInPlace(uint8_t *rgba, int width, int height, int stride, uint8_t *alpha, int alpha_nb_channel, int alpha_stride) {
+    if (NULL == rgba || width <= 0 || height <= 0 || stride < width * 4)
+        return -1;
+    if (NULL == alpha || (alpha_nb_channel != 1 && alpha_nb_channel != 3 && alpha_nb_channel != 4) ||
+        alpha_stride < width * alpha_nb_channel)
+        return -3;
+
+    merge_row_func merge = select_merge_row(4, alpha_nb_channel);
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            uint8_t *row = rgba + (size_t) i * stride;
+            merge(row, row, alpha + (size_t) i * alpha_stride, width);
         }
-    }
+    }, image_util::stripes(height));
     return 0;
 }
 
 int WXEnhanceForeground(uint8_t *img_dst, int dst_type, int dst_stride, uint8_t *img_src, int img_width, int img_height, int src_type,
                         int src_stride, uint8_t *alpha, int alpha_type, int alpha_stride, int *rect, bool is_mask_alpha_channel) {
+    return WXEnhanceForegroundEx(img_dst, dst_type, dst_stride, img_src, img_width, img_height, src_type, src_stride, alpha,
+                                 alpha_type, alpha_stride, rect, is_mask_alpha_channel, false, NULL);
+}
+
+int WXEnhanceForegroundEx(uint8_t *img_dst, int dst_type, int dst_stride, uint8_t *img_src, int img_width, int img_height, int src_type,
+                          int src_stride, uint8_t *alpha, int alpha_type, int alpha_stride, int *rect, bool is_mask_alpha_channel,
+                          bool band_only, size_t *peak_memory) {
     if (0 >= img_width || 0 >= img_height)
         return -2;
 
@@ -205,12 +448,12 @@ int WXEnhanceForeground(uint8_t *img_dst, int dst_type, int dst_stride, uint8_t
         return -4;
 
     if (nullptr == alpha || (1 != alpha_type && 3 != alpha_type && 4 != alpha_type) ||
-        alpha_stride < img_width * alpha_type)
+        alpha_stride < img_width * alpha_type || (is_mask_alpha_channel && 4 != alpha_type))
         return -5;
 
     return enhance_foreground::enhance(img_dst, dst_type, dst_stride, img_src, img_width,
                                        img_height, src_type, src_stride, alpha, alpha_type,
-                                       alpha_stride, rect, is_mask_alpha_channel);
+                                       alpha_stride, rect, is_mask_alpha_channel, band_only, peak_memory);
 }
 
 int WXShadowView(uint8_t *rgba_view, int view_stride, int view_width, int view_height, int x, int y, uint8_t *rgba_fg, int fg_stride, int fg_width, int fg_height, uint8_t r, uint8_t g, uint8_t b) {
@@ -245,42 +488,272 @@ int WXShadowView(uint8_t *rgba_view, int view_stride, int view_width, int view_h
     return 0;
 }
 
+// 计算 mask 第 channel 通道非零像素的外接矩形：先从上、下两端逐行找到第一行非零，
+// 再只在这两行之间找左右边界，每行只需检查当前边界之外的部分
+static bool mask_rect(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, int *rect) {
+    int top = 0;
+    while (top < height && first_nonzero(mask + (size_t) top * stride, 0, width, nb_channel, channel) == width)
+        top++;
+    if (top == height)
+        return false;
+    int bottom = height - 1;
+    while (first_nonzero(mask + (size_t) bottom * stride, 0, width, nb_channel, channel) == width)
+        bottom--;
+
+    int left = width, right = -1;
+    for (int i = top; i <= bottom && (left > 0 || right < width - 1); i++) {
+        const uint8_t *row = mask + (size_t) i * stride;
+        left = first_nonzero(row, 0, left, nb_channel, channel);
+        right = last_nonzero(row, right + 1, width, nb_channel, channel);
+    }
+    rect[0] = left;
+    rect[1] = top;
+    rect[2] = right - left + 1;
+    rect[3] = bottom - top + 1;
+    return true;
+}
+
+int WXCalculateMaskRect(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, int *rect) {
+    if (rect == NULL)
+        return -4;
+    // 参数错误和全为 0 时 rect 都置 0，与原来的 CalculateMaskRect 一致（例如宽高为 0 时）
+    memset(rect, 0, sizeof(int) * 4);
+    if (nb_channel != 1 && nb_channel != 3 && nb_channel != 4)
+        return -1;
+    if (mask == NULL || width <= 0 || height <= 0)
+        return -2;
+    if (stride < width * nb_channel)
+        return -3;
+    if (channel < 0 || channel >= nb_channel)
+        return -4;
+
+    if (!mask_rect(mask, width, height, nb_channel, stride, channel, rect))
+        return -5;
+    return 0;
+}
+
+int WXUpdateMaskRect(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel,
+                     const int *dirty_rect, int *rect) {
+    if (nb_channel != 1 && nb_channel != 3 && nb_channel != 4)
+        return -1;
+    if (mask == NULL || width <= 0 || height <= 0 || dirty_rect == NULL)
+        return -2;
+    if (stride < width * nb_channel)
+        return -3;
+    if (rect == NULL || channel < 0 || channel >= nb_channel)
+        return -4;
+
+    // 脏区裁剪到图像内
+    int dx0 = MAX(dirty_rect[0], 0), dy0 = MAX(dirty_rect[1], 0);
+    int dx1 = MIN(dirty_rect[0] + dirty_rect[2], width), dy1 = MIN(dirty_rect[1] + dirty_rect[3], height);
+    bool old_empty = rect[2] <= 0 || rect[3] <= 0;
+    if (dx0 >= dx1 || dy0 >= dy1)
+        return old_empty ? -5 : 0;
+
+    if (!old_empty) {
+        // 脏区外的像素没有变化。旧矩形的四条边上都有非零像素，只要脏区没有碰到任何一条边，
+        // 这些像素就还在，新矩形就是旧矩形与脏区内非零像素的并集；否则边界可能被擦除，重新计算
+        int x0 = rect[0], y0 = rect[1], x1 = rect[0] + rect[2] - 1, y1 = rect[1] + rect[3] - 1;
+        bool rows_overlap = dx0 <= x1 && dx1 > x0;
+        bool cols_overlap = dy0 <= y1 && dy1 > y0;
+        bool touches_edge = (rows_overlap && ((dy0 <= y0 && y0 < dy1) || (dy0 <= y1 && y1 < dy1))) ||
+                            (cols_overlap && ((dx0 <= x0 && x0 < dx1) || (dx0 <= x1 && x1 < dx1)));
+        if (touches_edge)
+            return WXCalculateMaskRect(mask, width, height, nb_channel, stride, channel, rect);
+    }
+
+    int dirty[4];
+    const uint8_t *origin = mask + (size_t) dy0 * stride + (size_t) dx0 * nb_channel;
+    if (!mask_rect(origin, dx1 - dx0, dy1 - dy0, nb_channel, stride, channel, dirty))
+        return old_empty ? -5 : 0;
+    dirty[0] += dx0;
+    dirty[1] += dy0;
+    if (!old_empty) {
+        int x1 = MAX(rect[0] + rect[2], dirty[0] + dirty[2]);
+        int y1 = MAX(rect[1] + rect[3], dirty[1] + dirty[3]);
+        dirty[0] = MIN(rect[0], dirty[0]);
+        dirty[1] = MIN(rect[1], dirty[1]);
+        dirty[2] = x1 - dirty[0];
+        dirty[3] = y1 - dirty[1];
+    }
+    memcpy(rect, dirty, sizeof(dirty));
+    return 0;
+}
+
 void CalculateMaskRect(const uint8_t *alpha, int mask_width, int mask_height, int *rect) {
-    int min_x = mask_width;
-    int min_y = mask_height;
-    int max_x = -1;
-    int max_y = -1;
-    int srcIndex = 0, rowIndex = 0;
-    for (int i = 0; i < mask_height; ++i) {
-        for (int j = 0; j < mask_width; ++j) {
-            if (alpha[srcIndex] > 0) {
-                if (i < min_y)
-                    min_y = i;
-                if (i > max_y)
-                    max_y = i;
-                if (j < min_x)
-                    min_x = j;
-                if (j > max_x)
-                    max_x = j;
-            }
-            srcIndex += 4;
+    int temp[4];
+    WXCalculateMaskRect(alpha, mask_width, mask_height, 4, mask_width * 4, 0, rect != nullptr ? rect : temp);
+}
+
+// 一行 rgba 的 alpha 是否全为 255
+static bool row_opaque(const uint8_t *row, int width) {
+    int j = 0;
+#if CV_SIMD
+    // 小端下 alpha 是每个像素 32 位的最高字节
+    const int lanes = cv::VTraits<cv::v_uint32>::vlanes();
+    const cv::v_uint32 alpha_mask = cv::vx_setall_u32(0xff000000u);
+    for (; j <= width - lanes * 4; j += lanes * 4) {
+        const uint32_t *p = reinterpret_cast<const uint32_t *>(row + j * 4);
+        cv::v_uint32 bits = cv::v_and(cv::v_and(cv::vx_load(p), cv::vx_load(p + lanes)),
+                                      cv::v_and(cv::vx_load(p + 2 * lanes), cv::vx_load(p + 3 * lanes)));
+        if (!cv::v_check_all(cv::v_eq(cv::v_and(bits, alpha_mask), alpha_mask)))
+            return false;
+    }
+#endif
+    for (; j < width; j++) {
+        if (row[j * 4 + 3] != 255)
+            return false;
+    }
+    return true;
+}
+
+// 一行 rgba 中 [begin, end) 像素 alpha 的最小值和最大值
+static void row_alpha_range(const uint8_t *row, int begin, int end, uint8_t *min_alpha, uint8_t *max_alpha) {
+    int j = begin;
+    uint8_t lo = 255, hi = 0;
+#if CV_SIMD
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    if (end - j >= lanes) {
+        cv::v_uint8 vlo = cv::vx_setall_u8(255), vhi = cv::vx_setzero_u8();
+        for (; j <= end - lanes; j += lanes) {
+            cv::v_uint8 r, g, b, a;
+            cv::v_load_deinterleave(row + j * 4, r, g, b, a);
+            vlo = cv::v_min(vlo, a);
+            vhi = cv::v_max(vhi, a);
+        }
+        lo = cv::v_reduce_min(vlo);
+        hi = cv::v_reduce_max(vhi);
+    }
+#endif
+    for (; j < end; j++) {
+        lo = MIN(lo, row[j * 4 + 3]);
+        hi = MAX(hi, row[j * 4 + 3]);
+    }
+    *min_alpha = lo;
+    *max_alpha = hi;
+}
+
+int WXProbeAlpha(const uint8_t *rgba, int width, int height, int stride, int *rect, uint8_t *cell_map, int cell_size) {
+    if (NULL == rgba || width <= 0 || height <= 0 || stride < width * 4)
+        return -1;
+    if (NULL != cell_map && cell_size <= 0)
+        return -2;
+
+    if (NULL != rect)
+        WXCalculateMaskRect(rgba, width, height, 4, stride, 3, rect);
+
+    if (NULL == cell_map) {
+        // 只需要判断有没有透明像素，遇到第一个 alpha 不为 255 的像素就返回
+        for (int i = 0; i < height; i++) {
+            if (!row_opaque(rgba + (size_t) i * stride, width))
+                return 1;
         }
-        rowIndex += mask_width * 4;
-        srcIndex = rowIndex;
+        return 0;
     }
 
-    if (rect != nullptr) {
-        if (max_x <= min_x || max_y <= min_y) {
-            rect[0] = 0;
-            rect[1] = 0;
-            rect[2] = 0;
-            rect[3] = 0;
-        } else {
-            rect[0] = min_x;
-            rect[1] = min_y;
-            rect[2] = max_x - min_x + 1;
-            rect[3] = max_y - min_y + 1;
+    // 每个格子记录两个标志：bit0 有 alpha 不为 0 的像素，bit1 有 alpha 不为 255 的像素
+    const int map_width = (width + cell_size - 1) / cell_size;
+    const int map_height = (height + cell_size - 1) / cell_size;
+    std::atomic<bool> transparent(false);
+    cv::parallel_for_(cv::Range(0, map_height), [&](const cv::Range &range) {
+        bool local_transparent = false;
+        for (int cy = range.start; cy < range.end; cy++) {
+            uint8_t *cells = cell_map + (size_t) cy * map_width;
+            memset(cells, 0, map_width);
+            for (int i = cy * cell_size; i < MIN(height, (cy + 1) * cell_size); i++) {
+                const uint8_t *row = rgba + (size_t) i * stride;
+                for (int cx = 0; cx < map_width; cx++) {
+                    uint8_t lo, hi;
+                    row_alpha_range(row, cx * cell_size, MIN(width, (cx + 1) * cell_size), &lo, &hi);
+                    cells[cx] |= (hi > 0 ? 1 : 0) | (lo < 255 ? 2 : 0);
+                }
+            }
+            // 全不透明 255，全透明 0，其它 128
+            for (int cx = 0; cx < map_width; cx++) {
+                local_transparent |= cells[cx] != 1;
+                cells[cx] = cells[cx] == 1 ? 255 : cells[cx] == 2 ? 0 : 128;
+            }
         }
+        if (local_transparent)
+            transparent = true;
+    });
+    return transparent ? 1 : 0;
+}
+
+int WXOutlineRGBA(uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height, int src_stride,
+                  float stroke_width, float softness, uint32_t color) {
+    WXOutlineStroke stroke = {stroke_width, softness, 0, color};
+    return WXOutlineRGBAStrokes(dst, dst_stride, src, width, height, src_stride, &stroke, 1, NULL, 0);
+}
+
+void *WXCreateOutlineCache(void) {
+    return new (std::nothrow) outline_stroke::cache();
+}
+
+void WXReleaseOutlineCache(void *cache) {
+    delete (outline_stroke::cache *) cache;
+}
+
+int WXOutlineRGBAStrokes(uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height, int src_stride,
+                         const WXOutlineStroke *strokes, int count, void *cache, uint64_t source_id) {
+    if (NULL == src || width <= 0 || height <= 0 || src_stride < width * 4)
+        return -1;
+    if (NULL == dst || dst_stride < width * 4)
+        return -2;
+    if (count < 0 || (count > 0 && NULL == strokes))
+        return -3;
+
+    std::vector<outline_stroke::stroke_spec> specs(count);
+    for (int k = 0; k < count; k++) {
+        if (strokes[k].width < 0 || strokes[k].softness < 0 || strokes[k].offset < 0)
+            return -3;
+        specs[k] = {strokes[k].width, strokes[k].softness, strokes[k].offset, strokes[k].color};
+    }
+
+    outline_stroke::cache local;
+    outline_stroke::cache *c = NULL != cache ? (outline_stroke::cache *) cache : &local;
+    const int margin = outline_stroke::margin(specs.data(), count);
+    const bool inside = outline_stroke::need_inside(specs.data(), count);
+    if (!c->matches(src, width, height, src_stride, source_id, margin, inside)) {
+        // 全透明时没有可描边的形状，距离场为空，结果就是原图
+        int rect[4];
+        bool empty = WXCalculateMaskRect(src, width, height, 4, src_stride, 3, rect) < 0;
+        outline_stroke::build_field(c->field, src, width, height, src_stride, empty ? NULL : rect, margin, inside);
+        c->set(src, width, height, src_stride, source_id, margin, inside);
     }
+    outline_stroke::stroke(dst, dst_stride, src, width, height, src_stride, c->field, specs.data(), count);
+    return 0;
 }
 
+void *WXCreateFeatherField(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, float max_outer) {
+    if (NULL == mask || width <= 0 || height <= 0 || (1 != nb_channel && 3 != nb_channel && 4 != nb_channel) ||
+        stride < width * nb_channel || channel < 0 || channel >= nb_channel || max_outer < 0)
+        return NULL;
+
+    feather_mask::field *field = new (std::nothrow) feather_mask::field();
+    if (NULL == field)
+        return NULL;
+    int rect[4];
+    bool empty = WXCalculateMaskRect(mask, width, height, nb_channel, stride, channel, rect) < 0;
+    feather_mask::build(*field, {mask, stride, nb_channel, channel}, width, height, empty ? NULL : rect, max_outer);
+    return field;
+}
+
+void WXReleaseFeatherField(void *field) {
+    delete (feather_mask::field *) field;
+}
+
+int WXFeatherMask(const void *field, uint8_t *dst, int dst_width, int dst_height, int dst_type, int dst_stride,
+                  float inner, float outer, int curve) {
+    if (NULL == field)
+        return -1;
+    const feather_mask::field *f = (const feather_mask::field *) field;
+    if (NULL == dst || dst_width != f->width || dst_height != f->height ||
+        (1 != dst_type && 3 != dst_type && 4 != dst_type) || dst_stride < dst_width * dst_type)
+        return -2;
+    if (inner < 0 || outer < 0 || curve < feather_mask::curve_linear || curve > feather_mask::curve_gaussian)
+        return -3;
+
+    feather_mask::map(dst, dst_type, dst_stride, *f, inner, outer, curve);
+    return 0;
+}
@@ -44,9 +44,22 @@ src_type：原图的色彩空间类型，4：rgba，3：rgb，1：gray  bitmap
 src_stride：原图birmapdata数据扫描宽度Stride，数据行宽，一般是图片宽度的整数倍，例如rgba一般是宽度的4倍，但是考虑到内存对齐，也不一定是宽度的整数倍
 dst_stride：rgba数据行宽
 alpha_type:黑白图色彩空间类型，4：rgba，3：rgb，1：gray
-alpha_stride:数据行宽*/
+alpha_stride:数据行宽
+返回值：-1 dst 或尺寸参数错误  -2 原图参数错误  -3 黑白图参数错误*/
 WXBGERASER_CAPI int WXMergeRGBA(uint8_t *dst, uint8_t *src, uint8_t *alpha, int width, int height, int src_type, int src_stride, int dst_stride, int alpha_type, int alpha_stride);
 
+/**
+黑白图原地合并到 rgba 原图的 alpha 通道，rgb 不变，省去额外分配的 dst
+rgba：原图，必须是 4 通道
+width:图像宽
+height:图像高
+stride：原图数据行宽
+alpha:黑白图，与原图同分辨率，取第 0 通道
+alpha_type:黑白图色彩空间类型，4：rgba，3：rgb，1：gray
+alpha_stride:数据行宽
+返回值：-1 原图参数错误  -3 黑白图参数错误*/
+WXBGERASER_CAPI int WXMergeAlphaInPlace(uint8_t *rgba, int width, int height, int stride, uint8_t *alpha, int alpha_type, int alpha_stride);
+
 /**
 优化前景边缘
 img_dst、img_src、alpha三者必须同分辨率  img_dst、img_src可以是同一个地址
@@ -62,14 +75,137 @@ alpha：黑白图mask
 alpha_type：黑白图色彩空间，4：rgba，3：rgb，1：gray
 alpha_stride：黑白图Stride
 rect:裁剪到边缘的矩形框：x,y,w,h
+is_mask_alpha_channel：mask 取 alpha 的第 4 个通道，此时 alpha_type 必须为 4
 返回值小于0 出错或者没必要进行前景优化：-1至-6参数错误  -7：mask图基本全黑  -8：抠出图片占比太小  -9：接近全白
  */
 WXBGERASER_CAPI int WXEnhanceForeground(uint8_t *img_dst, int dst_type, int dst_stride, uint8_t *img_src, int img_width, int img_height, int src_type, int src_stride, uint8_t *alpha, int alpha_type, int alpha_stride, int *rect, bool is_mask_alpha_channel);
 
+/**
+同 WXEnhanceForeground，另外返回处理过程中额外分配内存的峰值
+估计在长边 600 的半精度小图上进行，按行分条处理，额外内存和原图大小基本无关
+band_only：只对 0 < mask < 255 的半透明像素做前景估计，估计只在这些像素附近（含 11x11 模糊范围）的块上进行，
+    mask 为 255 的像素直接复制原图，为 0 的像素清 0（rgba 的 alpha 也为 0），细边缘的人像抠图实测快 3-4 倍（1200 万像素单核约 110-150 ms 对 420-480 ms）
+peak_memory：额外内存峰值，单位字节，可以为 NULL*/
+WXBGERASER_CAPI int WXEnhanceForegroundEx(uint8_t *img_dst, int dst_type, int dst_stride, uint8_t *img_src, int img_width, int img_height, int src_type, int src_stride, uint8_t *alpha, int alpha_type, int alpha_stride, int *rect, bool is_mask_alpha_channel, bool band_only, size_t *peak_memory);
+
 WXBGERASER_CAPI int WXShadowView(uint8_t *rgba_view, int view_stride, int view_width, int view_height, int x, int y, uint8_t *rgba_fg, int fg_stride, int fg_width, int fg_height, uint8_t r, uint8_t g, uint8_t b);
 
+//rgba 黑白图第 0 通道的外接矩形，数据行宽为 mask_width * 4，等同于 WXCalculateMaskRect(alpha, mask_width, mask_height, 4, mask_width * 4, 0, rect)
 WXBGERASER_CAPI void CalculateMaskRect(const uint8_t *alpha, int mask_width, int mask_height, int *rect);
 
+/**
+计算黑白图第 channel 通道非零像素的外接矩形
+从上下两端逐行查找，找到第一行非零即停止，左右边界只在找到的行之间查找
+mask：黑白图
+width:图像宽
+height:图像高
+nb_channel:色彩空间类型，4：rgba，3：rgb，1：gray
+stride:数据行宽
+channel:判断非零的通道，0 到 nb_channel - 1
+rect:外接矩形：x,y,w,h
+返回值：-1至-4参数错误  -5：全为 0。rect 不为 NULL 时出错也会置 0
+只有一行或一列非零时 rect 的宽或高为 1，不再当作空矩形*/
+WXBGERASER_CAPI int WXCalculateMaskRect(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, int *rect);
+
+/**
+局部修改黑白图后（例如一次笔刷）增量更新外接矩形
+只有 dirty_rect 内的像素发生了变化，rect 传入修改前的外接矩形，返回修改后的外接矩形
+脏区碰到旧矩形的边时（可能擦除了边界）会重新计算整张图，否则只扫描脏区
+dirty_rect:修改的区域：x,y,w,h，可以超出图像范围
+其它参数和返回值同 WXCalculateMaskRect*/
+WXBGERASER_CAPI int WXUpdateMaskRect(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, const int *dirty_rect, int *rect);
+
+/**
+检查 rgba 图片有没有透明像素，直接读原数据，不分配内存
+rgba：图片，alpha 在每个像素的第 4 个字节
+width:图像宽
+height:图像高
+stride:数据行宽
+rect:alpha 不为 0 的像素的外接矩形：x,y,w,h，可以为 NULL，全透明时置 0
+cell_map:按 cell_size x cell_size 分格的透明度图，可以为 NULL，大小至少 ceil(width / cell_size) * ceil(height / cell_size)
+    每格 255：全不透明，0：全透明，128：半透明或两者都有
+cell_size:格子边长
+rect、cell_map 都为 NULL 时遇到第一个 alpha 不为 255 的像素就返回
+返回值：1：有透明像素  0：全不透明  -1：图片参数错误  -2：cell_size 错误*/
+WXBGERASER_CAPI int WXProbeAlpha(const uint8_t *rgba, int width, int height, int stride, int *rect, uint8_t *cell_map, int cell_size);
+
+/**
+给 rgba 图片中的形状描边，alpha > 128 的像素为形状
+用精确欧氏距离变换求每个像素到形状的距离，描边覆盖率由距离解析得到（带抗锯齿），耗时和描边宽度无关
+只处理 alpha 不为 0 的外接矩形外扩描边范围的区域，区域外直接复制原图
+dst：结果，可以等于 src
+dst_stride：结果数据行宽
+src：预乘的 rgba 图片
+width:图像宽
+height:图像高
+src_stride:数据行宽
+stroke_width：描边宽度，单位像素
+softness：描边边缘的模糊程度，同高斯模糊的 sigma，0 为不模糊
+color：描边颜色 0xAARRGGBB，不预乘，按 SRC_OVER 叠加在图片上
+返回值：0：成功  -1：src 参数错误  -2：dst 参数错误  -3：描边参数错误*/
+WXBGERASER_CAPI int WXOutlineRGBA(uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height, int src_stride, float stroke_width, float softness, uint32_t color);
+
+/**
+一条描边，用于 WXOutlineRGBAStrokes
+width：描边宽度，单位像素
+softness：描边边缘的模糊程度，同高斯模糊的 sigma，0 为不模糊
+offset：描边内侧到形状的距离，0 时描边从形状内部开始（同 WXOutlineRGBA），大于 0 时描边和形状之间留出空隙
+color：描边颜色 0xAARRGGBB，不预乘*/
+typedef struct {
+    float width;
+    float softness;
+    float offset;
+    uint32_t color;
+} WXOutlineStroke;
+
+/**
+创建 WXOutlineRGBAStrokes 的距离场缓存，不再使用时调用 WXReleaseOutlineCache 释放
+同一个缓存不能同时在多个线程中使用
+返回值：缓存，内存不足时为 NULL*/
+WXBGERASER_CAPI void *WXCreateOutlineCache(void);
+
+WXBGERASER_CAPI void WXReleaseOutlineCache(void *cache);
+
+/**
+一次给 rgba 图片画多条描边（例如白色内圈、彩色外圈、阴影），距离场只计算一次，所有描边在同一遍中逐像素叠加
+strokes：描边，按顺序叠加，后面的在上层
+count：描边条数，0 时直接复制原图
+cache：距离场缓存，可以为 NULL。src 的像素地址、尺寸、stride、source_id 都和上次相同，
+    且描边范围没有超出上次时直接复用距离场，例如只修改描边颜色
+source_id：图片内容的标识，内容改变时必须换一个值（例如 Bitmap 的 generationId）
+其它参数同 WXOutlineRGBA
+返回值：0：成功  -1：src 参数错误  -2：dst 参数错误  -3：描边参数错误*/
+WXBGERASER_CAPI int WXOutlineRGBAStrokes(uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height, int src_stride, const WXOutlineStroke *strokes, int count, void *cache, uint64_t source_id);
+
+/**
+创建羽化用的有符号距离场，mask 第 channel 通道大于 128 的像素为形状
+距离场只计算一次，之后调整羽化参数只需调用 WXFeatherMask 做映射，不再使用时调用 WXReleaseFeatherField 释放
+mask：黑白图
+width:图像宽
+height:图像高
+nb_channel:色彩空间类型，4：rgba，3：rgb，1：gray
+stride:数据行宽
+channel:形状所在的通道，0 到 nb_channel - 1
+max_outer：之后向外羽化的最大宽度，单位像素
+返回值：距离场，参数错误或内存不足时为 NULL*/
+WXBGERASER_CAPI void *WXCreateFeatherField(const uint8_t *mask, int width, int height, int nb_channel, int stride, int channel, float max_outer);
+
+WXBGERASER_CAPI void WXReleaseFeatherField(void *field);
+
+/**
+按距离场输出羽化后的黑白图：形状边界向内 inner、向外 outer 像素之间按 curve 从 255 过渡到 0
+耗时和羽化宽度无关，向内、向外可以分别控制
+field：WXCreateFeatherField 创建的距离场
+dst：结果，每个通道都写入相同的值
+dst_width、dst_height：结果的宽高，必须和创建距离场时相同
+dst_type：结果的通道数，4：rgba，3：rgb，1：gray
+dst_stride：结果数据行宽
+inner：向内羽化的宽度，单位像素
+outer：向外羽化的宽度，单位像素，超过创建时的 max_outer 按 max_outer 处理
+curve：过渡曲线，0：线性  1：smoothstep  2：高斯（同高斯模糊的边缘）
+返回值：0：成功  -1：field 为 NULL  -2：dst 参数错误  -3：羽化参数错误*/
+WXBGERASER_CAPI int WXFeatherMask(const void *field, uint8_t *dst, int dst_width, int dst_height, int dst_type, int dst_stride, float inner, float outer, int curve);
+
 #ifdef __cplusplus
 };
 #endif
@@ -1,86 +1,95 @@
 #ifndef _LIB_ENHANCE_FOREGROUND_H_
 #define _LIB_ENHANCE_FOREGROUND_H_
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "opencv2/opencv.hpp"
-
+#include "image_util.h"
+
+// 前景颜色估计，整张图不再转成 float 的 Mat，按行分条流式处理：
+// 1. 统计 mask 的外接矩形和非零像素数
+// 2. 把 roi 内去预乘的 rgb 和 mask 缩小到长边 600 的小图（INTER_AREA），半精度保存
+// 3. 小图上做 11x11 均值模糊，得到前景、背景的估计，半精度保存
+// 4. 逐行把估计值双线性放大回 roi，和原图、mask 一起算出结果直接写到 img_dst
+// 除了两张小图，只有每个线程几行的缓冲，占用内存和原图大小无关
+// band_only 时只有 0 < mask < 255 的半透明像素需要估计：2、3 两步只处理这些像素用到的小图块，
+// 其余像素 mask 为 255 时直接复制原图，为 0 时清 0
 class enhance_foreground {
 private:
-	static int prepare_rgb_data(cv::Mat& image, uint8_t * img_src_data, int img_w, int img_h, int src_type, int src_stride) {
-		if (src_type != 3 && src_type != 4 && src_type != 1)
-			return -1;
-
-		int src_row_index = 0, src_index = 0, img_index = 0;
-		float temp = 0.0f;
-		for (int i = 0; i < img_h; i++) {
-			float* image_buf = image.ptr<float>(i);
-			img_index = 0;
-			for (int j = 0; j < img_w; j++) {
-				if (src_type == 1) {
-					temp = img_src_data[src_index] / 255.0f;
-					image_buf[img_index] = temp;
-					image_buf[img_index + 1] = temp;
-					image_buf[img_index + 2] = temp;
-				}
-				else {
-                    float alpha = img_src_data[src_index + 3] / 255.0f;
-                    if (alpha != 0.0f) {
-                        image_buf[img_index] = img_src_data[src_index] / 255.0f / alpha;
-                        image_buf[img_index + 1] = img_src_data[src_index + 1] / 255.0f / alpha;
-                        image_buf[img_index + 2] = img_src_data[src_index + 2] / 255.0f / alpha;
-                    } else {
-                        image_buf[img_index] = img_src_data[src_index] / 255.0f;
-                        image_buf[img_index + 1] = img_src_data[src_index + 1] / 255.0f;
-                        image_buf[img_index + 2] = img_src_data[src_index + 2] / 255.0f;
-                    }
-				}
-				img_index += 3;
-				src_index += src_type;
-			}
-			src_row_index += src_stride;
-			src_index = src_row_index;
+	// 统计本次处理分配的内存，用于返回峰值
+	struct memory_usage {
+		std::atomic<size_t> current{0};
+		std::atomic<size_t> peak{0};
+
+		void add(size_t bytes) {
+			size_t now = current += bytes;
+			size_t max = peak.load();
+			while (now > max && !peak.compare_exchange_weak(max, now));
 		}
-		return 0;
-	}
 
-	static int prepare_alpha_data(cv::Mat& alpha, uint8_t * alpha_src_data, int img_w, int img_h, int src_alpha_type,int alpha_stride,
-                                  int& min_x, int& min_y, int& max_x, int& max_y,int& white_count, bool is_mask_alpha_channel) {
-		int src_row_index = 0, src_index = 0, alpha_index = 0;
-		white_count = 0;
-		float temp = 0.f;
-		min_x = img_w;
-		min_y = img_h;
-		max_x = -1;
-		max_y = -1;
-		for (int i = 0; i < img_h; i++) {
-			float* alpha_buf = alpha.ptr<float>(i);
-			alpha_index = 0;
-			for (int j = 0; j < img_w; j++) {
-                int alpha_data = is_mask_alpha_channel ? alpha_src_data[src_index + 3] : alpha_src_data[src_index];
-				if (alpha_data > 0) {
-					white_count++;
-					if (i < min_y)
-						min_y = i;
-					if (i > max_y)
-						max_y = i;
-					if (j < min_x)
-						min_x = j;
-					if (j > max_x)
-						max_x = j;
-
-					temp = alpha_data / 255.0f;
-
-					alpha_buf[alpha_index] = temp;
-					alpha_buf[alpha_index + 1] = temp;
-					alpha_buf[alpha_index + 2] = temp;
-				}
-				src_index += src_alpha_type;
-				alpha_index += 3;
-			}
-			src_row_index += alpha_stride;
-			src_index = src_row_index;
+		void remove(size_t bytes) {
+			current -= bytes;
 		}
-		return 0;
-	}
+	};
+
+	template<typename T>
+	struct buffer {
+		std::vector<T> data;
+		memory_usage &usage;
+
+		buffer(memory_usage &usage, size_t count) : data(count), usage(usage) {
+			usage.add(count * sizeof(T));
+		}
+
+		~buffer() {
+			usage.remove(data.size() * sizeof(T));
+		}
+
+		T *ptr() {
+			return data.data();
+		}
+	};
+
+	// 一个方向上的缩放系数：目标位置 i 由 index[k] 处的源像素乘 weight[k] 累加得到，k 在 [start[i], start[i + 1]) 内
+	struct resize_tab {
+		std::vector<int> start;
+		std::vector<int> index;
+		std::vector<float> weight;
+
+		void push(int i, float w) {
+			index.push_back(i);
+			weight.push_back(w);
+		}
+
+		size_t bytes() const {
+			return start.size() * sizeof(int) + index.size() * sizeof(int) + weight.size() * sizeof(float);
+		}
+	};
+
+	// 原图和 mask
+	struct planes {
+		const uint8_t *src;
+		int src_type;
+		int src_stride;
+		const uint8_t *alpha;
+		int alpha_type;
+		int alpha_stride;
+		int alpha_offset;
+	};
+
+	// 小图每个像素的通道数：去预乘的 rgb 和 mask
+	static const int small_channels = 4;
+	// 估计值每个像素的通道数：前景 rgb 和背景 rgb
+	static const int est_channels = 6;
+	// 均值模糊的通道数：mask，前景 img*a*a，背景 img*(1-a)^2
+	static const int blur_channels = 7;
+	static const int blur_size = 11;
+	// 小图分块的边长
+	static const int tile = 8;
+	// 放大估计值时按这么多列一段按需计算
+	static const int segment = 64;
 
 	static uint8_t clip(float f) {
 		uint8_t r = 0;
@@ -93,76 +102,481 @@ private:
 		return r;
 	}
 
-	static int mat_div(cv::Mat& src1, cv::Mat& src2, cv::Mat& dst, float gamma, int img_w, int img_h) {
-		int img_index = 0;
-		float tmp = 0.0f;
-		for (int i = 0; i < img_h; i++) {
-			float* src1_buf = src1.ptr<float>(i);
-			float* src2_buf = src2.ptr<float>(i);
-			float* dst_buf = dst.ptr<float>(i);
-			img_index = 0;
-			for (int j = 0; j < img_w; j++) {
-				dst_buf[img_index] = src1_buf[img_index] / (src2_buf[img_index] + gamma);
-				img_index += 1;
-				dst_buf[img_index] = src1_buf[img_index] / (src2_buf[img_index] + gamma);
-				img_index += 1;
-				dst_buf[img_index] = src1_buf[img_index] / (src2_buf[img_index] + gamma);
-				img_index += 1;
+	// i / 255.0f
+	static const float *unit_table() {
+		static const struct table {
+			float v[256];
+			table() {
+				for (int i = 0; i < 256; i++)
+					v[i] = i / 255.0f;
 			}
+		} t;
+		return t.v;
+	}
+
+	// 去预乘的 rgb，范围 0-1；不透明像素除以 1.0f 结果不变，不用做除法
+	static void load_rgb(const uint8_t *p, int src_type, float *rgb) {
+		const float *unit = unit_table();
+		if (src_type == 1) {
+			rgb[0] = rgb[1] = rgb[2] = unit[p[0]];
+			return;
+		}
+		if (src_type == 3 || p[3] == 255 || p[3] == 0) {
+			for (int c = 0; c < 3; c++)
+				rgb[c] = unit[p[c]];
+			return;
+		}
+		float alpha = unit[p[3]];
+		for (int c = 0; c < 3; c++)
+			rgb[c] = unit[p[c]] / alpha;
+	}
+
+	// roi 中第 y 行的 [x0, x1) 转为 float：每个像素 rgb 和 mask
+	static void load_row(float *row, const planes &p, int y, int x0, int x1) {
+		const uint8_t *src = p.src + (size_t) y * p.src_stride + (size_t) x0 * p.src_type;
+		const uint8_t *alpha = p.alpha + (size_t) y * p.alpha_stride + (size_t) x0 * p.alpha_type + p.alpha_offset;
+		for (int j = 0; j < x1 - x0; j++) {
+			load_rgb(src + j * p.src_type, p.src_type, row + j * small_channels);
+			row[j * small_channels + 3] = unit_table()[alpha[j * p.alpha_type]];
+		}
+	}
+
+	// 同 cv::resize 的 INTER_AREA 缩小
+	static void area_tab(resize_tab &tab, int ssize, int dsize) {
+		double scale = 1. / ((double) dsize / ssize);
+		tab.start.push_back(0);
+		for (int dx = 0; dx < dsize; dx++) {
+			double fsx1 = dx * scale, fsx2 = fsx1 + scale;
+			double cell_width = std::min(scale, ssize - fsx1);
+			int sx1 = cvCeil(fsx1), sx2 = cvFloor(fsx2);
+			sx2 = std::min(sx2, ssize - 1);
+			sx1 = std::min(sx1, sx2);
+			if (sx1 - fsx1 > 1e-3)
+				tab.push(sx1 - 1, (float) ((sx1 - fsx1) / cell_width));
+			for (int sx = sx1; sx < sx2; sx++)
+				tab.push(sx, (float) (1.0 / cell_width));
+			if (fsx2 - sx2 > 1e-3)
+				tab.push(sx2, (float) (std::min(std::min(fsx2 - sx2, 1.), cell_width) / cell_width));
+			tab.start.push_back((int) tab.index.size());
 		}
-		return 0;
 	}
 
-	static int mat_div1(cv::Mat& src1, cv::Mat& src2, cv::Mat& dst, float gamma, int img_w, int img_h) {
-		int img_index = 0;
-		float tmp = 0.0f;
-		for (int i = 0; i < img_h; i++) {
-			float* src1_buf = src1.ptr<float>(i);
-			float* src2_buf = src2.ptr<float>(i);
-			float* dst_buf = dst.ptr<float>(i);
-			img_index = 0;
-			for (int j = 0; j < img_w; j++) {
-				dst_buf[img_index] = src1_buf[img_index] / (gamma - src2_buf[img_index]);
-				img_index += 1;
-				dst_buf[img_index] = src1_buf[img_index] / (gamma - src2_buf[img_index]);
-				img_index += 1;
-				dst_buf[img_index] = src1_buf[img_index] / (gamma - src2_buf[img_index]);
-				img_index += 1;
+	// 同 cv::resize 的 INTER_LINEAR，area_mode 为 INTER_AREA 放大时的系数
+	static void linear_tab(resize_tab &tab, int ssize, int dsize, bool area_mode) {
+		double inv_scale = (double) dsize / ssize, scale = 1. / inv_scale;
+		tab.start.push_back(0);
+		for (int dx = 0; dx < dsize; dx++) {
+			int sx;
+			float fx;
+			if (!area_mode) {
+				fx = (float) ((dx + 0.5) * scale - 0.5);
+				sx = cvFloor(fx);
+				fx -= sx;
+			} else {
+				sx = cvFloor(dx * scale);
+				fx = (float) ((dx + 1) - (sx + 1) * inv_scale);
+				fx = fx <= 0 ? 0.f : fx - cvFloor(fx);
+			}
+			if (sx < 0) {
+				fx = 0;
+				sx = 0;
 			}
+			if (sx >= ssize - 1) {
+				fx = 0;
+				sx = ssize - 1;
+			}
+			tab.push(sx, 1.f - fx);
+			tab.push(std::min(sx + 1, ssize - 1), fx);
+			tab.start.push_back((int) tab.index.size());
 		}
-		return 0;
 	}
 
-	static int save_result(cv::Mat& img_fg, uint8_t * img_dst, int img_w, int img_h, int dst_type, int dst_stride, int min_x, int min_y, int max_x, int max_y) {
-		int dst_row_index = dst_stride*min_y, dst_index = dst_row_index, img_index = 0;
-		int st_img = 3 * min_x;
-		int st_dst = min_x*dst_type;
-		float temp = 0.0f;
-		if (max_x - min_x < img_w || max_y - min_y < img_h) {
-			memset(img_dst, (uint8_t)0, sizeof(uint8_t)*dst_stride*img_h);
+	static void mask_stats(const planes &p, int img_w, int img_h, int &min_x, int &min_y, int &max_x, int &max_y, int &white_count) {
+		min_x = img_w;
+		min_y = img_h;
+		max_x = -1;
+		max_y = -1;
+		white_count = 0;
+		std::mutex mutex;
+		cv::parallel_for_(cv::Range(0, img_h), [&](const cv::Range &range) {
+			int local_min_x = img_w, local_min_y = img_h, local_max_x = -1, local_max_y = -1, count = 0;
+			for (int i = range.start; i < range.end; i++) {
+				const uint8_t *row = p.alpha + (size_t) i * p.alpha_stride + p.alpha_offset;
+				int row_count = 0;
+				for (int j = 0; j < img_w; j++)
+					row_count += row[j * p.alpha_type] > 0;
+				if (row_count > 0) {
+					int first = 0, last = img_w - 1;
+					while (row[first * p.alpha_type] == 0)
+						first++;
+					while (row[last * p.alpha_type] == 0)
+						last--;
+					count += row_count;
+					local_min_y = std::min(local_min_y, i);
+					local_max_y = i;
+					local_min_x = std::min(local_min_x, first);
+					local_max_x = std::max(local_max_x, last);
+				}
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			min_x = std::min(min_x, local_min_x);
+			min_y = std::min(min_y, local_min_y);
+			max_x = std::max(max_x, local_max_x);
+			max_y = std::max(max_y, local_max_y);
+			white_count += count;
+		}, image_util::stripes(img_h));
+	}
+
+	// 小图按 tile x tile 分块，只处理标记了的块
+	struct tile_map {
+		int cols;
+		int rows;
+		std::vector<uint8_t> flags;
+
+		tile_map(int w, int h, uint8_t value) : cols((w + tile - 1) / tile), rows((h + tile - 1) / tile), flags((size_t) cols * rows, value) {}
+
+		uint8_t *row(int ty) {
+			return &flags[(size_t) ty * cols];
+		}
+
+		const uint8_t *row(int ty) const {
+			return &flags[(size_t) ty * cols];
+		}
+	};
+
+	// 对一行块中每段连续标记的块 [tx0, tx1) 调用 f
+	template<typename F>
+	static void for_each_run(const uint8_t *flags, int cols, F f) {
+		for (int tx = 0; tx < cols; tx++) {
+			if (!flags[tx])
+				continue;
+			int begin = tx;
+			while (tx < cols && flags[tx])
+				tx++;
+			f(begin, tx);
 		}
-		for (int i = min_y; i < max_y; i++) {
-			float* image_buf = img_fg.ptr<float>(i);
-			img_index = st_img;
-			dst_index += st_dst;
-			for (int j = min_x; j < max_x; j++) {
-				if (dst_type == 1) {
-					img_dst[dst_index] = clip(image_buf[img_index] * 255.0f);
+	}
+
+	// 只处理半透明区域时，标记 roi 中 0 < mask < 255 的像素放大时用到的小图块
+	static void band_tiles(tile_map &tiles, const planes &p, int x0, int y0, int x1, int y1, const resize_tab &up_x, const resize_tab &up_y) {
+		cv::parallel_for_(cv::Range(0, tiles.rows), [&](const cv::Range &range) {
+			for (int ty = range.start; ty < range.end; ty++) {
+				uint8_t *flags = tiles.row(ty);
+				const int sy_begin = ty * tile, sy_end = sy_begin + tile;
+				for (int y = 0; y < y1 - y0; y++) {
+					int k = up_y.start[y];
+					if (up_y.index[k + 1] < sy_begin)
+						continue;
+					if (up_y.index[k] >= sy_end)
+						break;
+					const uint8_t *alpha = p.alpha + (size_t) (y0 + y) * p.alpha_stride + (size_t) x0 * p.alpha_type + p.alpha_offset;
+					for (int x = 0; x < x1 - x0; x++) {
+						if ((uint8_t) (alpha[x * p.alpha_type] - 1) < 254) {
+							int kx = up_x.start[x];
+							flags[up_x.index[kx] / tile] = 1;
+							flags[up_x.index[kx + 1] / tile] = 1;
+						}
+					}
 				}
-				else {
-					img_dst[dst_index] = clip(image_buf[img_index] * 255.0f);
-					img_dst[dst_index + 1] = clip(image_buf[img_index + 1] * 255.0f);
-					img_dst[dst_index + 2] = clip(image_buf[img_index + 2] * 255.0f);
-					img_dst[dst_index + 3] = 255;
+			}
+		});
+	}
+
+	// 每个块向外扩一块，均值模糊的半径小于一块
+	static void dilate_tiles(tile_map &dst, const tile_map &src) {
+		for (int ty = 0; ty < src.rows; ty++) {
+			for (int tx = 0; tx < src.cols; tx++) {
+				if (!src.row(ty)[tx])
+					continue;
+				for (int i = std::max(ty - 1, 0); i <= std::min(ty + 1, src.rows - 1); i++)
+					for (int j = std::max(tx - 1, 0); j <= std::min(tx + 1, src.cols - 1); j++)
+						dst.row(i)[j] = 1;
+			}
+		}
+	}
+
+	// roi [x0, x1) x [y0, y1) 缩放到 w x h 的小图，只计算 tiles 中标记的块
+	static void shrink(cv::hfloat *small, int w, int h, const planes &p, int x0, int y0, int x1, const resize_tab &xtab,
+					   const resize_tab &ytab, const tile_map &tiles, memory_usage &usage) {
+		cv::parallel_for_(cv::Range(0, h), [&](const cv::Range &range) {
+			buffer<float> row(usage, (size_t) (x1 - x0) * small_channels);
+			buffer<float> hrow(usage, (size_t) w * small_channels);
+			buffer<float> sum(usage, (size_t) w * small_channels);
+			for (int dy = range.start; dy < range.end; dy++) {
+				for_each_run(tiles.row(dy / tile), tiles.cols, [&](int tx0, int tx1) {
+					const int c0 = tx0 * tile, c1 = std::min(w, tx1 * tile);
+					// 这些小图像素用到的 roi 列
+					const int s0 = xtab.index[xtab.start[c0]], s1 = xtab.index[xtab.start[c1] - 1] + 1;
+					std::fill(sum.ptr() + c0 * small_channels, sum.ptr() + c1 * small_channels, 0.f);
+					for (int k = ytab.start[dy]; k < ytab.start[dy + 1]; k++) {
+						float beta = ytab.weight[k];
+						if (beta == 0.f)
+							continue;
+						load_row(row.ptr() + s0 * small_channels, p, y0 + ytab.index[k], x0 + s0, x0 + s1);
+						for (int dx = c0; dx < c1; dx++) {
+							float *d = hrow.ptr() + dx * small_channels;
+							std::fill(d, d + small_channels, 0.f);
+							for (int n = xtab.start[dx]; n < xtab.start[dx + 1]; n++) {
+								const float *s = row.ptr() + xtab.index[n] * small_channels;
+								float alpha = xtab.weight[n];
+								for (int c = 0; c < small_channels; c++)
+									d[c] += s[c] * alpha;
+							}
+						}
+						for (int i = c0 * small_channels; i < c1 * small_channels; i++)
+							sum.data[i] += hrow.data[i] * beta;
+					}
+					cv::hfloat *dst = small + (size_t) dy * w * small_channels;
+					for (int i = c0 * small_channels; i < c1 * small_channels; i++)
+						dst[i] = cv::hfloat(sum.data[i]);
+				});
+			}
+		}, image_util::stripes(h));
+	}
+
+	// 小图一行 [c0, c1) 的 7 个模糊通道水平方向的 11 点和（BORDER_REFLECT_101），计算顺序同原来的 multiply/scaleAdd/add
+	static void blur_row_h(double *dst, const cv::hfloat *small_row, int w, int c0, int c1, float *terms) {
+		const int r = blur_size / 2;
+		for (int j = c0 - r; j < c1 + r; j++) {
+			const cv::hfloat *px = small_row + image_util::reflect_101(j, w) * small_channels;
+			float *v = terms + (j - c0 + r) * blur_channels;
+			float a = px[3];
+			v[0] = a;
+			for (int c = 0; c < 3; c++) {
+				float img = px[c];
+				float img_alpha = img * a;
+				float img_asq = img_alpha * a;
+				v[1 + c] = img_asq;
+				v[4 + c] = img_alpha * -2 + img + img_asq;
+			}
+		}
+		for (int c = 0; c < blur_channels; c++) {
+			double s = 0;
+			for (int k = 0; k < blur_size; k++)
+				s += terms[k * blur_channels + c];
+			dst[c] = s;
+			for (int j = 1; j < c1 - c0; j++) {
+				s += terms[(j + blur_size - 1) * blur_channels + c] - terms[(j - 1) * blur_channels + c];
+				dst[j * blur_channels + c] = s;
+			}
+		}
+	}
+
+	// 小图上 11x11 均值模糊，得到前景 blurred_fg 和背景 blurred_bg，只计算 tiles 中标记的块
+	// bg_add 为 true 时背景除以 blurred_alpha + 1，否则除以 1 - blurred_alpha，与原来两个分支一致
+	static void estimate(cv::hfloat *est, const cv::hfloat *small, int w, int h, bool bg_add, const tile_map &tiles, memory_usage &usage) {
+		const int r = blur_size / 2;
+		const double scale = 1. / (blur_size * blur_size);
+		cv::parallel_for_(cv::Range(0, tiles.rows), [&](const cv::Range &range) {
+			const size_t row_size = (size_t) w * blur_channels;
+			buffer<float> terms(usage, (size_t) (w + blur_size - 1) * blur_channels);
+			buffer<double> sums(usage, row_size * (tile + blur_size - 1));
+			buffer<double> col(usage, row_size);
+			for (int ty = range.start; ty < range.end; ty++) {
+				const int r0 = ty * tile, r1 = std::min(h, r0 + tile);
+				for_each_run(tiles.row(ty), tiles.cols, [&](int tx0, int tx1) {
+					const int c0 = tx0 * tile, c1 = std::min(w, tx1 * tile);
+					const size_t size = (size_t) (c1 - c0) * blur_channels;
+					// 第 r0 - r 到 r1 + r - 1 行的水平和
+					for (int y = r0 - r; y < r1 + r; y++)
+						blur_row_h(sums.ptr() + (y - r0 + r) * size, small + (size_t) image_util::reflect_101(y, h) * w * small_channels, w, c0, c1, terms.ptr());
+					std::fill(col.ptr(), col.ptr() + size, 0.);
+					for (int k = 0; k < blur_size; k++)
+						for (size_t i = 0; i < size; i++)
+							col.data[i] += sums.data[k * size + i];
+					for (int y = r0; y < r1; y++) {
+						if (y > r0) {
+							const double *add = sums.ptr() + (y - r0 + blur_size - 1) * size, *sub = sums.ptr() + (y - r0 - 1) * size;
+							for (size_t i = 0; i < size; i++)
+								col.data[i] += add[i] - sub[i];
+						}
+						cv::hfloat *dst = est + (size_t) y * w * est_channels;
+						for (int j = c0; j < c1; j++) {
+							const double *s = col.ptr() + (j - c0) * blur_channels;
+							float blurred_alpha = (float) (s[0] * scale);
+							float fg_div = blurred_alpha + (float) 1e-5;
+							float bg_div = bg_add ? blurred_alpha + (float) (1 + 1e-5) : (float) (1 + 1e-5) - blurred_alpha;
+							for (int c = 0; c < 3; c++) {
+								dst[j * est_channels + c] = cv::hfloat((float) (s[1 + c] * scale) / fg_div);
+								dst[j * est_channels + 3 + c] = cv::hfloat((float) (s[4 + c] * scale) / bg_div);
+							}
+						}
+					}
+				});
+			}
+		});
+	}
+
+	// 估计值的一行 [begin, end) 列水平放大到 roi 宽
+	static void expand_row(float *dst, const cv::hfloat *est_row, const resize_tab &xtab, int begin, int end) {
+		for (int x = begin; x < end; x++) {
+			int k = xtab.start[x];
+			const cv::hfloat *s0 = est_row + xtab.index[k] * est_channels;
+			const cv::hfloat *s1 = est_row + xtab.index[k + 1] * est_channels;
+			float a0 = xtab.weight[k], a1 = xtab.weight[k + 1];
+			for (int c = 0; c < est_channels; c++)
+				dst[x * est_channels + c] = (float) s0[c] * a0 + (float) s1[c] * a1;
+		}
+	}
+
+	// 逐行放大估计值，算出前景颜色写到 img_dst，roi 外清 0
+	// band_only 时 mask 为 0 的像素清 0，为 255 的像素直接复制原图，只有半透明像素使用估计值
+	static void compose(uint8_t *img_dst, int dst_type, int dst_stride, int img_w, int img_h, const planes &p, const cv::hfloat *est,
+						int w, int x0, int y0, int x1, int y1, const resize_tab &xtab, const resize_tab &ytab, bool band_only,
+						memory_usage &usage) {
+		const int roi_w = x1 - x0;
+		const int segments = (roi_w + segment - 1) / segment;
+		const bool clear = x1 - x0 < img_w || y1 - y0 < img_h;
+		cv::parallel_for_(cv::Range(0, img_h), [&](const cv::Range &range) {
+			// 两行放大后的估计值，按 segment 列一段在用到时才计算
+			buffer<float> rows(usage, (size_t) 2 * roi_w * est_channels);
+			buffer<uint8_t> valid(usage, (size_t) 2 * segments);
+			float *cache[2] = {rows.ptr(), rows.ptr() + (size_t) roi_w * est_channels};
+			int cached[2] = {-1, -1};
+			for (int y = range.start; y < range.end; y++) {
+				uint8_t *dst = img_dst + (size_t) y * dst_stride;
+				if (y < y0 || y >= y1) {
+					if (clear)
+						memset(dst, 0, dst_stride);
+					continue;
 				}
 
-				img_index += 3;
-				dst_index += dst_type;
+				int k = ytab.start[y - y0];
+				int slot[2];
+				for (int n = 0; n < 2; n++) {
+					int sy = ytab.index[k + n];
+					slot[n] = cached[0] == sy ? 0 : cached[1] == sy ? 1 : -1;
+					if (slot[n] < 0) {
+						// 不能覆盖这一行要用的另一行
+						slot[n] = cached[0] == ytab.index[k + 1 - n] ? 1 : 0;
+						cached[slot[n]] = sy;
+						memset(valid.ptr() + slot[n] * segments, 0, segments);
+					}
+				}
+				const float *r[2] = {cache[slot[0]], cache[slot[1]]};
+				float b0 = ytab.weight[k], b1 = ytab.weight[k + 1];
+
+				const uint8_t *src = p.src + (size_t) y * p.src_stride;
+				const uint8_t *alpha = p.alpha + (size_t) y * p.alpha_stride + p.alpha_offset;
+				for (int j = x0; j < x1; j++) {
+					const uint8_t *px = src + j * p.src_type;
+					uint8_t mask = alpha[j * p.alpha_type];
+					uint8_t *d = dst + j * dst_type;
+					uint8_t out[3];
+					if (band_only && mask == 0) {
+						for (int c = 0; c < dst_type; c++)
+							d[c] = 0;
+						continue;
+					} else if (band_only && mask == 255 && (p.src_type != 4 || px[3] == 255)) {
+						out[0] = px[0];
+						out[1] = px[p.src_type == 1 ? 0 : 1];
+						out[2] = px[p.src_type == 1 ? 0 : 2];
+					} else {
+						float rgb[3];
+						load_rgb(px, p.src_type, rgb);
+						if (band_only && mask == 255) {
+							for (int c = 0; c < 3; c++)
+								out[c] = clip(rgb[c] * 255.0f);
+						} else {
+							int seg = (j - x0) / segment;
+							for (int n = 0; n < 2; n++) {
+								uint8_t *v = valid.ptr() + slot[n] * segments + seg;
+								if (!*v) {
+									expand_row(cache[slot[n]], est + (size_t) cached[slot[n]] * w * est_channels, xtab, seg * segment,
+											   std::min(roi_w, seg * segment + segment));
+									*v = 1;
+								}
+							}
+							float a = unit_table()[mask];
+							const float *e0 = r[0] + (j - x0) * est_channels, *e1 = r[1] + (j - x0) * est_channels;
+							for (int c = 0; c < 3; c++) {
+								float blurred_fg = e0[c] * b0 + e1[c] * b1;
+								float blurred_bg = e0[3 + c] * b0 + e1[3 + c] * b1;
+								float t = blurred_fg - blurred_bg;
+								t = a * t;
+								t = rgb[c] - t;
+								t = t - blurred_bg;
+								t = a * t;
+								out[c] = clip((blurred_fg + t) * 255.0f);
+							}
+						}
+					}
+					if (dst_type == 1) {
+						d[0] = out[0];
+					} else {
+						d[0] = out[0];
+						d[1] = out[1];
+						d[2] = out[2];
+						if (dst_type == 4)
+							d[3] = 255;
+					}
+				}
+				if (clear) {
+					memset(dst, 0, (size_t) x0 * dst_type);
+					memset(dst + (size_t) x1 * dst_type, 0, dst_stride - (size_t) x1 * dst_type);
+				}
 			}
-			dst_row_index += dst_stride;
-			dst_index = dst_row_index;
+		}, image_util::stripes(img_h));
+	}
+
+	static bool overlaps(const uint8_t *a, size_t a_size, const uint8_t *b, size_t b_size) {
+		return a < b + b_size && b < a + a_size;
+	}
+
+	// img_dst 和输入重叠时，只有行宽、像素类型都相同才能逐像素原地处理，否则先复制输入
+	static const uint8_t *detach(const uint8_t *data, int type, int stride, const uint8_t *img_dst, int dst_type, int dst_stride, int img_h,
+								 std::unique_ptr<buffer<uint8_t>> &copy, memory_usage &usage) {
+		size_t size = (size_t) stride * img_h;
+		if (!overlaps(data, size, img_dst, (size_t) dst_stride * img_h) ||
+			(data == img_dst && stride == dst_stride && type == dst_type))
+			return data;
+		copy.reset(new buffer<uint8_t>(usage, size));
+		memcpy(copy->ptr(), data, size);
+		return copy->ptr();
+	}
+
+	static void run(uint8_t *img_dst, int dst_type, int dst_stride, int img_width, int img_height, planes p,
+					int min_x, int min_y, int max_x, int max_y, int w, int h, bool shrinked, bool band_only, memory_usage &usage) {
+		const int roi_w = max_x - min_x, roi_h = max_y - min_y;
+		std::unique_ptr<buffer<uint8_t>> src_copy, alpha_copy;
+		p.src = detach(p.src, p.src_type, p.src_stride, img_dst, dst_type, dst_stride, img_height, src_copy, usage);
+		p.alpha = detach(p.alpha, p.alpha_type, p.alpha_stride, img_dst, dst_type, dst_stride, img_height, alpha_copy, usage);
+
+		// 缩小：两个方向都不放大时用 INTER_AREA，否则用 INTER_AREA 放大时的双线性系数；放大回 roi 用 INTER_LINEAR
+		resize_tab down_x, down_y, up_x, up_y;
+		if (roi_w >= w && roi_h >= h) {
+			area_tab(down_x, roi_w, w);
+			area_tab(down_y, roi_h, h);
+		} else {
+			linear_tab(down_x, roi_w, w, true);
+			linear_tab(down_y, roi_h, h, true);
 		}
-		return 0;
+		linear_tab(up_x, w, roi_w, false);
+		linear_tab(up_y, h, roi_h, false);
+		size_t tab_bytes = down_x.bytes() + down_y.bytes() + up_x.bytes() + up_y.bytes();
+		usage.add(tab_bytes);
+
+		// band_only 时只估计半透明像素用到的块，缩小时再向外扩一块供模糊使用
+		tile_map est_tiles(w, h, !band_only), small_tiles(w, h, !band_only);
+		if (band_only) {
+			band_tiles(est_tiles, p, min_x, min_y, max_x, max_y, up_x, up_y);
+			dilate_tiles(small_tiles, est_tiles);
+		}
+		size_t tile_bytes = est_tiles.flags.size() + small_tiles.flags.size();
+		usage.add(tile_bytes);
+
+		{
+			buffer<cv::hfloat> est(usage, (size_t) w * h * est_channels);
+			{
+				buffer<cv::hfloat> small(usage, (size_t) w * h * small_channels);
+				shrink(small.ptr(), w, h, p, min_x, min_y, max_x, down_x, down_y, small_tiles, usage);
+				estimate(est.ptr(), small.ptr(), w, h, shrinked, est_tiles, usage);
+			}
+			compose(img_dst, dst_type, dst_stride, img_width, img_height, p, est.ptr(), w, min_x, min_y, max_x, max_y, up_x, up_y,
+					band_only, usage);
+		}
+		usage.remove(tile_bytes);
+		usage.remove(tab_bytes);
 	}
 
 	static void set_margin(int& min_x, int& min_y, int& max_x, int& max_y, int margin, int img_width, int img_height) {
@@ -182,13 +596,11 @@ private:
 
 public:
 	static int enhance(uint8_t * img_dst, int dst_type, int dst_stride, uint8_t * img_src, int img_width, int img_height, int src_type, int src_stride,
-                       uint8_t * alpha_src, int alpha_type, int alpha_stride,int *rect, bool is_mask_alpha_channel) {
-		cv::Mat alpha = cv::Mat::zeros(img_height, img_width, CV_32FC3);
-		if (alpha.empty())
-			return -6;
+                       uint8_t * alpha_src, int alpha_type, int alpha_stride, int *rect, bool is_mask_alpha_channel, bool band_only = false, size_t *peak_memory = NULL) {
+		memory_usage usage;
+		planes p = {img_src, src_type, src_stride, alpha_src, alpha_type, alpha_stride, is_mask_alpha_channel ? 3 : 0};
 		int min_x, min_y, max_x, max_y, white_count;
-		prepare_alpha_data(alpha, alpha_src, img_width, img_height, alpha_type, alpha_stride, min_x,
-						   min_y, max_x, max_y, white_count, is_mask_alpha_channel);
+		mask_stats(p, img_width, img_height, min_x, min_y, max_x, max_y, white_count);
 
 		if (rect != NULL) {
 			if (max_x <= min_x || max_y <= min_y) {
@@ -203,6 +615,8 @@ public:
 				rect[3] = max_y - min_y + 1;
 			}
 		}
+		if (peak_memory != NULL)
+			*peak_memory = 0;
 
 		if ((max_x - min_x) <= 5 || (max_y - min_y) <= 5)//???????
 			return -7;
@@ -216,26 +630,13 @@ public:
 		if (sw2 < 0.06f)//???????
 			return -9;
 
-		cv::Mat image = cv::Mat(img_height, img_width, CV_32FC3);
-		if (image.empty())
-			return -6;
-		prepare_rgb_data(image, img_src, img_width, img_height, src_type, src_stride);
-
-
-		cv::Mat img_fg;
+		// 估计在 w x h 的小图上进行；长边不超过 600 时就在原图上进行，背景的分母也不同
 		int const_size = 600;
 		int max_ = (img_width > img_height ? img_width : img_height);
-		if (max_ > const_size) {
-			cv::Mat image_s;
-			cv::Mat alpha_s;
-			int w = 0, h = 0;
-			cv::Mat image_roi;
-			cv::Mat alpha_roi;
-			//cv::Rect roi;
-			int roi_w = 0, roi_h = 0;
-
-			if (sw1 < 1.2f) {
-				//???roi
+		bool shrinked = max_ > const_size;
+		int w = img_width, h = img_height;
+		if (!shrinked || sw1 < 1.2f) {
+			if (shrinked) {
 				if (img_width == max_) {
 					h = const_size * img_height / img_width;
 					w = const_size;
@@ -243,139 +644,34 @@ public:
 					w = const_size * img_width / img_height;
 					h = const_size;
 				}
-				min_x = 0;
-				min_y = 0;
-				max_x = img_width;
-				max_y = img_height;
-			} else {
-				set_margin(min_x, min_y, max_x, max_y, max_ > 1500 ? 100 : 50, img_width,
-						   img_height);
-				max_x = max_x + 1;
-				max_y = max_y + 1;
-				roi_w = max_x - min_x;
-				roi_h = max_y - min_y;
-				cv::Rect roi(min_x, min_y, roi_w, roi_h);
-
-				image_roi = image(roi);
-				alpha_roi = alpha(roi);
-
-				max_ = (roi_w > roi_h ? roi_w : roi_h);
-				if (roi_w == max_) {
-					h = const_size * roi_h / roi_w;
-					w = const_size;
-				} else {
-					w = const_size * roi_w / roi_h;
-					h = const_size;
-				}
-			}
-			cv::Size resize_size(w, h);
-
-			if (image_roi.empty()) {
-				cv::resize(image, image_s, resize_size, 0, 0, cv::INTER_AREA);
-				cv::resize(alpha, alpha_s, resize_size, 0, 0, cv::INTER_AREA);
-			} else {
-				cv::resize(image_roi, image_s, resize_size, 0, 0, cv::INTER_AREA);
-				cv::resize(alpha_roi, alpha_s, resize_size, 0, 0, cv::INTER_AREA);
-			}
-
-			cv::Mat blurred_alpha;
-			cv::Size blur_size(11, 11);
-			cv::blur(alpha_s, blurred_alpha, blur_size);
-
-			cv::Mat img_alpha;
-			cv::multiply(image_s, alpha_s, img_alpha);
-			cv::Mat img_asq;
-			cv::multiply(img_alpha, alpha_s, img_asq);
-
-			cv::Mat bg_s;
-			cv::scaleAdd(img_alpha, -2, image_s, bg_s);
-			cv::add(bg_s, img_asq, bg_s);
-
-			cv::Mat blurred_fg_alpha;
-			cv::blur(img_asq, blurred_fg_alpha, blur_size);
-			cv::Mat blurred_fg_ = cv::Mat(h, w, CV_32FC3);
-			mat_div(blurred_fg_alpha, blurred_alpha, blurred_fg_, (float) 1e-5, w, h);
-
-			cv::Mat blurred_bg_alpha;
-			cv::blur(bg_s, blurred_bg_alpha, blur_size);
-			cv::Mat blurred_bg_ = cv::Mat(h, w, CV_32FC3);
-			mat_div(blurred_bg_alpha, blurred_alpha, blurred_bg_, (float) (1 + 1e-5), w, h);
-
-			cv::Mat blurred_fg;
-			cv::Mat blurred_bg;
-
-			if (image_roi.empty()) {
-				cv::Size img_size(img_width, img_height);
-				cv::resize(blurred_fg_, blurred_fg, img_size);
-				cv::resize(blurred_bg_, blurred_bg, img_size);
-				cv::subtract(blurred_fg, blurred_bg, img_fg);
-				cv::multiply(alpha, img_fg, img_fg);
-				cv::subtract(image, img_fg, img_fg);
-				cv::subtract(img_fg, blurred_bg, img_fg);
-				cv::multiply(alpha, img_fg, img_fg);
-				cv::add(blurred_fg, img_fg, img_fg);
-			} else {
-				cv::Size img_size(roi_w, roi_h);
-				cv::resize(blurred_fg_, blurred_fg, img_size);
-				cv::resize(blurred_bg_, blurred_bg, img_size);
-
-				cv::Mat img_fg_;
-				cv::subtract(blurred_fg, blurred_bg, img_fg_);
-				cv::multiply(alpha_roi, img_fg_, img_fg_);
-				cv::subtract(image_roi, img_fg_, img_fg_);
-				cv::subtract(img_fg_, blurred_bg, img_fg_);
-				cv::multiply(alpha_roi, img_fg_, img_fg_);
-				cv::add(blurred_fg, img_fg_, img_fg_);
-
-				//img_fg = cv::Mat::zeros(img_height, img_width, CV_32FC3);
-
-				//cv::Mat img_fg_roi = img_fg(roi);
-				//img_fg_.copyTo(img_fg_roi);
-				img_fg_.copyTo(image_roi);
-				img_fg = image;
 			}
-		} else {
-			cv::Mat img_alpha;
-			cv::multiply(image, alpha, img_alpha);
-			cv::Mat img_asq;
-			cv::multiply(img_alpha, alpha, img_asq);
-
-			cv::Mat img_bg;
-			cv::scaleAdd(img_alpha, -2, image, img_bg);
-			cv::add(img_bg, img_asq, img_bg);
-
-			cv::Mat blurred_alpha;
-			cv::Size blur_size(11, 11);
-			cv::blur(alpha, blurred_alpha, blur_size);
-
-			cv::Mat blurred_fg_alpha;
-			cv::blur(img_asq, blurred_fg_alpha, blur_size);
-			cv::Mat blurred_fg = cv::Mat(img_height, img_width, CV_32FC3);
-			mat_div(blurred_fg_alpha, blurred_alpha, blurred_fg, (float) 1e-5, img_width,
-					img_height);
-
-			cv::Mat blurred_bg_alpha;
-			cv::blur(img_bg, blurred_bg_alpha, blur_size);
-			cv::Mat blurred_bg = cv::Mat(img_height, img_width, CV_32FC3);
-			mat_div1(blurred_bg_alpha, blurred_alpha, blurred_bg, (float) (1 + 1e-5), img_width,
-					 img_height);
-
-			cv::subtract(blurred_fg, blurred_bg, img_fg);
-			cv::multiply(alpha, img_fg, img_fg);
-			cv::subtract(image, img_fg, img_fg);
-			cv::subtract(img_fg, blurred_bg, img_fg);
-			cv::multiply(alpha, img_fg, img_fg);
-			cv::add(blurred_fg, img_fg, img_fg);
 			min_x = 0;
 			min_y = 0;
 			max_x = img_width;
 			max_y = img_height;
+		} else {
+			set_margin(min_x, min_y, max_x, max_y, max_ > 1500 ? 100 : 50, img_width, img_height);
+			max_x = max_x + 1;
+			max_y = max_y + 1;
+			int roi_w = max_x - min_x, roi_h = max_y - min_y;
+			max_ = (roi_w > roi_h ? roi_w : roi_h);
+			if (roi_w == max_) {
+				h = const_size * roi_h / roi_w;
+				w = const_size;
+			} else {
+				w = const_size * roi_w / roi_h;
+				h = const_size;
+			}
 		}
-
-		save_result(img_fg, img_dst, img_width, img_height, dst_type, dst_stride, min_x, min_y,
-					max_x, max_y);
+		try {
+			run(img_dst, dst_type, dst_stride, img_width, img_height, p, min_x, min_y, max_x, max_y, w, h, shrinked, band_only, usage);
+		} catch (const std::exception &) {
+			return -6;
+		}
+		if (peak_memory != NULL)
+			*peak_memory = usage.peak;
 		return 0;
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
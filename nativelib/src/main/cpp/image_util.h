@@ -0,0 +1,29 @@
+#ifndef _LIB_IMAGE_UTIL_H_
+#define _LIB_IMAGE_UTIL_H_
+
+#include <cmath>
+
+// 各模块共用的小函数
+class image_util {
+public:
+	// 按行分条并行时的条带数，每个条带约 64 行
+	static double stripes(int height) {
+		return (height + 63) / 64;
+	}
+
+	// BORDER_REFLECT_101 的越界坐标映射，与 cv::borderInterpolate 一致
+	static int reflect_101(int p, int len) {
+		if (len == 1)
+			return 0;
+		while (p < 0 || p >= len)
+			p = p < 0 ? -p : 2 * len - 2 - p;
+		return p;
+	}
+
+	// 标准正态分布的累积分布函数
+	static double gauss_cdf(double x) {
+		return 0.5 * std::erfc(-x / std::sqrt(2.0));
+	}
+};
+
+#endif
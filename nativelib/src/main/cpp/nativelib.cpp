@@ -1,5 +1,8 @@
 #include <jni.h>
+#include <algorithm>
+#include <array>
 #include <string>
+#include <vector>
 #include <android/log.h>
 #include <opencv2/core.hpp>
 #include <android/bitmap.h>
@@ -9,6 +12,65 @@
 #define LOG_TAG "NativeCutout"
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
+// JNI_OnLoad 时查好的类和成员 ID，描边每帧都会调用，不再每次 FindClass
+// 类找不到时为 nullptr，对应的接口直接返回
+static jclass gOutlineStrokeClass = nullptr;
+static jfieldID gStrokeWidthField = nullptr;
+static jfieldID gStrokeColorField = nullptr;
+static jfieldID gStrokeSoftnessField = nullptr;
+static jfieldID gStrokeOffsetField = nullptr;
+static jmethodID gBitmapGetGenerationId = nullptr;
+static jclass gOutlineContoursClass = nullptr;
+static jmethodID gOutlineContoursInit = nullptr;
+
+// 查找类并创建全局引用，失败时清除异常并打印日志
+static jclass findGlobalClass(JNIEnv *env, const char *name) {
+    jclass local = env->FindClass(name);
+    if (local == nullptr) {
+        env->ExceptionClear();
+        LOGE("JNI_OnLoad: class %s not found.", name);
+        return nullptr;
+    }
+    auto global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv((void **) &env, JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    gOutlineStrokeClass = findGlobalClass(env, "com/sqsong/nativelib/OutlineStroke");
+    if (gOutlineStrokeClass != nullptr) {
+        gStrokeWidthField = env->GetFieldID(gOutlineStrokeClass, "width", "F");
+        gStrokeColorField = env->GetFieldID(gOutlineStrokeClass, "color", "I");
+        gStrokeSoftnessField = env->GetFieldID(gOutlineStrokeClass, "softness", "F");
+        gStrokeOffsetField = env->GetFieldID(gOutlineStrokeClass, "offset", "F");
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            LOGE("JNI_OnLoad: OutlineStroke is missing a field.");
+            env->DeleteGlobalRef(gOutlineStrokeClass);
+            gOutlineStrokeClass = nullptr;
+        }
+    }
+    gOutlineContoursClass = findGlobalClass(env, "com/sqsong/nativelib/OutlineContours");
+    if (gOutlineContoursClass != nullptr) {
+        gOutlineContoursInit = env->GetMethodID(gOutlineContoursClass, "<init>", "([F[IZ)V");
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            LOGE("JNI_OnLoad: OutlineContours is missing its constructor.");
+            env->DeleteGlobalRef(gOutlineContoursClass);
+            gOutlineContoursClass = nullptr;
+        }
+    }
+    jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
+    gBitmapGetGenerationId = env->GetMethodID(bitmapClass, "getGenerationId", "()I");
+    env->DeleteLocalRef(bitmapClass);
+    return JNI_VERSION_1_6;
+}
+
 static jobject createBitmap(JNIEnv *env, int width, int height) {
     jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
     jmethodID createBitmapMethod = env->GetStaticMethodID(bitmapClass, "createBitmap", "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
@@ -19,6 +81,25 @@ static jobject createBitmap(JNIEnv *env, int width, int height) {
     return outputBitmap;
 }
 
+// round(a * b / 255)，用移位代替除法，对 0~255 的输入结果精确
+static inline uint32_t mulDiv255(uint32_t a, uint32_t b) {
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// 255 / a 的 Q16 定点倒数表，用于反预乘。倒数向上取整，使 (c * table[a] + 2^15) >> 16
+// 恰好等于 round(c * 255 / a)。table[0] 为 0，全透明像素反预乘后为黑色
+static const uint32_t *alphaReciprocals() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> values{};
+        for (uint32_t a = 1; a < 256; a++) {
+            values[a] = ((255u << 16) + a - 1) / a;
+        }
+        return values;
+    }();
+    return table.data();
+}
+
 static bool bitmapToRGBA(JNIEnv *env, jobject bitmap, cv::Mat &mat) {
     AndroidBitmapInfo info;
     if (AndroidBitmap_getInfo(env, bitmap, &info) < 0) {
@@ -177,63 +258,91 @@ static void matToBitmap(JNIEnv *env, const cv::Mat &mat, jobject bitmap) {
     AndroidBitmap_unlockPixels(env, bitmap);
 }
 
+// 闭合折线按 Catmull-Rom 样条转成三次贝塞尔曲线：起点之后每段追加两个控制点和终点，最后一段回到起点
+static void smoothContour(const std::vector<cv::Point2f> &points, std::vector<cv::Point2f> &out) {
+    const int n = (int) points.size();
+    out.push_back(points[0]);
+    for (int i = 0; i < n; i++) {
+        const cv::Point2f &p0 = points[(i + n - 1) % n];
+        const cv::Point2f &p1 = points[i];
+        const cv::Point2f &p2 = points[(i + 1) % n];
+        const cv::Point2f &p3 = points[(i + 2) % n];
+        out.push_back(p1 + (p2 - p0) * (1.f / 6));
+        out.push_back(p2 - (p3 - p1) * (1.f / 6));
+        out.push_back(p2);
+    }
+}
+
 extern "C"
 JNIEXPORT jobject JNICALL
-Java_com_sqsong_nativelib_NativeLib_getBitmapOutlinePath(JNIEnv *env, jobject thiz, jobject bitmap) {
+Java_com_sqsong_nativelib_NativeLib_getBitmapContours(JNIEnv *env, jobject thiz, jobject bitmap, jfloat tolerance, jboolean smooth) {
+    if (gOutlineContoursClass == nullptr) {
+        return nullptr;
+    }
 // 将 Android Bitmap 转换为 OpenCV Mat
     AndroidBitmapInfo info;
     void *pixels = nullptr;
-    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS) {
-        // 错误处理
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS
+        || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
         return nullptr;
     }
 
     if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
-        // 错误处理
         return nullptr;
     }
 
-    cv::Mat src(info.height, info.width, CV_8UC4, pixels);
-
-    // 创建一个比原始图像稍大的新图像，周围填充 1 个像素的透明边框
-    int borderSize = 1;  // 可以根据需要调整边框大小
-    cv::Mat paddedSrc;
-    cv::copyMakeBorder(src, paddedSrc, borderSize, borderSize, borderSize, borderSize, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0, 0));
+    cv::Mat src(info.height, info.width, CV_8UC4, pixels, info.stride);
 
-    // 提取 Alpha 通道
+    // 提取 Alpha 通道，周围填充 1 个像素的透明边框，贴边的形状也能得到闭合的轮廓
+    int borderSize = 1;
     cv::Mat alphaChannel;
-    cv::extractChannel(paddedSrc, alphaChannel, 3); // 提取 Alpha 通道
+    cv::extractChannel(src, alphaChannel, 3);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    cv::Mat paddedAlpha;
+    cv::copyMakeBorder(alphaChannel, paddedAlpha, borderSize, borderSize, borderSize, borderSize, cv::BORDER_CONSTANT, cv::Scalar(0));
 
     // 将 Alpha 通道转换为二值图像
     cv::Mat binary;
-    cv::threshold(alphaChannel, binary, 127, 255, cv::THRESH_BINARY);
+    cv::threshold(paddedAlpha, binary, 127, 255, cv::THRESH_BINARY);
 
     // 查找轮廓
     std::vector<std::vector<cv::Point>> contours;
     cv::findContours(binary, contours, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE);
 
-    // 创建 Java 中的 Path 对象
-    jclass pathClass = env->FindClass("android/graphics/Path");
-    jmethodID pathConstructor = env->GetMethodID(pathClass, "<init>", "()V");
-    jobject path = env->NewObject(pathClass, pathConstructor);
-
-    jmethodID moveToMethod = env->GetMethodID(pathClass, "moveTo", "(FF)V");
-    jmethodID lineToMethod = env->GetMethodID(pathClass, "lineTo", "(FF)V");
-    jmethodID closeMethod = env->GetMethodID(pathClass, "close", "()V");
-
-    // 将轮廓转换为 Path
-    for (const auto &contour: contours) {
-        if (contour.empty()) continue;
-        // 移动到第一个点（注意坐标需要减去边框大小）
-        env->CallVoidMethod(path, moveToMethod, (jfloat) (contour[0].x - borderSize), (jfloat) (contour[0].y - borderSize));
-        for (size_t i = 1; i < contour.size(); ++i) {
-            env->CallVoidMethod(path, lineToMethod, (jfloat) (contour[i].x - borderSize), (jfloat) (contour[i].y - borderSize));
+    // 简化（Douglas-Peucker）、平滑后打包：points 为 x, y 交替的坐标，第 k 个轮廓的点是 offsets[k] 到 offsets[k + 1]
+    std::vector<cv::Point2f> points;
+    std::vector<jint> offsets(1, 0);
+    std::vector<cv::Point> simplified;
+    std::vector<cv::Point2f> contour;
+    for (const auto &c: contours) {
+        if (c.empty()) continue;
+        if (tolerance > 0.f) {
+            cv::approxPolyDP(c, simplified, tolerance, true);
+        } else {
+            simplified = c;
+        }
+        // 注意坐标需要减去边框大小
+        contour.clear();
+        for (const cv::Point &p: simplified) {
+            contour.emplace_back((float) (p.x - borderSize), (float) (p.y - borderSize));
         }
-        env->CallVoidMethod(path, closeMethod);
+        if (smooth) {
+            smoothContour(contour, points);
+        } else {
+            points.insert(points.end(), contour.begin(), contour.end());
+        }
+        offsets.push_back((jint) points.size());
     }
 
-    AndroidBitmap_unlockPixels(env, bitmap);
-    return path;
+    jfloatArray pointArray = env->NewFloatArray((jsize) points.size() * 2);
+    jintArray offsetArray = env->NewIntArray((jsize) offsets.size());
+    if (pointArray == nullptr || offsetArray == nullptr) {
+        return nullptr;
+    }
+    env->SetFloatArrayRegion(pointArray, 0, (jsize) points.size() * 2, (const jfloat *) points.data());
+    env->SetIntArrayRegion(offsetArray, 0, (jsize) offsets.size(), offsets.data());
+
+    return env->NewObject(gOutlineContoursClass, gOutlineContoursInit, pointArray, offsetArray, smooth);
 }
 
 //extern "C"
@@ -308,45 +417,25 @@ Java_com_sqsong_nativelib_NativeLib_cutoutBitmapBySource(JNIEnv *env, jobject th
     }
     // 输出数据缓冲区
     auto *outData = new uint8_t[srcStride * srcHeight];
-    float maxRatio = 5.0f; // 限制最大放大倍数，防止噪点过度放大
-    // 单次遍历所有像素
-    // srcData和cutData均为 RGBA 格式：B,G,R,A
-    // outData最终要输出为经过"反预乘"恢复后的前景图。
-    int pixelCount = srcWidth * srcHeight;
-    for (int i = 0; i < pixelCount; i++) {
-        // 通道顺序为：BGRA
-        uint8_t B_s = srcData[i * 4 + 0];
-        uint8_t G_s = srcData[i * 4 + 1];
-        uint8_t R_s = srcData[i * 4 + 2];
-        // A_s无关，因为srcBitmap是JPG转的，无有效透明信息
-        // 我们真正关心的Alpha来自cutoutBitmap
-        uint8_t A_c = cutData[i * 4 + 3];
-        float A = A_c / 255.0f;
-        float Bf = B_s / 255.0f;
-        float Gf = G_s / 255.0f;
-        float Rf = R_s / 255.0f;
-        float FR, FG, FB;
-        if (A > 0.001f) {
-            float ratio = 1.0f / A;
-            if (ratio > maxRatio) ratio = maxRatio;
-            // F ≈ I / A
-            FB = Bf * ratio;
-            FG = Gf * ratio;
-            FR = Rf * ratio;
-        } else {
-            // Alpha近乎0，直接保留原色或设为黑色
-            FB = Bf;
-            FG = Gf;
-            FR = Rf;
+    const uint32_t maxRatio = 5; // 限制最大放大倍数，防止噪点过度放大
+    const uint32_t *reciprocals = alphaReciprocals();
+    // 单次遍历所有像素，全部使用定点整数运算
+    // srcBitmap是JPG转的，无有效透明信息，我们真正关心的Alpha来自cutoutBitmap
+    // 先估计前景 F ≈ I / A，再输出预乘后的 F * A，保证颜色值不超过Alpha
+    for (int y = 0; y < srcHeight; y++) {
+        const uint8_t *src = srcData + y * srcStride;
+        const uint8_t *cut = cutData + y * cutStride;
+        uint8_t *out = outData + y * srcStride;
+        for (int x = 0; x < srcWidth; x++) {
+            const uint32_t A = cut[x * 4 + 3];
+            // Q16 的放大倍数 min(255 / A, maxRatio)
+            const uint32_t ratio = A * maxRatio >= 255 ? reciprocals[A] : (maxRatio << 16);
+            for (int c = 0; c < 3; c++) {
+                const uint32_t F = std::min<uint32_t>(255, (src[x * 4 + c] * ratio + (1u << 15)) >> 16);
+                out[x * 4 + c] = (uint8_t) mulDiv255(F, A);
+            }
+            out[x * 4 + 3] = (uint8_t) A;
         }
-        // 最终输出 = F * A
-        FB *= A;
-        FG *= A;
-        FR *= A;
-        outData[i * 4 + 0] = (uint8_t) (FB * 255.0f);
-        outData[i * 4 + 1] = (uint8_t) (FG * 255.0f);
-        outData[i * 4 + 2] = (uint8_t) (FR * 255.0f);
-        outData[i * 4 + 3] = A_c;
     }
     jobject outputBitmap = createBitmap(env, srcWidth, srcHeight);
     rgbaToBitmap(env, outputBitmap, outData, srcStride, srcHeight);
@@ -376,157 +465,187 @@ Java_com_sqsong_nativelib_NativeLib_hasAlpha(JNIEnv *env, jobject thiz, jobject
         return JNI_FALSE;
     }
 
-    // 使用bitmap的数据创建OpenCV的Mat对象，不拷贝数据，直接指向同一块内存
-    cv::Mat mat(info.height, info.width, CV_8UC4, bitmapPixels);
+    // 直接在像素上逐行检查alpha，遇到第一个不是255的像素就返回，必须在解锁之前完成
+    int result = WXProbeAlpha((const uint8_t *) bitmapPixels, (int) info.width, (int) info.height, (int) info.stride,
+                              nullptr, nullptr, 0);
 
-    // 分离通道，以获得Alpha通道
-    std::vector<cv::Mat> channels;
-    cv::split(mat, channels); // channels[3]为Alpha通道
-
-    // 解锁像素，后面不再需要直接访问bitmapPixels
     AndroidBitmap_unlockPixels(env, bitmap);
+    return result > 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_sqsong_nativelib_NativeLib_probeAlpha(JNIEnv *env, jobject thiz, jobject bitmap, jintArray rect, jbyteArray cellMap, jint cellSize) {
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        return -1;
+    }
+    if (rect != nullptr && env->GetArrayLength(rect) < 4) {
+        return -3;
+    }
+    jsize cellsCount = 0;
+    if (cellMap != nullptr) {
+        if (cellSize <= 0) {
+            return -2;
+        }
+        cellsCount = (jsize) (((info.width + cellSize - 1) / cellSize) * ((info.height + cellSize - 1) / cellSize));
+        if (env->GetArrayLength(cellMap) < cellsCount) {
+            return -3;
+        }
+    }
 
-    // 利用OpenCV的minMaxLoc快速找到Alpha通道的最小值和最大值
-    double minVal = 0, maxVal = 0;
-    cv::minMaxLoc(channels[3], &minVal, &maxVal);
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+        return -1;
+    }
+    // WXProbeAlpha 内部是多线程的，不能在 GetPrimitiveArrayCritical 期间运行，透明度图先写进本地缓冲再拷贝出去
+    jint box[4] = {0, 0, 0, 0};
+    std::vector<uint8_t> cells(cellMap != nullptr ? (size_t) cellsCount : 0);
+    int result = WXProbeAlpha((const uint8_t *) pixels, (int) info.width, (int) info.height, (int) info.stride,
+                              rect != nullptr ? box : nullptr, cellMap != nullptr ? cells.data() : nullptr, cellSize);
+    AndroidBitmap_unlockPixels(env, bitmap);
 
-    // 若最小Alpha值小于255，说明存在至少一个像素不是完全不透明(有透明度)
-    if (minVal < 255.0) {
-        return JNI_TRUE;
-    } else {
-        return JNI_FALSE;
+    if (rect != nullptr) {
+        env->SetIntArrayRegion(rect, 0, 4, box);
     }
+    if (cellMap != nullptr) {
+        env->SetByteArrayRegion(cellMap, 0, cellsCount, (const jbyte *) cells.data());
+    }
+    return result;
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_sqsong_nativelib_NativeLib_nativeOutlineBitmap(JNIEnv *env, jobject thiz, jobject srcBitmap, jobject destBitmap, jint strokeWidth, jfloat blurRadius, jint strokeColor) {
-    // 1. 读取 srcBitmap 到 Mat
+// 给 srcBitmap 画 strokes 写入 destBitmap，两者都是 RGBA_8888 且尺寸相同
+static void outlineBitmap(JNIEnv *env, jobject srcBitmap, jobject destBitmap, const WXOutlineStroke *strokes, int count, void *cache, uint64_t sourceId) {
     AndroidBitmapInfo srcInfo;
-    if (AndroidBitmap_getInfo(env, srcBitmap, &srcInfo) != ANDROID_BITMAP_RESULT_SUCCESS) {
+    AndroidBitmapInfo destInfo;
+    if (AndroidBitmap_getInfo(env, srcBitmap, &srcInfo) != ANDROID_BITMAP_RESULT_SUCCESS
+        || AndroidBitmap_getInfo(env, destBitmap, &destInfo) != ANDROID_BITMAP_RESULT_SUCCESS) {
         return;
     }
-    if (srcInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
-        return; // 必须是 RGBA_8888
+    if (srcInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888 || destInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888
+        || destInfo.width != srcInfo.width || destInfo.height != srcInfo.height) {
+        return;
     }
 
     void* srcPixels = nullptr;
     if (AndroidBitmap_lockPixels(env, srcBitmap, &srcPixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
         return;
     }
-    cv::Mat srcMat(srcInfo.height, srcInfo.width, CV_8UC4, srcPixels);
+    void* destPixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, destBitmap, &destPixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        AndroidBitmap_unlockPixels(env, srcBitmap);
+        return;
+    }
 
-    // 2. 为了避免贴边无法描边，我们加留白
-    int padding = strokeWidth + (int)ceil(blurRadius);
-    if (padding < 1) padding = 1; // 至少留白1像素
-    cv::Mat padded;
-    // copyMakeBorder(源, 目标, top, bottom, left, right, borderType, 填充值)
-    // 对 RGBA，可以用 Scalar(0,0,0,0) 表示全透明
-    copyMakeBorder(srcMat, padded, padding, padding, padding, padding,
-                   cv::BORDER_CONSTANT, cv::Scalar(0,0,0,0));
+    // 距离变换描边：不需要留白，直接从 srcBitmap 读、写到 destBitmap，只处理 mask 外接矩形附近的区域
+    int result = WXOutlineRGBAStrokes((uint8_t *) destPixels, (int) destInfo.stride, (const uint8_t *) srcPixels,
+                                      (int) srcInfo.width, (int) srcInfo.height, (int) srcInfo.stride,
+                                      strokes, count, cache, sourceId);
+    if (result < 0) {
+        LOGE("outlineBitmap: WXOutlineRGBAStrokes failed %d", result);
+    }
 
-    // 解锁 srcBitmap (我们已经复制到 padded)
+    AndroidBitmap_unlockPixels(env, destBitmap);
     AndroidBitmap_unlockPixels(env, srcBitmap);
+}
 
-    // 3. 分离 alpha 通道 & 二值化
-    std::vector<cv::Mat> channels;
-    split(padded, channels);  // [0]=B, [1]=G, [2]=R, [3]=A
-    cv::Mat alpha = channels[3];
-
-    cv::Mat mask;
-    threshold(alpha, mask, 128, 255, cv::THRESH_BINARY);
-
-    // 4. 形态学膨胀 (dilate)
-    if (strokeWidth > 0) {
-        int kernelSize = strokeWidth * 2 + 1;
-        cv::Mat kernel = getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(kernelSize, kernelSize));
-        dilate(mask, mask, kernel);
-    }
-
-    // 5. 高斯模糊
-    if (blurRadius > 0.f) {
-        float sigma = blurRadius;
-        int kSize = std::max(1, (int)(sigma * 4)) | 1; // 通常取4*sigma并保证奇数
-        GaussianBlur(mask, mask, cv::Size(kSize, kSize), sigma);
-    }
-
-    // 6. 用 mask 构造"描边层"
-    // strokeColorRGBA 是 0xAARRGGBB
-    uchar A = (strokeColor >> 24) & 0xFF;
-    uchar R = (strokeColor >> 16) & 0xFF;
-    uchar G = (strokeColor >>  8) & 0xFF;
-    uchar B = (strokeColor      ) & 0xFF;
-    // 创建 strokeMat (padded同大小) 填充 strokeColor
-    cv::Mat strokeMat(padded.rows, padded.cols, CV_8UC4, cv::Scalar(B, G, R, A));
-
-    // 替换 alpha 通道 = mask
-    std::vector<cv::Mat> strokeChans;
-    split(strokeMat, strokeChans);  // strokeChans[0]=B,1=G,2=R,3=A
-    strokeChans[3] = mask;
-    merge(strokeChans, strokeMat);
-
-    // 7. 在 padded 上把 strokeMat 叠加到原图 padded
-    //    先把 padded 复制一份 outMat
-    cv::Mat outMat = padded.clone(); // CV_8UC4
-
-    for (int y = 0; y < outMat.rows; y++) {
-        cv::Vec4b* dstPix = outMat.ptr<cv::Vec4b>(y);
-        const cv::Vec4b* fgPix = strokeMat.ptr<cv::Vec4b>(y);
-        const cv::Vec4b* bgPix = padded.ptr<cv::Vec4b>(y);
-
-        for (int x = 0; x < outMat.cols; x++) {
-            float fgA = fgPix[x][3] / 255.f; // stroke alpha
-            float bgA = bgPix[x][3] / 255.f;
-            float outA = fgA + bgA * (1.f - fgA);
-            if (outA < 1e-5f) {
-                dstPix[x] = cv::Vec4b(0,0,0,0);
-                continue;
-            }
-            float fgB = fgPix[x][0]/255.f, fgG = fgPix[x][1]/255.f, fgR = fgPix[x][2]/255.f;
-            float bgB = bgPix[x][0]/255.f, bgG = bgPix[x][1]/255.f, bgR = bgPix[x][2]/255.f;
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_sqsong_nativelib_NativeLib_nativeOutlineBitmap(JNIEnv *env, jobject thiz, jobject srcBitmap, jobject destBitmap, jint strokeWidth, jfloat blurRadius, jint strokeColor) {
+    // blurRadius 作为描边边缘的高斯 sigma
+    WXOutlineStroke stroke = {(float) std::max(0, (int) strokeWidth), std::max(0.f, (float) blurRadius), 0, (uint32_t) strokeColor};
+    outlineBitmap(env, srcBitmap, destBitmap, &stroke, 1, nullptr, 0);
+}
 
-            float outB = (fgB * fgA + bgB * bgA * (1.f - fgA)) / outA;
-            float outG = (fgG * fgA + bgG * bgA * (1.f - fgA)) / outA;
-            float outR = (fgR * fgA + bgR * bgA * (1.f - fgA)) / outA;
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_sqsong_nativelib_NativeLib_createOutlineCache(JNIEnv *env, jobject thiz) {
+    return (jlong) (intptr_t) WXCreateOutlineCache();
+}
 
-            dstPix[x][0] = (uchar)cvRound(outB*255.f);
-            dstPix[x][1] = (uchar)cvRound(outG*255.f);
-            dstPix[x][2] = (uchar)cvRound(outR*255.f);
-            dstPix[x][3] = (uchar)cvRound(outA*255.f);
-        }
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_sqsong_nativelib_NativeLib_releaseOutlineCache(JNIEnv *env, jobject thiz, jlong cache) {
+    WXReleaseOutlineCache((void *) (intptr_t) cache);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_sqsong_nativelib_NativeLib_nativeOutlineBitmapStrokes(JNIEnv *env, jobject thiz, jobject srcBitmap, jobject destBitmap, jobjectArray strokes, jlong cache) {
+    if (gOutlineStrokeClass == nullptr || gBitmapGetGenerationId == nullptr) {
+        return;
+    }
+    const jsize count = env->GetArrayLength(strokes);
+    std::vector<WXOutlineStroke> specs(count);
+    for (jsize i = 0; i < count; i++) {
+        jobject stroke = env->GetObjectArrayElement(strokes, i);
+        specs[i].width = std::max(0.f, env->GetFloatField(stroke, gStrokeWidthField));
+        specs[i].softness = std::max(0.f, env->GetFloatField(stroke, gStrokeSoftnessField));
+        specs[i].offset = std::max(0.f, env->GetFloatField(stroke, gStrokeOffsetField));
+        specs[i].color = (uint32_t) env->GetIntField(stroke, gStrokeColorField);
+        env->DeleteLocalRef(stroke);
     }
 
-    // outMat 现在是 (padded宽, padded高) 的图，四周有留白
+    // 像素内容变化时 generationId 会变，缓存的距离场随之失效
+    const uint64_t sourceId = (uint32_t) env->CallIntMethod(srcBitmap, gBitmapGetGenerationId);
 
-    // 8. 如果你想要的结果与 srcBitmap 尺寸相同，需要再裁切 (去掉 padding)。
-    //    否则就把整个 outMat 拷贝到 destBitmap，看需求。
-    //    这里示例把最终尺寸缩回原来的 w/h (不含留白)。
-    int finalW = srcInfo.width;
-    int finalH = srcInfo.height;
-    // 裁切 ROI, 如果 padding 超过图尺寸，需要检查
-    cv::Rect roi(padding, padding, finalW, finalH);
-    // 注意：要确保roi在图像范围内
-    if (roi.x + roi.width > outMat.cols)  roi.width = outMat.cols - roi.x;
-    if (roi.y + roi.height > outMat.rows) roi.height = outMat.rows - roi.y;
-    cv::Mat cropped = outMat(roi);
+    outlineBitmap(env, srcBitmap, destBitmap, specs.data(), (int) count, (void *) (intptr_t) cache, sourceId);
+}
 
-    // 9. 写回 destBitmap
-    AndroidBitmapInfo destInfo;
-    if (AndroidBitmap_getInfo(env, destBitmap, &destInfo) == ANDROID_BITMAP_RESULT_SUCCESS
-        && destInfo.format == ANDROID_BITMAP_FORMAT_RGBA_8888
-        && destInfo.width == finalW
-        && destInfo.height == finalH) {
-        void* destPixels = nullptr;
-        if (AndroidBitmap_lockPixels(env, destBitmap, &destPixels) == ANDROID_BITMAP_RESULT_SUCCESS) {
-            // 拷贝 cropped 数据
-            for (int y = 0; y < cropped.rows; y++) {
-                memcpy(
-                        (uint8_t*)destPixels + y * destInfo.stride,
-                        cropped.ptr(y),
-                        cropped.cols * 4
-                );
-            }
-            AndroidBitmap_unlockPixels(env, destBitmap);
-        }
+// 黑白图 bitmap 的通道数和形状所在的通道：RGBA_8888 取 alpha，A_8 取唯一的通道
+static bool maskLayout(const AndroidBitmapInfo &info, int *nbChannel, int *channel) {
+    if (info.format == ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        *nbChannel = 4;
+        *channel = 3;
+        return true;
+    }
+    if (info.format == ANDROID_BITMAP_FORMAT_A_8) {
+        *nbChannel = 1;
+        *channel = 0;
+        return true;
+    }
+    return false;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_sqsong_nativelib_NativeLib_createFeatherField(JNIEnv *env, jobject thiz, jobject maskBitmap, jfloat maxOuter) {
+    AndroidBitmapInfo info;
+    int nbChannel, channel;
+    if (AndroidBitmap_getInfo(env, maskBitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS || !maskLayout(info, &nbChannel, &channel)) {
+        return 0;
+    }
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, maskBitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        return 0;
+    }
+    void *field = WXCreateFeatherField((const uint8_t *) pixels, (int) info.width, (int) info.height, nbChannel,
+                                       (int) info.stride, channel, std::max(0.f, (float) maxOuter));
+    AndroidBitmap_unlockPixels(env, maskBitmap);
+    return (jlong) (intptr_t) field;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_sqsong_nativelib_NativeLib_releaseFeatherField(JNIEnv *env, jobject thiz, jlong field) {
+    WXReleaseFeatherField((void *) (intptr_t) field);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_sqsong_nativelib_NativeLib_featherMask(JNIEnv *env, jobject thiz, jlong field, jobject destBitmap, jfloat inner, jfloat outer, jint curve) {
+    AndroidBitmapInfo info;
+    int nbChannel, channel;
+    if (AndroidBitmap_getInfo(env, destBitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS || !maskLayout(info, &nbChannel, &channel)) {
+        return -2;
+    }
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, destBitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        return -2;
     }
-}
\ No newline at end of file
+    // RGBA_8888 的四个通道都写入羽化值，即预乘后的白色，可以直接用 DST_IN 叠加到图片上
+    int result = WXFeatherMask((const void *) (intptr_t) field, (uint8_t *) pixels, (int) info.width, (int) info.height,
+                               nbChannel, (int) info.stride, inner, outer, curve);
+    AndroidBitmap_unlockPixels(env, destBitmap);
+    return result;
+}
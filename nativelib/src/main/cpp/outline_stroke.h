@@ -0,0 +1,215 @@
+#ifndef _LIB_OUTLINE_STROKE_H_
+#define _LIB_OUTLINE_STROKE_H_
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "image_util.h"
+#include "signed_distance.h"
+
+// 描边：不再膨胀 + 高斯模糊，改为精确欧氏距离变换
+// 1. alpha > 128 的像素为形状，在 mask 外接矩形外扩描边范围的区域内，算出每个像素到形状边界的有符号距离
+//    （Felzenszwalb-Huttenlocher 可分离距离变换，先按列再按行，时间和描边宽度无关）
+// 2. 描边覆盖率由距离解析得到：宽度 r 的描边边界在距离 r 处，softness 为高斯模糊的 sigma，再加像素宽度的抗锯齿
+// 3. 按覆盖率把描边颜色定点整数叠加(SRC_OVER)到预乘的 rgba 上，一次写完，区域外直接复制原图
+// 多条描边共用一个距离场，逐像素按顺序叠加；距离场可以缓存，只改颜色时跳过第 1 步
+class outline_stroke {
+public:
+	typedef signed_distance::field distance_field;
+
+	// 一条描边：从距形状 offset 处开始向外宽 width，offset 为 0 时同时覆盖形状内部
+	struct stroke_spec {
+		float width;
+		float softness;
+		float offset;
+		uint32_t color;
+	};
+
+private:
+	// 覆盖率表的精度：每像素 64 格，不模糊时相邻两格相差不到 4
+	static const int lut_scale = 64;
+
+	// round(a * b / 255)
+	static uint32_t mul_div_255(uint32_t a, uint32_t b) {
+		uint32_t t = a * b + 128;
+		return (t + (t >> 8)) >> 8;
+	}
+
+	// 覆盖率 cdf(t) 关于 t 的积分，用于在像素宽度 [t - 0.5, t + 0.5] 上求平均
+	static double coverage_integral(double t, double softness) {
+		if (softness <= 0)
+			return t > 0 ? t : 0;
+		double u = t / softness;
+		return t * image_util::gauss_cdf(u) + softness * std::exp(-0.5 * u * u) / std::sqrt(2.0 * CV_PI);
+	}
+
+	// 像素中心在描边边界内 t 像素时的覆盖率 0-255，t 在 [-range, range] 之外为 0 或 255
+	static std::vector<uint8_t> coverage_table(float softness, float &range) {
+		range = 3 * softness + 1;
+		int size = (int) std::ceil(2 * range * lut_scale) + 1;
+		std::vector<uint8_t> lut(size);
+		for (int i = 0; i < size; i++) {
+			double t = (double) i / lut_scale - range;
+			double c = coverage_integral(t + 0.5, softness) - coverage_integral(t - 0.5, softness);
+			lut[i] = (uint8_t) cv::saturate_cast<uint8_t>(c * 255);
+		}
+		return lut;
+	}
+
+	// 一条描边在距离 e 处的覆盖率：外侧边界内的部分减去内侧边界内的部分
+	struct ring {
+		float outer;
+		float inner;
+		bool has_inner;
+		float range;
+		std::vector<uint8_t> lut;
+		uint32_t a;
+		uint32_t rgb[3];
+
+		uint32_t edge(float t) const {
+			if (t <= -range)
+				return 0;
+			if (t >= range)
+				return 255;
+			return lut[(int) std::min((t + range) * lut_scale + 0.5f, (float) (lut.size() - 1))];
+		}
+
+		uint32_t coverage(float e) const {
+			uint32_t c = edge(outer - e);
+			if (has_inner && c != 0) {
+				uint32_t in = edge(inner - e);
+				c = c > in ? c - in : 0;
+			}
+			return c;
+		}
+	};
+
+	static std::vector<ring> make_rings(const stroke_spec *strokes, int count) {
+		std::vector<ring> rings(count);
+		for (int k = 0; k < count; k++) {
+			const stroke_spec &s = strokes[k];
+			ring &r = rings[k];
+			r.lut = coverage_table(s.softness, r.range);
+			r.has_inner = s.offset > 0;
+			r.inner = s.offset;
+			r.outer = s.offset + s.width;
+			r.a = (s.color >> 24) & 0xFF;
+			r.rgb[0] = (s.color >> 16) & 0xFF;
+			r.rgb[1] = (s.color >> 8) & 0xFF;
+			r.rgb[2] = s.color & 0xFF;
+		}
+		return rings;
+	}
+
+	// 按顺序把所有描边叠加到一个像素上，每个像素只读写一次
+	static void blend_row(uint8_t *dst, const uint8_t *src, const float *dist, int width, const std::vector<ring> &rings, float max_reach) {
+		for (int x = 0; x < width; x++) {
+			if (dist[x] >= max_reach) {
+				if (dst != src)
+					memcpy(dst + x * 4, src + x * 4, 4);
+				continue;
+			}
+			uint32_t p[4] = {src[x * 4], src[x * 4 + 1], src[x * 4 + 2], src[x * 4 + 3]};
+			for (const ring &r : rings) {
+				const uint32_t sa = mul_div_255(r.a, r.coverage(dist[x]));
+				if (sa == 0)
+					continue;
+				const uint32_t inv = 255 - sa;
+				for (int c = 0; c < 3; c++)
+					p[c] = mul_div_255(r.rgb[c], sa) + mul_div_255(p[c], inv);
+				p[3] = sa + mul_div_255(p[3], inv);
+			}
+			for (int c = 0; c < 4; c++)
+				dst[x * 4 + c] = (uint8_t) p[c];
+		}
+	}
+
+	static float reach(const stroke_spec &s) {
+		return s.offset + s.width + 3 * s.softness + 2;
+	}
+
+	// 形状内是否需要精确的距离：边界在 edge 处的描边，形状内（t >= edge + 0.5）覆盖率仍不满时才需要
+	static bool need_inside(float edge, float softness) {
+		return 3 * softness + 1 > edge + 0.5f;
+	}
+
+public:
+	// 距离场缓存，只改描边颜色、宽度不超过缓存范围时不用重新计算
+	// 同一张图片（像素地址、尺寸、source_id 都相同）才会复用，图片内容变了调用方要换 source_id
+	struct cache {
+		distance_field field;
+		const uint8_t *src = NULL;
+		int width = 0, height = 0, stride = 0;
+		uint64_t source_id = 0;
+		int margin = -1;
+		bool inside = false;
+
+		bool matches(const uint8_t *rgba, int w, int h, int s, uint64_t id, int need_margin, bool need_in) const {
+			return margin >= need_margin && (inside || !need_in) && src == rgba && width == w && height == h && stride == s &&
+			       source_id == id;
+		}
+
+		void set(const uint8_t *rgba, int w, int h, int s, uint64_t id, int m, bool in) {
+			src = rgba;
+			width = w;
+			height = h;
+			stride = s;
+			source_id = id;
+			margin = m;
+			inside = in;
+		}
+	};
+
+	// 所有描边在形状外能达到的最远距离，作为计算距离场的外扩范围
+	static int margin(const stroke_spec *strokes, int count) {
+		float m = 0;
+		for (int k = 0; k < count; k++)
+			m = std::max(m, reach(strokes[k]));
+		return (int) std::ceil(m);
+	}
+
+	static bool need_inside(const stroke_spec *strokes, int count) {
+		for (int k = 0; k < count; k++) {
+			const stroke_spec &s = strokes[k];
+			if (need_inside(s.offset + s.width, s.softness) || (s.offset > 0 && need_inside(s.offset, s.softness)))
+				return true;
+		}
+		return false;
+	}
+
+	// 在 rect（alpha 不为 0 的外接矩形）外扩 margin 像素的区域内计算距离场，rect 为 NULL 时距离场为空
+	static void build_field(distance_field &f, const uint8_t *rgba, int width, int height, int stride, const int *rect,
+	                        int margin, bool inside) {
+		signed_distance::build(f, {rgba, stride, 4, 3}, width, height, rect, margin, inside);
+	}
+
+	// 按顺序把 strokes 叠加到 src 上写入 dst，后面的描边在上层，dst 可以等于 src
+	// 距离场 f 的外扩范围至少为 margin(strokes, count)
+	static void stroke(uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height, int src_stride,
+	                   const distance_field &f, const stroke_spec *strokes, int count) {
+		std::vector<ring> rings = make_rings(strokes, count);
+		float max_reach = 0;
+		for (int k = 0; k < count; k++)
+			max_reach = std::max(max_reach, reach(strokes[k]));
+		cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &r) {
+			for (int i = r.start; i < r.end; i++) {
+				const uint8_t *s = src + (size_t) i * src_stride;
+				uint8_t *d = dst + (size_t) i * dst_stride;
+				if (i < f.y || i >= f.y + f.height || count == 0) {
+					if (d != s)
+						memcpy(d, s, (size_t) width * 4);
+					continue;
+				}
+				if (d != s) {
+					memcpy(d, s, (size_t) f.x * 4);
+					memcpy(d + (size_t) (f.x + f.width) * 4, s + (size_t) (f.x + f.width) * 4, (size_t) (width - f.x - f.width) * 4);
+				}
+				blend_row(d + (size_t) f.x * 4, s + (size_t) f.x * 4, f.dist.data() + (size_t) (i - f.y) * f.width, f.width,
+				          rings, max_reach);
+			}
+		}, image_util::stripes(height));
+	}
+};
+
+#endif
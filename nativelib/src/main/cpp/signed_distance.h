@@ -0,0 +1,175 @@
+#ifndef _LIB_SIGNED_DISTANCE_H_
+#define _LIB_SIGNED_DISTANCE_H_
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "image_util.h"
+
+// 黑白图的有符号距离场：mask 大于 128 的像素为形状，算出每个像素到形状边界的距离
+// 精确欧氏距离变换（Felzenszwalb-Huttenlocher），先按列再按行，时间只和区域像素数有关，
+// 两遍都按 64 列 / 64 行分条并行；只在 mask 外接矩形外扩 margin 的区域内计算，区域外看作形状外
+class signed_distance {
+public:
+	// 区域内每个像素到形状边界的有符号距离，形状外为正，形状内为负，单位像素
+	struct field {
+		int x = 0, y = 0, width = 0, height = 0;
+		std::vector<float> dist;
+	};
+
+	// 黑白图，判断第 channel 通道
+	struct mask {
+		const uint8_t *data;
+		int stride;
+		int nb_channel;
+		int channel;
+	};
+
+private:
+	// 列方向没有对侧像素。列距离不用 uint16_t：区域高度达到 65535 时距离会和 0xFFFF 冲突
+	static const int32_t no_site = INT32_MAX;
+
+	static bool is_site(const mask &m, const uint8_t *row, int x) {
+		return row[x * m.nb_channel + m.channel] > 128;
+	}
+
+	// 一维下包络：d[q] = min (q - p)^2 + f[p]，只考虑 f[p] >= 0 的位置，没有这样的位置时 d 全为 -1
+	static void lower_envelope(const double *f, double *d, int n, int *v, double *z) {
+		int k = -1;
+		for (int q = 0; q < n; q++) {
+			if (f[q] < 0)
+				continue;
+			double s = 0;
+			while (k >= 0) {
+				s = ((f[q] + (double) q * q) - (f[v[k]] + (double) v[k] * v[k])) / (2.0 * (q - v[k]));
+				if (s > z[k])
+					break;
+				k--;
+			}
+			k++;
+			v[k] = q;
+			z[k] = k == 0 ? -HUGE_VAL : s;
+			z[k + 1] = HUGE_VAL;
+		}
+		if (k < 0) {
+			for (int q = 0; q < n; q++)
+				d[q] = -1;
+			return;
+		}
+		k = 0;
+		for (int q = 0; q < n; q++) {
+			while (z[k + 1] < q)
+				k++;
+			d[q] = (double) (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+
+	// 按列：每个像素到同一列中对侧（形状内外相反）最近像素的距离
+	// 区域上下各外一行看作形状外：区域贴着图片边时那是图外，否则是外扩出来的留白
+	static void column_pass(int32_t *g, const mask &m, const field &f, int x0, int x1) {
+		const uint8_t *row = m.data + (size_t) f.y * m.stride;
+		for (int x = x0; x < x1; x++)
+			g[x] = is_site(m, row, f.x + x) ? 1 : no_site;
+		for (int i = 1; i < f.height; i++) {
+			const uint8_t *prev = row;
+			row += m.stride;
+			const int32_t *gp = g + (size_t) (i - 1) * f.width;
+			int32_t *gi = g + (size_t) i * f.width;
+			for (int x = x0; x < x1; x++) {
+				if (is_site(m, row, f.x + x) != is_site(m, prev, f.x + x))
+					gi[x] = 1;
+				else
+					gi[x] = gp[x] == no_site ? no_site : gp[x] + 1;
+			}
+		}
+		for (int x = x0; x < x1; x++) {
+			int32_t *gl = g + (size_t) (f.height - 1) * f.width;
+			if (is_site(m, row, f.x + x))
+				gl[x] = 1;
+		}
+		for (int i = f.height - 2; i >= 0; i--) {
+			const uint8_t *next = row;
+			row -= m.stride;
+			const int32_t *gn = g + (size_t) (i + 1) * f.width;
+			int32_t *gi = g + (size_t) i * f.width;
+			for (int x = x0; x < x1; x++) {
+				int32_t d = is_site(m, row, f.x + x) != is_site(m, next, f.x + x) ? 1 : gn[x] == no_site ? no_site : gn[x] + 1;
+				if (d < gi[x])
+					gi[x] = d;
+			}
+		}
+	}
+
+	// 按行：合并列方向的距离得到二维距离，形状外的像素取到形状的距离，形状内的像素取到形状外像素的距离
+	// inside 为 false 时不算形状内的距离，一律记为 -0.5
+	static void row_pass(field &f, const int32_t *g, const mask &m, int i, bool inside,
+	                     std::vector<double> &fo, std::vector<double> &d, std::vector<int> &v, std::vector<double> &z) {
+		const uint8_t *row = m.data + (size_t) (f.y + i) * m.stride;
+		const int32_t *gi = g + (size_t) i * f.width;
+		float *out = f.dist.data() + (size_t) i * f.width;
+		bool any_site = false, any_empty = false;
+
+		// 左右各多一列，区域左右外侧看作形状外
+		fo[0] = fo[f.width + 1] = -1;
+		for (int x = 0; x < f.width; x++) {
+			bool site = is_site(m, row, f.x + x);
+			any_site |= site;
+			any_empty |= !site;
+			fo[x + 1] = site ? 0 : gi[x] == no_site ? -1 : (double) gi[x] * gi[x];
+		}
+		if (any_empty) {
+			lower_envelope(fo.data(), d.data(), f.width + 2, v.data(), z.data());
+			for (int x = 0; x < f.width; x++)
+				out[x] = d[x + 1] < 0 ? FLT_MAX : (float) std::sqrt(d[x + 1]) - 0.5f;
+		}
+		if (!any_site)
+			return;
+		if (!inside) {
+			for (int x = 0; x < f.width; x++) {
+				if (is_site(m, row, f.x + x))
+					out[x] = -0.5f;
+			}
+			return;
+		}
+
+		fo[0] = fo[f.width + 1] = 0;
+		for (int x = 0; x < f.width; x++)
+			fo[x + 1] = is_site(m, row, f.x + x) ? (double) gi[x] * gi[x] : 0;
+		lower_envelope(fo.data(), d.data(), f.width + 2, v.data(), z.data());
+		for (int x = 0; x < f.width; x++) {
+			if (is_site(m, row, f.x + x))
+				out[x] = 0.5f - (float) std::sqrt(d[x + 1]);
+		}
+	}
+
+public:
+	// 在 rect（mask 不为 0 的外接矩形）外扩 margin 像素的区域内计算距离场，rect 为 NULL 时距离场为空
+	// inside 为 true 时形状内的像素也计算到形状外像素的距离
+	static void build(field &f, const mask &m, int width, int height, const int *rect, int margin, bool inside) {
+		if (rect == NULL) {
+			f.x = f.y = f.width = f.height = 0;
+			f.dist.clear();
+			return;
+		}
+		f.x = std::max(rect[0] - margin, 0);
+		f.y = std::max(rect[1] - margin, 0);
+		f.width = std::min(rect[0] + rect[2] + margin, width) - f.x;
+		f.height = std::min(rect[1] + rect[3] + margin, height) - f.y;
+		f.dist.assign((size_t) f.width * f.height, FLT_MAX);
+
+		std::vector<int32_t> g((size_t) f.width * f.height);
+		cv::parallel_for_(cv::Range(0, (f.width + 63) / 64), [&](const cv::Range &range) {
+			column_pass(g.data(), m, f, range.start * 64, std::min(range.end * 64, f.width));
+		});
+		cv::parallel_for_(cv::Range(0, f.height), [&](const cv::Range &range) {
+			std::vector<double> fo(f.width + 2), d(f.width + 2), z(f.width + 3);
+			std::vector<int> v(f.width + 2);
+			for (int i = range.start; i < range.end; i++)
+				row_pass(f, g.data(), m, i, inside, fo, d, v, z);
+		}, image_util::stripes(f.height));
+	}
+};
+
+#endif
@@ -5,16 +5,80 @@ import android.graphics.Path
 
 object NativeLib {
 
+    // featherMask 的过渡曲线
+    const val FEATHER_CURVE_LINEAR = 0
+    const val FEATHER_CURVE_SMOOTH = 1
+    const val FEATHER_CURVE_GAUSSIAN = 2
+
     // Used to load the 'nativelib' library on application startup.
     init {
         System.loadLibrary("nativelib")
     }
 
-    external fun getBitmapOutlinePath(bitmap: Bitmap): Path
+    /**
+     * alpha 大于 127 的区域的轮廓，轮廓点在 native 层打包返回，这里一次性构建 Path。
+     *
+     * @param tolerance Douglas-Peucker 简化的最大偏差，单位像素，0 为不简化
+     * @param smooth 为 true 时把轮廓转成平滑的三次贝塞尔曲线
+     */
+    @JvmOverloads
+    fun getBitmapOutlinePath(bitmap: Bitmap, tolerance: Float = 0f, smooth: Boolean = false): Path {
+        return getBitmapContours(bitmap, tolerance, smooth)?.toPath() ?: Path()
+    }
+
+    /**
+     * 同 [getBitmapOutlinePath]，返回打包的轮廓点，bitmap 不是 ARGB_8888 时返回 null
+     */
+    external fun getBitmapContours(bitmap: Bitmap, tolerance: Float, smooth: Boolean): OutlineContours?
 
     external fun nativeOutlineBitmap(srcBitmap: Bitmap, destBitmap: Bitmap, strokeWidth: Int, blurRadius: Float, color: Int)
 
+    /**
+     * 一次画多条描边，按顺序叠加，后面的在上层。距离场只计算一次，所有描边在同一遍中合成。
+     *
+     * @param cache [createOutlineCache] 创建的距离场缓存，0 为不缓存。srcBitmap 没有修改过且描边范围
+     * 没有变大时（例如只改颜色）直接复用上次的距离场
+     */
+    external fun nativeOutlineBitmapStrokes(srcBitmap: Bitmap, destBitmap: Bitmap, strokes: Array<OutlineStroke>, cache: Long)
+
+    /**
+     * 创建 [nativeOutlineBitmapStrokes] 的距离场缓存，不再使用时调用 [releaseOutlineCache]，不能同时在多个线程中使用
+     */
+    external fun createOutlineCache(): Long
+
+    external fun releaseOutlineCache(cache: Long)
+
     external fun cutoutBitmapBySource(cutoutBitmap: Bitmap, srcBitmap: Bitmap): Bitmap?
 
     external fun hasAlpha(bitmap: Bitmap): Boolean
-}
\ No newline at end of file
+
+    /**
+     * 检查 ARGB_8888 bitmap 的透明度，直接读像素，不复制。
+     *
+     * @param rect 不为 null 时写入 alpha 不为 0 的像素的外接矩形 x, y, w, h，长度至少为 4
+     * @param cellMap 不为 null 时写入按 cellSize 分格的透明度图，每格 -1(255)：全不透明，0：全透明，
+     * -128(128)：半透明或两者都有，长度至少为 ceil(width / cellSize) * ceil(height / cellSize)
+     * @return 1：有透明像素，0：全不透明，小于 0：参数错误
+     */
+    external fun probeAlpha(bitmap: Bitmap, rect: IntArray?, cellMap: ByteArray?, cellSize: Int): Int
+
+    /**
+     * 创建羽化用的有符号距离场，maskBitmap 为 ARGB_8888（取 alpha）或 ALPHA_8，值大于 128 的像素为形状。
+     * 距离场只计算一次，拖动滑杆时只需调用 [featherMask]，不再使用时调用 [releaseFeatherField]
+     *
+     * @param maxOuter 之后向外羽化的最大宽度，单位像素
+     * @return 距离场，失败时为 0
+     */
+    external fun createFeatherField(maskBitmap: Bitmap, maxOuter: Float): Long
+
+    external fun releaseFeatherField(field: Long)
+
+    /**
+     * 把羽化后的黑白图写入 destBitmap（ARGB_8888 或 ALPHA_8，尺寸和创建距离场的 bitmap 相同），
+     * 形状边界向内 inner、向外 outer 像素之间按 curve 过渡，耗时和羽化宽度无关
+     *
+     * @param curve [FEATHER_CURVE_LINEAR]、[FEATHER_CURVE_SMOOTH] 或 [FEATHER_CURVE_GAUSSIAN]
+     * @return 0：成功，小于 0：参数错误
+     */
+    external fun featherMask(field: Long, destBitmap: Bitmap, inner: Float, outer: Float, curve: Int): Int
+}
@@ -0,0 +1,42 @@
+package com.sqsong.nativelib
+
+import android.graphics.Path
+
+/**
+ * [NativeLib.getBitmapContours] 返回的轮廓，所有点打包在一个数组里，由 native 层构造。
+ *
+ * @param points x, y 交替的坐标
+ * @param offsets 第 k 个轮廓的点为 offsets[k] 到 offsets[k + 1]（按点计），长度为轮廓数 + 1
+ * @param cubic 为 true 时每个轮廓是起点加若干段三次贝塞尔曲线（每段两个控制点和终点），否则为折线
+ */
+class OutlineContours(val points: FloatArray, val offsets: IntArray, val cubic: Boolean) {
+
+    val size: Int
+        get() = offsets.size - 1
+
+    /**
+     * 把所有轮廓闭合后加到 path 中
+     */
+    fun toPath(path: Path = Path()): Path {
+        for (k in 0 until size) {
+            var i = offsets[k] * 2
+            val end = offsets[k + 1] * 2
+            if (i == end) continue
+            path.moveTo(points[i], points[i + 1])
+            i += 2
+            if (cubic) {
+                while (i < end) {
+                    path.cubicTo(points[i], points[i + 1], points[i + 2], points[i + 3], points[i + 4], points[i + 5])
+                    i += 6
+                }
+            } else {
+                while (i < end) {
+                    path.lineTo(points[i], points[i + 1])
+                    i += 2
+                }
+            }
+            path.close()
+        }
+        return path
+    }
+}
@@ -0,0 +1,16 @@
+package com.sqsong.nativelib
+
+/**
+ * 一条描边，用于 [NativeLib.nativeOutlineBitmapStrokes]，native 层按字段名读取。
+ *
+ * @param width 描边宽度，单位像素
+ * @param color 描边颜色 ARGB
+ * @param softness 描边边缘的模糊程度，同高斯模糊的 sigma，0 为不模糊
+ * @param offset 描边内侧到形状的距离，0 时描边覆盖形状内部，大于 0 时描边和形状之间留出空隙
+ */
+data class OutlineStroke(
+    val width: Float,
+    val color: Int,
+    val softness: Float = 0f,
+    val offset: Float = 0f
+)
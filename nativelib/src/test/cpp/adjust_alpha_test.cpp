@@ -0,0 +1,141 @@
+//
+//  adjust_alpha_test.cpp
+//  WXAdjustAlpha 与原来的实现逐像素比较：第 0 通道用 cv::GaussianBlur 模糊后查 smooth step 表，
+//  写入前 3 个通道，第 4 个通道和行尾的填充保持不变；外接矩形为结果中非零像素的范围
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "LibAlpha.h"
+
+// LibAlpha.cpp 中生成 alpha_table 的函数
+uint8_t *smooth_step_table(int a, int b);
+
+static const uint8_t pad_value = 0x5A;
+
+// 柔和边缘的椭圆黑白图，加少量噪点；第 4 通道为随机值，行尾填充为 pad_value
+static std::vector<uint8_t> make_mask(int width, int height, int nb_channel, int stride) {
+    std::vector<uint8_t> mask((size_t) stride * height, pad_value);
+    srand(width * 7 + height + nb_channel);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float dx = (x - width * 0.45f) / (width * 0.3f), dy = (y - height * 0.55f) / (height * 0.25f);
+            float d = sqrtf(dx * dx + dy * dy);
+            int v = d < 0.9f ? 255 : d < 1.1f ? (int) ((1.1f - d) / 0.2f * 255) : 0;
+            if (rand() % 50 == 0)
+                v = rand() % 256;
+            uint8_t *p = &mask[(size_t) y * stride + x * nb_channel];
+            for (int c = 0; c < nb_channel; c++)
+                p[c] = c == 3 ? (uint8_t) rand() : (uint8_t) v;
+        }
+    }
+    return mask;
+}
+
+// 第 channel 通道非零像素的外接矩形，没有时返回 false
+static bool bounding_rect(const uint8_t *data, int width, int height, int nb_channel, int stride, int channel, int *rect) {
+    int minx = width, miny = height, maxx = -1, maxy = -1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (data[(size_t) y * stride + x * nb_channel + channel] == 0)
+                continue;
+            minx = MIN(minx, x);
+            maxx = MAX(maxx, x);
+            miny = MIN(miny, y);
+            maxy = MAX(maxy, y);
+        }
+    }
+    if (maxx < 0)
+        return false;
+    rect[0] = minx;
+    rect[1] = miny;
+    rect[2] = maxx - minx + 1;
+    rect[3] = maxy - miny + 1;
+    return true;
+}
+
+// 原来的实现，结果写入 dst
+static void reference(uint8_t *dst, const uint8_t *src, int width, int height, int nb_channel, int stride) {
+    static const uint8_t *table = smooth_step_table(60, 220);
+    cv::Mat plane(height, width, CV_8UC1);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            plane.at<uint8_t>(y, x) = src[(size_t) y * stride + x * nb_channel];
+    const int blur_size = MAX(width, height) > 1000 ? 5 : 3;
+    cv::Mat blurred;
+    cv::GaussianBlur(plane, blurred, cv::Size(blur_size, blur_size), 0);
+    memcpy(dst, src, (size_t) stride * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t *p = dst + (size_t) y * stride + x * nb_channel;
+            for (int c = 0; c < MIN(nb_channel, 3); c++)
+                p[c] = table[blurred.at<uint8_t>(y, x)];
+        }
+    }
+}
+
+// 返回不一致的项数
+static int check(int width, int height, int nb_channel, int pad, bool in_place) {
+    const int stride = width * nb_channel + pad;
+    std::vector<uint8_t> src = make_mask(width, height, nb_channel, stride);
+    std::vector<uint8_t> expected(src.size());
+    reference(expected.data(), src.data(), width, height, nb_channel, stride);
+
+    std::vector<uint8_t> dst = in_place ? src : std::vector<uint8_t>(src.size(), pad_value);
+    int rect[4];
+    int ret = WXAdjustAlpha(dst.data(), in_place ? dst.data() : src.data(), width, height, nb_channel, stride, rect);
+
+    int failures = 0;
+    if (ret != 0) {
+        printf("%dx%d nb_channel %d: returned %d\n", width, height, nb_channel, ret);
+        failures++;
+    }
+    size_t bad = 0;
+    for (int y = 0; y < height; y++) {
+        const size_t row = (size_t) y * stride;
+        for (int x = 0; x < width * nb_channel; x++)
+            bad += dst[row + x] != expected[row + x];
+        if (in_place) {
+            for (int x = width * nb_channel; x < stride; x++)
+                bad += dst[row + x] != pad_value;
+        }
+    }
+    if (bad > 0) {
+        printf("%dx%d nb_channel %d pad %d in_place %d: %zu bytes differ\n", width, height, nb_channel, pad, in_place, bad);
+        failures++;
+    }
+    int expected_rect[4];
+    bounding_rect(expected.data(), width, height, nb_channel, stride, 0, expected_rect);
+    if (memcmp(rect, expected_rect, sizeof(rect)) != 0) {
+        printf("%dx%d nb_channel %d: rect %d %d %d %d, expected %d %d %d %d\n", width, height, nb_channel,
+               rect[0], rect[1], rect[2], rect[3], expected_rect[0], expected_rect[1], expected_rect[2], expected_rect[3]);
+        failures++;
+    }
+
+    // 不处理时 rect 为原图的外接矩形
+    int raw_rect[4], expected_raw_rect[4];
+    ret = WXAdjustAlpha(NULL, src.data(), width, height, nb_channel, stride, raw_rect);
+    bounding_rect(src.data(), width, height, nb_channel, stride, 0, expected_raw_rect);
+    if (ret != 0 || memcmp(raw_rect, expected_raw_rect, sizeof(raw_rect)) != 0) {
+        printf("%dx%d nb_channel %d: rect only returned %d, rect %d %d %d %d\n", width, height, nb_channel, ret,
+               raw_rect[0], raw_rect[1], raw_rect[2], raw_rect[3]);
+        failures++;
+    }
+    return failures;
+}
+
+int main() {
+    int failures = 0;
+    for (int nb_channel : {1, 3, 4}) {
+        for (bool in_place : {false, true}) {
+            // 3x3 核
+            failures += check(641, 479, nb_channel, 3, in_place);
+            // 5x5 核，宽度不是向量长度的倍数
+            failures += check(1283, 723, nb_channel, 0, in_place);
+        }
+    }
+    printf("adjust_alpha_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+//
+//  enhance_foreground_test.cpp
+//  WXEnhanceForegroundEx 与原来整张图用 CV_32FC3 Mat 处理的实现逐像素比较，误差不超过 1；
+//  band_only 时半透明像素与完整处理的结果比较，其余像素为原图或 0
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "LibAlpha.h"
+#include "enhance_foreground_mat.h"
+
+// 测试图：渐变加噪点的预乘 rgba，少量像素半透明
+static std::vector<uint8_t> make_image(int width, int height, int nb_channel, int stride) {
+    std::vector<uint8_t> image((size_t) stride * height, 0);
+    srand(width + height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t *p = &image[(size_t) y * stride + x * nb_channel];
+            int a = rand() % 8 == 0 ? rand() % 256 : 255;
+            int rgb[3] = {x * 255 / width, y * 255 / height, (x + y) * 127 / (width + height) + rand() % 64};
+            if (nb_channel == 1) {
+                p[0] = (uint8_t) rgb[2];
+                continue;
+            }
+            for (int c = 0; c < 3; c++)
+                p[c] = (uint8_t) (rgb[c] * a / 255);
+            p[3] = (uint8_t) a;
+        }
+    }
+    return image;
+}
+
+// 中心 (cx, cy)、半轴 (rx, ry) 的椭圆 mask，边缘 edge 像素内渐变，渐变处夹杂随机值
+static std::vector<uint8_t> make_mask(int width, int height, int nb_channel, int stride, float cx, float cy, float rx, float ry,
+                                      float edge) {
+    std::vector<uint8_t> mask((size_t) stride * height, 0);
+    srand(width * 5 + height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float dx = (x - cx) / rx, dy = (y - cy) / ry;
+            float d = (sqrtf(dx * dx + dy * dy) - 1) * MIN(rx, ry) / edge;
+            int v = d < -0.5f ? 255 : d > 0.5f ? 0 : (int) ((0.5f - d) * 255);
+            if (v > 0 && v < 255 && rand() % 4 == 0)
+                v = rand() % 256;
+            uint8_t *p = &mask[(size_t) y * stride + x * nb_channel];
+            for (int c = 0; c < nb_channel; c++)
+                p[c] = (uint8_t) v;
+        }
+    }
+    return mask;
+}
+
+struct test_case {
+    const char *name;
+    int width, height;
+    float cx, cy, rx, ry;
+};
+
+// 返回不一致的项数
+static int check(const test_case &t, int src_type, int dst_type, int alpha_type) {
+    const int width = t.width, height = t.height;
+    const int src_stride = width * src_type + 4, dst_stride = width * dst_type + 8, alpha_stride = width * alpha_type;
+    const bool is_mask_alpha_channel = alpha_type == 4;
+    std::vector<uint8_t> src = make_image(width, height, src_type, src_stride);
+    std::vector<uint8_t> alpha = make_mask(width, height, alpha_type, alpha_stride, t.cx * width, t.cy * height,
+                                           t.rx * width, t.ry * height, 12);
+
+    std::vector<uint8_t> expected((size_t) dst_stride * height, 0x5A);
+    int expected_rect[4];
+    int expected_ret = enhance_foreground_mat::enhance(expected.data(), dst_type, dst_stride, src.data(), width, height, src_type,
+                                                       src_stride, alpha.data(), alpha_type, alpha_stride, expected_rect,
+                                                       is_mask_alpha_channel);
+
+    std::vector<uint8_t> dst((size_t) dst_stride * height, 0x5A);
+    int rect[4];
+    size_t peak_memory = 0;
+    int ret = WXEnhanceForegroundEx(dst.data(), dst_type, dst_stride, src.data(), width, height, src_type, src_stride,
+                                    alpha.data(), alpha_type, alpha_stride, rect, is_mask_alpha_channel, false, &peak_memory);
+
+    int failures = 0;
+    if (ret != 0 || expected_ret != 0) {
+        printf("%s src %d dst %d alpha %d: returned %d, expected %d\n", t.name, src_type, dst_type, alpha_type, ret,
+               expected_ret);
+        return 1;
+    }
+    if (memcmp(rect, expected_rect, sizeof(rect)) != 0) {
+        printf("%s: rect %d %d %d %d, expected %d %d %d %d\n", t.name, rect[0], rect[1], rect[2], rect[3],
+               expected_rect[0], expected_rect[1], expected_rect[2], expected_rect[3]);
+        failures++;
+    }
+    int max_diff = 0;
+    for (int y = 0; y < height; y++) {
+        const size_t row = (size_t) y * dst_stride;
+        for (int x = 0; x < width * dst_type; x++)
+            max_diff = MAX(max_diff, abs(dst[row + x] - expected[row + x]));
+    }
+    if (max_diff > 1) {
+        printf("%s src %d dst %d alpha %d: max difference %d\n", t.name, src_type, dst_type, alpha_type, max_diff);
+        failures++;
+    }
+    // 缩小处理时额外的内存只有小图和每个线程几行，小于原来一张整图的 CV_32FC3
+    if (peak_memory == 0 || (MAX(width, height) > 600 && peak_memory >= (size_t) width * height * 12)) {
+        printf("%s: peak memory %zu\n", t.name, peak_memory);
+        failures++;
+    }
+    return failures;
+}
+
+// band_only 时 mask 为 0 的像素为 0，为 255 的像素为去预乘的原图，半透明像素与完整处理相差不超过 1
+static int check_band(const test_case &t, int src_type, int dst_type, int alpha_type) {
+    const int width = t.width, height = t.height;
+    const int src_stride = width * src_type + 4, dst_stride = width * dst_type + 8, alpha_stride = width * alpha_type;
+    const bool is_mask_alpha_channel = alpha_type == 4;
+    std::vector<uint8_t> src = make_image(width, height, src_type, src_stride);
+    std::vector<uint8_t> alpha = make_mask(width, height, alpha_type, alpha_stride, t.cx * width, t.cy * height,
+                                           t.rx * width, t.ry * height, 12);
+
+    std::vector<uint8_t> full((size_t) dst_stride * height, 0x5A), band((size_t) dst_stride * height, 0x5A);
+    int ret = WXEnhanceForegroundEx(full.data(), dst_type, dst_stride, src.data(), width, height, src_type, src_stride,
+                                    alpha.data(), alpha_type, alpha_stride, NULL, is_mask_alpha_channel, false, NULL);
+    int band_ret = WXEnhanceForegroundEx(band.data(), dst_type, dst_stride, src.data(), width, height, src_type, src_stride,
+                                         alpha.data(), alpha_type, alpha_stride, NULL, is_mask_alpha_channel, true, NULL);
+    if (ret != 0 || band_ret != 0) {
+        printf("%s band src %d dst %d alpha %d: returned %d, full %d\n", t.name, src_type, dst_type, alpha_type, band_ret, ret);
+        return 1;
+    }
+
+    int max_diff = 0;
+    size_t transparent = 0, opaque = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t mask = alpha[(size_t) y * alpha_stride + x * alpha_type + (is_mask_alpha_channel ? 3 : 0)];
+            const uint8_t *s = &src[(size_t) y * src_stride + x * src_type];
+            const uint8_t *d = &band[(size_t) y * dst_stride + x * dst_type];
+            const uint8_t *f = &full[(size_t) y * dst_stride + x * dst_type];
+            if (mask == 0) {
+                for (int c = 0; c < dst_type; c++)
+                    transparent += d[c] != 0;
+            } else if (mask == 255) {
+                uint8_t expected[4] = {s[0], s[0], s[0], 255};
+                if (src_type == 4) {
+                    for (int c = 0; c < 3; c++) {
+                        float v = s[3] == 0 || s[3] == 255 ? s[c] : (s[c] / 255.0f) / (s[3] / 255.0f) * 255.0f;
+                        expected[c] = (uint8_t) MIN(v, 255.0f);
+                    }
+                }
+                opaque += memcmp(d, expected, dst_type) != 0;
+            } else {
+                for (int c = 0; c < dst_type; c++)
+                    max_diff = MAX(max_diff, abs(d[c] - f[c]));
+            }
+        }
+    }
+    if (transparent > 0 || opaque > 0 || max_diff > 1) {
+        printf("%s band src %d dst %d alpha %d: %zu transparent and %zu opaque pixels differ, max difference %d\n", t.name,
+               src_type, dst_type, alpha_type, transparent, opaque, max_diff);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    const test_case cases[] = {
+        // 长边不超过 600，在原图上估计
+        {"small", 517, 389, 0.5f, 0.5f, 0.42f, 0.4f},
+        // 外接矩形接近整张图，整张图缩小到 600
+        {"covering", 1381, 947, 0.5f, 0.5f, 0.52f, 0.54f},
+        // 只处理外接矩形加 100 像素边距的 roi
+        {"roi", 1213, 1703, 0.4f, 0.55f, 0.25f, 0.2f},
+    };
+    int failures = 0;
+    for (const test_case &t : cases) {
+        for (int src_type : {4, 1}) {
+            failures += check(t, src_type, 4, 1);
+            failures += check(t, src_type, 1, 4);
+            failures += check_band(t, src_type, 4, 1);
+            failures += check_band(t, src_type, 1, 4);
+        }
+    }
+    printf("enhance_foreground_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
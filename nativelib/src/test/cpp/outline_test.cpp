@@ -0,0 +1,290 @@
+//
+//  outline_test.cpp
+//  描边：距离场与暴力计算的欧氏距离比较；WXOutlineRGBA、WXOutlineRGBAStrokes 的结果与由距离解析得到的覆盖率
+//  逐条做 SRC_OVER 的结果比较，误差不超过 2；使用距离场缓存时结果与不使用时相同
+//
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "LibAlpha.h"
+#include "signed_distance.h"
+
+static const int max_level_diff = 2;
+
+// 随机的圆组成的黑白图，圆内的值随机为 255 或半透明
+static std::vector<uint8_t> make_blobs(int width, int height, int count) {
+    std::vector<uint8_t> mask((size_t) width * height, 0);
+    for (int k = 0; k < count; k++) {
+        int cx = rand() % width, cy = rand() % height, r = rand() % 15;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+                    mask[(size_t) y * width + x] = rand() % 2 ? 255 : (uint8_t) (rand() % 256);
+            }
+        }
+    }
+    return mask;
+}
+
+// 暴力计算 (x, y) 到形状边界的有符号距离：形状外为到最近形状像素中心的距离减 0.5，形状内为 0.5 减到最近非形状像素的距离
+// [x0, x1) x [y0, y1) 之外的像素都看作形状外
+static float brute_distance(const uint8_t *mask, int stride, int nb_channel, int x0, int y0, int x1, int y1, int x, int y) {
+    auto site = [&](int i, int j) {
+        return i >= x0 && i < x1 && j >= y0 && j < y1 && mask[(size_t) j * stride + i * nb_channel] > 128;
+    };
+    const bool inside = site(x, y);
+    double best = HUGE_VAL;
+    for (int j = y0 - 1; j <= y1; j++) {
+        for (int i = x0 - 1; i <= x1; i++) {
+            if (site(i, j) != inside)
+                best = std::min(best, (double) (i - x) * (i - x) + (double) (j - y) * (j - y));
+        }
+    }
+    if (best == HUGE_VAL)
+        return FLT_MAX;
+    return inside ? 0.5f - (float) std::sqrt(best) : (float) std::sqrt(best) - 0.5f;
+}
+
+// 返回不一致的项数
+static int check_distance_field() {
+    int failures = 0;
+    srand(1);
+    for (int it = 0; it < 200; it++) {
+        int width = 1 + rand() % 70, height = 1 + rand() % 60;
+        std::vector<uint8_t> mask = make_blobs(width, height, rand() % 6);
+        int rect[4];
+        if (WXCalculateMaskRect(mask.data(), width, height, 1, width, 0, rect) < 0)
+            continue;
+        int margin = rand() % 10;
+        for (bool inside : {true, false}) {
+            signed_distance::field f;
+            signed_distance::build(f, {mask.data(), width, 1, 0}, width, height, rect, margin, inside);
+            for (int i = 0; i < f.height; i++) {
+                for (int j = 0; j < f.width; j++) {
+                    const int x = f.x + j, y = f.y + i;
+                    float expected = brute_distance(mask.data(), width, 1, f.x, f.y, f.x + f.width, f.y + f.height, x, y);
+                    if (!inside && expected < 0)
+                        expected = -0.5f;
+                    float d = f.dist[(size_t) i * f.width + j];
+                    if (d != expected && std::fabs(d - expected) > 1e-4f) {
+                        if (failures < 10)
+                            printf("distance %dx%d margin %d inside %d at (%d, %d): %f, expected %f\n", width, height,
+                                   margin, inside, x, y, d, expected);
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+
+    // 高度超过 65535 的列，只有第一个像素为形状
+    const int tall = 70000;
+    std::vector<uint8_t> column(tall, 0);
+    column[0] = 255;
+    int rect[4] = {0, 0, 1, 1};
+    signed_distance::field f;
+    signed_distance::build(f, {column.data(), 1, 1, 0}, 1, tall, rect, tall, true);
+    for (int y = 1; y < tall; y++) {
+        if (f.dist[y] != y - 0.5f) {
+            printf("tall column at %d: %f\n", y, f.dist[y]);
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+// 宽 width 的描边边界内 t 像素处，像素宽度内的平均覆盖率：高斯边缘 (sigma = softness) 的累积分布在 [t - 0.5, t + 0.5] 上的平均
+static double coverage(double t, double softness) {
+    auto integral = [softness](double s) {
+        if (softness <= 0)
+            return s > 0 ? s : 0.0;
+        double u = s / softness;
+        return s * 0.5 * std::erfc(-u / std::sqrt(2.0)) + softness * std::exp(-0.5 * u * u) / std::sqrt(2.0 * M_PI);
+    };
+    return std::min(std::max(integral(t + 0.5) - integral(t - 0.5), 0.0), 1.0);
+}
+
+// 预乘的 rgba 像素 p 上按顺序叠加描边，e 为像素到形状边界的有符号距离
+static void blend(double *p, const WXOutlineStroke *strokes, int count, float e) {
+    for (int k = 0; k < count; k++) {
+        const WXOutlineStroke &s = strokes[k];
+        double c = coverage(s.offset + s.width - e, s.softness);
+        if (s.offset > 0)
+            c = std::max(c - coverage(s.offset - e, s.softness), 0.0);
+        const double sa = ((s.color >> 24) & 0xFF) / 255.0 * c;
+        const double rgb[3] = {(double) ((s.color >> 16) & 0xFF), (double) ((s.color >> 8) & 0xFF), (double) (s.color & 0xFF)};
+        for (int i = 0; i < 3; i++)
+            p[i] = rgb[i] * sa + p[i] * (1 - sa);
+        p[3] = 255 * sa + p[3] * (1 - sa);
+    }
+}
+
+// 预乘的测试图：两个边缘抗锯齿的圆、一个矩形和一个贴着右下角的矩形
+static std::vector<uint8_t> make_shapes(int width, int height, int stride) {
+    std::vector<uint8_t> image((size_t) stride * height, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float d1 = std::sqrt((x - 50.f) * (x - 50.f) + (y - 60.f) * (y - 60.f)) - 30.f;
+            float d2 = std::sqrt((x - 95.3f) * (x - 95.3f) + (y - 85.7f) * (y - 85.7f)) - 9.4f;
+            float a = std::min(std::max(0.5f - std::min(d1, d2), 0.f), 1.f);
+            if ((x >= 100 && x < 130 && y >= 20 && y < 40) || (x >= width - 25 && y >= height - 15))
+                a = 1;
+            uint8_t *p = &image[(size_t) y * stride + x * 4];
+            const int alpha = (int) (a * 255 + 0.5f);
+            p[0] = (uint8_t) (alpha * x / width);
+            p[1] = (uint8_t) (alpha * y / height);
+            p[2] = (uint8_t) (alpha / 2);
+            p[3] = (uint8_t) alpha;
+        }
+    }
+    return image;
+}
+
+// rgba 图片每个像素到 alpha 形状边界的有符号距离
+static std::vector<float> brute_field(const uint8_t *rgba, int width, int height, int stride) {
+    std::vector<float> dist((size_t) width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            dist[(size_t) y * width + x] = brute_distance(rgba + 3, stride, 4, 0, 0, width, height, x, y);
+    }
+    return dist;
+}
+
+// dst 与 src 上叠加 strokes 的解析结果比较，dist 为 src 的距离场，返回不一致的项数
+static int compare_strokes(const char *name, const uint8_t *dst, int dst_stride, const uint8_t *src, int width, int height,
+                           int src_stride, const std::vector<float> &dist, const WXOutlineStroke *strokes, int count) {
+    int max_diff = 0, worst_x = 0, worst_y = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *s = src + (size_t) y * src_stride + x * 4;
+            const uint8_t *d = dst + (size_t) y * dst_stride + x * 4;
+            double p[4] = {(double) s[0], (double) s[1], (double) s[2], (double) s[3]};
+            blend(p, strokes, count, dist[(size_t) y * width + x]);
+            for (int c = 0; c < 4; c++) {
+                int diff = std::abs(d[c] - (int) std::lround(p[c]));
+                if (diff > max_diff) {
+                    max_diff = diff;
+                    worst_x = x;
+                    worst_y = y;
+                }
+            }
+        }
+    }
+    if (max_diff > max_level_diff) {
+        printf("%s: max difference %d at (%d, %d)\n", name, max_diff, worst_x, worst_y);
+        return 1;
+    }
+    return 0;
+}
+
+static const int shapes_width = 160, shapes_height = 120, shapes_stride = shapes_width * 4 + 12;
+
+static int check_single_stroke(const std::vector<float> &dist, float stroke_width, float softness, uint32_t color, bool in_place) {
+    const int width = shapes_width, height = shapes_height, src_stride = shapes_stride;
+    const int dst_stride = in_place ? src_stride : width * 4;
+    std::vector<uint8_t> src = make_shapes(width, height, src_stride);
+    std::vector<uint8_t> dst = in_place ? src : std::vector<uint8_t>((size_t) dst_stride * height, 0x5A);
+    int ret = WXOutlineRGBA(dst.data(), dst_stride, in_place ? dst.data() : src.data(), width, height, src_stride, stroke_width,
+                            softness, color);
+    char name[96];
+    snprintf(name, sizeof(name), "width %g softness %g color %08X in_place %d", stroke_width, softness, color, in_place);
+    if (ret != 0) {
+        printf("%s: returned %d\n", name, ret);
+        return 1;
+    }
+    WXOutlineStroke stroke = {stroke_width, softness, 0, color};
+    return compare_strokes(name, dst.data(), dst_stride, src.data(), width, height, src_stride, dist, &stroke, 1);
+}
+
+// 多条描边，包括和形状之间有空隙的描边
+static int check_strokes(const std::vector<float> &dist) {
+    const int width = shapes_width, height = shapes_height, stride = shapes_stride;
+    std::vector<uint8_t> src = make_shapes(width, height, stride);
+    std::vector<uint8_t> dst(src.size(), 0x5A);
+    const WXOutlineStroke strokes[] = {
+        {7, 3, 6, 0x60000000},
+        {3, 0, 0, 0xFFFFFFFF},
+        {2.5f, 0.6f, 3, 0xFFE04020},
+        {1, 0, 7.5f, 0xB02040FF},
+    };
+    const int count = sizeof(strokes) / sizeof(strokes[0]);
+    int ret = WXOutlineRGBAStrokes(dst.data(), stride, src.data(), width, height, stride, strokes, count, NULL, 0);
+    if (ret != 0) {
+        printf("strokes: returned %d\n", ret);
+        return 1;
+    }
+    return compare_strokes("strokes", dst.data(), stride, src.data(), width, height, stride, dist, strokes, count);
+}
+
+// 使用缓存的结果与不使用缓存时相同：第一次计算、只改颜色、描边变宽超出缓存范围、图片内容和 source_id 改变
+static int check_cache() {
+    const int width = shapes_width, height = shapes_height, stride = shapes_stride;
+    std::vector<uint8_t> src = make_shapes(width, height, stride);
+    std::vector<uint8_t> cached(src.size()), expected(src.size());
+    void *cache = WXCreateOutlineCache();
+    if (cache == NULL) {
+        printf("cache: WXCreateOutlineCache returned NULL\n");
+        return 1;
+    }
+
+    WXOutlineStroke strokes[] = {
+        {3, 0, 0, 0xFFFFFFFF},
+        {4, 1.5f, 2, 0xFF3050F0},
+    };
+    struct step {
+        const char *name;
+        uint32_t colors[2];
+        float outer_width;
+        bool change_image;
+    };
+    const step steps[] = {
+        {"first call", {0xFFFFFFFF, 0xFF3050F0}, 4, false},
+        {"color only", {0xFF000000, 0x80F0C020}, 4, false},
+        {"wider stroke", {0xFF000000, 0x80F0C020}, 16, false},
+        {"new image", {0xFF000000, 0x80F0C020}, 16, true},
+    };
+    int failures = 0;
+    uint64_t source_id = 1;
+    for (const step &s : steps) {
+        if (s.change_image) {
+            // 去掉左边的圆
+            for (int y = 0; y < height; y++)
+                memset(&src[(size_t) y * stride], 0, 84 * 4);
+            source_id++;
+        }
+        for (int k = 0; k < 2; k++)
+            strokes[k].color = s.colors[k];
+        strokes[1].width = s.outer_width;
+        int ret = WXOutlineRGBAStrokes(cached.data(), stride, src.data(), width, height, stride, strokes, 2, cache, source_id);
+        int expected_ret = WXOutlineRGBAStrokes(expected.data(), stride, src.data(), width, height, stride, strokes, 2, NULL, 0);
+        if (ret != 0 || expected_ret != 0 || memcmp(cached.data(), expected.data(), expected.size()) != 0) {
+            printf("cache, %s: returned %d, differs from the result without a cache\n", s.name, ret);
+            failures++;
+        }
+    }
+    WXReleaseOutlineCache(cache);
+    return failures;
+}
+
+int main() {
+    int failures = check_distance_field();
+    std::vector<uint8_t> shapes = make_shapes(shapes_width, shapes_height, shapes_stride);
+    const std::vector<float> dist = brute_field(shapes.data(), shapes_width, shapes_height, shapes_stride);
+    for (bool in_place : {false, true}) {
+        // 硬边
+        failures += check_single_stroke(dist, 6, 0, 0xFF2080E0, in_place);
+        failures += check_single_stroke(dist, 2.5f, 0, 0xC0FF0000, in_place);
+        // 柔和边缘
+        failures += check_single_stroke(dist, 4.5f, 2, 0xFFFFFFFF, in_place);
+        failures += check_single_stroke(dist, 10, 0.7f, 0x8000FF40, in_place);
+        failures += check_single_stroke(dist, 0, 3, 0xFF000000, in_place);
+    }
+    failures += check_strokes(dist);
+    failures += check_cache();
+    printf("outline_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
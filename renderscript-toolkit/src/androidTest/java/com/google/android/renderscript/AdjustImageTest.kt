@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.android.renderscript
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+import kotlin.math.abs
+import kotlin.math.pow
+
+/**
+ * Compares adjustImage with the AdjustImage shader, evaluated in float for every pixel.
+ */
+@RunWith(AndroidJUnit4::class)
+class AdjustImageTest {
+    private val sizeX = 83
+    private val sizeY = 57
+    private val input = opaqueTestImage(sizeX, sizeY)
+
+    @Test
+    fun eachAdjustmentIsWithinOneStepOfTheShader() {
+        listOf(
+            Adjustments(),
+            Adjustments(brightness = 0.12f),
+            Adjustments(contrast = 1.25f),
+            Adjustments(saturation = 1.8f),
+            Adjustments(exposure = -1f),
+            Adjustments(exposure = 0.8f),
+            Adjustments(highlights = 0.3f),
+            Adjustments(shadows = 1.3f),
+            Adjustments(temperature = -0.8f),
+            Adjustments(hue = -2.5f),
+            Adjustments(sharpness = 0.7f),
+            Adjustments(vignette = 0.8f)
+        ).forEach(::assertWithinOneStep)
+    }
+
+    @Test
+    fun combinedAdjustmentsAreWithinOneStepOfTheShader() {
+        assertWithinOneStep(Adjustments(brightness = 0.05f, contrast = 1.2f, exposure = 0.3f))
+        assertWithinOneStep(
+            Adjustments(
+                brightness = -0.05f,
+                contrast = 0.8f,
+                saturation = 0.4f,
+                exposure = -0.5f,
+                highlights = 1.6f,
+                shadows = 0.7f,
+                temperature = 0.5f,
+                hue = 1f,
+                sharpness = 0.3f,
+                vignette = 0.5f
+            )
+        )
+    }
+
+    private fun assertWithinOneStep(adjustments: Adjustments) {
+        val output = Toolkit.adjustImage(
+            input, sizeX, sizeY, adjustments, null, AlphaType.UNPREMULTIPLIED
+        )
+        val expected = shader(input.toUnitFloats(), adjustments).toBytes()
+        val difference = maxDifference(expected, output)
+        assertTrue("$adjustments is $difference steps from the shader", difference <= 1)
+    }
+
+    // The main() of the AdjustImage shader, without the final premultiplication.
+    private fun shader(source: FloatArray, a: Adjustments): FloatArray {
+        val image = sharpen(source, sizeX, sizeY, a.sharpness)
+        var magnitude = 1f + abs(a.exposure * 1.045f)
+        if (a.exposure < 0f) {
+            magnitude = 1f / magnitude
+        }
+        for (y in 0 until sizeY) {
+            for (x in 0 until sizeX) {
+                val i = (y * sizeX + x) * 4
+                for (k in 0..2) {
+                    val bright = (image[i + k] + a.brightness).coerceIn(0f, 1f)
+                    val contrasted = (bright - 0.5f) * a.contrast.coerceAtLeast(0f) + 0.5f
+                    image[i + k] = ((contrasted - 0.5f) * a.contrast + 0.5f).coerceIn(0f, 1f)
+                }
+                val l = 0.2126f * image[i] + 0.7152f * image[i + 1] + 0.0722f * image[i + 2]
+                for (k in 0..2) {
+                    val saturated = (l * (1f - a.saturation) + image[i + k] * a.saturation)
+                        .coerceIn(0f, 1f)
+                    image[i + k] = 1f - (1f - saturated).pow(magnitude)
+                }
+                highlightsShadows(image, i, a.highlights, a.shadows)
+                hueWarmth(image, i, a.hue, a.temperature)
+                val factor = vignetteFactor(sizeX, sizeY, x, y, a.vignette)
+                for (k in 0..2) {
+                    image[i + k] *= factor
+                }
+            }
+        }
+        return image
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.android.renderscript
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertArrayEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+import kotlin.math.abs
+import kotlin.math.floor
+import kotlin.math.min
+import kotlin.math.pow
+import kotlin.math.roundToInt
+import kotlin.math.sqrt
+
+/**
+ * Compares adjustmentChain with the standalone OpenGL filters, run one pass per filter with the
+ * colors rounded to 8 bits between the passes, like the frame buffers of the GL chain.
+ */
+@RunWith(AndroidJUnit4::class)
+class AdjustmentChainTest {
+    private val sizeX = 97
+    private val sizeY = 61
+    private val input = opaqueTestImage(sizeX, sizeY)
+
+    @Test
+    fun eachFilterIsWithinThreeStepsOfItsShader() {
+        listOf(
+            Adjustments(brightness = 0.1f),
+            Adjustments(contrast = 1.2f),
+            Adjustments(saturation = 1.7f),
+            Adjustments(exposure = -0.6f),
+            Adjustments(exposure = 0.5f),
+            Adjustments(highlights = 0.3f),
+            Adjustments(highlights = 1.7f),
+            Adjustments(shadows = 0.65f),
+            Adjustments(shadows = 1.35f),
+            Adjustments(temperature = 0.7f),
+            Adjustments(hue = 2f),
+            Adjustments(colorTemperature = -1f),
+            Adjustments(tone = 15f),
+            Adjustments(sharpness = 0.8f),
+            Adjustments(clarity = 0.5f),
+            Adjustments(vignette = 0.7f)
+        ).forEach(::assertWithinThreeSteps)
+    }
+
+    @Test
+    fun stackedFiltersAreWithinThreeStepsOfTheShaderPasses() {
+        assertWithinThreeSteps(
+            Adjustments(
+                brightness = 0.05f,
+                contrast = 1.1f,
+                saturation = 1.3f,
+                exposure = 0.2f,
+                highlights = 0.7f,
+                shadows = 1.2f,
+                temperature = 0.3f,
+                hue = 0.4f,
+                sharpness = 0.5f,
+                vignette = 0.6f
+            )
+        )
+    }
+
+    @Test
+    fun defaultAdjustmentsLeaveTheImageUnchanged() {
+        val output = Toolkit.adjustmentChain(
+            input, sizeX, sizeY, Adjustments(), null, AlphaType.UNPREMULTIPLIED
+        )
+        assertArrayEquals(input, output)
+    }
+
+    private fun assertWithinThreeSteps(adjustments: Adjustments) {
+        val output = Toolkit.adjustmentChain(
+            input, sizeX, sizeY, adjustments, null, AlphaType.UNPREMULTIPLIED
+        )
+        val expected = shaderPasses(input.toUnitFloats(), adjustments).toBytes()
+        val difference = maxDifference(expected, output)
+        assertTrue("$adjustments is $difference steps from the shaders", difference <= 3)
+    }
+
+    // The filters in the order of ComposeAdjustImageFilter, skipping those at their default.
+    private fun shaderPasses(source: FloatArray, a: Adjustments): FloatArray {
+        var image = source
+        if (a.brightness != 0f) {
+            image = pointPass(image) { c, i ->
+                for (k in 0..2) c[i + k] = (c[i + k] + a.brightness).coerceIn(0f, 1f)
+            }
+        }
+        if (a.contrast != 1f) {
+            image = pointPass(image) { c, i ->
+                for (k in 0..2) c[i + k] = (c[i + k] - 0.5f) * a.contrast.coerceAtLeast(0f) + 0.5f
+            }
+        }
+        if (a.saturation != 1f) {
+            image = pointPass(image) { c, i ->
+                val l = 0.299f * c[i] + 0.587f * c[i + 1] + 0.114f * c[i + 2]
+                for (k in 0..2) c[i + k] = l * (1f - a.saturation) + c[i + k] * a.saturation
+            }
+        }
+        if (a.exposure != 0f) {
+            image = pointPass(image) { c, i ->
+                for (k in 0..2) c[i + k] *= 2f.pow(a.exposure)
+            }
+        }
+        if (a.highlights != 1f || a.shadows != 1f) {
+            image = pointPass(image) { c, i -> highlightsShadows(c, i, a.highlights, a.shadows) }
+        }
+        if (a.temperature != 0f || a.hue != 0f) {
+            image = pointPass(image) { c, i -> hueWarmth(c, i, a.hue, a.temperature) }
+        }
+        if (a.colorTemperature != 0f) {
+            image = pointPass(image) { c, i ->
+                c[i] = (c[i] - a.colorTemperature * 0.1f).coerceIn(0f, 1f)
+                c[i + 2] = (c[i + 2] + a.colorTemperature * 0.1f).coerceIn(0f, 1f)
+            }
+        }
+        if (a.tone != 0f) {
+            image = pointPass(image) { c, i -> tone(c, i, a.tone) }
+        }
+        if (a.sharpness != 0f) {
+            image = quantize(sharpen(image, sizeX, sizeY, a.sharpness))
+        }
+        if (a.clarity != 0f) {
+            image = quantize(clarity(image, a.clarity))
+        }
+        if (a.vignette != 0f) {
+            image = image.copyOf()
+            for (y in 0 until sizeY) {
+                for (x in 0 until sizeX) {
+                    val factor = vignetteFactor(sizeX, sizeY, x, y, a.vignette)
+                    for (k in 0..2) image[(y * sizeX + x) * 4 + k] *= factor
+                }
+            }
+            image = quantize(image)
+        }
+        return image
+    }
+
+    private inline fun pointPass(image: FloatArray, filter: (FloatArray, Int) -> Unit): FloatArray {
+        val result = image.copyOf()
+        for (i in result.indices step 4) {
+            filter(result, i)
+        }
+        return quantize(result)
+    }
+
+    // What writing to an 8 bit frame buffer does.
+    private fun quantize(image: FloatArray): FloatArray {
+        for (i in image.indices) {
+            image[i] = (image[i].coerceIn(0f, 1f) * 255f).roundToInt() / 255f
+        }
+        return image
+    }
+
+    // The tone shader: a rotation of the hue in the HSV space.
+    private fun tone(c: FloatArray, i: Int, degrees: Float) {
+        val r = c[i]
+        val g = c[i + 1]
+        val b = c[i + 2]
+        val p = if (b <= g) floatArrayOf(g, b, 0f, -1f / 3f) else floatArrayOf(b, g, -1f, 2f / 3f)
+        val q = if (p[0] <= r) {
+            floatArrayOf(r, p[1], p[2], p[0])
+        } else {
+            floatArrayOf(p[0], p[1], p[3], r)
+        }
+        val d = q[0] - min(q[3], q[1])
+        val e = 1e-10f
+        var h = abs(q[2] + (q[3] - q[1]) / (6f * d + e))
+        val s = d / (q[0] + e)
+        val v = q[0]
+        h += degrees / 360f
+        h -= floor(h)
+        val offsets = floatArrayOf(1f, 2f / 3f, 1f / 3f)
+        for (k in 0..2) {
+            val f = h + offsets[k]
+            val channel = abs((f - floor(f)) * 6f - 3f)
+            c[i + k] = v * ((1f - s) + (channel - 1f).coerceIn(0f, 1f) * s)
+        }
+        c[i + 3] = 1f
+    }
+
+    // The clarity shader: a sharpening weakened where the Sobel gradient of red is strong.
+    private fun clarity(image: FloatArray, strength: Float): FloatArray {
+        val gx = floatArrayOf(-1f, 0f, 1f, -2f, 0f, 2f, -1f, 0f, 1f)
+        val gy = floatArrayOf(-1f, -2f, -1f, 0f, 0f, 0f, 1f, 2f, 1f)
+        val result = image.copyOf()
+        for (y in 0 until sizeY) {
+            for (x in 0 until sizeX) {
+                var ex = 0f
+                var ey = 0f
+                var index = 0
+                for (i in -1..1) {
+                    for (j in -1..1) {
+                        val t = image.sample(sizeX, sizeY, x + i, y + j, 0)
+                        ex += t * gx[index]
+                        ey += t * gy[index]
+                        index++
+                    }
+                }
+                val weight = strength * (1f - smoothstep(0.2f, 1f, sqrt(ex * ex + ey * ey)))
+                val o = (y * sizeX + x) * 4
+                for (k in 0..2) {
+                    val neighbors = image.sample(sizeX, sizeY, x - 1, y, k) +
+                            image.sample(sizeX, sizeY, x + 1, y, k) +
+                            image.sample(sizeX, sizeY, x, y - 1, k) +
+                            image.sample(sizeX, sizeY, x, y + 1, k)
+                    result[o + k] = image[o + k] * (1f + 4f * weight) - weight * neighbors
+                }
+                result[o + 3] = 1f
+            }
+        }
+        return result
+    }
+}
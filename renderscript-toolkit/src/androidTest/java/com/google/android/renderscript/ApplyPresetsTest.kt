@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.android.renderscript
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertArrayEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+import java.util.Random
+
+/**
+ * Compares applyPresets with one lut3d call per cube, and with the float math of colorMatrix for
+ * the matrices.
+ */
+@RunWith(AndroidJUnit4::class)
+class ApplyPresetsTest {
+    private val sizeX = 317
+    private val sizeY = 211
+    private val random = Random(1)
+    private val input = ByteArray(sizeX * sizeY * 4).also { random.nextBytes(it) }
+    private val cubes = listOf(17, 33, 64).map { size ->
+        val values = ByteArray(size * size * size * 4).also { random.nextBytes(it) }
+        Rgba3dArray(values, size, size, size)
+    }
+    private val matrix = FloatArray(16) {
+        if (it % 5 == 0) 0.8f else 0.1f + random.nextFloat() / 10
+    }
+    private val addVector = floatArrayOf(0.05f, -0.02f, 0.1f, 0f)
+
+    @Test
+    fun cubesMatchLut3d() {
+        val outputs = Toolkit.applyPresets(
+            input, sizeX, sizeY, cubes.map { ColorPreset(it) }, null, AlphaType.UNPREMULTIPLIED
+        )
+        for (i in cubes.indices) {
+            assertArrayEquals(Toolkit.lut3d(input, sizeX, sizeY, cubes[i]), outputs[i])
+        }
+    }
+
+    @Test
+    fun premultipliedCubesMatchLut3dOfTheUnpremultipliedImage() {
+        val outputs = Toolkit.applyPresets(input, sizeX, sizeY, cubes.map { ColorPreset(it) })
+        val unpremultiplied = Toolkit.unpremultiply(input, sizeX, sizeY)
+        for (i in cubes.indices) {
+            val expected = Toolkit.premultiply(
+                Toolkit.lut3d(unpremultiplied, sizeX, sizeY, cubes[i]), sizeX, sizeY
+            )
+            assertArrayEquals(expected, outputs[i])
+        }
+    }
+
+    @Test
+    fun restrictedCubesMatchLut3d() {
+        val restriction = Range2d(10, 300, 5, 200)
+        val outputs = Toolkit.applyPresets(
+            input, sizeX, sizeY, listOf(ColorPreset(cubes[0])), restriction,
+            AlphaType.UNPREMULTIPLIED
+        )
+        assertArrayEquals(Toolkit.lut3d(input, sizeX, sizeY, cubes[0], restriction), outputs[0])
+    }
+
+    // The native code may fuse the multiply-adds, so the last bit can differ from Kotlin.
+    @Test
+    fun matricesAreWithinOneStepOfTheFloatColorMatrix() {
+        val outputs = Toolkit.applyPresets(
+            input, sizeX, sizeY, listOf(ColorPreset(matrix, addVector)), null,
+            AlphaType.UNPREMULTIPLIED
+        )
+        val expected = ByteArray(input.size)
+        for (i in input.indices step 4) {
+            for (j in 0..3) {
+                var sum = 0f
+                for (k in 0..3) {
+                    sum += input.unsigned(i + k) * matrix[k * 4 + j]
+                }
+                sum += addVector[j] * 255f
+                expected[i + j] = sum.coerceIn(0f, 255f).toInt().toByte()
+            }
+        }
+        val difference = maxDifference(expected, outputs[0])
+        assertTrue("The matrix is $difference steps from colorMatrix", difference <= 1)
+    }
+}
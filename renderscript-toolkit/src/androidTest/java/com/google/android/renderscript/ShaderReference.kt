@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.android.renderscript
+
+import kotlin.math.atan2
+import kotlin.math.cos
+import kotlin.math.pow
+import kotlin.math.sin
+import kotlin.math.sqrt
+
+/* The functions of the OpenGL adjustment shaders, written as literally as possible so the tests
+ * can compare the kernels with them. The images are RGBA float arrays with values from 0 to 1,
+ * and i is the index of the red value of a pixel.
+ */
+
+private val warmFilter = floatArrayOf(0.93f, 0.54f, 0f)
+
+// The RGBtoYIQ and YIQtoRGB mat3 constants. GLSL reads them as columns.
+private val glToYiqColumns = arrayOf(
+    floatArrayOf(0.299f, 0.587f, 0.114f),
+    floatArrayOf(0.596f, -0.274f, -0.322f),
+    floatArrayOf(0.212f, -0.523f, 0.311f)
+)
+private val glToRgbColumns = arrayOf(
+    floatArrayOf(1f, 0.956f, 0.621f),
+    floatArrayOf(1f, -0.272f, -0.647f),
+    floatArrayOf(1f, -1.105f, 1.702f)
+)
+
+internal fun smoothstep(edge0: Float, edge1: Float, x: Float): Float {
+    val t = ((x - edge0) / (edge1 - edge0)).coerceIn(0f, 1f)
+    return t * t * (3f - 2f * t)
+}
+
+/** texture() with clamp to edge: channel k of the pixel (x, y). */
+internal fun FloatArray.sample(sizeX: Int, sizeY: Int, x: Int, y: Int, k: Int) =
+    this[(y.coerceIn(0, sizeY - 1) * sizeX + x.coerceIn(0, sizeX - 1)) * 4 + k]
+
+/** colorHighlightsShadows. */
+internal fun highlightsShadows(c: FloatArray, i: Int, highlights: Float, shadows: Float) {
+    val l = 0.3f * (c[i] + c[i + 1] + c[i + 2])
+    val shadow = (l.pow(1f / shadows) - 0.76f * l.pow(2f / shadows) - l).coerceIn(0f, 1f)
+    val highlight = (1f - ((1f - l).pow(1f / (2f - highlights)) -
+            0.8f * (1f - l).pow(2f / (2f - highlights))) - l).coerceIn(-1f, 0f)
+    val contrasted = (l - 0.5f) * 1.5f + 0.5f
+    val white = contrasted * contrasted * contrasted * (highlights.coerceIn(1f, 2f) - 1f)
+    val inverse = 1f - contrasted
+    val black = inverse * inverse * inverse * (1f - shadows.coerceIn(0f, 1f))
+    for (k in 0..2) {
+        val scaled = if (l > 0f) (l + shadow + highlight) * (c[i + k] / l) else 0f
+        c[i + k] = (scaled * (1f - white) + white) * (1f - black)
+    }
+}
+
+/** colorHueWarmth: the YIQ hue rotation, then the warm overlay. */
+internal fun hueWarmth(c: FloatArray, i: Int, hue: Float, temperature: Float) {
+    val r = c[i]
+    val g = c[i + 1]
+    val b = c[i + 2]
+    val y = 0.299f * r + 0.587f * g + 0.114f * b
+    var iq = 0.595716f * r - 0.274453f * g - 0.321263f * b
+    var q = 0.211456f * r - 0.522591f * g + 0.31135f * b
+    val angle = atan2(q, iq) + hue
+    val chroma = sqrt(iq * iq + q * q)
+    q = chroma * sin(angle)
+    iq = chroma * cos(angle)
+    val rotated = floatArrayOf(
+        y + 0.9563f * iq + 0.6210f * q,
+        y - 0.2721f * iq - 0.6474f * q,
+        y - 1.1070f * iq + 1.7046f * q
+    )
+    val yiq = FloatArray(3)
+    val rgb = FloatArray(3)
+    for (j in 0..2) {
+        for (k in 0..2) {
+            yiq[k] += glToYiqColumns[j][k] * rotated[j]
+        }
+    }
+    for (j in 0..2) {
+        for (k in 0..2) {
+            rgb[k] += glToRgbColumns[j][k] * yiq[j]
+        }
+    }
+    for (k in 0..2) {
+        val w = warmFilter[k]
+        val processed = if (rgb[k] < 0.5f) 2f * rgb[k] * w else 1f - 2f * (1f - rgb[k]) * (1f - w)
+        c[i + k] = rgb[k] * (1f - temperature) + processed * temperature
+    }
+}
+
+/** colorSharpen: the 3x3 sharpening kernel. The alpha is kept. */
+internal fun sharpen(image: FloatArray, sizeX: Int, sizeY: Int, strength: Float): FloatArray {
+    val result = image.copyOf()
+    for (y in 0 until sizeY) {
+        for (x in 0 until sizeX) {
+            for (k in 0..2) {
+                val neighbors = image.sample(sizeX, sizeY, x - 1, y, k) +
+                        image.sample(sizeX, sizeY, x + 1, y, k) +
+                        image.sample(sizeX, sizeY, x, y - 1, k) +
+                        image.sample(sizeX, sizeY, x, y + 1, k)
+                val i = (y * sizeX + x) * 4 + k
+                result[i] = image[i] * (4f * strength + 1f) - strength * neighbors
+            }
+        }
+    }
+    return result
+}
+
+/** colorVignette: what the colors of the pixel (x, y) are multiplied by. */
+internal fun vignetteFactor(sizeX: Int, sizeY: Int, x: Int, y: Int, vignette: Float): Float {
+    val dx = (x + 0.5f) / sizeX - 0.5f
+    val dy = (y + 0.5f) / sizeY - 0.5f
+    return 1f - smoothstep(1f - vignette, 1f, sqrt(dx * dx + dy * dy))
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.android.renderscript
+
+import java.util.Random
+import kotlin.math.abs
+import kotlin.math.max
+import kotlin.math.roundToInt
+
+// Helpers shared by the tests that compare a kernel with a reference computed in Kotlin.
+
+/** An opaque RGBA image: red and green gradients with some noise, and a noisy blue. */
+internal fun opaqueTestImage(sizeX: Int, sizeY: Int, seed: Long = 1): ByteArray {
+    val random = Random(seed)
+    val image = ByteArray(sizeX * sizeY * 4)
+    for (y in 0 until sizeY) {
+        for (x in 0 until sizeX) {
+            val i = (y * sizeX + x) * 4
+            image[i] = ((x * 255 / sizeX + random.nextInt(20)) % 256).toByte()
+            image[i + 1] = ((y * 255 / sizeY + random.nextInt(20)) % 256).toByte()
+            image[i + 2] = random.nextInt(256).toByte()
+            image[i + 3] = 255.toByte()
+        }
+    }
+    return image
+}
+
+/** The unsigned value of the byte at index. */
+internal fun ByteArray.unsigned(index: Int) = this[index].toInt() and 0xff
+
+/** The bytes as floats from 0 to 1. */
+internal fun ByteArray.toUnitFloats() = FloatArray(size) { unsigned(it) / 255f }
+
+/** The floats from 0 to 1 rounded to bytes, as when a shader writes to an 8 bit buffer. */
+internal fun FloatArray.toBytes() =
+    ByteArray(size) { (this[it].coerceIn(0f, 1f) * 255f).roundToInt().toByte() }
+
+/** The largest difference between two buffers of the same size. */
+internal fun maxDifference(a: ByteArray, b: ByteArray): Int {
+    require(a.size == b.size)
+    var result = 0
+    for (i in a.indices) {
+        result = max(result, abs(a.unsigned(i) - b.unsigned(i)))
+    }
+    return result
+}
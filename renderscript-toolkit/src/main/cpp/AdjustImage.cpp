@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Adjustments.h"
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.AdjustImage"
+
+namespace renderscript {
+
+// The range of values a channel can take at some point of the kernel.
+struct Interval {
+    float low;
+    float high;
+};
+
+/**
+ * One step of the adjustments, before compilation.
+ *
+ * A CURVE maps each channel independently. A MATRIX mixes the channels linearly. The
+ * highlights and shadows mix them in a way that's neither, and stay as is.
+ */
+struct AdjustStep {
+    enum class Kind { CURVE, MATRIX, HIGHLIGHTS_SHADOWS };
+    Kind kind;
+    // For CURVE, the function of each channel, given the channel index and the value.
+    std::function<float(int, float)> curve;
+    // For MATRIX, the rows of a 3x3 matrix and the offset added after the multiplication.
+    float matrix[3][3];
+    float offset[3];
+
+    static AdjustStep makeCurve(std::function<float(int, float)> f) {
+        AdjustStep step{Kind::CURVE, std::move(f), {}, {}};
+        return step;
+    }
+    static AdjustStep makeMatrix(const float (&m)[3][3]) {
+        AdjustStep step{Kind::MATRIX, nullptr, {}, {0.f, 0.f, 0.f}};
+        std::copy(&m[0][0], &m[0][0] + 9, &step.matrix[0][0]);
+        return step;
+    }
+};
+
+/**
+ * Evaluates the AdjustImage shader of the OpenGL editor.
+ *
+ * The adjustments are first listed as curves and matrices. Consecutive curves are composed
+ * and consecutive matrices multiplied, so e.g. brightness, contrast, and exposure are one
+ * curve. The curves that come before any mixing of the channels see only the 256 input
+ * values, and become an exact lookup table. The others are tabulated over the range of
+ * values they can receive, and interpolated.
+ *
+ * Each tile is then processed one row at a time, applying the compiled steps in turn to the
+ * whole row while it's in the cache. The vignette, the only spatial term after the
+ * sharpening, is computed per pixel when the row is stored.
+ */
+class AdjustImageTask : public Task {
+    const uchar4* mIn;
+    uchar4* mOut;
+    const Adjustments mAdjustments;
+    const bool mPremultiplied;
+
+    struct CompiledStep {
+        AdjustStep::Kind kind;
+        // For CURVE, kCurveSize + 1 values per channel over [low, low + kCurveSize / scale].
+        std::vector<float> table;
+        float low[3];
+        float scale[3];
+        // For MATRIX, the columns and the offset.
+        float4 columns[3];
+        float4 offset;
+    };
+    // When the kernel starts with a curve and there's no sharpening, that curve as an exact
+    // table of 256 entries per channel, already divided by 255. Otherwise the identity.
+    float mInputTable[3][256];
+    std::vector<CompiledStep> mSteps;
+    // (L + shadow(L) + highlight(L)), tabulated for L from 0 to 1.
+    std::vector<float> mHighlightsShadowsCurve;
+
+    // Per thread: the float row being adjusted, then unpremultiplied input rows.
+    ThreadScratch mScratch;
+
+    void compile();
+    void applyCurve(const CompiledStep& step, float4* row, size_t length) const;
+    void applyMatrix(const CompiledStep& step, float4* row, size_t length) const;
+    void applyHighlightsShadows(float4* row, size_t length) const;
+    // Returns a row of unpremultiplied input pixels, using scratch if needed.
+    const uchar4* inputRow(size_t y, size_t startX, size_t endX, uchar4* scratch) const;
+    // Fills row with the input, sharpened if needed, and mapped through the input table.
+    void loadRow(size_t y, size_t startX, size_t endX, float4* row, uchar4* scratch) const;
+    void storeRow(size_t y, size_t startX, size_t endX, const float4* row) const;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    AdjustImageTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                    const Adjustments& adjustments, RenderScriptToolkit::AlphaType alphaType,
+                    uint32_t threadCount, const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, false, restriction},
+          mIn{reinterpret_cast<const uchar4*>(in)},
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mAdjustments{adjustments},
+          mPremultiplied{alphaType == RenderScriptToolkit::AlphaType::PREMULTIPLIED},
+          mScratch{threadCount} {
+        compile();
+    }
+};
+
+void AdjustImageTask::compile() {
+    const Adjustments& a = mAdjustments;
+    std::vector<AdjustStep> steps;
+
+    // The steps of the shader, in its order. The sharpening comes first, on the input.
+    if (a.brightness != 0.f) {
+        const float b = a.brightness;
+        steps.push_back(AdjustStep::makeCurve(
+                [b](int, float x) { return clamp(x + b, 0.f, 1.f); }));
+    }
+    // The shader applies the contrast twice, the second time with a clamp. The clamp also
+    // bounds the sharpened values when the contrast is 1.
+    const float k = a.contrast;
+    steps.push_back(AdjustStep::makeCurve([k](int, float x) {
+        x = (x - 0.5f) * std::max(k, 0.f) + 0.5f;
+        return clamp((x - 0.5f) * k + 0.5f, 0.f, 1.f);
+    }));
+    if (a.saturation != 1.f) {
+        const float s = a.saturation;
+        const float weights[3] = {0.2126f, 0.7152f, 0.0722f};
+        float m[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                m[i][j] = weights[j] * (1.f - s) + (i == j ? s : 0.f);
+            }
+        }
+        steps.push_back(AdjustStep::makeMatrix(m));
+        steps.push_back(AdjustStep::makeCurve([](int, float x) { return clamp(x, 0.f, 1.f); }));
+    }
+    if (a.exposure != 0.f) {
+        const float magnitude = a.exposure * 1.045f;
+        float power = 1.f + std::fabs(magnitude);
+        if (magnitude < 0.f) {
+            power = 1.f / power;
+        }
+        steps.push_back(AdjustStep::makeCurve([power](int, float x) {
+            return 1.f - std::pow(std::max(1.f - x, 0.f), power);
+        }));
+    }
+    if (a.highlights != 1.f || a.shadows != 1.f) {
+        steps.push_back(AdjustStep{AdjustStep::Kind::HIGHLIGHTS_SHADOWS, nullptr, {}, {}});
+        mHighlightsShadowsCurve = highlightsShadowsTable(a);
+    }
+    // With no hue and no temperature, the YIQ round trips of the shader are within 1e-3 of
+    // the identity, i.e. below the rounding of the output, and are skipped.
+    if (a.hue != 0.f || a.temperature != 0.f) {
+        const float c = std::cos(a.hue);
+        const float s = std::sin(a.hue);
+        const float rotate[3][3] = {{1.f, 0.f, 0.f}, {0.f, c, -s}, {0.f, s, c}};
+        // The shader stores its matrices as columns, hence the transpose.
+        float glToYiq[3][3];
+        float glToRgb[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                glToYiq[i][j] = kGlToYiqColumns[j][i];
+                glToRgb[i][j] = kGlToRgbColumns[j][i];
+            }
+        }
+        // Consecutive matrices are multiplied below.
+        steps.push_back(AdjustStep::makeMatrix(kToYiq));
+        steps.push_back(AdjustStep::makeMatrix(rotate));
+        steps.push_back(AdjustStep::makeMatrix(kToRgb));
+        steps.push_back(AdjustStep::makeMatrix(glToYiq));
+        steps.push_back(AdjustStep::makeMatrix(glToRgb));
+        if (a.temperature != 0.f) {
+            const float t = a.temperature;
+            steps.push_back(AdjustStep::makeCurve([t](int channel, float x) {
+                const float warm[3] = {0.93f, 0.54f, 0.f};
+                const float overlay = x < 0.5f ? 2.f * x * warm[channel]
+                                               : 1.f - 2.f * (1.f - x) * (1.f - warm[channel]);
+                return x + (overlay - x) * t;
+            }));
+        }
+    }
+
+    // Fold the consecutive curves and matrices.
+    std::vector<AdjustStep> folded;
+    for (AdjustStep& step : steps) {
+        if (!folded.empty() && folded.back().kind == step.kind) {
+            AdjustStep& previous = folded.back();
+            if (step.kind == AdjustStep::Kind::CURVE) {
+                auto first = std::move(previous.curve);
+                auto second = std::move(step.curve);
+                previous.curve = [first, second](int c, float x) { return second(c, first(c, x)); };
+                continue;
+            }
+            if (step.kind == AdjustStep::Kind::MATRIX) {
+                float product[3][3];
+                float offset[3];
+                for (int i = 0; i < 3; i++) {
+                    offset[i] = step.offset[i];
+                    for (int j = 0; j < 3; j++) {
+                        product[i][j] = 0.f;
+                        for (int n = 0; n < 3; n++) {
+                            product[i][j] += step.matrix[i][n] * previous.matrix[n][j];
+                        }
+                        offset[i] += step.matrix[i][j] * previous.offset[j];
+                    }
+                }
+                std::copy(&product[0][0], &product[0][0] + 9, &previous.matrix[0][0]);
+                std::copy(offset, offset + 3, previous.offset);
+                continue;
+            }
+        }
+        folded.push_back(std::move(step));
+    }
+
+    // Without sharpening, the first curve sees only the 256 byte values.
+    const bool sharpen = mAdjustments.sharpness != 0.f;
+    size_t first = 0;
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 256; i++) {
+            mInputTable[c][i] = i / 255.f;
+        }
+    }
+    if (!sharpen && !folded.empty() && folded[0].kind == AdjustStep::Kind::CURVE) {
+        for (int c = 0; c < 3; c++) {
+            for (int i = 0; i < 256; i++) {
+                mInputTable[c][i] = folded[0].curve(c, i / 255.f);
+            }
+        }
+        first = 1;
+    }
+
+    // Track the range of each channel, to know over which values to tabulate the curves.
+    Interval range[3];
+    for (int c = 0; c < 3; c++) {
+        if (sharpen) {
+            // The sharpening kernel sums to 1, with negative weights of 4 * sharpness.
+            range[c] = {-4.f * a.sharpness, 1.f + 4.f * a.sharpness};
+        } else {
+            const float* table = mInputTable[c];
+            range[c] = {*std::min_element(table, table + 256),
+                        *std::max_element(table, table + 256)};
+        }
+    }
+
+    for (size_t s = first; s < folded.size(); s++) {
+        const AdjustStep& step = folded[s];
+        CompiledStep compiled;
+        compiled.kind = step.kind;
+        switch (step.kind) {
+            case AdjustStep::Kind::CURVE:
+                compiled.table.resize(3 * (kCurveSize + 1));
+                for (int c = 0; c < 3; c++) {
+                    // Avoid an empty range, e.g. when a channel is constant.
+                    const float low = range[c].low;
+                    const float width = std::max(range[c].high - low, 1e-6f);
+                    compiled.low[c] = low;
+                    compiled.scale[c] = kCurveSize / width;
+                    float* table = compiled.table.data() + c * (kCurveSize + 1);
+                    for (int i = 0; i <= kCurveSize; i++) {
+                        table[i] = step.curve(c, low + width * i / kCurveSize);
+                    }
+                    range[c] = {*std::min_element(table, table + kCurveSize + 1),
+                                *std::max_element(table, table + kCurveSize + 1)};
+                }
+                break;
+            case AdjustStep::Kind::MATRIX: {
+                Interval result[3];
+                for (int i = 0; i < 3; i++) {
+                    result[i] = {step.offset[i], step.offset[i]};
+                    for (int j = 0; j < 3; j++) {
+                        const float m = step.matrix[i][j];
+                        result[i].low += m * (m >= 0.f ? range[j].low : range[j].high);
+                        result[i].high += m * (m >= 0.f ? range[j].high : range[j].low);
+                    }
+                }
+                for (int j = 0; j < 3; j++) {
+                    compiled.columns[j] = float4{step.matrix[0][j], step.matrix[1][j],
+                                                 step.matrix[2][j], 0.f};
+                    range[j] = result[j];
+                }
+                compiled.offset = float4{step.offset[0], step.offset[1], step.offset[2], 0.f};
+                break;
+            }
+            case AdjustStep::Kind::HIGHLIGHTS_SHADOWS: {
+                // The colors are scaled by curve(L) / L, with L at least 0.3 of each channel,
+                // then pulled toward white or black.
+                const float maxCurve = *std::max_element(mHighlightsShadowsCurve.begin(),
+                                                         mHighlightsShadowsCurve.end());
+                for (int c = 0; c < 3; c++) {
+                    range[c] = {-0.1f, std::max(1.f, maxCurve / 0.3f) + 0.1f};
+                }
+                break;
+            }
+        }
+        mSteps.push_back(std::move(compiled));
+    }
+}
+
+void AdjustImageTask::applyCurve(const CompiledStep& step, float4* row, size_t length) const {
+    const float* tables[3] = {step.table.data(), step.table.data() + (kCurveSize + 1),
+                              step.table.data() + 2 * (kCurveSize + 1)};
+    for (size_t i = 0; i < length; i++) {
+        float4 pixel = row[i];
+        for (int c = 0; c < 3; c++) {
+            const float x = clamp((pixel[c] - step.low[c]) * step.scale[c], 0.f,
+                                  static_cast<float>(kCurveSize));
+            const int index = std::min(static_cast<int>(x), kCurveSize - 1);
+            const float* table = tables[c];
+            pixel[c] = table[index] + (table[index + 1] - table[index]) * (x - index);
+        }
+        row[i] = pixel;
+    }
+}
+
+void AdjustImageTask::applyMatrix(const CompiledStep& step, float4* row, size_t length) const {
+    const float4 c0 = step.columns[0];
+    const float4 c1 = step.columns[1];
+    const float4 c2 = step.columns[2];
+    const float4 offset = step.offset;
+    for (size_t i = 0; i < length; i++) {
+        const float4 pixel = row[i];
+        float4 result = c0 * pixel[0] + c1 * pixel[1] + c2 * pixel[2] + offset;
+        result[3] = pixel[3];
+        row[i] = result;
+    }
+}
+
+void AdjustImageTask::applyHighlightsShadows(float4* row, size_t length) const {
+    const float* table = mHighlightsShadowsCurve.data();
+    const float whiteTarget = clamp(mAdjustments.highlights, 1.f, 2.f) - 1.f;
+    const float blackTarget = 1.f - clamp(mAdjustments.shadows, 0.f, 1.f);
+    for (size_t i = 0; i < length; i++) {
+        const float4 pixel = row[i];
+        const float l = 0.3f * (pixel[0] + pixel[1] + pixel[2]);
+        float4 rgb = {0.f, 0.f, 0.f, 0.f};
+        if (l > 0.f) {
+            float curve;
+            const float x = l * kCurveSize;
+            if (l < kCurveDirect) {
+                curve = highlightsShadowsCurve(mAdjustments, l);
+            } else {
+                const int index = std::min(static_cast<int>(x), kCurveSize - 1);
+                curve = table[index] + (table[index + 1] - table[index]) * (x - index);
+            }
+            rgb = pixel * (curve / l);
+        }
+        const float contrasted = (l - 0.5f) * 1.5f + 0.5f;
+        rgb += (1.f - rgb) * (contrasted * contrasted * contrasted * whiteTarget);
+        const float inverse = 1.f - contrasted;
+        rgb -= rgb * (inverse * inverse * inverse * blackTarget);
+        rgb[3] = pixel[3];
+        row[i] = rgb;
+    }
+}
+
+const uchar4* AdjustImageTask::inputRow(size_t y, size_t startX, size_t endX,
+                                        uchar4* scratch) const {
+    const uchar4* in = mIn + y * mSizeX + startX;
+    if (!mPremultiplied) {
+        return in;
+    }
+    unpremultiplyRow(in, scratch, endX - startX);
+    return scratch;
+}
+
+void AdjustImageTask::loadRow(size_t y, size_t startX, size_t endX, float4* row,
+                              uchar4* scratch) const {
+    const size_t length = endX - startX;
+    const float sharpness = mAdjustments.sharpness;
+    if (sharpness == 0.f) {
+        const uchar4* in = inputRow(y, startX, endX, scratch);
+        for (size_t i = 0; i < length; i++) {
+            const uchar4 pixel = in[i];
+            row[i] = float4{mInputTable[0][pixel[0]], mInputTable[1][pixel[1]],
+                            mInputTable[2][pixel[2]], pixel[3] * (1.f / 255.f)};
+        }
+        return;
+    }
+
+    // The 3x3 sharpening of the shader, on the unpremultiplied input. The rows and the columns
+    // past the edges repeat the edge pixels, like the clamped texture.
+    const size_t extendedStartX = startX > 0 ? startX - 1 : 0;
+    const size_t extendedEndX = std::min(endX + 1, mSizeX);
+    const size_t extendedLength = extendedEndX - extendedStartX;
+    const uchar4* above =
+            inputRow(y > 0 ? y - 1 : 0, extendedStartX, extendedEndX, scratch);
+    const uchar4* center = inputRow(y, extendedStartX, extendedEndX, scratch + extendedLength);
+    const uchar4* below = inputRow(std::min(y + 1, mSizeY - 1), extendedStartX, extendedEndX,
+                                   scratch + 2 * extendedLength);
+    for (size_t i = 0; i < length; i++) {
+        const size_t x = startX + i - extendedStartX;
+        const size_t left = x > 0 ? x - 1 : 0;
+        const size_t right = std::min(x + 1, extendedLength - 1);
+        const float4 middle = convert<float4>(center[x]);
+        const float4 cross = convert<float4>(above[x]) + convert<float4>(below[x]) +
+                             convert<float4>(center[left]) + convert<float4>(center[right]);
+        float4 sharpened = (middle * (1.f + 4.f * sharpness) - cross * sharpness) * (1.f / 255.f);
+        sharpened[3] = middle[3] * (1.f / 255.f);
+        row[i] = sharpened;
+    }
+}
+
+void AdjustImageTask::storeRow(size_t y, size_t startX, size_t endX, const float4* row) const {
+    uchar4* out = mOut + y * mSizeX;
+    const float vignette = mAdjustments.vignette;
+    const float edge0 = 1.f - vignette;
+    const float dy = (y + 0.5f) / mSizeY - 0.5f;
+    for (size_t x = startX; x < endX; x++) {
+        float4 c = row[x - startX];
+        float factor = 1.f;
+        if (vignette != 0.f) {
+            // The distance between the texture coordinates of the pixel and the center.
+            const float dx = (x + 0.5f) / mSizeX - 0.5f;
+            factor = 1.f - smoothstep(edge0, 1.f, std::sqrt(dx * dx + dy * dy));
+        }
+        if (mPremultiplied) {
+            factor *= c[3];
+        }
+        const float alpha = c[3];
+        c *= factor;
+        c[3] = alpha;
+        out[x] = convert<uchar4>(clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+    }
+}
+
+void AdjustImageTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                  size_t endY) {
+    const size_t length = endX - startX;
+    // The float row, then three unpremultiplied rows with a column on each side.
+    const size_t needed = length * sizeof(float4) + 3 * (length + 2) * sizeof(uchar4);
+    float4* row = reinterpret_cast<float4*>(mScratch.get(threadIndex, needed));
+    uchar4* scratch = reinterpret_cast<uchar4*>(row + length);
+
+    for (size_t y = startY; y < endY; y++) {
+        loadRow(y, startX, endX, row, scratch);
+        for (const CompiledStep& step : mSteps) {
+            switch (step.kind) {
+                case AdjustStep::Kind::CURVE:
+                    applyCurve(step, row, length);
+                    break;
+                case AdjustStep::Kind::MATRIX:
+                    applyMatrix(step, row, length);
+                    break;
+                case AdjustStep::Kind::HIGHLIGHTS_SHADOWS:
+                    applyHighlightsShadows(row, length);
+                    break;
+            }
+        }
+        storeRow(y, startX, endX, row);
+    }
+}
+
+void RenderScriptToolkit::adjustImage(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                      size_t sizeY, const Adjustments& adjustments,
+                                      AlphaType alphaType, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (adjustments.colorTemperature != 0.f || adjustments.tone != 0.f ||
+        adjustments.clarity != 0.f) {
+        ALOGE("The AdjustImage shader has no color temperature, tone, or clarity. Use "
+              "adjustmentChain.");
+        return;
+    }
+    if (!validAdjustments(LOG_TAG, in, out, adjustments, adjustments.sharpness != 0.f)) {
+        return;
+    }
+#endif
+
+    AdjustImageTask task(in, out, sizeX, sizeY, adjustments, alphaType,
+                         processor->getNumberOfThreads(), restriction);
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Adjustments.h"
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.AdjustmentChain"
+
+namespace renderscript {
+
+static inline float luminance(float4 c) {
+    return 0.299f * c[0] + 0.587f * c[1] + 0.114f * c[2];
+}
+
+// Rounds the colors to 8 bits, like the frame buffers between the shaders of the GL chain.
+// Without it, small differences add up over the filters.
+static inline float4 quantize(float4 c) {
+    const float4 scaled = min(max(c, 0.f), 1.f) * 255.f + 0.5f;
+    return convert<float4>(convert<int4>(scaled)) * (1.f / 255.f);
+}
+
+// Sets the color channels of c to rgb, keeping the alpha of c, and rounds them.
+static inline float4 withColor(float4 c, float4 rgb) {
+    rgb[3] = c[3];
+    return quantize(rgb);
+}
+
+/**
+ * Applies the filters to a rectangle of the image. The filters that work on one pixel at a
+ * time are applied first. When sharpness or clarity is set, their results are kept for three
+ * rows, which the 3x3 neighborhood filter reads.
+ */
+class AdjustmentChainTask : public Task {
+    const uchar4* mIn;
+    uchar4* mOut;
+    const Adjustments mAdjustments;
+    const bool mPremultiplied;
+
+    // Precomputed from the adjustments.
+    bool mHasHighlightsShadows;
+    bool mHasTemperatureHue;
+    bool mHasNeighborhood;
+    float mExposureFactor;
+    // The hue rotation and the YIQ round trip of the temperature shader, as one matrix.
+    float4 mTemperatureHueMatrix[3];
+    // (L + shadow(L) + highlight(L)) of the highlights and shadows shader, L from 0 to 1.
+    std::vector<float> mHighlightsShadowsCurve;
+
+    // The filtered rows around the current one, one area per thread.
+    ThreadScratch mScratch;
+
+    float4 applyHighlightsShadows(float4 c) const;
+    float4 applyTemperatureHue(float4 c) const;
+    float4 applyTone(float4 c) const;
+    // Applies the filters that don't need the neighbors.
+    float4 applyPointFilters(uchar4 pixel) const;
+    // Applies the vignette and stores the result.
+    void store(float4 c, size_t x, size_t y) const;
+    void pointFilterRow(size_t y, size_t startX, size_t endX, float4* out) const;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    AdjustmentChainTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                        const Adjustments& adjustments, RenderScriptToolkit::AlphaType alphaType,
+                        uint32_t threadCount, const Restriction* restriction);
+};
+
+AdjustmentChainTask::AdjustmentChainTask(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                         size_t sizeY, const Adjustments& adjustments,
+                                         RenderScriptToolkit::AlphaType alphaType,
+                                         uint32_t threadCount, const Restriction* restriction)
+    : Task{sizeX, sizeY, 4, false, restriction},
+      mIn{reinterpret_cast<const uchar4*>(in)},
+      mOut{reinterpret_cast<uchar4*>(out)},
+      mAdjustments{adjustments},
+      mPremultiplied{alphaType == RenderScriptToolkit::AlphaType::PREMULTIPLIED},
+      mScratch{threadCount} {
+    const Adjustments& a = mAdjustments;
+    mHasHighlightsShadows = a.highlights != 1.f || a.shadows != 1.f;
+    mHasTemperatureHue = a.temperature != 0.f || a.hue != 0.f;
+    mHasNeighborhood = a.sharpness != 0.f || a.clarity != 0.f;
+    mExposureFactor = std::exp2(a.exposure);
+
+    if (mHasHighlightsShadows) {
+        mHighlightsShadowsCurve = highlightsShadowsTable(a);
+    }
+
+    if (mHasTemperatureHue) {
+        // The shader goes to YIQ, rotates I and Q by the hue, and comes back. It then goes
+        // through a second pair of YIQ matrices that GLSL reads as columns, which is close
+        // to, but not exactly, the identity. All of it is linear, so it's one matrix.
+        const float c = std::cos(a.hue);
+        const float s = std::sin(a.hue);
+        for (int column = 0; column < 3; column++) {
+            float rgb[3] = {0.f, 0.f, 0.f};
+            rgb[column] = 1.f;
+            float yiq[3];
+            for (int i = 0; i < 3; i++) {
+                yiq[i] = kToYiq[i][0] * rgb[0] + kToYiq[i][1] * rgb[1] + kToYiq[i][2] * rgb[2];
+            }
+            const float rotatedI = yiq[1] * c - yiq[2] * s;
+            const float rotatedQ = yiq[1] * s + yiq[2] * c;
+            yiq[1] = rotatedI;
+            yiq[2] = rotatedQ;
+            for (int i = 0; i < 3; i++) {
+                rgb[i] = kToRgb[i][0] * yiq[0] + kToRgb[i][1] * yiq[1] + kToRgb[i][2] * yiq[2];
+            }
+            float glYiq[3] = {0.f, 0.f, 0.f};
+            for (int j = 0; j < 3; j++) {
+                for (int i = 0; i < 3; i++) {
+                    glYiq[i] += kGlToYiqColumns[j][i] * rgb[j];
+                }
+            }
+            float4 result = {0.f, 0.f, 0.f, 0.f};
+            for (int j = 0; j < 3; j++) {
+                for (int i = 0; i < 3; i++) {
+                    result[i] += kGlToRgbColumns[j][i] * glYiq[j];
+                }
+            }
+            mTemperatureHueMatrix[column] = result;
+        }
+    }
+
+    if (mHasNeighborhood) {
+        // The tiles start by filtering the row above and below them. Taller tiles do it less.
+        mMinRowsPerTile = 16;
+    }
+}
+
+float4 AdjustmentChainTask::applyHighlightsShadows(float4 c) const {
+    // The luminance of this shader weighs the three channels by 0.3.
+    const float l = 0.3f * (c[0] + c[1] + c[2]);
+    float4 rgb = {0.f, 0.f, 0.f, 0.f};
+    if (l > 0.f) {
+        float curve;
+        if (l < kCurveDirect) {
+            curve = highlightsShadowsCurve(mAdjustments, l);
+        } else {
+            const float x = l * kCurveSize;
+            const int i = static_cast<int>(x);
+            const float* table = mHighlightsShadowsCurve.data();
+            curve = i >= kCurveSize ? table[kCurveSize]
+                                    : table[i] + (table[i + 1] - table[i]) * (x - i);
+        }
+        rgb = c * (curve / l);
+    }
+    const float contrasted = (l - 0.5f) * 1.5f + 0.5f;
+    const float white = contrasted * contrasted * contrasted *
+                        (clamp(mAdjustments.highlights, 1.f, 2.f) - 1.f);
+    rgb += (1.f - rgb) * white;
+    const float inverse = 1.f - contrasted;
+    const float black = inverse * inverse * inverse * (1.f - clamp(mAdjustments.shadows, 0.f, 1.f));
+    rgb -= rgb * black;
+    return withColor(c, rgb);
+}
+
+float4 AdjustmentChainTask::applyTemperatureHue(float4 c) const {
+    const float4* m = mTemperatureHueMatrix;
+    const float4 rgb = m[0] * c[0] + m[1] * c[1] + m[2] * c[2];
+    // Overlay of a warm color: 0.93, 0.54, 0.
+    const float4 warm = {0.93f, 0.54f, 0.f, 0.f};
+    const float4 overlay =
+            select(rgb < 0.5f, 2.f * rgb * warm, 1.f - 2.f * (1.f - rgb) * (1.f - warm));
+    return withColor(c, rgb + (overlay - rgb) * mAdjustments.temperature);
+}
+
+float4 AdjustmentChainTask::applyTone(float4 c) const {
+    // RGB to HSV and back, as in the tone shader.
+    const float value = std::max(c[0], std::max(c[1], c[2]));
+    const float delta = value - std::min(c[0], std::min(c[1], c[2]));
+    float h = 0.f;
+    if (delta > 0.f) {
+        if (value == c[0]) {
+            h = (c[1] - c[2]) / delta;
+        } else if (value == c[1]) {
+            h = (c[2] - c[0]) / delta + 2.f;
+        } else {
+            h = (c[0] - c[1]) / delta + 4.f;
+        }
+        h /= 6.f;
+    }
+    const float s = value > 0.f ? delta / value : 0.f;
+    h += mAdjustments.tone / 360.f;
+    h -= std::floor(h);
+
+    const float4 f = h + float4{1.f, 2.f / 3.f, 1.f / 3.f, 0.f};
+    // f is positive, so truncating it floors it.
+    const float4 t = (f - convert<float4>(convert<int4>(f))) * 6.f - 3.f;
+    const float4 p = min(max(max(t, -t) - 1.f, 0.f), 1.f);
+    float4 rgb = value * (1.f + (p - 1.f) * s);
+    // The tone shader writes an opaque alpha.
+    rgb[3] = 1.f;
+    return quantize(rgb);
+}
+
+float4 AdjustmentChainTask::applyPointFilters(uchar4 pixel) const {
+    const Adjustments& a = mAdjustments;
+    float4 c = convert<float4>(pixel) * (1.f / 255.f);
+    if (mPremultiplied && c[3] > 0.f) {
+        const float4 rgb = c * (1.f / c[3]);
+        c = withColor(c, rgb);
+    }
+    if (a.brightness != 0.f) {
+        c = withColor(c, c + a.brightness);
+    }
+    if (a.contrast != 1.f) {
+        c = withColor(c, (c - 0.5f) * std::max(a.contrast, 0.f) + 0.5f);
+    }
+    if (a.saturation != 1.f) {
+        const float l = luminance(c);
+        c = withColor(c, l + (c - l) * a.saturation);
+    }
+    if (a.exposure != 0.f) {
+        c = withColor(c, c * mExposureFactor);
+    }
+    if (mHasHighlightsShadows) {
+        c = applyHighlightsShadows(c);
+    }
+    if (mHasTemperatureHue) {
+        c = applyTemperatureHue(c);
+    }
+    if (a.colorTemperature != 0.f) {
+        float4 rgb = c;
+        rgb[0] -= a.colorTemperature * 0.1f;
+        rgb[2] += a.colorTemperature * 0.1f;
+        c = withColor(c, rgb);
+    }
+    if (a.tone != 0.f) {
+        c = applyTone(c);
+    }
+    return c;
+}
+
+void AdjustmentChainTask::store(float4 c, size_t x, size_t y) const {
+    const float vignette = mAdjustments.vignette;
+    if (vignette != 0.f) {
+        // The distance between the texture coordinates of the pixel and the center.
+        const float dx = (x + 0.5f) / mSizeX - 0.5f;
+        const float dy = (y + 0.5f) / mSizeY - 0.5f;
+        const float distance = std::sqrt(dx * dx + dy * dy);
+        const float4 rgb = c * (1.f - smoothstep(1.f - vignette, 1.f, distance));
+        c = withColor(c, rgb);
+    }
+    if (mPremultiplied) {
+        const float4 rgb = c * c[3];
+        c = withColor(c, rgb);
+    }
+    mOut[y * mSizeX + x] = convert<uchar4>(c * 255.f + 0.5f);
+}
+
+void AdjustmentChainTask::pointFilterRow(size_t y, size_t startX, size_t endX,
+                                         float4* out) const {
+    const uchar4* in = mIn + y * mSizeX;
+    for (size_t x = startX; x < endX; x++) {
+        out[x - startX] = applyPointFilters(in[x]);
+    }
+}
+
+void AdjustmentChainTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                      size_t endY) {
+    if (!mHasNeighborhood) {
+        for (size_t y = startY; y < endY; y++) {
+            const uchar4* in = mIn + y * mSizeX;
+            for (size_t x = startX; x < endX; x++) {
+                store(applyPointFilters(in[x]), x, y);
+            }
+        }
+        return;
+    }
+
+    // Three filtered rows, each with one column on both sides. Past the edges of the image,
+    // the edge pixels are repeated, like the clamped texture of the shaders.
+    const size_t width = endX - startX + 2;
+    const size_t needed = 3 * width * sizeof(float4);
+    float4* scratch = reinterpret_cast<float4*>(mScratch.get(threadIndex, needed));
+    float4* rows[3];
+    for (int i = 0; i < 3; i++) {
+        rows[i] = scratch + i * width;
+    }
+    const size_t filterStartX = startX > 0 ? startX - 1 : 0;
+    const size_t filterEndX = std::min(endX + 1, mSizeX);
+    auto filterRow = [&](size_t y, float4* row) {
+        pointFilterRow(y, filterStartX, filterEndX, row + (filterStartX + 1 - startX));
+        if (startX == 0) {
+            row[0] = row[1];
+        }
+        if (endX == mSizeX) {
+            row[width - 1] = row[width - 2];
+        }
+    };
+
+    // rows[0] is above the current row, rows[1] the current row, rows[2] the one below.
+    filterRow(startY > 0 ? startY - 1 : 0, rows[0]);
+    filterRow(startY, rows[1]);
+    const float sharpness = mAdjustments.sharpness;
+    const float clarity = mAdjustments.clarity;
+    for (size_t y = startY; y < endY; y++) {
+        if (y + 1 < mSizeY) {
+            filterRow(y + 1, rows[2]);
+        } else {
+            std::copy(rows[1], rows[1] + width, rows[2]);
+        }
+        for (size_t i = 1; i < width - 1; i++) {
+            const float4 center = rows[1][i];
+            const float4 cross = rows[0][i] + rows[2][i] + rows[1][i - 1] + rows[1][i + 1];
+            float4 c;
+            if (sharpness != 0.f) {
+                c = withColor(center, center * (1.f + 4.f * sharpness) - cross * sharpness);
+            } else {
+                // Sobel on the red channel. Strong edges are sharpened less.
+                auto red = [&](int row, size_t column) { return rows[row][column][0]; };
+                const float gx = red(0, i + 1) + 2.f * red(1, i + 1) + red(2, i + 1) -
+                                 red(0, i - 1) - 2.f * red(1, i - 1) - red(2, i - 1);
+                const float gy = red(2, i - 1) + 2.f * red(2, i) + red(2, i + 1) -
+                                 red(0, i - 1) - 2.f * red(0, i) - red(0, i + 1);
+                const float edge = smoothstep(0.2f, 1.f, std::sqrt(gx * gx + gy * gy));
+                const float k = clarity * (1.f - edge);
+                c = center * (1.f + 4.f * k) - cross * k;
+                // The clarity shader writes an opaque alpha.
+                c[3] = 1.f;
+                c = quantize(c);
+            }
+            store(c, startX + i - 1, y);
+        }
+        std::rotate(rows, rows + 1, rows + 3);
+    }
+}
+
+void RenderScriptToolkit::adjustmentChain(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                          size_t sizeY, const Adjustments& adjustments,
+                                          AlphaType alphaType, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (adjustments.sharpness != 0.f && adjustments.clarity != 0.f) {
+        ALOGE("Sharpness and clarity can't be combined. %f and %f provided.",
+              adjustments.sharpness, adjustments.clarity);
+        return;
+    }
+    if (!validAdjustments(LOG_TAG, in, out, adjustments,
+                          adjustments.sharpness != 0.f || adjustments.clarity != 0.f)) {
+        return;
+    }
+#endif
+
+    AdjustmentChainTask task(in, out, sizeX, sizeY, adjustments, alphaType,
+                             processor->getNumberOfThreads(), restriction);
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_ADJUSTMENTS_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_ADJUSTMENTS_H
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+#include "Utils.h"
+
+/* What adjustImage and adjustmentChain have in common: the constants of the shaders they
+ * evaluate, the highlights and shadows curve, the scratch areas, and the validation.
+ */
+
+namespace renderscript {
+
+using Adjustments = RenderScriptToolkit::Adjustments;
+
+// The number of intervals of the tabulated curves. The tables have one more entry.
+static constexpr int kCurveSize = 4096;
+// Below this value, the highlights and shadows curve is too steep to be interpolated.
+static constexpr float kCurveDirect = 16.f / kCurveSize;
+
+// RGB to YIQ and back, as used for the hue rotation.
+static constexpr float kToYiq[3][3] = {{0.299f, 0.587f, 0.114f},
+                                       {0.595716f, -0.274453f, -0.321263f},
+                                       {0.211456f, -0.522591f, 0.31135f}};
+static constexpr float kToRgb[3][3] = {{1.f, 0.9563f, 0.6210f},
+                                       {1.f, -0.2721f, -0.6474f},
+                                       {1.f, -1.1070f, 1.7046f}};
+// The mat3 constants of the temperature shader. GLSL reads them as columns.
+static constexpr float kGlToYiqColumns[3][3] = {{0.299f, 0.587f, 0.114f},
+                                                {0.596f, -0.274f, -0.322f},
+                                                {0.212f, -0.523f, 0.311f}};
+static constexpr float kGlToRgbColumns[3][3] = {{1.f, 0.956f, 0.621f},
+                                                {1.f, -0.272f, -0.647f},
+                                                {1.f, -1.105f, 1.702f}};
+
+static inline float smoothstep(float edge0, float edge1, float x) {
+    const float t = clamp((x - edge0) / (edge1 - edge0), 0.f, 1.f);
+    return t * t * (3.f - 2.f * t);
+}
+
+/**
+ * The curve of the highlights and shadows shader, (L + shadow(L) + highlight(L)), for a
+ * luminance L from 0 to 1.
+ */
+static inline float highlightsShadowsCurve(const Adjustments& adjustments, float l) {
+    const float shadows = adjustments.shadows;
+    const float highlights = adjustments.highlights;
+    const float shadow =
+            clamp(std::pow(l, 1.f / shadows) - 0.76f * std::pow(l, 2.f / shadows) - l, 0.f, 1.f);
+    const float highlight =
+            clamp(1.f - (std::pow(1.f - l, 1.f / (2.f - highlights)) -
+                         0.8f * std::pow(1.f - l, 2.f / (2.f - highlights))) - l,
+                  -1.f, 0.f);
+    return l + shadow + highlight;
+}
+
+// highlightsShadowsCurve tabulated for kCurveSize + 1 values of L from 0 to 1.
+static inline std::vector<float> highlightsShadowsTable(const Adjustments& adjustments) {
+    std::vector<float> table(kCurveSize + 1);
+    for (int i = 0; i <= kCurveSize; i++) {
+        table[i] = highlightsShadowsCurve(adjustments, static_cast<float>(i) / kCurveSize);
+    }
+    return table;
+}
+
+/**
+ * One scratch area per thread, grown as needed and freed with the task.
+ */
+class ThreadScratch {
+    std::vector<void*> mAreas;
+    std::vector<size_t> mSizes;  // The size in bytes of the areas.
+
+   public:
+    explicit ThreadScratch(uint32_t threadCount) : mAreas(threadCount), mSizes(threadCount) {}
+    ThreadScratch(const ThreadScratch&) = delete;
+    ThreadScratch& operator=(const ThreadScratch&) = delete;
+    ~ThreadScratch() {
+        for (void* area : mAreas) {
+            free(area);
+        }
+    }
+
+    // Returns the area of the thread, with at least size bytes.
+    void* get(int threadIndex, size_t size) {
+        if (size > mSizes[threadIndex] || !mAreas[threadIndex]) {
+            mAreas[threadIndex] = realloc(mAreas[threadIndex], size);
+            mSizes[threadIndex] = size;
+        }
+        return mAreas[threadIndex];
+    }
+};
+
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+/**
+ * The checks both functions share. neighborhood is whether the adjustments read the neighbors
+ * of the pixels, in which case the buffers must differ.
+ */
+static inline bool validAdjustments(const char* tag, const uint8_t* in, const uint8_t* out,
+                                    const Adjustments& adjustments, bool neighborhood) {
+    if (adjustments.highlights >= 2.f || adjustments.shadows <= 0.f) {
+        __android_log_print(ANDROID_LOG_ERROR, tag,
+                            "The highlights should be less than 2 and the shadows more than 0. "
+                            "%f and %f provided.", adjustments.highlights, adjustments.shadows);
+        return false;
+    }
+    if (neighborhood && in == out) {
+        __android_log_print(ANDROID_LOG_ERROR, tag,
+                            "The input and output buffers must differ when sharpening.");
+        return false;
+    }
+    return true;
+}
+#endif
+
+}  // namespace renderscript
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_ADJUSTMENTS_H
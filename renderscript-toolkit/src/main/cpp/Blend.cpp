@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
@@ -35,20 +38,45 @@ class BlendTask : public Task {
     const uchar4* mIn;
     // The destination, used both for input and output.
     uchar4* mOut;
+    // The opacity of the source, from 0 to 255.
+    uint32_t mOpacity;
+    // If not null, one byte per pixel that further scales the opacity of the source.
+    const uchar* mMask;
+    // Whether both buffers have straight alpha, and need to be premultiplied to be blended.
+    bool mUnpremultiplied;
+
+    // When the source needs to be faded or premultiplied, it's stored here before being blended,
+    // followed by the premultiplied destination if needed. There's one area per thread, cached
+    // here to avoid paying the allocation cost per tile.
+    std::vector<uchar4*> mScratch;      // Pointers to the scratch areas, one per thread.
+    std::vector<size_t> mScratchSize;   // The size of the scratch areas in uchar4, one per thread.
 
-    void blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in, uchar4* out,
-               uint32_t length);
     // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
     void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
                      size_t endY) override;
 
    public:
     BlendTask(RenderScriptToolkit::BlendingMode mode, const uint8_t* in, uint8_t* out, size_t sizeX,
-              size_t sizeY, const Restriction* restriction)
+              size_t sizeY, float opacity, const uint8_t* mask,
+              RenderScriptToolkit::AlphaType alphaType, uint32_t threadCount,
+              const Restriction* restriction)
         : Task{sizeX, sizeY, 4, true, restriction},
           mMode{mode},
           mIn{reinterpret_cast<const uchar4*>(in)},
-          mOut{reinterpret_cast<uchar4*>(out)} {}
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mOpacity{static_cast<uint32_t>(clamp(opacity, 0.f, 1.f) * 255.f + 0.5f)},
+          mMask{mask},
+          mUnpremultiplied{alphaType == RenderScriptToolkit::AlphaType::UNPREMULTIPLIED},
+          mScratch{threadCount},
+          mScratchSize(threadCount) {}
+
+    ~BlendTask() {
+        for (size_t i = 0; i < mScratch.size(); i++) {
+            if (mScratch[i]) {
+                free(mScratch[i]);
+            }
+        }
+    }
 };
 
 #if defined(ARCH_ARM_USE_INTRINSICS)
@@ -80,13 +108,105 @@ static inline uchar4 convertClipped(TI amount) {
                     static_cast<uchar>(amount.w > 255 ? 255 : amount.w)};
 }
 
-void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in, uchar4* out,
-                      uint32_t length) {
+/**
+ * Applies one of the separable blend modes, SCREEN to EXCLUSION, to a line of pixels.
+ *
+ * The pixels are converted to premultiplied floats in [0, 1]. The blend function receives the
+ * source and destination and returns the composited, premultiplied result.
+ */
+template <typename BlendFunction>
+static void blendSeparable(const uchar4* in, uchar4* out, uint32_t length, BlendFunction f) {
+    for (uint32_t i = 0; i < length; i++) {
+        const float4 s = convert<float4>(in[i]) * (1.f / 255.f);
+        const float4 d = convert<float4>(out[i]) * (1.f / 255.f);
+        out[i] = convert<uchar4>(clamp(f(s, d) * 255.f + 0.5f, 0.f, 255.f));
+    }
+}
+
+/**
+ * The reciprocals of the alpha values, scaled so that multiplying a premultiplied channel in
+ * [0, 1] by kAlphaReciprocals[alpha] unpremultiplies it. Transparent pixels get 0.
+ */
+static const struct AlphaReciprocals {
+    float values[256];
+    AlphaReciprocals() {
+        values[0] = 0.f;
+        for (int a = 1; a < 256; a++) {
+            values[a] = 255.f / a;
+        }
+    }
+    float operator[](float alpha) const { return values[static_cast<int>(alpha * 255.f + 0.5f)]; }
+} kAlphaReciprocals;
+
+/**
+ * Composites the result of a blend function over the destination, as defined by the W3C
+ * Compositing and Blending spec:
+ *     result.rgb = (1 - d.a) * s.rgb + (1 - s.a) * d.rgb + s.a * d.a * B(Cs, Cd)
+ *     result.a = s.a + d.a - s.a * d.a
+ * where Cs and Cd are the unpremultiplied source and destination colors.
+ *
+ * This is used for the modes that can't be expressed directly on premultiplied values. The blend
+ * function gets the three colors at once, as vectors, and must not branch on them.
+ */
+template <typename ChannelFunction>
+static inline float4 compositeUnpremultiplied(float4 s, float4 d, ChannelFunction b) {
+    const float sa = s.w;
+    const float da = d.w;
+    const float4 one = 1.f;
+    const float4 cs = min(s * kAlphaReciprocals[sa], one);
+    const float4 cd = min(d * kAlphaReciprocals[da], one);
+    float4 r = s * (1.f - da) + d * (1.f - sa) + sa * da * b(cs, cd);
+    r.w = sa + da - sa * da;
+    return r;
+}
+
+static inline float4 hardLight(float4 cs, float4 cd) {
+    return select(cs <= 0.5f, 2.f * cs * cd, cd + (2.f * cs - 1.f) * (1.f - cd));
+}
+
+static inline float4 softLight(float4 cs, float4 cd) {
+    const float4 root = {sqrtf(cd.x), sqrtf(cd.y), sqrtf(cd.z), 0.f};
+    const float4 dd = select(cd <= 0.25f, ((16.f * cd - 12.f) * cd + 4.f) * cd, root);
+    return select(cs <= 0.5f, cd - (1.f - 2.f * cs) * cd * (1.f - cd),
+                  cd + (2.f * cs - 1.f) * (dd - cd));
+}
+
+// Clamping the denominators of dodge and burn to kTiny gives the limits of the divisions, 1 and 0,
+// without a test. It has to be far below the rounding error of an unpremultiplied 1.
+static constexpr float kTiny = 1e-12f;
+
+static inline float4 colorDodge(float4 cs, float4 cd) {
+    const float4 one = 1.f;
+    return select(cd <= 0.f, 0.f, min(cd / max(one - cs, kTiny), one));
+}
+
+static inline float4 colorBurn(float4 cs, float4 cd) {
+    const float4 one = 1.f;
+    return select(cd >= 1.f, one, one - min((one - cd) / max(cs, kTiny), one));
+}
+
+/**
+ * Scales the source by the opacity and by the mask, if present. Both are in [0, 255].
+ */
+static void fadeSource(const uchar4* in, const uchar* mask, uint32_t opacity, uchar4* out,
+                       uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        const uint32_t factor = mask ? (opacity * mask[i] + 127) / 255 : opacity;
+        out[i] = convert<uchar4>((convert<uint4>(in[i]) * factor + 127) / 255);
+    }
+}
+
+/**
+ * Blends a line of length pixels of in into out. Shared by BlendTask and CompositeTask.
+ */
+static void blendLine(RenderScriptToolkit::BlendingMode mode, const uchar4* in, uchar4* out,
+                      uint32_t length, bool usesSimd) {
     uint32_t x1 = 0;
     uint32_t x2 = length;
 
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd) {
+    // The SIMD kernels only cover the RenderScript modes.
+    if (usesSimd && mode <= RenderScriptToolkit::BlendingMode::SUBTRACT) {
         if (rsdIntrinsicBlend_K(out, in, (int) mode, x1, x2) >= 0) {
             return;
         } else {
@@ -110,7 +230,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::SRC_OVER:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendSrcOver_K(out, in, len);
@@ -129,7 +249,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::DST_OVER:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendDstOver_K(out, in, len);
@@ -148,7 +268,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::SRC_IN:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendSrcIn_K(out, in, len);
@@ -166,7 +286,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::DST_IN:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendDstIn_K(out, in, len);
@@ -184,7 +304,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::SRC_OUT:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendSrcOut_K(out, in, len);
@@ -202,7 +322,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::DST_OUT:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendDstOut_K(out, in, len);
@@ -220,7 +340,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::SRC_ATOP:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendSrcAtop_K(out, in, len);
@@ -243,7 +363,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::DST_ATOP:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendDstAtop_K(out, in, len);
@@ -264,7 +384,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::XOR:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendXor_K(out, in, len);
@@ -280,7 +400,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::MULTIPLY:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendMultiply_K(out, in, len);
@@ -297,7 +417,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::ADD:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendAdd_K(out, in, len);
@@ -318,7 +438,7 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         break;
     case RenderScriptToolkit::BlendingMode::SUBTRACT:
     #if defined(ARCH_X86_HAVE_SSSE3)
-        if (mUsesSimd) {
+        if (usesSimd) {
             if((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
                 rsdIntrinsicBlendSub_K(out, in, len);
@@ -338,29 +458,295 @@ void BlendTask::blend(RenderScriptToolkit::BlendingMode mode, const uchar4* in,
         }
         break;
 
+    case RenderScriptToolkit::BlendingMode::SCREEN:
+        blendSeparable(in, out, length, [](float4 s, float4 d) { return s + d - s * d; });
+        break;
+    case RenderScriptToolkit::BlendingMode::OVERLAY:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return compositeUnpremultiplied(s, d,
+                                            [](float4 cs, float4 cd) { return hardLight(cd, cs); });
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::SOFT_LIGHT:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return compositeUnpremultiplied(s, d, softLight);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::HARD_LIGHT:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return compositeUnpremultiplied(s, d, hardLight);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::DARKEN:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return s + d - max(s * d[3], d * s[3]);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::LIGHTEN:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return s + d - min(s * d[3], d * s[3]);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::COLOR_DODGE:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return compositeUnpremultiplied(s, d, colorDodge);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::COLOR_BURN:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            return compositeUnpremultiplied(s, d, colorBurn);
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::DIFFERENCE:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            float4 r = s + d - 2.f * min(s * d[3], d * s[3]);
+            r[3] = s[3] + d[3] - s[3] * d[3];
+            return r;
+        });
+        break;
+    case RenderScriptToolkit::BlendingMode::EXCLUSION:
+        blendSeparable(in, out, length, [](float4 s, float4 d) {
+            float4 r = s + d - 2.f * s * d;
+            r[3] = s[3] + d[3] - s[3] * d[3];
+            return r;
+        });
+        break;
+
     default:
         ALOGE("Called unimplemented value %d", mode);
         assert(false);
     }
 }
 
-void BlendTask::processData(int /* threadIndex */, size_t startX, size_t startY, size_t endX,
+void BlendTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
                             size_t endY) {
+    const bool fade = mOpacity != 255 || mMask != nullptr;
+    const size_t length = endX - startX;
+    const size_t needed = mUnpremultiplied ? 2 * length : length;
+    if ((fade || mUnpremultiplied) &&
+        (needed > mScratchSize[threadIndex] || !mScratch[threadIndex])) {
+        mScratch[threadIndex] =
+                reinterpret_cast<uchar4*>(realloc(mScratch[threadIndex], needed * sizeof(uchar4)));
+        mScratchSize[threadIndex] = needed;
+    }
+    uchar4* source = mScratch[threadIndex];
+    uchar4* dest = source + length;
     for (size_t y = startY; y < endY; y++) {
         size_t offset = y * mSizeX + startX;
-        blend(mMode, mIn + offset, mOut + offset, endX - startX);
+        const uchar4* in = mIn + offset;
+        if (mUnpremultiplied) {
+            premultiplyRow(in, source, length);
+            in = source;
+        }
+        if (fade) {
+            // Fading scales all four channels, so it works on premultiplied values as is.
+            fadeSource(in, mMask ? mMask + offset : nullptr, mOpacity, source, length);
+            in = source;
+        }
+        if (mUnpremultiplied) {
+            premultiplyRow(mOut + offset, dest, length);
+            blendLine(mMode, in, dest, length, mUsesSimd);
+            unpremultiplyRow(dest, mOut + offset, length);
+        } else {
+            blendLine(mMode, in, mOut + offset, length, mUsesSimd);
+        }
     }
 }
 
 void RenderScriptToolkit::blend(BlendingMode mode, const uint8_t* in, uint8_t* out, size_t sizeX,
                                 size_t sizeY, const Restriction* restriction) {
+    blend(mode, in, out, sizeX, sizeY, 1.f, nullptr, AlphaType::PREMULTIPLIED, restriction);
+}
+
+void RenderScriptToolkit::blend(BlendingMode mode, const uint8_t* in, uint8_t* out, size_t sizeX,
+                                size_t sizeY, float opacity, const uint8_t* mask,
+                                AlphaType alphaType, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (mode < BlendingMode::CLEAR || mode > BlendingMode::EXCLUSION) {
+        ALOGE("Unknown blending mode %d.", static_cast<int>(mode));
+        return;
+    }
+#endif
+
+    BlendTask task(mode, in, out, sizeX, sizeY, opacity, mask, alphaType,
+                   processor->getNumberOfThreads(), restriction);
+    processor->doTask(&task);
+}
+
+/**
+ * Whether blending a fully transparent source leaves the destination unchanged. Layers that are
+ * transparent over a whole tile can then be skipped.
+ */
+static bool transparentSourceIsNoOp(RenderScriptToolkit::BlendingMode mode) {
+    switch (mode) {
+        case RenderScriptToolkit::BlendingMode::CLEAR:
+        case RenderScriptToolkit::BlendingMode::SRC:
+        case RenderScriptToolkit::BlendingMode::SRC_IN:
+        case RenderScriptToolkit::BlendingMode::DST_IN:
+        case RenderScriptToolkit::BlendingMode::SRC_OUT:
+        case RenderScriptToolkit::BlendingMode::DST_ATOP:
+        case RenderScriptToolkit::BlendingMode::MULTIPLY:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/**
+ * Composites a stack of layers into a destination, bottom layer first.
+ *
+ * Each tile of the destination goes through all the layers before moving to the next one, so
+ * the destination rows of the tile stay in the cache and are written to memory once. For each
+ * tile, the layers that don't overlap it, or that are fully transparent over it, are skipped.
+ */
+class CompositeTask : public Task {
+    const RenderScriptToolkit::Layer* mLayers;
+    size_t mLayerCount;
+    // The destination, used both for input and output.
+    uchar4* mOut;
+    // The opacity of each layer, from 0 to 255.
+    std::vector<uint32_t> mOpacities;
+
+    // The part of a layer that overlaps the tile being processed, in destination coordinates.
+    struct ActiveLayer {
+        size_t index;
+        size_t startX;
+        size_t startY;
+        size_t endX;
+        size_t endY;
+    };
+    // The layers that affect the tile being processed, one list per thread.
+    std::vector<std::vector<ActiveLayer>> mActiveLayers;
+    // Where faded layer pixels are stored before being blended, one area per thread.
+    std::vector<uchar4*> mScratch;
+    std::vector<size_t> mScratchSize;  // The size of the scratch areas in uchar4, one per thread.
+
+    bool isTransparent(const RenderScriptToolkit::Layer& layer, size_t startX, size_t startY,
+                       size_t endX, size_t endY);
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    CompositeTask(const RenderScriptToolkit::Layer* layers, size_t layerCount, uint8_t* out,
+                  size_t sizeX, size_t sizeY, uint32_t threadCount,
+                  const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, false, restriction},
+          mLayers{layers},
+          mLayerCount{layerCount},
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mOpacities(layerCount),
+          mActiveLayers{threadCount},
+          mScratch{threadCount},
+          mScratchSize(threadCount) {
+        for (size_t i = 0; i < layerCount; i++) {
+            mOpacities[i] =
+                    static_cast<uint32_t>(clamp(layers[i].opacity, 0.f, 1.f) * 255.f + 0.5f);
+        }
+        // Square-ish tiles let us skip the transparent areas of the layers in two dimensions.
+        mMinRowsPerTile = 16;
+    }
+
+    ~CompositeTask() {
+        for (size_t i = 0; i < mScratch.size(); i++) {
+            if (mScratch[i]) {
+                free(mScratch[i]);
+            }
+        }
+    }
+};
+
+// Returns whether all the pixels of the rectangle, in layer coordinates, are transparent.
+bool CompositeTask::isTransparent(const RenderScriptToolkit::Layer& layer, size_t startX,
+                                  size_t startY, size_t endX, size_t endY) {
+    const uchar4* pixels = reinterpret_cast<const uchar4*>(layer.pixels);
+    for (size_t y = startY; y < endY; y++) {
+        const uchar4* row = pixels + y * layer.sizeX;
+        const uchar* maskRow = layer.mask ? layer.mask + y * layer.sizeX : nullptr;
+        for (size_t x = startX; x < endX; x++) {
+            if (row[x][3] != 0 && (maskRow == nullptr || maskRow[x] != 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void CompositeTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                size_t endY) {
+    std::vector<ActiveLayer>& active = mActiveLayers[threadIndex];
+    active.clear();
+    for (size_t i = 0; i < mLayerCount; i++) {
+        const RenderScriptToolkit::Layer& layer = mLayers[i];
+        const long layerStartX = std::max<long>(startX, layer.offsetX);
+        const long layerStartY = std::max<long>(startY, layer.offsetY);
+        const long layerEndX = std::min<long>(endX, layer.offsetX + (long)layer.sizeX);
+        const long layerEndY = std::min<long>(endY, layer.offsetY + (long)layer.sizeY);
+        if (layerStartX >= layerEndX || layerStartY >= layerEndY) {
+            continue;
+        }
+        if (transparentSourceIsNoOp(layer.mode) &&
+            (mOpacities[i] == 0 ||
+             isTransparent(layer, layerStartX - layer.offsetX, layerStartY - layer.offsetY,
+                           layerEndX - layer.offsetX, layerEndY - layer.offsetY))) {
+            continue;
+        }
+        active.push_back({i, (size_t)layerStartX, (size_t)layerStartY, (size_t)layerEndX,
+                          (size_t)layerEndY});
+    }
+    if (active.empty()) {
+        return;
+    }
+
+    const size_t width = endX - startX;
+    if (width > mScratchSize[threadIndex] || !mScratch[threadIndex]) {
+        mScratch[threadIndex] =
+                reinterpret_cast<uchar4*>(realloc(mScratch[threadIndex], width * sizeof(uchar4)));
+        mScratchSize[threadIndex] = width;
+    }
+    uchar4* faded = mScratch[threadIndex];
+
+    // Go row by row through all the layers, so that the destination row stays in the cache.
+    for (size_t y = startY; y < endY; y++) {
+        uchar4* out = mOut + y * mSizeX;
+        for (const ActiveLayer& a : active) {
+            if (y < a.startY || y >= a.endY) {
+                continue;
+            }
+            const RenderScriptToolkit::Layer& layer = mLayers[a.index];
+            const size_t offset = (y - layer.offsetY) * layer.sizeX + (a.startX - layer.offsetX);
+            const size_t length = a.endX - a.startX;
+            const uchar4* in = reinterpret_cast<const uchar4*>(layer.pixels) + offset;
+            if (mOpacities[a.index] != 255 || layer.mask != nullptr) {
+                fadeSource(in, layer.mask ? layer.mask + offset : nullptr, mOpacities[a.index],
+                           faded, length);
+                in = faded;
+            }
+            blendLine(layer.mode, in, out + a.startX, length, mUsesSimd);
+        }
+    }
+}
+
+void RenderScriptToolkit::composite(const Layer* layers, size_t layerCount, uint8_t* out,
+                                    size_t sizeX, size_t sizeY, const Restriction* restriction) {
 #ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
     if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
         return;
     }
+    for (size_t i = 0; i < layerCount; i++) {
+        if (layers[i].mode < BlendingMode::CLEAR || layers[i].mode > BlendingMode::EXCLUSION) {
+            ALOGE("Unknown blending mode %d for layer %zu.", static_cast<int>(layers[i].mode), i);
+            return;
+        }
+    }
 #endif
 
-    BlendTask task(mode, in, out, sizeX, sizeY, restriction);
+    CompositeTask task(layers, layerCount, out, sizeX, sizeY, processor->getNumberOfThreads(),
+                       restriction);
     processor->doTask(&task);
 }
 
@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
@@ -49,6 +51,22 @@ class BlurTask : public Task {
     std::vector<void*> mScratch;       // Pointers to the scratch areas, one per thread.
     std::vector<size_t> mScratchSize;  // The size in bytes of the scratch areas, one per thread.
 
+    // Whether the input has unpremultiplied alpha. If so, each thread premultiplies the rows
+    // the vertical pass reads into a window of 2 * radius + 1 rows, and the output is
+    // unpremultiplied as it's written. Nearby output rows share most of their input rows, so
+    // each row is converted once or twice, instead of into a copy of the whole image. Every row
+    // is stored twice, at slots i and i + window of a ring, so that the window is contiguous
+    // wherever it starts.
+    bool mUnpremultiplied;
+    struct PremultipliedRows {
+        std::vector<uchar4> ring;
+        // The rows [first, end) are in the ring. They may extend past the image, in which case
+        // they hold copies of its first or last row.
+        int first = 0;
+        int end = 0;
+    };
+    std::vector<PremultipliedRows> mPremultipliedRows;  // One per thread.
+
     // The radius of the blur, in floating point and integer format.
     float mRadius;
     int mIradius;
@@ -57,6 +75,9 @@ class BlurTask : public Task {
                   uint32_t threadIndex);
     void kernelU1(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
     void ComputeGaussianWeights();
+    // Returns the premultiplied rows currentY - radius to currentY + radius, with a stride of
+    // mSizeX pixels.
+    const uchar* premultipliedWindow(uint32_t currentY, uint32_t threadIndex);
 
     // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
     void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
@@ -64,12 +85,16 @@ class BlurTask : public Task {
 
    public:
     BlurTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY, size_t vectorSize,
-             uint32_t threadCount, float radius, const Restriction* restriction)
+             uint32_t threadCount, float radius, RenderScriptToolkit::AlphaType alphaType,
+             const Restriction* restriction)
         : Task{sizeX, sizeY, vectorSize, false, restriction},
           mIn{in},
           outArray{out},
           mScratch{threadCount},
-          mScratchSize{threadCount},
+          mScratchSize(threadCount),
+          mUnpremultiplied{alphaType == RenderScriptToolkit::AlphaType::UNPREMULTIPLIED &&
+                           vectorSize == 4},
+          mPremultipliedRows(mUnpremultiplied ? threadCount : 0),
           mRadius{std::min(25.0f, radius)} {
         ComputeGaussianWeights();
     }
@@ -358,6 +383,31 @@ static void OneHU1(uint32_t sizeX, uchar* out, int32_t x, const float* ptrIn, co
     out[0] = (uchar)blurredPixel;
 }
 
+const uchar* BlurTask::premultipliedWindow(uint32_t currentY, uint32_t threadIndex) {
+    PremultipliedRows& rows = mPremultipliedRows[threadIndex];
+    const int window = mIradius * 2 + 1;
+    const int start = (int)currentY - mIradius;
+    if (rows.ring.empty()) {
+        rows.ring.resize((size_t)window * 2 * mSizeX);
+    }
+    // Only convert the rows that aren't already there. Those that are keep their slot, as rows
+    // less than a window apart never share one. Tiles can be visited in any order.
+    const uchar4* in = (const uchar4*)mIn;
+    for (int y = start; y < start + window; y++) {
+        if (y >= rows.first && y < rows.end) {
+            continue;
+        }
+        const int clamped = std::min(std::max(y, 0), (int)mSizeY - 1);
+        uchar4* slot = rows.ring.data() + (size_t)(((y % window) + window) % window) * mSizeX;
+        premultiplyRow(in + (size_t)clamped * mSizeX, slot, mSizeX);
+        memcpy(slot + (size_t)window * mSizeX, slot, mSizeX * sizeof(uchar4));
+    }
+    rows.first = start;
+    rows.end = start + window;
+    return (const uchar*)(rows.ring.data() +
+                          (size_t)(((start % window) + window) % window) * mSizeX);
+}
+
 /**
  * Full blur of a line of RGBA data.
  *
@@ -377,11 +427,22 @@ void BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
     uint32_t x1 = xstart;
     uint32_t x2 = xend;
 
+    // The rows to blur, the index of the current one, and how many there are. For
+    // unpremultiplied input, the window holds the rows needed, already clamped to the image.
+    const uchar *in = mIn;
+    int y = currentY;
+    int sizeY = mSizeY;
+    if (mUnpremultiplied) {
+        in = premultipliedWindow(currentY, threadIndex);
+        y = mIradius;
+        sizeY = mIradius * 2 + 1;
+    }
+
 #if defined(ARCH_ARM_USE_INTRINSICS)
     if (mUsesSimd && mSizeX >= 4) {
-      rsdIntrinsicBlurU4_K(out, (uchar4 const *)(mIn + stride * currentY),
-                 mSizeX, mSizeY,
-                 stride, x1, currentY, x2 - x1, mIradius, mIp + mIradius);
+      rsdIntrinsicBlurU4_K(out, (uchar4 const *)(in + stride * y),
+                 mSizeX, sizeY,
+                 stride, x1, y, x2 - x1, mIradius, mIp + mIradius);
         return;
     }
 #endif
@@ -396,9 +457,8 @@ void BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
         buf = (float4 *) ((((intptr_t)mScratch[threadIndex]) + 15) & ~0xf);
     }
     float4 *fout = (float4 *)buf;
-    int y = currentY;
-    if ((y > mIradius) && (y < ((int)mSizeY - mIradius))) {
-        const uchar *pi = mIn + (y - mIradius) * stride;
+    if (mUnpremultiplied || ((y > mIradius) && (y < (sizeY - mIradius)))) {
+        const uchar *pi = in + (y - mIradius) * stride;
         OneVFU4(fout, pi, stride, mFp, mIradius * 2 + 1, mSizeX, mUsesSimd);
     } else {
         x1 = 0;
@@ -514,6 +574,9 @@ void BlurTask::processData(int threadIndex, size_t startX, size_t startY, size_t
         void* outPtr = outArray + (mSizeX * y + startX) * mVectorSize;
         if (mVectorSize == 4) {
             kernelU4(outPtr, startX, endX, y, threadIndex);
+            if (mUnpremultiplied) {
+                unpremultiplyRow((uchar4*)outPtr, (uchar4*)outPtr, endX - startX);
+            }
         } else {
             kernelU1(outPtr, startX, endX, y);
         }
@@ -535,7 +598,28 @@ void RenderScriptToolkit::blur(const uint8_t* in, uint8_t* out, size_t sizeX, si
 #endif
 
     BlurTask task(in, out, sizeX, sizeY, vectorSize, processor->getNumberOfThreads(), radius,
-                  restriction);
+                  AlphaType::PREMULTIPLIED, restriction);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::blur(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                               size_t vectorSize, int radius, AlphaType alphaType,
+                               const Restriction* restriction) {
+    if (alphaType == AlphaType::PREMULTIPLIED || vectorSize != 4) {
+        blur(in, out, sizeX, sizeY, vectorSize, radius, restriction);
+        return;
+    }
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+#endif
+
+    BlurTask task(in, out, sizeX, sizeY, vectorSize, processor->getNumberOfThreads(), radius,
+                  alphaType, restriction);
     processor->doTask(&task);
 }
 
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.ColorSpace"
+
+namespace renderscript {
+
+using ColorSpace = RenderScriptToolkit::ColorSpace;
+
+// The number of intervals of the interpolated tables. The tables have one more entry.
+static constexpr int kTableSize = 4096;
+
+/**
+ * The transfer functions, tabulated once. The curves are smooth enough that interpolating
+ * between 4097 entries is accurate to about 1e-6, much less than an 8 bit step.
+ */
+struct ColorSpaceTables {
+    // Exact sRGB to linear for 8 bit input.
+    float srgbToLinear8[256];
+    // sRGB to linear, linear to sRGB, and the f(t) of CIE Lab, for values from 0 to 1.
+    float srgbToLinear[kTableSize + 1];
+    float linearToSrgb[kTableSize + 1];
+    float labF[kTableSize + 1];
+
+    ColorSpaceTables() {
+        auto toLinear = [](double c) {
+            return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+        };
+        auto toSrgb = [](double c) {
+            return c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+        };
+        auto f = [](double t) {
+            constexpr double delta = 6.0 / 29.0;
+            return t > delta * delta * delta ? std::cbrt(t)
+                                             : t / (3.0 * delta * delta) + 4.0 / 29.0;
+        };
+        for (int i = 0; i < 256; i++) {
+            srgbToLinear8[i] = static_cast<float>(toLinear(i / 255.0));
+        }
+        for (int i = 0; i <= kTableSize; i++) {
+            const double x = static_cast<double>(i) / kTableSize;
+            srgbToLinear[i] = static_cast<float>(toLinear(x));
+            linearToSrgb[i] = static_cast<float>(toSrgb(x));
+            labF[i] = static_cast<float>(f(x));
+        }
+    }
+};
+
+// Built on first use. The initialization of a local static is thread safe.
+static const ColorSpaceTables& tables() {
+    static const ColorSpaceTables t;
+    return t;
+}
+
+// Looks up each channel of x, clamped to [0, 1], in a table of kTableSize + 1 entries. Only
+// the loads are done lane by lane.
+static inline float4 interpolate(const float* table, float4 x) {
+    x = min(max(x, 0.f), 1.f) * kTableSize;
+    int4 i = convert<int4>(x);
+    // 1 interpolates fully towards the last entry. Comparisons are -1 where true.
+    i += i >= kTableSize;
+    const float4 low = {table[i[0]], table[i[1]], table[i[2]], table[i[3]]};
+    const float4 high = {table[i[0] + 1], table[i[1] + 1], table[i[2] + 1], table[i[3] + 1]};
+    return low + (high - low) * (x - convert<float4>(i));
+}
+
+// Returns the sum of the columns of a 3x3 matrix, each scaled by one channel of v.
+static inline float4 multiply(const float4* columns, float4 v) {
+    return columns[0] * v[0] + columns[1] * v[1] + columns[2] * v[2];
+}
+
+// The D65 white point.
+static constexpr float kWhiteX = 0.95047f;
+static constexpr float kWhiteZ = 1.08883f;
+
+// Linear sRGB to XYZ divided by the white point, and back, as columns.
+static const float4 kLinearToXyz[3] = {
+        {0.4124564f / kWhiteX, 0.2126729f, 0.0193339f / kWhiteZ, 0.f},
+        {0.3575761f / kWhiteX, 0.7151522f, 0.1191920f / kWhiteZ, 0.f},
+        {0.1804375f / kWhiteX, 0.0721750f, 0.9503041f / kWhiteZ, 0.f}};
+static const float4 kXyzToLinear[3] = {
+        {3.2404542f * kWhiteX, -0.9692660f * kWhiteX, 0.0556434f * kWhiteX, 0.f},
+        {-1.5371385f, 1.8760108f, -0.2040259f, 0.f},
+        {-0.4985314f * kWhiteZ, 0.0415560f * kWhiteZ, 1.0572252f * kWhiteZ, 0.f}};
+
+static inline float4 labFInverse(float4 f) {
+    constexpr float delta = 6.f / 29.f;
+    return select(f > delta, f * f * f, 3.f * delta * delta * (f - 4.f / 29.f));
+}
+
+static float4 labFromLinear(float4 linear) {
+    const float4 f = interpolate(tables().labF, multiply(kLinearToXyz, linear));
+    // L = 116 fy - 16, a = 500 (fx - fy), b = 200 (fy - fz).
+    const float4 lab = float4{116.f, 500.f, 200.f, 0.f} * (f.yxyw - float4{0.f, f.y, f.z, 0.f});
+    return lab - float4{16.f, 0.f, 0.f, 0.f};
+}
+
+static float4 linearFromLab(float4 lab) {
+    const float fy = (lab[0] + 16.f) / 116.f;
+    const float4 xyz = labFInverse(fy + lab.yxzw * float4{1.f / 500.f, 0.f, -1.f / 200.f, 0.f});
+    return multiply(kXyzToLinear, xyz);
+}
+
+// Returns the hue in degrees of an sRGB color, given its max, min, and their difference.
+static inline float hueOf(float4 rgb, float max, float delta) {
+    if (delta <= 0.f) {
+        return 0.f;
+    }
+    float h;
+    if (max == rgb[0]) {
+        h = (rgb[1] - rgb[2]) / delta;
+        if (h < 0.f) h += 6.f;
+    } else if (max == rgb[1]) {
+        h = (rgb[2] - rgb[0]) / delta + 2.f;
+    } else {
+        h = (rgb[0] - rgb[1]) / delta + 4.f;
+    }
+    return h * 60.f;
+}
+
+// Returns k mod period for k in [0, 2 * period).
+static inline float4 wrap(float4 k, float period) {
+    return select(k >= period, k - period, k);
+}
+
+/**
+ * Converts an sRGB color, with channels from 0 to 1, to the space. The channels of the result
+ * are in the natural units of the space:
+ *  - LINEAR_SRGB: r, g, b from 0 to 1.
+ *  - HSV and HSL: hue in degrees from 0 to 360, saturation and value or lightness from 0 to 1.
+ *  - LAB: L from 0 to 100, a and b from about -128 to 127.
+ */
+static float4 fromSrgb(ColorSpace space, float4 rgb) {
+    switch (space) {
+        case ColorSpace::SRGB:
+            return rgb;
+        case ColorSpace::LINEAR_SRGB:
+            return interpolate(tables().srgbToLinear, rgb);
+        case ColorSpace::HSV:
+        case ColorSpace::HSL: {
+            const float max = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+            const float min = std::min(rgb[0], std::min(rgb[1], rgb[2]));
+            const float delta = max - min;
+            const float h = hueOf(rgb, max, delta);
+            if (space == ColorSpace::HSV) {
+                return float4{h, max > 0.f ? delta / max : 0.f, max, 0.f};
+            }
+            const float l = (max + min) * 0.5f;
+            const float d = 1.f - std::fabs(2.f * l - 1.f);
+            return float4{h, d > 0.f ? delta / d : 0.f, l, 0.f};
+        }
+        case ColorSpace::LAB:
+            return labFromLinear(fromSrgb(ColorSpace::LINEAR_SRGB, rgb));
+    }
+    return rgb;
+}
+
+/**
+ * The inverse of fromSrgb. The result can be out of [0, 1] for colors outside of the sRGB gamut.
+ */
+static float4 toSrgb(ColorSpace space, float4 c) {
+    switch (space) {
+        case ColorSpace::SRGB:
+            return c;
+        case ColorSpace::LINEAR_SRGB:
+            return interpolate(tables().linearToSrgb, c);
+        case ColorSpace::HSV: {
+            // Each channel is v - v * s * clamp(min(k, 4 - k), 0, 1), k = (n + h / 60) mod 6,
+            // with n = 5, 3, 1 for r, g, and b.
+            const float4 k = wrap(float4{5.f, 3.f, 1.f, 0.f} + c[0] / 60.f, 6.f);
+            const float4 rgb = c[2] - c[2] * c[1] * min(max(min(k, 4.f - k), 0.f), 1.f);
+            return rgb * float4{1.f, 1.f, 1.f, 0.f};
+        }
+        case ColorSpace::HSL: {
+            // Each channel is l - a * clamp(min(k - 3, 9 - k), -1, 1), k = (n + h / 30) mod 12,
+            // with n = 0, 8, 4 for r, g, and b, and a = s * min(l, 1 - l).
+            const float4 k = wrap(float4{0.f, 8.f, 4.f, 0.f} + c[0] / 30.f, 12.f);
+            const float a = c[1] * std::min(c[2], 1.f - c[2]);
+            const float4 rgb = c[2] - a * min(max(min(k - 3.f, 9.f - k), -1.f), 1.f);
+            return rgb * float4{1.f, 1.f, 1.f, 0.f};
+        }
+        case ColorSpace::LAB:
+            return toSrgb(ColorSpace::LINEAR_SRGB, linearFromLab(c));
+    }
+    return c;
+}
+
+// Hue is stored in 8 bits as 256 steps around the circle.
+static constexpr float kHueToByte = 256.f / 360.f;
+
+/**
+ * How the natural units of a space are stored in bytes: byte = unit * scale + offset. The hue
+ * wraps around rather than being clamped.
+ */
+struct ByteEncoding {
+    float4 scale;
+    float4 offset;
+    bool hue;
+
+    explicit ByteEncoding(ColorSpace space)
+        : scale{255.f, 255.f, 255.f, 0.f}, offset{0.f, 0.f, 0.f, 0.f}, hue{false} {
+        if (space == ColorSpace::HSV || space == ColorSpace::HSL) {
+            scale[0] = kHueToByte;
+            hue = true;
+        } else if (space == ColorSpace::LAB) {
+            scale = float4{255.f / 100.f, 1.f, 1.f, 0.f};
+            offset = float4{0.f, 128.f, 128.f, 0.f};
+        }
+    }
+
+    /**
+     * Reads an 8 bit pixel of the space as the natural units returned by fromSrgb.
+     */
+    float4 decode(uchar4 pixel) const {
+        return (convert<float4>(pixel) - offset) / select(scale != 0.f, scale, 1.f);
+    }
+
+    /**
+     * Stores natural units of the space as an 8 bit pixel, keeping the alpha of original.
+     */
+    uchar4 encode(float4 c, uchar alpha) const {
+        const float4 scaled = c * scale + offset + 0.5f;
+        uchar4 out = convert<uchar4>(min(max(scaled, 0.f), 255.f));
+        if (hue) {
+            out[0] = static_cast<uchar>(static_cast<int>(scaled[0]) & 0xff);
+        }
+        out[3] = alpha;
+        return out;
+    }
+};
+
+/**
+ * Like fromSrgb, for an 8 bit sRGB pixel. The linear values come from the exact 8 bit table
+ * rather than from the interpolated one.
+ */
+static float4 fromSrgb8(ColorSpace space, uchar4 pixel) {
+    if (space == ColorSpace::LINEAR_SRGB || space == ColorSpace::LAB) {
+        const float* table = tables().srgbToLinear8;
+        const float4 linear = {table[pixel[0]], table[pixel[1]], table[pixel[2]], 0.f};
+        return space == ColorSpace::LAB ? labFromLinear(linear) : linear;
+    }
+    return fromSrgb(space, convert<float4>(pixel) / 255.f);
+}
+
+/**
+ * Either converts pixels from one color space to another, or converts sRGB pixels to a space,
+ * adjusts them there, and converts them back, without storing the intermediate values.
+ */
+class ColorSpaceTask : public Task {
+    const uchar4* mIn;
+    uchar4* mOut;
+    ColorSpace mFrom;
+    ColorSpace mTo;
+    ByteEncoding mFromBytes;
+    ByteEncoding mToBytes;
+    // When adjusting, each channel c in the working space becomes c * mScale + mOffset.
+    bool mAdjust;
+    float4 mScale;
+    float4 mOffset;
+    // Whether the pixels to adjust are premultiplied, and need to be unpremultiplied first.
+    bool mPremultiplied;
+
+    // Clamps the adjusted channels to the range of the working space. The hue wraps around.
+    float4 adjust(float4 c) const;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    ColorSpaceTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY, ColorSpace from,
+                   ColorSpace to, const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, true, restriction},
+          mIn{reinterpret_cast<const uchar4*>(in)},
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mFrom{from},
+          mTo{to},
+          mFromBytes{from},
+          mToBytes{to},
+          mAdjust{false},
+          mScale{1.f, 1.f, 1.f, 0.f},
+          mOffset{0.f, 0.f, 0.f, 0.f},
+          mPremultiplied{false} {}
+
+    ColorSpaceTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY, ColorSpace space,
+                   const float* scale, const float* offset,
+                   RenderScriptToolkit::AlphaType alphaType, const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, true, restriction},
+          mIn{reinterpret_cast<const uchar4*>(in)},
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mFrom{space},
+          mTo{space},
+          mFromBytes{ColorSpace::SRGB},
+          mToBytes{ColorSpace::SRGB},
+          mAdjust{true},
+          mScale{scale[0], scale[1], scale[2], 0.f},
+          mOffset{offset[0], offset[1], offset[2], 0.f},
+          mPremultiplied{alphaType == RenderScriptToolkit::AlphaType::PREMULTIPLIED} {}
+};
+
+float4 ColorSpaceTask::adjust(float4 c) const {
+    c = c * mScale + mOffset;
+    switch (mTo) {
+        case ColorSpace::HSV:
+        case ColorSpace::HSL:
+            if (c[0] < 0.f || c[0] >= 360.f) {
+                c[0] -= 360.f * std::floor(c[0] / 360.f);
+            }
+            c[1] = clamp(c[1], 0.f, 1.f);
+            c[2] = clamp(c[2], 0.f, 1.f);
+            break;
+        case ColorSpace::LAB:
+            c[0] = clamp(c[0], 0.f, 100.f);
+            break;
+        default:
+            // Out of range values are clamped when converting back.
+            break;
+    }
+    return c;
+}
+
+void ColorSpaceTask::processData(int /* threadIndex */, size_t startX, size_t startY,
+                                 size_t endX, size_t endY) {
+    for (size_t y = startY; y < endY; y++) {
+        const size_t offset = y * mSizeX + startX;
+        const size_t length = endX - startX;
+        const uchar4* in = mIn + offset;
+        uchar4* out = mOut + offset;
+
+        if (!mAdjust) {
+            for (size_t x = 0; x < length; x++) {
+                const uchar4 pixel = in[x];
+                const float4 c =
+                        mFrom == ColorSpace::SRGB
+                                ? fromSrgb8(mTo, pixel)
+                                : fromSrgb(mTo, toSrgb(mFrom, mFromBytes.decode(pixel)));
+                out[x] = mToBytes.encode(c, pixel[3]);
+            }
+            continue;
+        }
+
+        // The color of premultiplied pixels is only meaningful once divided by the alpha.
+        if (mPremultiplied) {
+            unpremultiplyRow(in, out, length);
+            in = out;
+        }
+        for (size_t x = 0; x < length; x++) {
+            const uchar4 pixel = in[x];
+            const float4 c = adjust(fromSrgb8(mTo, pixel));
+            out[x] = mToBytes.encode(toSrgb(mTo, c), pixel[3]);
+        }
+        if (mPremultiplied) {
+            premultiplyRow(out, out, length);
+        }
+    }
+}
+
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+static bool validColorSpace(ColorSpace space) {
+    if (space < ColorSpace::SRGB || space > ColorSpace::LAB) {
+        ALOGE("Unknown color space %d.", static_cast<int>(space));
+        return false;
+    }
+    return true;
+}
+#endif
+
+void RenderScriptToolkit::convertColorSpace(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                            size_t sizeY, ColorSpace from, ColorSpace to,
+                                            const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (!validColorSpace(from) || !validColorSpace(to)) {
+        return;
+    }
+#endif
+
+    ColorSpaceTask task(in, out, sizeX, sizeY, from, to, restriction);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::adjustInColorSpace(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                             size_t sizeY, ColorSpace space, const float* scale,
+                                             const float* offset, AlphaType alphaType,
+                                             const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (!validColorSpace(space)) {
+        return;
+    }
+#endif
+
+    ColorSpaceTask task(in, out, sizeX, sizeY, space, scale, offset, alphaType, restriction);
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+namespace renderscript {
+
+#define LOG_TAG "renderscript.toolkit.Convolve"
+
+/**
+ * Checks whether a kernel is the outer product of a column and a row, i.e. whether it has rank 1.
+ * This is the case of box, Gaussian, Sobel and many sharpening kernels.
+ *
+ * The largest coefficient's column and row are taken as the factors. If the kernel can be
+ * rebuilt from them, they are returned in column and row and true is returned.
+ */
+static bool factorKernel(const float* kernel, int size, std::vector<float>* column,
+                         std::vector<float>* row) {
+    int pivot = 0;
+    for (int i = 1; i < size * size; i++) {
+        if (fabsf(kernel[i]) > fabsf(kernel[pivot])) {
+            pivot = i;
+        }
+    }
+    const float largest = fabsf(kernel[pivot]);
+    if (largest == 0.0f) {
+        return false;
+    }
+
+    const int pivotY = pivot / size;
+    const int pivotX = pivot % size;
+    column->resize(size);
+    row->resize(size);
+    for (int i = 0; i < size; i++) {
+        (*column)[i] = kernel[i * size + pivotX];
+        (*row)[i] = kernel[pivotY * size + i] / kernel[pivot];
+    }
+
+    const float tolerance = largest * 1e-5f;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (fabsf((*column)[y] * (*row)[x] - kernel[y * size + x]) > tolerance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Converts a sum to a pixel. Float sums are rounded, fixed point sums are in 1/256th.
+static inline uchar4 toPixel(float4 sum) {
+    return convert<uchar4>(clamp(sum + 0.5f, 0.f, 255.f));
+}
+static inline uchar2 toPixel(float2 sum) {
+    return convert<uchar2>(clamp(sum + 0.5f, 0.f, 255.f));
+}
+static inline uchar toPixel(float sum) {
+    return convert<uchar>(clamp(sum + 0.5f, 0.f, 255.f));
+}
+static inline uchar4 toPixel(int4 sum) {
+    return convert<uchar4>(clamp((sum + 128) >> 8, 0, 255));
+}
+static inline uchar2 toPixel(int2 sum) {
+    return convert<uchar2>(clamp((sum + 128) >> 8, 0, 255));
+}
+static inline uchar toPixel(int sum) {
+    return convert<uchar>(clamp((sum + 128) >> 8, 0, 255));
+}
+
+/**
+ * Applies a square convolution of any odd size.
+ *
+ * Kernels that have rank 1 are applied as a horizontal pass followed by a vertical pass, i.e.
+ * 2 * size rather than size * size multiplications per cell. The horizontally filtered rows are
+ * kept in a ring of float rows so that each input row is filtered once per tile.
+ *
+ * Other kernels are applied directly. The input rows are widened once into a ring of rows,
+ * padded with the edge values, so the inner loops have no bounds checks and can be vectorized.
+ * The sums are accumulated either in fixed point, with the coefficients quantized to
+ * int16_t * 256 like convolve3x3 and convolve5x5, or in floats for more precision.
+ *
+ * In both cases, the edge values are used for the cells that are off boundary.
+ */
+class ConvolveTask : public Task {
+    const uchar* mIn;
+    uchar* mOut;
+    // The width and height of the kernel, and the number of cells on each side of the center.
+    const int mSize;
+    const int mRadius;
+    const bool mFloatAccumulation;
+    // Whether the kernel is mColumn * mRow. If so, mCoefficients and mIntCoefficients are unused.
+    bool mSeparable;
+    std::vector<float> mColumn;
+    std::vector<float> mRow;
+    std::vector<float> mCoefficients;
+    std::vector<int32_t> mIntCoefficients;
+
+    // Working area for the ring of rows and the sums. There's one area per thread, cached here
+    // to avoid paying the allocation cost per tile.
+    std::vector<void*> mScratch;       // Pointers to the scratch areas, one per thread.
+    std::vector<size_t> mScratchSize;  // The size of the scratch areas in float4, one per thread.
+
+    // Returns a 16 byte aligned scratch area of at least count float4.
+    void* getScratch(int threadIndex, size_t count);
+
+    template <typename PixelType, typename ComputationType>
+    void convolveSeparable(int threadIndex, size_t startX, size_t startY, size_t endX,
+                           size_t endY);
+    template <typename PixelType, typename ComputationType, typename CoefficientType>
+    void convolveDirect(int threadIndex, size_t startX, size_t startY, size_t endX, size_t endY,
+                        const CoefficientType* coefficients);
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    ConvolveTask(const void* in, void* out, size_t vectorSize, size_t sizeX, size_t sizeY,
+                 const float* coefficients, size_t kernelSize, bool floatAccumulation,
+                 uint32_t threadCount, const Restriction* restriction)
+        : Task{sizeX, sizeY, vectorSize, false, restriction},
+          mIn{(const uchar*)in},
+          mOut{(uchar*)out},
+          mSize{(int)kernelSize},
+          mRadius{(int)kernelSize / 2},
+          mFloatAccumulation{floatAccumulation},
+          mScratch{threadCount},
+          mScratchSize(threadCount) {
+        mSeparable = factorKernel(coefficients, mSize, &mColumn, &mRow);
+        if (!mSeparable) {
+            mCoefficients.assign(coefficients, coefficients + mSize * mSize);
+            mIntCoefficients.resize(mSize * mSize);
+            for (int i = 0; i < mSize * mSize; i++) {
+                const float c = coefficients[i] * 256.f;
+                mIntCoefficients[i] = (int16_t)(c >= 0 ? c + 0.5f : c - 0.5f);
+            }
+        }
+        // Each tile starts with an empty ring. Make the tiles tall enough that filling it is a
+        // small part of the work.
+        mMinRowsPerTile = std::max(16, 2 * mSize);
+    }
+
+    ~ConvolveTask() {
+        for (size_t i = 0; i < mScratch.size(); i++) {
+            if (mScratch[i]) {
+                free(mScratch[i]);
+            }
+        }
+    }
+};
+
+void* ConvolveTask::getScratch(int threadIndex, size_t count) {
+    if (count > mScratchSize[threadIndex] || !mScratch[threadIndex]) {
+        mScratch[threadIndex] = realloc(mScratch[threadIndex], count * sizeof(float4) + 15);
+        mScratchSize[threadIndex] = count;
+    }
+    // Make sure the buffer is aligned so that the compiler can use aligned vector accesses.
+    return reinterpret_cast<void*>((((intptr_t)mScratch[threadIndex]) + 15) & ~0xf);
+}
+
+/**
+ * Widens the cells startX - radius to endX + radius of an input row, replacing the cells that
+ * are off boundary by the edge values.
+ */
+template <typename PixelType, typename ComputationType>
+static void loadPaddedRow(const PixelType* in, ComputationType* out, int startX, int endX,
+                          int radius, int sizeX) {
+    for (int x = startX - radius; x < endX + radius; x++) {
+        *out++ = convert<ComputationType>(in[clamp(x, 0, sizeX - 1)]);
+    }
+}
+
+template <typename PixelType, typename ComputationType>
+void ConvolveTask::convolveSeparable(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                     size_t endY) {
+    const PixelType* in = reinterpret_cast<const PixelType*>(mIn);
+    PixelType* out = reinterpret_cast<PixelType*>(mOut);
+    const int lastRow = mSizeY - 1;
+
+    // The scratch area holds a ring of mSize horizontally filtered rows, followed by one padded
+    // input row and one row to accumulate the vertical pass into. Input row r is kept in slot
+    // r % mSize. An output row never needs more than mSize distinct rows, so the rows it uses
+    // are all still in the ring.
+    const size_t width = endX - startX;
+    const size_t paddedWidth = width + 2 * mRadius;
+    ComputationType* ring = reinterpret_cast<ComputationType*>(
+            getScratch(threadIndex, mSize * width + paddedWidth + width));
+    ComputationType* source = ring + mSize * width;
+    ComputationType* sum = source + paddedWidth;
+
+    int nextRow = std::max((int)startY - mRadius, 0);
+    for (size_t y = startY; y < endY; y++) {
+        // Horizontal pass, for the input rows this output row needs that aren't in the ring yet.
+        const int lastNeeded = std::min((int)y + mRadius, lastRow);
+        for (int r = nextRow; r <= lastNeeded; r++) {
+            loadPaddedRow(in + r * mSizeX, source, startX, endX, mRadius, mSizeX);
+            ComputationType* filtered = ring + (r % mSize) * width;
+            for (size_t i = 0; i < width; i++) {
+                filtered[i] = source[i] * mRow[0];
+            }
+            for (int k = 1; k < mSize; k++) {
+                const float c = mRow[k];
+                const ComputationType* s = source + k;
+                for (size_t i = 0; i < width; i++) {
+                    filtered[i] += s[i] * c;
+                }
+            }
+        }
+        nextRow = std::max(nextRow, lastNeeded + 1);
+
+        // Vertical pass.
+        for (int k = 0; k < mSize; k++) {
+            const int r = clamp((int)y + k - mRadius, 0, lastRow);
+            const ComputationType* filtered = ring + (r % mSize) * width;
+            const float c = mColumn[k];
+            if (k == 0) {
+                for (size_t i = 0; i < width; i++) {
+                    sum[i] = filtered[i] * c;
+                }
+            } else {
+                for (size_t i = 0; i < width; i++) {
+                    sum[i] += filtered[i] * c;
+                }
+            }
+        }
+        PixelType* o = out + y * mSizeX + startX;
+        for (size_t i = 0; i < width; i++) {
+            o[i] = toPixel(sum[i]);
+        }
+    }
+}
+
+template <typename PixelType, typename ComputationType, typename CoefficientType>
+void ConvolveTask::convolveDirect(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                  size_t endY, const CoefficientType* coefficients) {
+    const PixelType* in = reinterpret_cast<const PixelType*>(mIn);
+    PixelType* out = reinterpret_cast<PixelType*>(mOut);
+    const int lastRow = mSizeY - 1;
+
+    // The scratch area holds a ring of mSize padded input rows, followed by one row to
+    // accumulate the sums into. See convolveSeparable for how the ring is indexed.
+    const size_t width = endX - startX;
+    const size_t paddedWidth = width + 2 * mRadius;
+    ComputationType* ring = reinterpret_cast<ComputationType*>(
+            getScratch(threadIndex, mSize * paddedWidth + width));
+    ComputationType* sum = ring + mSize * paddedWidth;
+
+    int nextRow = std::max((int)startY - mRadius, 0);
+    for (size_t y = startY; y < endY; y++) {
+        const int lastNeeded = std::min((int)y + mRadius, lastRow);
+        for (int r = nextRow; r <= lastNeeded; r++) {
+            loadPaddedRow(in + r * mSizeX, ring + (r % mSize) * paddedWidth, startX, endX,
+                          mRadius, mSizeX);
+        }
+        nextRow = std::max(nextRow, lastNeeded + 1);
+
+        for (size_t i = 0; i < width; i++) {
+            sum[i] = ComputationType{};
+        }
+        for (int ky = 0; ky < mSize; ky++) {
+            const int r = clamp((int)y + ky - mRadius, 0, lastRow);
+            const ComputationType* row = ring + (r % mSize) * paddedWidth;
+            const CoefficientType* c = coefficients + ky * mSize;
+            for (int kx = 0; kx < mSize; kx++) {
+                // Many large kernels, e.g. disks and diamonds, have a lot of zeros.
+                if (c[kx] == 0) {
+                    continue;
+                }
+                const ComputationType* s = row + kx;
+                for (size_t i = 0; i < width; i++) {
+                    sum[i] += s[i] * c[kx];
+                }
+            }
+        }
+        PixelType* o = out + y * mSizeX + startX;
+        for (size_t i = 0; i < width; i++) {
+            o[i] = toPixel(sum[i]);
+        }
+    }
+}
+
+void ConvolveTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                               size_t endY) {
+    switch (mVectorSize) {
+        case 4:
+        case 3:
+            if (mSeparable) {
+                convolveSeparable<uchar4, float4>(threadIndex, startX, startY, endX, endY);
+            } else if (mFloatAccumulation) {
+                convolveDirect<uchar4, float4>(threadIndex, startX, startY, endX, endY,
+                                               mCoefficients.data());
+            } else {
+                convolveDirect<uchar4, int4>(threadIndex, startX, startY, endX, endY,
+                                             mIntCoefficients.data());
+            }
+            break;
+        case 2:
+            if (mSeparable) {
+                convolveSeparable<uchar2, float2>(threadIndex, startX, startY, endX, endY);
+            } else if (mFloatAccumulation) {
+                convolveDirect<uchar2, float2>(threadIndex, startX, startY, endX, endY,
+                                               mCoefficients.data());
+            } else {
+                convolveDirect<uchar2, int2>(threadIndex, startX, startY, endX, endY,
+                                             mIntCoefficients.data());
+            }
+            break;
+        case 1:
+            if (mSeparable) {
+                convolveSeparable<uchar, float>(threadIndex, startX, startY, endX, endY);
+            } else if (mFloatAccumulation) {
+                convolveDirect<uchar, float>(threadIndex, startX, startY, endX, endY,
+                                             mCoefficients.data());
+            } else {
+                convolveDirect<uchar, int>(threadIndex, startX, startY, endX, endY,
+                                           mIntCoefficients.data());
+            }
+            break;
+        default:
+            ALOGE("Bad vector size %zd", mVectorSize);
+    }
+}
+
+void RenderScriptToolkit::convolve(const void* in, void* out, size_t vectorSize, size_t sizeX,
+                                   size_t sizeY, const float* coefficients, size_t kernelSize,
+                                   bool floatAccumulation, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (vectorSize < 1 || vectorSize > 4) {
+        ALOGE("The vectorSize should be between 1 and 4. %zu provided.", vectorSize);
+        return;
+    }
+    if (kernelSize < 1 || kernelSize > kMaxConvolveSize || kernelSize % 2 == 0) {
+        ALOGE("The kernelSize should be an odd number between 1 and %zu. %zu provided.",
+              kMaxConvolveSize, kernelSize);
+        return;
+    }
+#endif
+
+    ConvolveTask task(in, out, vectorSize, sizeX, sizeY, coefficients, kernelSize,
+                      floatAccumulation, processor->getNumberOfThreads(), restriction);
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
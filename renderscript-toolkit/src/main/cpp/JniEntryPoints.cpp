@@ -17,6 +17,8 @@
 #include <android/bitmap.h>
 #include <cassert>
 #include <jni.h>
+#include <memory>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "Utils.h"
@@ -39,7 +41,12 @@ class ByteArrayGuard {
     jbyte* data;
 
    public:
+    // A null array is accepted, for optional parameters. get() then returns nullptr.
     ByteArrayGuard(JNIEnv* env, jbyteArray array) : env{env}, array{array} {
+        if (array == nullptr) {
+            data = nullptr;
+            return;
+        }
 #ifdef USE_CRITICAL
         data = reinterpret_cast<jbyte*>(env->GetPrimitiveArrayCritical(array, nullptr));
 #else
@@ -47,6 +54,9 @@ class ByteArrayGuard {
 #endif
     }
     ~ByteArrayGuard() {
+        if (array == nullptr) {
+            return;
+        }
 #ifdef USE_CRITICAL
         env->ReleasePrimitiveArrayCritical(array, data, 0);
 #else
@@ -199,49 +209,100 @@ extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_d
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeBlend(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jint jmode, jbyteArray source_array,
-        jbyteArray dest_array, jint size_x, jint size_y, jobject restriction) {
+        jbyteArray dest_array, jint size_x, jint size_y, jfloat opacity, jbyteArray mask_array,
+        jint alpha_type, jobject restriction) {
     auto toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     auto mode = static_cast<RenderScriptToolkit::BlendingMode>(jmode);
     RestrictionParameter restrict {env, restriction};
     ByteArrayGuard source{env, source_array};
     ByteArrayGuard dest{env, dest_array};
+    ByteArrayGuard mask{env, mask_array};
 
-    toolkit->blend(mode, source.get(), dest.get(), size_x, size_y, restrict.get());
+    toolkit->blend(mode, source.get(), dest.get(), size_x, size_y, opacity, mask.get(),
+                   static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeBlendBitmap(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jint jmode, jobject source_bitmap,
-        jobject dest_bitmap, jobject restriction) {
+        jobject dest_bitmap, jfloat opacity, jobject mask_bitmap, jint alpha_type,
+        jobject restriction) {
     auto toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     auto mode = static_cast<RenderScriptToolkit::BlendingMode>(jmode);
+    auto alphaType = static_cast<RenderScriptToolkit::AlphaType>(alpha_type);
     RestrictionParameter restrict {env, restriction};
     BitmapGuard source{env, source_bitmap};
     BitmapGuard dest{env, dest_bitmap};
 
-    toolkit->blend(mode, source.get(), dest.get(), source.width(), source.height(), restrict.get());
+    if (mask_bitmap == nullptr) {
+        toolkit->blend(mode, source.get(), dest.get(), source.width(), source.height(), opacity,
+                       nullptr, alphaType, restrict.get());
+    } else {
+        BitmapGuard mask{env, mask_bitmap};
+        toolkit->blend(mode, source.get(), dest.get(), source.width(), source.height(), opacity,
+                       mask.get(), alphaType, restrict.get());
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeCompositeBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobjectArray layer_bitmaps,
+        jobjectArray mask_bitmaps, jintArray offsets_and_modes, jfloatArray opacities,
+        jobject dest_bitmap, jobject restriction) {
+    auto toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard dest{env, dest_bitmap};
+    IntArrayGuard offsetsAndModes{env, offsets_and_modes};
+    FloatArrayGuard opacity{env, opacities};
+
+    // The guards keep the layer and mask bitmaps locked until the composite is done.
+    const jsize count = env->GetArrayLength(layer_bitmaps);
+    std::vector<std::unique_ptr<BitmapGuard>> guards;
+    std::vector<RenderScriptToolkit::Layer> layers(count);
+    for (jsize i = 0; i < count; i++) {
+        guards.emplace_back(new BitmapGuard{env, env->GetObjectArrayElement(layer_bitmaps, i)});
+        RenderScriptToolkit::Layer& layer = layers[i];
+        layer.pixels = guards.back()->get();
+        layer.sizeX = guards.back()->width();
+        layer.sizeY = guards.back()->height();
+        layer.offsetX = offsetsAndModes.get()[i * 3];
+        layer.offsetY = offsetsAndModes.get()[i * 3 + 1];
+        layer.mode =
+                static_cast<RenderScriptToolkit::BlendingMode>(offsetsAndModes.get()[i * 3 + 2]);
+        layer.opacity = opacity.get()[i];
+        jobject mask = env->GetObjectArrayElement(mask_bitmaps, i);
+        if (mask != nullptr) {
+            guards.emplace_back(new BitmapGuard{env, mask});
+            layer.mask = guards.back()->get();
+        }
+    }
+
+    toolkit->composite(layers.data(), layers.size(), dest.get(), dest.width(), dest.height(),
+                       restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeBlur(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint vectorSize,
-        jint size_x, jint size_y, jint radius, jbyteArray output_array, jobject restriction) {
+        jint size_x, jint size_y, jint radius, jbyteArray output_array, jint alpha_type,
+        jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     ByteArrayGuard input{env, input_array};
     ByteArrayGuard output{env, output_array};
 
-    toolkit->blur(input.get(), output.get(), size_x, size_y, vectorSize, radius, restrict.get());
+    toolkit->blur(input.get(), output.get(), size_x, size_y, vectorSize, radius,
+                  static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeBlurBitmap(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
-        jobject output_bitmap, jint radius, jobject restriction) {
+        jobject output_bitmap, jint radius, jint alpha_type, jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     BitmapGuard input{env, input_bitmap};
     BitmapGuard output{env, output_bitmap};
 
     toolkit->blur(input.get(), output.get(), input.width(), input.height(), input.vectorSize(),
-                  radius, restrict.get());
+                  radius, static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                  restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeColorMatrix(
@@ -273,46 +334,182 @@ extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_n
                          input.width(), input.height(), matrix.get(), add.get(), restrict.get());
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeConvertColorSpace(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
+        jint size_y, jbyteArray output_array, jint from, jint to, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+
+    toolkit->convertColorSpace(input.get(), output.get(), size_x, size_y,
+                               static_cast<RenderScriptToolkit::ColorSpace>(from),
+                               static_cast<RenderScriptToolkit::ColorSpace>(to), restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeAdjustInColorSpace(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
+        jint size_y, jbyteArray output_array, jint space, jfloatArray jscale, jfloatArray joffset,
+        jint alpha_type, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+    FloatArrayGuard scale{env, jscale};
+    FloatArrayGuard offset{env, joffset};
+
+    toolkit->adjustInColorSpace(input.get(), output.get(), size_x, size_y,
+                                static_cast<RenderScriptToolkit::ColorSpace>(space), scale.get(),
+                                offset.get(),
+                                static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                                restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeAdjustInColorSpaceBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jint space, jfloatArray jscale, jfloatArray joffset,
+        jint alpha_type, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+    FloatArrayGuard scale{env, jscale};
+    FloatArrayGuard offset{env, joffset};
+
+    toolkit->adjustInColorSpace(input.get(), output.get(), input.width(), input.height(),
+                                static_cast<RenderScriptToolkit::ColorSpace>(space), scale.get(),
+                                offset.get(),
+                                static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                                restrict.get());
+}
+
+// The adjustments are passed from Kotlin as an array, in the order of the fields of the struct.
+static RenderScriptToolkit::Adjustments adjustmentsOf(const float* values) {
+    RenderScriptToolkit::Adjustments adjustments;
+    adjustments.brightness = values[0];
+    adjustments.contrast = values[1];
+    adjustments.saturation = values[2];
+    adjustments.exposure = values[3];
+    adjustments.highlights = values[4];
+    adjustments.shadows = values[5];
+    adjustments.temperature = values[6];
+    adjustments.hue = values[7];
+    adjustments.colorTemperature = values[8];
+    adjustments.tone = values[9];
+    adjustments.sharpness = values[10];
+    adjustments.clarity = values[11];
+    adjustments.vignette = values[12];
+    return adjustments;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeAdjustmentChain(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
+        jint size_y, jbyteArray output_array, jfloatArray adjustment_values, jint alpha_type,
+        jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+    FloatArrayGuard values{env, adjustment_values};
+
+    toolkit->adjustmentChain(input.get(), output.get(), size_x, size_y, adjustmentsOf(values.get()),
+                             static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                             restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeAdjustmentChainBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jfloatArray adjustment_values, jint alpha_type,
+        jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+    FloatArrayGuard values{env, adjustment_values};
+
+    toolkit->adjustmentChain(input.get(), output.get(), input.width(), input.height(),
+                             adjustmentsOf(values.get()),
+                             static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                             restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeAdjustImage(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
+        jint size_y, jbyteArray output_array, jfloatArray adjustment_values, jint alpha_type,
+        jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+    FloatArrayGuard values{env, adjustment_values};
+
+    toolkit->adjustImage(input.get(), output.get(), size_x, size_y, adjustmentsOf(values.get()),
+                         static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeAdjustImageBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jfloatArray adjustment_values, jint alpha_type,
+        jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+    FloatArrayGuard values{env, adjustment_values};
+
+    toolkit->adjustImage(input.get(), output.get(), input.width(), input.height(),
+                         adjustmentsOf(values.get()),
+                         static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeConvolve(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint vectorSize,
         jint size_x, jint size_y, jbyteArray output_array, jfloatArray coefficients,
-        jobject restriction) {
+        jint kernel_size, jboolean float_accumulation, jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     ByteArrayGuard input{env, input_array};
     ByteArrayGuard output{env, output_array};
     FloatArrayGuard coeffs{env, coefficients};
 
-    switch (env->GetArrayLength(coefficients)) {
-        case 9:
-            toolkit->convolve3x3(input.get(), output.get(), vectorSize, size_x, size_y,
-                                 coeffs.get(), restrict.get());
-            break;
-        case 25:
-            toolkit->convolve5x5(input.get(), output.get(), vectorSize, size_x, size_y,
-                                 coeffs.get(), restrict.get());
-            break;
+    if (kernel_size == 3 && !float_accumulation) {
+        toolkit->convolve3x3(input.get(), output.get(), vectorSize, size_x, size_y, coeffs.get(),
+                             restrict.get());
+    } else if (kernel_size == 5 && !float_accumulation) {
+        toolkit->convolve5x5(input.get(), output.get(), vectorSize, size_x, size_y, coeffs.get(),
+                             restrict.get());
+    } else {
+        toolkit->convolve(input.get(), output.get(), vectorSize, size_x, size_y, coeffs.get(),
+                          kernel_size, float_accumulation, restrict.get());
     }
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeConvolveBitmap(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
-        jobject output_bitmap, jfloatArray coefficients, jobject restriction) {
+        jobject output_bitmap, jfloatArray coefficients, jint kernel_size,
+        jboolean float_accumulation, jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     BitmapGuard input{env, input_bitmap};
     BitmapGuard output{env, output_bitmap};
     FloatArrayGuard coeffs{env, coefficients};
 
-    switch (env->GetArrayLength(coefficients)) {
-        case 9:
-            toolkit->convolve3x3(input.get(), output.get(), input.vectorSize(), input.width(),
-                                 input.height(), coeffs.get(), restrict.get());
-            break;
-        case 25:
-            toolkit->convolve5x5(input.get(), output.get(), input.vectorSize(), input.width(),
-                                 input.height(), coeffs.get(), restrict.get());
-            break;
+    if (kernel_size == 3 && !float_accumulation) {
+        toolkit->convolve3x3(input.get(), output.get(), input.vectorSize(), input.width(),
+                             input.height(), coeffs.get(), restrict.get());
+    } else if (kernel_size == 5 && !float_accumulation) {
+        toolkit->convolve5x5(input.get(), output.get(), input.vectorSize(), input.width(),
+                             input.height(), coeffs.get(), restrict.get());
+    } else {
+        toolkit->convolve(input.get(), output.get(), input.vectorSize(), input.width(),
+                          input.height(), coeffs.get(), kernel_size, float_accumulation,
+                          restrict.get());
     }
 }
 
@@ -432,49 +629,302 @@ extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_n
                    cubeSizeY, cubeSizeZ, restrict.get());
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeLut3dFromTiles(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
+        jbyteArray cube_values, jint size_x, jint size_y, jfloat intensity) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard cube{env, cube_values};
+
+    toolkit->lut3dFromTiles(input.get(), cube.get(), size_x, size_y, intensity);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeLut3dFromTilesBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jbyteArray cube_values, jfloat intensity) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    ByteArrayGuard cube{env, cube_values};
+
+    toolkit->lut3dFromTiles(input.get(), cube.get(), input.width(), input.height(), intensity);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeLut3dFromCurveMap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray map_array,
+        jbyteArray cube_values, jint size_x, jint size_y, jint cube_size, jfloat intensity) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    ByteArrayGuard map{env, map_array};
+    ByteArrayGuard cube{env, cube_values};
+
+    toolkit->lut3dFromCurveMap(map.get(), cube.get(), size_x, size_y, cube_size, intensity);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeLut3dFromCurveMapBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject map_bitmap,
+        jbyteArray cube_values, jint cube_size, jfloat intensity) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    BitmapGuard map{env, map_bitmap};
+    ByteArrayGuard cube{env, cube_values};
+
+    toolkit->lut3dFromCurveMap(map.get(), cube.get(), map.width(), map.height(), cube_size,
+                               intensity);
+}
+
+/**
+ * Fills the presets of applyPresets from the arrays given by Kotlin, one cube (or null), three
+ * cube sizes, and 20 floats of matrix and add vector per preset. The guards keep the cubes
+ * locked until the presets are applied.
+ */
+static std::vector<RenderScriptToolkit::Preset> presetsOf(
+        JNIEnv* env, jobjectArray cube_arrays, const int* cubeSizes, const float* matrices,
+        std::vector<std::unique_ptr<ByteArrayGuard>>* guards) {
+    const jsize count = env->GetArrayLength(cube_arrays);
+    std::vector<RenderScriptToolkit::Preset> presets(count);
+    for (jsize i = 0; i < count; i++) {
+        RenderScriptToolkit::Preset& preset = presets[i];
+        auto cube = static_cast<jbyteArray>(env->GetObjectArrayElement(cube_arrays, i));
+        if (cube != nullptr) {
+            guards->emplace_back(new ByteArrayGuard{env, cube});
+            preset.cube = guards->back()->get();
+            preset.cubeSizeX = cubeSizes[i * 3];
+            preset.cubeSizeY = cubeSizes[i * 3 + 1];
+            preset.cubeSizeZ = cubeSizes[i * 3 + 2];
+        } else {
+            preset.matrix = matrices + i * 20;
+            preset.addVector = matrices + i * 20 + 16;
+        }
+    }
+    return presets;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeApplyPresets(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
+        jint size_y, jobjectArray cube_arrays, jintArray cube_sizes, jfloatArray matrices,
+        jobjectArray output_arrays, jint alpha_type, jobject restriction) {
+    auto toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    IntArrayGuard sizes{env, cube_sizes};
+    FloatArrayGuard matrixValues{env, matrices};
+
+    std::vector<std::unique_ptr<ByteArrayGuard>> guards;
+    std::vector<RenderScriptToolkit::Preset> presets =
+            presetsOf(env, cube_arrays, sizes.get(), matrixValues.get(), &guards);
+    for (size_t i = 0; i < presets.size(); i++) {
+        auto output = static_cast<jbyteArray>(env->GetObjectArrayElement(output_arrays, i));
+        guards.emplace_back(new ByteArrayGuard{env, output});
+        presets[i].out = guards.back()->get();
+    }
+
+    toolkit->applyPresets(input.get(), size_x, size_y, presets.data(), presets.size(),
+                          static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                          restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeApplyPresetsBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobjectArray cube_arrays, jintArray cube_sizes, jfloatArray matrices,
+        jobjectArray output_bitmaps, jint alpha_type, jobject restriction) {
+    auto toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard input{env, input_bitmap};
+    IntArrayGuard sizes{env, cube_sizes};
+    FloatArrayGuard matrixValues{env, matrices};
+
+    std::vector<std::unique_ptr<ByteArrayGuard>> guards;
+    std::vector<RenderScriptToolkit::Preset> presets =
+            presetsOf(env, cube_arrays, sizes.get(), matrixValues.get(), &guards);
+    std::vector<std::unique_ptr<BitmapGuard>> outputs;
+    for (size_t i = 0; i < presets.size(); i++) {
+        outputs.emplace_back(new BitmapGuard{env, env->GetObjectArrayElement(output_bitmaps, i)});
+        presets[i].out = outputs.back()->get();
+    }
+
+    toolkit->applyPresets(input.get(), input.width(), input.height(), presets.data(),
+                          presets.size(), static_cast<RenderScriptToolkit::AlphaType>(alpha_type),
+                          restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativePremultiply(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
+        jbyteArray output_array, jint size_x, jint size_y, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+
+    toolkit->premultiply(input.get(), output.get(), size_x, size_y, restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeUnpremultiply(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
+        jbyteArray output_array, jint size_x, jint size_y, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+
+    toolkit->unpremultiply(input.get(), output.get(), size_x, size_y, restrict.get());
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeResize(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
         jint vector_size, jint input_size_x, jint input_size_y, jbyteArray output_array,
-        jint output_size_x, jint output_size_y, jobject restriction) {
+        jint output_size_x, jint output_size_y, jint filter, jint alpha_type,
+        jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     ByteArrayGuard input{env, input_array};
     ByteArrayGuard output{env, output_array};
 
     toolkit->resize(input.get(), output.get(), input_size_x, input_size_y, vector_size,
-                    output_size_x, output_size_y, restrict.get());
+                    output_size_x, output_size_y,
+                    static_cast<RenderScriptToolkit::ResizeFilter>(filter),
+                    static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeResizeBitmap(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
-        jobject output_bitmap, jobject restriction) {
+        jobject output_bitmap, jint filter, jint alpha_type, jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
     RestrictionParameter restrict {env, restriction};
     BitmapGuard input{env, input_bitmap};
     BitmapGuard output{env, output_bitmap};
 
     toolkit->resize(input.get(), output.get(), input.width(), input.height(), input.vectorSize(),
-                    output.width(), output.height(), restrict.get());
+                    output.width(), output.height(),
+                    static_cast<RenderScriptToolkit::ResizeFilter>(filter),
+                    static_cast<RenderScriptToolkit::AlphaType>(alpha_type), restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeYuvToRgb(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
-        jbyteArray output_array, jint size_x, jint size_y, jint format) {
+        jbyteArray output_array, jint size_x, jint size_y, jint format, jint matrix, jint range,
+        jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
     ByteArrayGuard input{env, input_array};
     ByteArrayGuard output{env, output_array};
 
     toolkit->yuvToRgb(input.get(), output.get(), size_x, size_y,
-                      static_cast<RenderScriptToolkit::YuvFormat>(format));
+                      static_cast<RenderScriptToolkit::YuvFormat>(format),
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range), restrict.get());
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeYuvToRgbBitmap(
         JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint size_x,
-        jint size_y, jobject output_bitmap, jint format) {
+        jint size_y, jobject output_bitmap, jint format, jint matrix, jint range,
+        jobject restriction) {
     RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
     BitmapGuard output{env, output_bitmap};
     ByteArrayGuard input{env, input_array};
 
     toolkit->yuvToRgb(input.get(), output.get(), size_x, size_y,
-                      static_cast<RenderScriptToolkit::YuvFormat>(format));
+                      static_cast<RenderScriptToolkit::YuvFormat>(format),
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range), restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeRgbToYuv(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
+        jbyteArray output_array, jint size_x, jint size_y, jint format, jint matrix, jint range) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    ByteArrayGuard input{env, input_array};
+    ByteArrayGuard output{env, output_array};
+
+    toolkit->rgbToYuv(input.get(), output.get(), size_x, size_y,
+                      static_cast<RenderScriptToolkit::YuvFormat>(format),
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeRgbToYuvBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jbyteArray output_array, jint format, jint matrix, jint range) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    ByteArrayGuard output{env, output_array};
+
+    toolkit->rgbToYuv(input.get(), output.get(), input.width(), input.height(),
+                      static_cast<RenderScriptToolkit::YuvFormat>(format),
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_google_android_renderscript_Toolkit_nativeRgbToYuvPlanes(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap, jobject y_buffer,
+        jobject u_buffer, jobject v_buffer, jint row_stride_y, jint row_stride_uv,
+        jint pixel_stride_uv, jint matrix, jint range) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+
+    RenderScriptToolkit::YuvOutputPlanes planes{
+            static_cast<uint8_t*>(env->GetDirectBufferAddress(y_buffer)),
+            static_cast<uint8_t*>(env->GetDirectBufferAddress(u_buffer)),
+            static_cast<uint8_t*>(env->GetDirectBufferAddress(v_buffer)),
+            static_cast<size_t>(row_stride_y),
+            static_cast<size_t>(row_stride_uv),
+            static_cast<size_t>(pixel_stride_uv)};
+    toolkit->rgbToYuv(input.get(), planes, input.width(), input.height(),
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeYuvPlanesToRgbBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject y_buffer, jobject u_buffer,
+        jobject v_buffer, jint size_x, jint size_y, jint row_stride_y, jint row_stride_uv,
+        jint pixel_stride_y, jint pixel_stride_uv, jint bits_per_sample, jint matrix, jint range,
+        jobject output_bitmap, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard output{env, output_bitmap};
+
+    // The planes are direct buffers, e.g. those of an android.media.Image, so they are read in
+    // place rather than copied.
+    RenderScriptToolkit::YuvPlanes planes{
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(y_buffer)),
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(u_buffer)),
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(v_buffer)),
+            static_cast<size_t>(row_stride_y),
+            static_cast<size_t>(row_stride_uv),
+            static_cast<size_t>(pixel_stride_y),
+            static_cast<size_t>(pixel_stride_uv),
+            static_cast<size_t>(bits_per_sample)};
+    toolkit->yuvToRgb(planes, output.get(), size_x, size_y,
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range), restrict.get());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_renderscript_Toolkit_nativeYuvPlanesToRgbTransformedBitmap(
+        JNIEnv* env, jobject /*thiz*/, jlong native_handle, jobject y_buffer, jobject u_buffer,
+        jobject v_buffer, jint size_x, jint size_y, jint row_stride_y, jint row_stride_uv,
+        jint pixel_stride_y, jint pixel_stride_uv, jint bits_per_sample, jint rotation_degrees,
+        jboolean mirror, jint matrix, jint range, jobject output_bitmap, jobject restriction) {
+    RenderScriptToolkit* toolkit = reinterpret_cast<RenderScriptToolkit*>(native_handle);
+    RestrictionParameter restrict {env, restriction};
+    BitmapGuard output{env, output_bitmap};
+
+    RenderScriptToolkit::YuvPlanes planes{
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(y_buffer)),
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(u_buffer)),
+            static_cast<const uint8_t*>(env->GetDirectBufferAddress(v_buffer)),
+            static_cast<size_t>(row_stride_y),
+            static_cast<size_t>(row_stride_uv),
+            static_cast<size_t>(pixel_stride_y),
+            static_cast<size_t>(pixel_stride_uv),
+            static_cast<size_t>(bits_per_sample)};
+    toolkit->yuvToRgb(planes, size_x, size_y, output.get(), output.width(), output.height(),
+                      static_cast<RenderScriptToolkit::Rotation>(rotation_degrees), mirror,
+                      static_cast<RenderScriptToolkit::YuvMatrix>(matrix),
+                      static_cast<RenderScriptToolkit::YuvRange>(range), restrict.get());
 }
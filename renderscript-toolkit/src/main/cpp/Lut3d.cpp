@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
@@ -32,20 +34,13 @@ class Lut3dTask : public Task {
     const uchar4* mIn;
     // Where we'll store the transformed result.
     uchar4* mOut;
-    // The size of each of the three cube dimensions. We don't make use of the last value.
-    int4 mCubeDimension;
+    // The size of each of the three cube dimensions.
+    int mCubeSizeX;
+    int mCubeSizeY;
+    int mCubeSizeZ;
     // The translation cube, in row major format.
     const uchar* mCubeTable;
 
-    /**
-     * Converts a subset of a line of the 2D buffer.
-     *
-     * @param in The start of the data to transform.
-     * @param out Where to store the result.
-     * @param length The number of 4-byte vectors to transform.
-     */
-    void kernel(const uchar4* in, uchar4* out, uint32_t length);
-
     // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
     void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
                      size_t endY) override;
@@ -57,30 +52,33 @@ class Lut3dTask : public Task {
         : Task{sizeX, sizeY, 4, true, restriction},
           mIn{reinterpret_cast<const uchar4*>(input)},
           mOut{reinterpret_cast<uchar4*>(output)},
-          mCubeDimension{cubeSizeX, cubeSizeY, cubeSizeZ, 0},
+          mCubeSizeX{cubeSizeX},
+          mCubeSizeY{cubeSizeY},
+          mCubeSizeZ{cubeSizeZ},
           mCubeTable{cube} {}
 };
 
 extern "C" void rsdIntrinsic3DLUT_K(void* dst, void const* in, size_t count, void const* lut,
                                     int32_t pitchy, int32_t pitchz, int dimx, int dimy, int dimz);
 
-void Lut3dTask::kernel(const uchar4* in, uchar4* out, uint32_t length) {
+void lut3dRow(const uchar4* in, uchar4* out, size_t length, const uint8_t* cube,
+              int cubeSizeX, int cubeSizeY, int cubeSizeZ, bool usesSimd) {
     uint32_t x1 = 0;
     uint32_t x2 = length;
 
-    const uchar* bp = mCubeTable;
+    const uchar* bp = cube;
 
-    int4 dims = mCubeDimension - 1;
+    // The size of each of the three cube dimensions. We don't make use of the last value.
+    const int4 cubeDimension{cubeSizeX, cubeSizeY, cubeSizeZ, 0};
+    int4 dims = cubeDimension - 1;
 
     const float4 m = (float4)(1.f / 255.f) * convert<float4>(dims);
     const int4 coordMul = convert<int4>(m * (float4)0x8000);
-    const size_t stride_y = mCubeDimension.x * 4;
-    const size_t stride_z = stride_y * mCubeDimension.y;
-
-    // ALOGE("strides %zu %zu", stride_y, stride_z);
+    const size_t stride_y = cubeDimension.x * 4;
+    const size_t stride_z = stride_y * cubeDimension.y;
 
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd) {
+    if (usesSimd) {
         int32_t len = x2 - x1;
         if (len > 0) {
             rsdIntrinsic3DLUT_K(out, in, len, bp, stride_y, stride_z, dims.x, dims.y, dims.z);
@@ -159,10 +157,158 @@ void Lut3dTask::processData(int /* threadIndex */, size_t startX, size_t startY,
                             size_t endY) {
     for (size_t y = startY; y < endY; y++) {
         size_t offset = mSizeX * y + startX;
-        kernel(mIn + offset, mOut + offset, endX - startX);
+        lut3dRow(mIn + offset, mOut + offset, endX - startX, mCubeTable, mCubeSizeX, mCubeSizeY,
+                 mCubeSizeZ, mUsesSimd);
+    }
+}
+
+/**
+ * Rearranges a LUT image made of square tiles, one per blue level, into a 3D cube.
+ */
+class Lut3dFromTilesTask : public Task {
+    // The LUT image.
+    const uchar4* mIn;
+    // Where we'll store the cube, in the row major format of Lut3dTask.
+    uchar4* mCube;
+    // The number of entries of the cube in each direction, which is also the size of a tile.
+    size_t mCubeSize;
+    // The number of tiles in each row of the LUT image.
+    size_t mLutTilesPerRow;
+    // How much of the LUT is applied, in 1/0x8000.
+    int mIntensity;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    Lut3dFromTilesTask(const uint8_t* input, uint8_t* cube, size_t sizeX, size_t sizeY,
+                       size_t cubeSize, float intensity)
+        : Task{sizeX, sizeY, 4, false, nullptr},
+          mIn{reinterpret_cast<const uchar4*>(input)},
+          mCube{reinterpret_cast<uchar4*>(cube)},
+          mCubeSize{cubeSize},
+          mLutTilesPerRow{sizeX / cubeSize},
+          mIntensity{static_cast<int>(intensity * 0x8000 + 0.5f)} {}
+};
+
+void Lut3dFromTilesTask::processData(int /* threadIndex */, size_t startX, size_t startY,
+                                     size_t endX, size_t endY) {
+    const int maxIndex = mCubeSize - 1;
+    for (size_t y = startY; y < endY; y++) {
+        const size_t green = y % mCubeSize;
+        const size_t tileRow = y / mCubeSize;
+        for (size_t x = startX; x < endX; x++) {
+            const size_t red = x % mCubeSize;
+            const size_t blue = tileRow * mLutTilesPerRow + x / mCubeSize;
+            uchar4 entry = mIn[y * mSizeX + x];
+            if (mIntensity != 0x8000) {
+                // Bake mix(identity, lut, intensity) into the entry. The identity is linear, so
+                // it's exactly what interpolating between the entries of the cube would give.
+                const int4 identity = int4{(int)red, (int)green, (int)blue, maxIndex} * 255;
+                const int4 base = (identity + maxIndex / 2) / maxIndex;
+                const int4 mixed = base * 0x8000 + (convert<int4>(entry) - base) * mIntensity;
+                entry = convert<uchar4>((mixed + 0x4000) >> 15);
+            }
+            entry[3] = 255;
+            mCube[(blue * mCubeSize + green) * mCubeSize + red] = entry;
+        }
     }
 }
 
+size_t RenderScriptToolkit::tiledLutCubeSize(size_t sizeX, size_t sizeY) {
+    const size_t entries = sizeX * sizeY;
+    size_t cubeSize = 2;
+    while (cubeSize * cubeSize * cubeSize < entries) {
+        cubeSize++;
+    }
+    if (cubeSize > 256 || cubeSize * cubeSize * cubeSize != entries || sizeX % cubeSize != 0 ||
+        sizeY % cubeSize != 0) {
+        return 0;
+    }
+    return cubeSize;
+}
+
+void RenderScriptToolkit::lut3dFromTiles(const uint8_t* input, uint8_t* cube, size_t sizeX,
+                                         size_t sizeY, float intensity) {
+    const size_t cubeSize = tiledLutCubeSize(sizeX, sizeY);
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (cubeSize == 0) {
+        ALOGE("The LUT image of %zux%zu is not made of cubeSize x cubeSize tiles, one per blue "
+              "level.", sizeX, sizeY);
+        return;
+    }
+    if (intensity < 0.f || intensity > 1.f) {
+        ALOGE("The intensity should be between 0 and 1. %f provided.", intensity);
+        return;
+    }
+#endif
+
+    Lut3dFromTilesTask task(input, cube, sizeX, sizeY, cubeSize, intensity);
+    processor->doTask(&task);
+}
+
+/**
+ * Samples a channel of a curve map at (u, v), with the bilinear filtering of the shaders. Past
+ * the edges, the edge texels are repeated.
+ */
+static float sampleCurveMap(const uchar4* map, size_t sizeX, size_t sizeY, int channel, float u,
+                            float v) {
+    const float x = clamp(u * sizeX - 0.5f, 0.f, sizeX - 1.f);
+    const float y = clamp(v * sizeY - 0.5f, 0.f, sizeY - 1.f);
+    const size_t x0 = static_cast<size_t>(x);
+    const size_t y0 = static_cast<size_t>(y);
+    const size_t x1 = std::min(x0 + 1, sizeX - 1);
+    const size_t y1 = std::min(y0 + 1, sizeY - 1);
+    auto texel = [&](size_t i, size_t j) { return map[j * sizeX + i][channel] / 255.f; };
+    const float top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * (x - x0);
+    const float bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * (x - x0);
+    return top + (bottom - top) * (y - y0);
+}
+
+void RenderScriptToolkit::lut3dFromCurveMap(const uint8_t* map, uint8_t* cube, size_t mapSizeX,
+                                            size_t mapSizeY, size_t cubeSize, float intensity) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (cubeSize < 2 || cubeSize > 256) {
+        ALOGE("The size of the cube should be between 2 and 256. %zu provided.", cubeSize);
+        return;
+    }
+    if (intensity < 0.f || intensity > 1.f) {
+        ALOGE("The intensity should be between 0 and 1. %f provided.", intensity);
+        return;
+    }
+#endif
+
+    // The curve of each channel at the levels of the grid. The rows are those of the shaders.
+    const float rows[3] = {0.16666f, 0.5f, 0.83333f};
+    const uchar4* in = reinterpret_cast<const uchar4*>(map);
+    std::vector<uchar> curves(3 * cubeSize);
+    for (int c = 0; c < 3; c++) {
+        for (size_t level = 0; level < cubeSize; level++) {
+            const float u = static_cast<float>(level) / (cubeSize - 1);
+            const float value = sampleCurveMap(in, mapSizeX, mapSizeY, c, u, rows[c]);
+            curves[c * cubeSize + level] =
+                    static_cast<uchar>(clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+        }
+    }
+
+    // The preset at every point of the grid, as a strip of tiles, one per blue level.
+    std::vector<uchar4> tiles(cubeSize * cubeSize * cubeSize);
+    for (size_t green = 0; green < cubeSize; green++) {
+        for (size_t blue = 0; blue < cubeSize; blue++) {
+            uchar4* row = tiles.data() + (green * cubeSize + blue) * cubeSize;
+            for (size_t red = 0; red < cubeSize; red++) {
+                row[red] = uchar4{curves[red], curves[cubeSize + green],
+                                  curves[2 * cubeSize + blue], 255};
+            }
+        }
+    }
+
+    Lut3dFromTilesTask task(reinterpret_cast<const uint8_t*>(tiles.data()), cube,
+                            cubeSize * cubeSize, cubeSize, cubeSize, intensity);
+    processor->doTask(&task);
+}
+
 void RenderScriptToolkit::lut3d(const uint8_t* input, uint8_t* output, size_t sizeX, size_t sizeY,
                                 const uint8_t* cube, size_t cubeSizeX, size_t cubeSizeY,
                                 size_t cubeSizeZ, const Restriction* restriction) {
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.Premultiply"
+
+namespace renderscript {
+
+/**
+ * The reciprocals of the alpha values, scaled so that (c * table[a] + 2^15) >> 16 is c * 255 / a
+ * rounded. Rounding the reciprocals up makes this exact for every c and a, ties included. The
+ * entry for 0 is 0, so that fully transparent pixels become black.
+ */
+struct ReciprocalTable {
+    uint32_t values[256];
+
+    ReciprocalTable() {
+        values[0] = 0;
+        for (uint32_t a = 1; a < 256; a++) {
+            values[a] = ((255u << 16) + a - 1) / a;
+        }
+    }
+};
+
+// Built on first use. The initialization of a local static is thread safe.
+static const uint32_t* reciprocals() {
+    static const ReciprocalTable table;
+    return table.values;
+}
+
+void premultiplyRow(const uchar4* in, uchar4* out, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        const uchar4 pixel = in[i];
+        const uint32_t a = pixel[3];
+        if (a == 255) {
+            out[i] = pixel;
+            continue;
+        }
+        // c * a / 255, rounded, without a division.
+        uint4 t = convert<uint4>(pixel) * a + 128;
+        t = (t + (t >> 8)) >> 8;
+        uchar4 result = convert<uchar4>(t);
+        result[3] = a;
+        out[i] = result;
+    }
+}
+
+void unpremultiplyRow(const uchar4* in, uchar4* out, size_t length) {
+    const uint32_t* table = reciprocals();
+    for (size_t i = 0; i < length; i++) {
+        const uchar4 pixel = in[i];
+        const uint32_t a = pixel[3];
+        if (a == 255) {
+            out[i] = pixel;
+            continue;
+        }
+        // Valid premultiplied colors don't exceed the alpha, but clamp in case they do.
+        const uint4 t = (convert<uint4>(pixel) * table[a] + (1u << 15)) >> 16;
+        uchar4 result;
+        for (int c = 0; c < 3; c++) {
+            result[c] = static_cast<uchar>(t[c] > 255 ? 255 : t[c]);
+        }
+        result[3] = a;
+        out[i] = result;
+    }
+}
+
+/**
+ * Converts between straight and premultiplied alpha, one row of the tile at a time.
+ */
+class PremultiplyTask : public Task {
+    const uchar4* mIn;
+    uchar4* mOut;
+    // True to premultiply, false to unpremultiply.
+    bool mPremultiply;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    PremultiplyTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY, bool premultiply,
+                    const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, true, restriction},
+          mIn{reinterpret_cast<const uchar4*>(in)},
+          mOut{reinterpret_cast<uchar4*>(out)},
+          mPremultiply{premultiply} {}
+};
+
+void PremultiplyTask::processData(int /* threadIndex */, size_t startX, size_t startY,
+                                  size_t endX, size_t endY) {
+    for (size_t y = startY; y < endY; y++) {
+        const size_t offset = y * mSizeX + startX;
+        if (mPremultiply) {
+            premultiplyRow(mIn + offset, mOut + offset, endX - startX);
+        } else {
+            unpremultiplyRow(mIn + offset, mOut + offset, endX - startX);
+        }
+    }
+}
+
+void RenderScriptToolkit::premultiply(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                                      const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+#endif
+
+    PremultiplyTask task(in, out, sizeX, sizeY, true, restriction);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::unpremultiply(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                        size_t sizeY, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+#endif
+
+    PremultiplyTask task(in, out, sizeX, sizeY, false, restriction);
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
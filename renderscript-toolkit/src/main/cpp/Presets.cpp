@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.Presets"
+
+namespace renderscript {
+
+/**
+ * Applies a list of presets to the same image, one output per preset.
+ *
+ * Each tile of the image is read once and transformed by all the presets before moving to the
+ * next tile, so the source stays in the cache. When the image is premultiplied, the tile is
+ * unpremultiplied once for all the presets.
+ */
+class PresetsTask : public Task {
+    const uchar4* mIn;
+    const RenderScriptToolkit::Preset* mPresets;
+    size_t mPresetCount;
+    RenderScriptToolkit::AlphaType mAlphaType;
+    // The matrices of the presets that have no cube, transposed so that each float4 is the
+    // contribution of one input channel, and their add vector scaled to 0-255.
+    std::vector<float4> mMatrices;
+    // Per thread buffers holding the unpremultiplied tile.
+    std::vector<void*> mScratch;
+    std::vector<size_t> mScratchSize;
+
+    void matrixRow(const uchar4* in, uchar4* out, size_t length, const float4* matrix) const;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    PresetsTask(const uint8_t* input, size_t sizeX, size_t sizeY,
+                const RenderScriptToolkit::Preset* presets, size_t presetCount,
+                RenderScriptToolkit::AlphaType alphaType, const Restriction* restriction,
+                unsigned int threadCount)
+        : Task{sizeX, sizeY, 4, true, restriction},
+          mIn{reinterpret_cast<const uchar4*>(input)},
+          mPresets{presets},
+          mPresetCount{presetCount},
+          mAlphaType{alphaType},
+          mMatrices(presetCount * 5),
+          mScratch{threadCount},
+          mScratchSize(threadCount) {
+        for (size_t p = 0; p < presetCount; p++) {
+            if (presets[p].cube != nullptr) {
+                continue;
+            }
+            // Same math as the float path of colorMatrix.
+            float4* m = &mMatrices[p * 5];
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    m[i][j] = presets[p].matrix[i * 4 + j];
+                }
+                m[4][i] = presets[p].addVector == nullptr ? 0.f : presets[p].addVector[i] * 255.f;
+            }
+        }
+    }
+    ~PresetsTask() {
+        for (void* buffer : mScratch) {
+            free(buffer);
+        }
+    }
+};
+
+void PresetsTask::matrixRow(const uchar4* in, uchar4* out, size_t length,
+                            const float4* matrix) const {
+    for (size_t i = 0; i < length; i++) {
+        const float4 f = convert<float4>(in[i]);
+        float4 sum = f[0] * matrix[0] + f[1] * matrix[1] + f[2] * matrix[2] + f[3] * matrix[3] +
+                     matrix[4];
+        out[i] = convert<uchar4>(clamp(sum, 0.f, 255.f));
+    }
+}
+
+void PresetsTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                              size_t endY) {
+    const size_t width = endX - startX;
+    const bool premultiplied = mAlphaType == RenderScriptToolkit::AlphaType::PREMULTIPLIED;
+
+    // Where the rows of the tile are read from, and the distance between them.
+    const uchar4* source = mIn + startY * mSizeX + startX;
+    size_t sourceStride = mSizeX;
+    if (premultiplied) {
+        const size_t needed = width * (endY - startY) * sizeof(uchar4);
+        if (mScratchSize[threadIndex] < needed) {
+            mScratch[threadIndex] = realloc(mScratch[threadIndex], needed);
+            mScratchSize[threadIndex] = needed;
+        }
+        uchar4* tile = static_cast<uchar4*>(mScratch[threadIndex]);
+        for (size_t y = startY; y < endY; y++) {
+            unpremultiplyRow(mIn + y * mSizeX + startX, tile + (y - startY) * width, width);
+        }
+        source = tile;
+        sourceStride = width;
+    }
+
+    for (size_t p = 0; p < mPresetCount; p++) {
+        const RenderScriptToolkit::Preset& preset = mPresets[p];
+        for (size_t y = startY; y < endY; y++) {
+            const uchar4* in = source + (y - startY) * sourceStride;
+            uchar4* out = reinterpret_cast<uchar4*>(preset.out) + y * mSizeX + startX;
+            if (preset.cube != nullptr) {
+                lut3dRow(in, out, width, preset.cube, preset.cubeSizeX, preset.cubeSizeY,
+                         preset.cubeSizeZ, mUsesSimd);
+            } else {
+                matrixRow(in, out, width, &mMatrices[p * 5]);
+            }
+            if (premultiplied) {
+                premultiplyRow(out, out, width);
+            }
+        }
+    }
+}
+
+void RenderScriptToolkit::applyPresets(const uint8_t* input, size_t sizeX, size_t sizeY,
+                                       const Preset* presets, size_t presetCount,
+                                       AlphaType alphaType, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    for (size_t p = 0; p < presetCount; p++) {
+        const Preset& preset = presets[p];
+        if (preset.cube != nullptr) {
+            if (preset.cubeSizeX < 2 || preset.cubeSizeY < 2 || preset.cubeSizeZ < 2 ||
+                preset.cubeSizeX > 256 || preset.cubeSizeY > 256 || preset.cubeSizeZ > 256) {
+                ALOGE("The dimensions of the cube of preset %zu should be between 2 and 256. "
+                      "(%zu, %zu, %zu) provided.", p, preset.cubeSizeX, preset.cubeSizeY,
+                      preset.cubeSizeZ);
+                return;
+            }
+        } else if (preset.matrix == nullptr) {
+            ALOGE("Preset %zu has neither a cube nor a matrix.", p);
+            return;
+        }
+        if (preset.out == input) {
+            ALOGE("The output of preset %zu can't be the input.", p);
+            return;
+        }
+    }
+#endif
+
+    PresetsTask task(input, sizeX, sizeY, presets, presetCount, alphaType, restriction,
+                     processor->getNumberOfThreads());
+    processor->doTask(&task);
+}
+
+}  // namespace renderscript
@@ -87,6 +87,24 @@ class RenderScriptToolkit {
      */
     ~RenderScriptToolkit();
 
+    /**
+     * How the color of RGBA pixels relates to their alpha.
+     *
+     * Android bitmaps are premultiplied. Blending, blurring, and resampling must average
+     * premultiplied colors, otherwise the color of transparent pixels bleeds into their
+     * neighbors. The methods that accept an AlphaType convert unpremultiplied data on the fly.
+     */
+    enum class AlphaType {
+        /**
+         * The color channels have been multiplied by the alpha.
+         */
+        PREMULTIPLIED = 0,
+        /**
+         * The color channels are independent of the alpha, also known as straight alpha.
+         */
+        UNPREMULTIPLIED = 1,
+    };
+
     /**
      * Determines how a source buffer is blended into a destination buffer.
      *
@@ -163,7 +181,54 @@ class RenderScriptToolkit {
         /**
          * dest = max(dest - src, 0.0)
          */
-        SUBTRACT = 14
+        SUBTRACT = 14,
+        /*
+         * The modes below follow the W3C Compositing and Blending definitions. The blended color
+         * B(Cs, Cd) is computed from the unpremultiplied source and destination colors, then
+         * composited with:
+         *     dest.rgb = (1 - dest.a) * src.rgb + (1 - src.a) * dest.rgb + src.a * dest.a * B
+         *     dest.a = src.a + dest.a - src.a * dest.a
+         */
+        /**
+         * B = Cs + Cd - Cs * Cd
+         */
+        SCREEN = 15,
+        /**
+         * B = HARD_LIGHT(Cd, Cs), i.e. multiply or screen depending on the destination.
+         */
+        OVERLAY = 16,
+        /**
+         * Darkens or lightens depending on the source, like a diffuse spotlight.
+         */
+        SOFT_LIGHT = 17,
+        /**
+         * B = Cs <= 0.5 ? 2 * Cs * Cd : SCREEN(2 * Cs - 1, Cd)
+         */
+        HARD_LIGHT = 18,
+        /**
+         * B = min(Cs, Cd)
+         */
+        DARKEN = 19,
+        /**
+         * B = max(Cs, Cd)
+         */
+        LIGHTEN = 20,
+        /**
+         * B = min(1, Cd / (1 - Cs))
+         */
+        COLOR_DODGE = 21,
+        /**
+         * B = 1 - min(1, (1 - Cd) / Cs)
+         */
+        COLOR_BURN = 22,
+        /**
+         * B = |Cs - Cd|
+         */
+        DIFFERENCE = 23,
+        /**
+         * B = Cs + Cd - 2 * Cs * Cd
+         */
+        EXCLUSION = 24
     };
 
     /**
@@ -171,7 +236,7 @@ class RenderScriptToolkit {
      *
      * Blends a source buffer and a destination buffer, placing the result in the destination
      * buffer. The blending is done pairwise between two corresponding RGBA values found in
-     * each buffer. The mode parameter specifies one of fifteen blending operations.
+     * each buffer. The mode parameter specifies one of twenty-five blending operations.
      * See {@link BlendingMode}.
      *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
@@ -191,6 +256,71 @@ class RenderScriptToolkit {
     void blend(BlendingMode mode, const uint8_t* _Nonnull source, uint8_t* _Nonnull dst,
                size_t sizeX, size_t sizeY, const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * Blend a faded source buffer with the destination buffer.
+     *
+     * Behaves like the blend method above, except that the source is first scaled by opacity
+     * and, if provided, by the mask. This is how a layer with an opacity and a layer mask is
+     * composited, in one pass.
+     *
+     * @param mode The specific blending operation to do.
+     * @param source The RGBA input buffer.
+     * @param dest The destination buffer. Used for input and output.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param opacity How much of the source is used, from 0 to 1.
+     * @param mask When not null, one byte per pixel that scales the source, 255 being opaque.
+     * @param alphaType How both buffers store their alpha. Unpremultiplied buffers are
+     *        premultiplied before blending, and the destination is unpremultiplied afterwards.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void blend(BlendingMode mode, const uint8_t* _Nonnull source, uint8_t* _Nonnull dst,
+               size_t sizeX, size_t sizeY, float opacity, const uint8_t* _Nullable mask,
+               AlphaType alphaType = AlphaType::PREMULTIPLIED,
+               const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * A layer to be composited by {@link RenderScriptToolkit::composite}.
+     */
+    struct Layer {
+        // The RGBA pixels of the layer, sizeX * sizeY * 4 bytes with a row-major layout.
+        const uint8_t* _Nonnull pixels;
+        size_t sizeX;
+        size_t sizeY;
+        // Where the top left corner of the layer is placed in the destination. Can be negative.
+        int offsetX = 0;
+        int offsetY = 0;
+        // How much of the layer is used, from 0 to 1.
+        float opacity = 1.f;
+        BlendingMode mode = BlendingMode::SRC_OVER;
+        // When not null, sizeX * sizeY bytes that scale the layer, 255 being opaque.
+        const uint8_t* _Nullable mask = nullptr;
+    };
+
+    /**
+     * Composite a stack of layers into the destination buffer.
+     *
+     * The layers are blended into the destination in order, the first layer being the bottom
+     * one. Each layer is faded by its opacity and mask, then blended using its mode, as the
+     * blend method would. A layer only affects the pixels of the destination it covers.
+     *
+     * This is equivalent to calling blend once per layer, but the destination is read and
+     * written only once, and the parts of the layers that are fully transparent are skipped.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of the destination. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param layers The layers to composite, bottom first.
+     * @param layerCount The number of layers.
+     * @param dest The RGBA destination buffer. Used for input and output.
+     * @param sizeX The width of the destination, as a number of RGBA values.
+     * @param sizeY The height of the destination, as a number of RGBA values.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void composite(const Layer* _Nonnull layers, size_t layerCount, uint8_t* _Nonnull dest,
+                   size_t sizeX, size_t sizeY, const Restriction* _Nullable restriction = nullptr);
+
     /**
      * Blur an image.
      *
@@ -222,6 +352,26 @@ class RenderScriptToolkit {
     void blur(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX, size_t sizeY,
               size_t vectorSize, int radius, const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * Blur an image that may have unpremultiplied alpha.
+     *
+     * Behaves like the blur method above. When alphaType is UNPREMULTIPLIED and vectorSize is 4,
+     * the input is premultiplied before blurring and the output is unpremultiplied, so that
+     * transparent pixels don't darken or tint their neighbors.
+     *
+     * @param in The buffer of the image to be blurred.
+     * @param out The buffer that receives the blurred image.
+     * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
+     * @param vectorSize Either 1 or 4, the number of bytes in each cell, i.e. A vs. RGBA.
+     * @param radius The radius of the pixels used to blur.
+     * @param alphaType How the input and output buffers store their alpha.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void blur(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX, size_t sizeY,
+              size_t vectorSize, int radius, AlphaType alphaType,
+              const Restriction* _Nullable restriction = nullptr);
+
     /**
      * Identity matrix that can be passed to the {@link RenderScriptToolkit::colorMatrix} method.
      *
@@ -316,6 +466,182 @@ class RenderScriptToolkit {
                      const float* _Nonnull matrix, const float* _Nullable addVector = nullptr,
                      const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * The color spaces supported by {@link RenderScriptToolkit::convertColorSpace} and
+     * {@link RenderScriptToolkit::adjustInColorSpace}.
+     *
+     * Each space is stored in the first three bytes of an RGBA pixel, the alpha being kept:
+     *  - SRGB: R, G, B.
+     *  - LINEAR_SRGB: R, G, B without the sRGB transfer function.
+     *  - HSV and HSL: hue, in 256 steps around the circle, then saturation and value or
+     *    lightness scaled to 0-255.
+     *  - LAB: CIE L*a*b* with a D65 white point. L is scaled from 0-100 to 0-255, a and b are
+     *    offset by 128.
+     *
+     * adjustInColorSpace works in natural units rather than in bytes: hue in degrees from 0 to
+     * 360, saturation, value, lightness, and linear values from 0 to 1, L from 0 to 100, and a
+     * and b from about -128 to 127.
+     */
+    enum class ColorSpace {
+        SRGB = 0,
+        LINEAR_SRGB = 1,
+        HSV = 2,
+        HSL = 3,
+        LAB = 4,
+    };
+
+    /**
+     * Convert an image from one color space to another.
+     *
+     * The transfer functions of sRGB and the cube root of Lab are tabulated once, so the
+     * conversions don't call pow.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * The input and output buffers must have the same dimensions, and can be the same buffer.
+     * Both buffers should be large enough for sizeX * sizeY * 4 bytes. The buffers have a
+     * row-major layout. The colors are taken as is, i.e. premultiplied pixels should be
+     * unpremultiplied first.
+     *
+     * @param in The buffer of the image to be converted.
+     * @param out The buffer that receives the converted image.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param from The color space of the input.
+     * @param to The color space of the output.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void convertColorSpace(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                           size_t sizeY, ColorSpace from, ColorSpace to,
+                           const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Adjust an sRGB image in another color space.
+     *
+     * Each pixel is converted to the color space, where each channel c becomes
+     * c * scale + offset, then converted back to sRGB. The converted image is never stored.
+     * For example, in HSV, an offset of 30 on the first channel rotates the hues by 30 degrees
+     * and a scale of 1.2 on the second one increases the saturation. In LAB, an offset on the
+     * third channel warms or cools the image.
+     *
+     * The hue wraps around, and the other channels are clamped to their range.
+     *
+     * @param in The buffer of the image to be adjusted.
+     * @param out The buffer that receives the adjusted image. Can be the same as in.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param space The color space in which to adjust the channels.
+     * @param scale Three factors, one per channel of the color space.
+     * @param offset Three values added to the channels after scaling.
+     * @param alphaType How both buffers store their alpha. Premultiplied pixels are
+     *        unpremultiplied before the conversion, and premultiplied again after.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void adjustInColorSpace(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                            size_t sizeY, ColorSpace space, const float* _Nonnull scale,
+                            const float* _Nonnull offset,
+                            AlphaType alphaType = AlphaType::PREMULTIPLIED,
+                            const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * The parameters of adjustmentChain and adjustImage, one per filter of the OpenGL editor.
+     * The defaults leave the image unchanged, and filters at their default are skipped.
+     *
+     * The values are the uniforms of the shaders, not the 0-1 progress of the sliders. The
+     * ranges used by the editor are noted for each.
+     */
+    struct Adjustments {
+        // Added to the colors. -0.15 to 0.15.
+        float brightness = 0.f;
+        // Scales the colors around 0.5. 0.75 to 1.25.
+        float contrast = 1.f;
+        // 0 is grey, 1 is unchanged. 0 to 2.
+        float saturation = 1.f;
+        // The colors are multiplied by 2^exposure. -1 to 0.6.
+        float exposure = 0.f;
+        // Below 1 darkens the highlights, above 1 brightens them. 0.2 to 1.8.
+        float highlights = 1.f;
+        // Below 1 darkens the shadows, above 1 lifts them. 0.6 to 1.4.
+        float shadows = 1.f;
+        // How much of a warm overlay is mixed in. -1 to 1.
+        float temperature = 0.f;
+        // Rotation of the hue in the YIQ space, in radians. -pi to pi.
+        float hue = 0.f;
+        // Shifts red to blue. -1.2 to 1.2.
+        float colorTemperature = 0.f;
+        // Rotation of the hue in the HSV space, in degrees. -20 to 20.
+        float tone = 0.f;
+        // Strength of a 3x3 sharpening. 0 to 1.
+        float sharpness = 0.f;
+        // Strength of a sharpening that spares the strong edges. 0 to 0.6. Can't be combined
+        // with sharpness.
+        float clarity = 0.f;
+        // Size of the darkened border. 0 to 1.
+        float vignette = 0.f;
+    };
+
+    /**
+     * Apply the adjustment filters of the OpenGL editor in a single pass.
+     *
+     * Computes, without a GL context, what the chain of shaders of ComposeAdjustImageFilter
+     * outputs, with the standalone tone, color temperature, and clarity filters. The filters
+     * are applied in this order: brightness, contrast, saturation, exposure, highlights and
+     * shadows, temperature and hue, color temperature, tone, sharpness or clarity, vignette.
+     * Like the frame buffers between the shaders, the colors are clamped to 0-1 and rounded to
+     * 8 bits after each filter, so the result matches the GPU to within rounding.
+     *
+     * All the filters but sharpness and clarity work on one pixel at a time. Those two look at
+     * the 3x3 neighborhood of the pixel, after the preceding filters.
+     *
+     * The colors are adjusted with straight alpha. Like the last shader of the chain, the tone
+     * and clarity filters make the image opaque.
+     *
+     * @param in The RGBA buffer of the image to be adjusted.
+     * @param out The buffer that receives the adjusted image. Can't be the same as in when
+     *        sharpness or clarity is set.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param adjustments The strength of each filter.
+     * @param alphaType How both buffers store their alpha. Premultiplied pixels are
+     *        unpremultiplied before the adjustments, and premultiplied again after.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void adjustmentChain(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                         size_t sizeY, const Adjustments& adjustments,
+                         AlphaType alphaType = AlphaType::PREMULTIPLIED,
+                         const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Apply the AdjustImage shader of the OpenGL editor in a single pass.
+     *
+     * Computes, without a GL context, what AdjustImageFilter outputs. It uses the brightness,
+     * contrast, saturation, exposure, highlights, shadows, temperature, hue, sharpness, and
+     * vignette of the adjustments. The others must be left at their default. Note that this
+     * shader differs from the chain of adjustmentChain in its saturation, exposure, and
+     * contrast, and sharpens first.
+     *
+     * The active adjustments are compiled into a short kernel. The per channel curves are
+     * composed into lookup tables and the linear steps into color matrices. E.g. brightness,
+     * contrast, and exposure cost a single table lookup per channel. The vignette is the only
+     * term evaluated per pixel.
+     *
+     * @param in The RGBA buffer of the image to be adjusted.
+     * @param out The buffer that receives the adjusted image. Can't be the same as in when
+     *        sharpness is set.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param adjustments The strength of each adjustment.
+     * @param alphaType How both buffers store their alpha. Premultiplied pixels are
+     *        unpremultiplied before the adjustments, and premultiplied again after.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void adjustImage(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                     size_t sizeY, const Adjustments& adjustments,
+                     AlphaType alphaType = AlphaType::PREMULTIPLIED,
+                     const Restriction* _Nullable restriction = nullptr);
+
     /**
      * Convolve a ByteArray.
      *
@@ -353,6 +679,39 @@ class RenderScriptToolkit {
                      size_t sizeY, const float* _Nonnull coefficients,
                      const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * The largest kernel size accepted by convolve.
+     */
+    static constexpr size_t kMaxConvolveSize = 25;
+
+    /**
+     * Convolve a ByteArray with a square kernel of any odd size.
+     *
+     * Behaves like convolve3x3 and convolve5x5, for kernels of kernelSize * kernelSize
+     * coefficients in row-major format. kernelSize should be an odd number no larger than
+     * kMaxConvolveSize.
+     *
+     * Kernels that are the product of a column and a row, e.g. box and Gaussian kernels, are
+     * detected and applied as two one-dimensional passes, which is much faster for large sizes.
+     * Other kernels are applied directly. By default, like for convolve3x3 and convolve5x5, their
+     * coefficients are then rounded to multiples of 1/256. With floatAccumulation, the sums are
+     * computed in floating point instead, which is slower but preserves small coefficients.
+     *
+     * @param in The buffer of the image to be convolved.
+     * @param out The buffer that receives the convolved image.
+     * @param vectorSize The number of bytes in each cell, a value from 1 to 4.
+     * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
+     * @param coefficients kernelSize * kernelSize multipliers.
+     * @param kernelSize The width and height of the kernel.
+     * @param floatAccumulation Whether non-separable kernels are computed in floating point.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void convolve(const void* _Nonnull in, void* _Nonnull out, size_t vectorSize, size_t sizeX,
+                  size_t sizeY, const float* _Nonnull coefficients, size_t kernelSize,
+                  bool floatAccumulation = false,
+                  const Restriction* _Nullable restriction = nullptr);
+
     /**
      * Compute the histogram of an image.
      *
@@ -475,10 +834,158 @@ class RenderScriptToolkit {
                const uint8_t* _Nonnull cube, size_t cubeSizeX, size_t cubeSizeY, size_t cubeSizeZ,
                const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * Convert a LUT image made of tiles into the cube used by lut3d.
+     *
+     * The LUT image of the LUT filter of the OpenGL editor is 512x512, made of 8x8 tiles of
+     * 64x64 entries. Each tile is for one blue level, left to right then top to bottom, and
+     * within a tile the red level increases to the right and the green level downwards. Other
+     * sizes of this layout, like 64x64 images of 4x4 tiles or 4096x64 strips, are accepted as
+     * long as the image holds cubeSize^3 entries in tiles of cubeSize x cubeSize, see
+     * tiledLutCubeSize.
+     *
+     * lut3d interpolates between the entries of the cube the same way the shader does between
+     * the texels of the image. The intensity of the filter, i.e. mix(in, lut(in), intensity),
+     * is baked into the cube, so that rendering with the cube costs the same at any intensity.
+     * The conversion is meant to be done once per LUT, and the cube kept and reused for every
+     * image or thumbnail the LUT is applied to.
+     *
+     * @param in The RGBA buffer of the LUT image.
+     * @param cube The buffer that receives the cube, cubeSize^3 RGBA entries in the row major
+     * format of lut3d, where X is red, Y green and Z blue.
+     * @param sizeX The width of the LUT image.
+     * @param sizeY The height of the LUT image.
+     * @param intensity How much of the LUT is applied, between 0 and 1.
+     */
+    void lut3dFromTiles(const uint8_t* _Nonnull in, uint8_t* _Nonnull cube, size_t sizeX,
+                        size_t sizeY, float intensity = 1.f);
+
+    /**
+     * The size of the cube of a LUT image made of tiles, or 0 if sizeX by sizeY doesn't fit
+     * the layout expected by lut3dFromTiles.
+     */
+    static size_t tiledLutCubeSize(size_t sizeX, size_t sizeY);
+
+    /**
+     * Bake a preset made of per channel curves into the cube used by lut3d.
+     *
+     * Presets like ABIGAIL of the OpenGL editor map each channel through one row of a curve
+     * map: red through the row at 1/6 of the height of the map, green at 1/2, and blue at 5/6.
+     * The result depends only on the color, so the preset is evaluated at every point of the
+     * cube grid, sampling the map with the bilinear filtering of the shader, and the grid is
+     * converted like lut3dFromTiles does.
+     *
+     * Not every preset can be baked. AMELIA also reads a map at the distance of the pixel to
+     * the center of the image, and OLIVIA blends with a texture at the position of the pixel.
+     *
+     * @param map The RGBA buffer of the curve map.
+     * @param cube The buffer that receives the cube, cubeSize^3 RGBA entries in the row major
+     * format of lut3d, where X is red, Y green and Z blue.
+     * @param mapSizeX The width of the curve map.
+     * @param mapSizeY The height of the curve map.
+     * @param cubeSize The number of entries of the cube in each direction, between 2 and 256.
+     * @param intensity How much of the preset is applied, between 0 and 1.
+     */
+    void lut3dFromCurveMap(const uint8_t* _Nonnull map, uint8_t* _Nonnull cube, size_t mapSizeX,
+                           size_t mapSizeY, size_t cubeSize = 64, float intensity = 1.f);
+
+    /**
+     * A color transform applied by {@link RenderScriptToolkit::applyPresets}, either the 3D
+     * lookup table of lut3d or the color matrix of colorMatrix.
+     */
+    struct Preset {
+        // When not null, the cube of lut3d, cubeSizeX * cubeSizeY * cubeSizeZ RGBA entries in
+        // row major format. The matrix is then ignored.
+        const uint8_t* _Nullable cube = nullptr;
+        size_t cubeSizeX = 0;
+        size_t cubeSizeY = 0;
+        size_t cubeSizeZ = 0;
+        // Otherwise, the 4x4 matrix of colorMatrix in row major format, and its optional
+        // addVector.
+        const float* _Nullable matrix = nullptr;
+        const float* _Nullable addVector = nullptr;
+        // The RGBA buffer that receives the image transformed by this preset, sizeX * sizeY * 4
+        // bytes with a row-major layout.
+        uint8_t* _Nonnull out;
+    };
+
+    /**
+     * Apply a list of presets to the same image, one output per preset.
+     *
+     * Each output is what lut3d or colorMatrix with four byte vectors would give for its
+     * preset, e.g. to render the thumbnails of a strip of filters. The presets are applied in
+     * a single task: each tile of the input is read once and transformed by all the presets,
+     * and the tiles are spread over the threads. Compared to one call per preset, this avoids
+     * reloading the input and waiting for the threads once per preset.
+     *
+     * The presets transform unpremultiplied colors. When the input is premultiplied, it's
+     * unpremultiplied once for all the presets and each output is premultiplied.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param in The RGBA buffer of the image to be transformed.
+     * @param sizeX The width of the buffers, as a number of RGBA values.
+     * @param sizeY The height of the buffers, as a number of RGBA values.
+     * @param presets The presets to apply, each with its output buffer.
+     * @param presetCount The number of presets.
+     * @param alphaType How the buffers store their alpha.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void applyPresets(const uint8_t* _Nonnull in, size_t sizeX, size_t sizeY,
+                      const Preset* _Nonnull presets, size_t presetCount,
+                      AlphaType alphaType = AlphaType::PREMULTIPLIED,
+                      const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Premultiply an image.
+     *
+     * Multiplies the red, green, and blue channels of each RGBA pixel by its alpha, i.e.
+     * out.rgb = round(in.rgb * in.a / 255). The alpha is unchanged. The division is done in
+     * fixed point.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * The input and output buffers must have the same dimensions. They can be the same buffer.
+     * Both buffers should be large enough for sizeX * sizeY * 4 bytes. The buffers have a
+     * row-major layout.
+     *
+     * @param in The buffer of the image with unpremultiplied alpha.
+     * @param out The buffer that receives the premultiplied image.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void premultiply(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                     size_t sizeY, const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Unpremultiply an image.
+     *
+     * The inverse of premultiply: out.rgb = min(255, round(in.rgb * 255 / in.a)). Fully
+     * transparent pixels become transparent black. Rather than dividing, each pixel is
+     * multiplied by a fixed point reciprocal of its alpha, looked up in a table.
+     *
+     * The parameters are the same as for premultiply.
+     *
+     * @param in The buffer of the premultiplied image.
+     * @param out The buffer that receives the image with unpremultiplied alpha.
+     * @param sizeX The width of both buffers, as a number of RGBA values.
+     * @param sizeY The height of both buffers, as a number of RGBA values.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void unpremultiply(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX,
+                       size_t sizeY, const Restriction* _Nullable restriction = nullptr);
+
     /**
      * Resize an image.
      *
-     * Resizes an image using bicubic interpolation.
+     * Resizes an image using bicubic interpolation. This is the same as calling the resize
+     * method below with ResizeFilter::BICUBIC. When downscaling, the filter is widened to cover
+     * all the input pixels under an output pixel, which avoids aliasing.
      *
      * This method supports cells of 1 to 4 bytes in length. Each byte of the cell is
      * interpolated independently from the others.
@@ -504,12 +1011,91 @@ class RenderScriptToolkit {
                 size_t inputSizeY, size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
                 const Restriction* _Nullable restriction = nullptr);
 
+    /**
+     * The filters that can be used by {@link RenderScriptToolkit::resize}.
+     *
+     * When downscaling, the filters are stretched to cover all the input pixels that fall
+     * under an output pixel, which avoids aliasing.
+     */
+    enum class ResizeFilter {
+        /**
+         * Bicubic (Catmull-Rom) interpolation. Sharp, with a slight overshoot on edges.
+         */
+        BICUBIC = 0,
+        /**
+         * Linear interpolation between the two nearest pixels in each direction.
+         */
+        BILINEAR = 1,
+        /**
+         * Area average. Each output pixel is the mean of the input pixels it covers. This is
+         * the fastest filter for large downscales, e.g. thumbnails.
+         */
+        BOX = 2,
+        /**
+         * Lanczos windowed sinc with three lobes. The highest quality, at a higher cost.
+         */
+        LANCZOS3 = 3,
+    };
+
+    /**
+     * Resize an image using the specified filter.
+     *
+     * Behaves like the resize method above, except that the filter can be chosen. The filter
+     * weights are computed once per call and applied as two separable passes.
+     *
+     * @param in The buffer of the image to be resized.
+     * @param out The buffer that receives the resized image.
+     * @param inputSizeX The width of the input buffer, as a number of 1-4 byte cells.
+     * @param inputSizeY The height of the input buffer, as a number of 1-4 byte cells.
+     * @param vectorSize The number of bytes in each cell of both buffers. A value from 1 to 4.
+     * @param outputSizeX The width of the output buffer, as a number of 1-4 byte cells.
+     * @param outputSizeY The height of the output buffer, as a number of 1-4 byte cells.
+     * @param filter The filter used to compute the output pixels.
+     * @param alphaType How the input and output buffers store their alpha. Only used when
+     *        vectorSize is 4. Unpremultiplied input is premultiplied as it's read, and the
+     *        output is unpremultiplied as it's written.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void resize(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t inputSizeX,
+                size_t inputSizeY, size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
+                ResizeFilter filter, AlphaType alphaType = AlphaType::PREMULTIPLIED,
+                const Restriction* _Nullable restriction = nullptr);
+
     /**
      * The YUV formats supported by yuvToRgb.
+     *
+     * NV21, YV12, and P010 use the values of android.graphics.ImageFormat. NV12 and I420, which
+     * have no ImageFormat, use their FourCC.
      */
     enum class YuvFormat {
         NV21 = 0x11,
         YV12 = 0x32315659,
+        // Y plane followed by interleaved U and V samples.
+        NV12 = 0x3231564E,
+        // Y plane followed by the U plane then the V plane.
+        I420 = 0x30323449,
+        // Like NV12 but with 16 bit little endian samples holding 10 bits in their high bits.
+        P010 = 0x36,
+    };
+
+    /**
+     * The matrices that yuvToRgb can use to convert YUV to RGB, as defined by the ITU-R
+     * recommendations of the same name. BT601 is used for standard definition content and most
+     * camera frames, BT709 for HD video, and BT2020 for UHD and HDR video.
+     */
+    enum class YuvMatrix {
+        BT601 = 0,
+        BT709 = 1,
+        BT2020 = 2,
+    };
+
+    /**
+     * The range of the YUV samples. LIMITED samples use [16, 235] for luma and [16, 240] for
+     * chroma, FULL samples use [0, 255]. Both scale up for 10 bit samples.
+     */
+    enum class YuvRange {
+        LIMITED = 0,
+        FULL = 1,
     };
 
     /**
@@ -523,14 +1109,159 @@ class RenderScriptToolkit {
      * RenderScript Intrinsic may not have converted the image correctly.
      * This Toolkit method should.
      *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
      * @param in The buffer of the image to be converted.
      * @param out The buffer that receives the converted image.
      * @param sizeX The width in pixels of the image. Must be even.
      * @param sizeY The height in pixels of the image.
-     * @param format Either YV12 or NV21.
+     * @param format The layout of the input buffer.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
      */
     void yuvToRgb(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX, size_t sizeY,
-                  YuvFormat format);
+                  YuvFormat format, YuvMatrix matrix = YuvMatrix::BT601,
+                  YuvRange range = YuvRange::LIMITED,
+                  const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * The planes of a 4:2:0 YUV image, e.g. those of an android.media.Image.
+     *
+     * Each plane can have its own padding and the chroma samples can be planar or interleaved,
+     * as described by the strides. All strides are in bytes. The U and V planes share their
+     * strides.
+     */
+    struct YuvPlanes {
+        const uint8_t* _Nonnull y;
+        const uint8_t* _Nonnull u;
+        const uint8_t* _Nonnull v;
+        // The distance between the start of two consecutive rows.
+        size_t rowStrideY;
+        size_t rowStrideUV;
+        // The distance between two consecutive samples of a row. For 8 bit samples, the chroma
+        // pixel stride is 1 for planar chroma and 2 for interleaved chroma.
+        size_t pixelStrideY = 1;
+        size_t pixelStrideUV = 1;
+        // Either 8, or 10 for 16 bit little endian P010 samples.
+        size_t bitsPerSample = 8;
+    };
+
+    /**
+     * Convert an image made of separate YUV planes to RGB.
+     *
+     * Same as the method above, but the planes can be anywhere in memory and have any stride,
+     * so the planes of a camera frame can be converted without first being repacked. The
+     * dimensions don't need to be even, the chroma planes being ((sizeX + 1) / 2) by
+     * ((sizeY + 1) / 2) samples.
+     *
+     * @param planes Where to find the samples of the image to be converted.
+     * @param out The buffer that receives the converted image.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void yuvToRgb(const YuvPlanes& planes, uint8_t* _Nonnull out, size_t sizeX, size_t sizeY,
+                  YuvMatrix matrix = YuvMatrix::BT601, YuvRange range = YuvRange::LIMITED,
+                  const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Clockwise rotations by a multiple of 90 degrees. The values are the angles in degrees.
+     */
+    enum class Rotation {
+        NONE = 0,
+        CW_90 = 90,
+        CW_180 = 180,
+        CW_270 = 270,
+    };
+
+    /**
+     * Convert YUV planes to RGB while resizing, rotating, and mirroring the image.
+     *
+     * Produces the same image as converting the planes with yuvToRgb, rotating the result
+     * clockwise, mirroring it horizontally if requested, and resizing it to the output
+     * dimensions, in a single pass and without intermediate buffers. This is meant to feed a
+     * preview from camera frames.
+     *
+     * The source is sampled bilinearly. When downscaling by more than a factor of two, this
+     * skips some of the input pixels.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of the output buffer. If provided, the range must be wholly contained with the dimensions
+     * described by outputSizeX and outputSizeY.
+     *
+     * @param planes Where to find the samples of the image to be converted.
+     * @param inputSizeX The width in pixels of the input image.
+     * @param inputSizeY The height in pixels of the input image.
+     * @param out The buffer that receives the converted image.
+     * @param outputSizeX The width in pixels of the output image.
+     * @param outputSizeY The height in pixels of the output image.
+     * @param rotation How much the image is rotated, before being mirrored.
+     * @param mirror Whether to flip the rotated image horizontally.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void yuvToRgb(const YuvPlanes& planes, size_t inputSizeX, size_t inputSizeY,
+                  uint8_t* _Nonnull out, size_t outputSizeX, size_t outputSizeY,
+                  Rotation rotation, bool mirror = false, YuvMatrix matrix = YuvMatrix::BT601,
+                  YuvRange range = YuvRange::LIMITED,
+                  const Restriction* _Nullable restriction = nullptr);
+
+    /**
+     * Where rgbToYuv writes the planes of a 4:2:0 YUV image. Same as YuvPlanes, for 8 bit
+     * samples and contiguous luma.
+     */
+    struct YuvOutputPlanes {
+        uint8_t* _Nonnull y;
+        uint8_t* _Nonnull u;
+        uint8_t* _Nonnull v;
+        size_t rowStrideY;
+        size_t rowStrideUV;
+        // 1 for planar chroma, 2 for interleaved chroma.
+        size_t pixelStrideUV = 1;
+    };
+
+    /**
+     * Convert an image from RGB to YUV.
+     *
+     * Converts an RGBA buffer to 4:2:0 YUV, the reverse of yuvToRgb. The alpha channel is
+     * ignored. Each chroma sample is computed from the average of the 2x2 pixels it covers.
+     *
+     * The planes can be anywhere in memory, e.g. in the input Image of a video encoder.
+     *
+     * @param in The RGBA buffer of the image to be converted.
+     * @param planes Where to write the samples of the converted image.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     */
+    void rgbToYuv(const uint8_t* _Nonnull in, const YuvOutputPlanes& planes, size_t sizeX,
+                  size_t sizeY, YuvMatrix matrix = YuvMatrix::BT601,
+                  YuvRange range = YuvRange::LIMITED);
+
+    /**
+     * Convert an image from RGB to a YUV buffer.
+     *
+     * Same as the method above, but writes a single buffer with the layout of the format. P010
+     * is not supported.
+     *
+     * @param in The RGBA buffer of the image to be converted.
+     * @param out The buffer that receives the converted image.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param format The layout of the output buffer.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     */
+    void rgbToYuv(const uint8_t* _Nonnull in, uint8_t* _Nonnull out, size_t sizeX, size_t sizeY,
+                  YuvFormat format, YuvMatrix matrix = YuvMatrix::BT601,
+                  YuvRange range = YuvRange::LIMITED);
 };
 
 }  // namespace renderscript
@@ -17,207 +17,137 @@
 #include <math.h>
 
 #include <cstdint>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
 #include "Utils.h"
 
-#if defined(ARCH_X86_HAVE_AVX2)
-#include <stdint.h>
-#include <x86intrin.h>
-#include <xmmintrin.h>
-#endif
-
 #define LOG_TAG "renderscript.toolkit.Resize"
 
 namespace renderscript {
 
-class ResizeTask : public Task {
-    const uchar* mIn;
-    uchar* mOut;
-    float mScaleX;
-    float mScaleY;
-    size_t mInputSizeX;
-    size_t mInputSizeY;
-
-    void kernelU1(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-    void kernelU2(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-    void kernelU4(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_SUPPORTS_FLOAT
-    void kernelF1(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-    void kernelF2(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-    void kernelF4(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
-#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_SUPPORTS_FLOAT
-
-    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
-    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
-                     size_t endY) override;
-
-   public:
-    ResizeTask(const uchar* input, uchar* output, size_t inputSizeX, size_t inputSizeY,
-               size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
-               const Restriction* restriction)
-        : Task{outputSizeX, outputSizeY, vectorSize, false, restriction},
-          mIn{input},
-          mOut{output},
-          mInputSizeX{inputSizeX},
-          mInputSizeY{inputSizeY} {
-        mScaleX = static_cast<float>(inputSizeX) / outputSizeX;
-        mScaleY = static_cast<float>(inputSizeY) / outputSizeY;
-    }
+/**
+ * The weights used to resample one axis of the image. They are computed once per call, for
+ * every output position of that axis.
+ *
+ * Output position i is computed from the count[i] input positions that start at start[i], using
+ * the count[i] weights found at weights[i * taps]. The weights of a position sum to 1.
+ */
+struct ResampleAxis {
+    // The maximum number of input positions that contribute to one output position.
+    int taps = 0;
+    std::vector<int32_t> start;
+    std::vector<int32_t> count;
+    std::vector<float> weights;
 };
 
-void ResizeTask::processData(int /* threadIndex */, size_t startX, size_t startY, size_t endX,
-                             size_t endY) {
-    typedef void (ResizeTask::*KernelFunction)(uchar*, uint32_t, uint32_t, uint32_t);
-
-    KernelFunction kernel;
-    switch (mVectorSize) {
-        case 4:
-            kernel = &ResizeTask::kernelU4;
-            break;
-        case 3:
-            kernel = &ResizeTask::kernelU4;
-            break;
-        case 2:
-            kernel = &ResizeTask::kernelU2;
-            break;
-        case 1:
-            kernel = &ResizeTask::kernelU1;
-            break;
-        default:
-            ALOGE("Bad vector size %zd", mVectorSize);
-    }
-
-    for (size_t y = startY; y < endY; y++) {
-        size_t offset = (mSizeX * y + startX) * paddedSize(mVectorSize);
-        uchar* out = mOut + offset;
-        std::invoke(kernel, this, out, startX, endX, y);
-    }
+static float boxFilter(float x) {
+    return (x > -0.5f && x <= 0.5f) ? 1.0f : 0.0f;
 }
 
-static float4 cubicInterpolate(float4 p0, float4 p1, float4 p2, float4 p3, float x) {
-    return p1 + 0.5f * x * (p2 - p0 + x * (2.f * p0 - 5.f * p1 + 4.f * p2 - p3
-            + x * (3.f * (p1 - p2) + p3 - p0)));
+static float bilinearFilter(float x) {
+    x = fabsf(x);
+    return x < 1.0f ? 1.0f - x : 0.0f;
 }
 
-static float2 cubicInterpolate(float2 p0,float2 p1,float2 p2,float2 p3, float x) {
-    return p1 + 0.5f * x * (p2 - p0 + x * (2.f * p0 - 5.f * p1 + 4.f * p2 - p3
-            + x * (3.f * (p1 - p2) + p3 - p0)));
+// The Catmull-Rom spline (a = -0.5), the curve used by the original RenderScript resize.
+static float bicubicFilter(float x) {
+    const float a = -0.5f;
+    x = fabsf(x);
+    if (x < 1.0f) {
+        return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
+    }
+    if (x < 2.0f) {
+        return (((x - 5.0f) * x + 8.0f) * x - 4.0f) * a;
+    }
+    return 0.0f;
 }
 
-
-#if defined(ARCH_X86_HAVE_AVX2)
-static float cubicInterpolate(float p0,float p1,float p2,float p3 , float x) {
-   return p1 + 0.5f * x * (p2 - p0 + x * (2.f * p0 - 5.f * p1 +
-           _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(4.f), _mm_set1_ps(p2),_mm_set1_ps(p3)))
-           + x * (_mm_cvtss_f32(_mm_fmadd_ss (_mm_set1_ps(3.f),_mm_set1_ps(p1 - p2),
-                                              _mm_set1_ps(p3 - p0))))));
-
-}
-#else
-static float cubicInterpolate(float p0,float p1,float p2,float p3 , float x) {
-    //ALOGI("CP, %f, %f, %f, %f, %f", p0, p1, p2, p3, x);
-    return p1 + 0.5f * x * (p2 - p0 + x * (2.f * p0 - 5.f * p1 + 4.f * p2 - p3
-            + x * (3.f * (p1 - p2) + p3 - p0)));
+static float sinc(float x) {
+    if (x == 0.0f) {
+        return 1.0f;
+    }
+    x *= static_cast<float>(M_PI);
+    return sinf(x) / x;
 }
-#endif
 
-static uchar4 OneBiCubic(const uchar4 *yp0, const uchar4 *yp1, const uchar4 *yp2, const uchar4 *yp3,
-                         float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float4 p0  = cubicInterpolate(convert<float4>(yp0[xs0]),
-                                  convert<float4>(yp0[xs1]),
-                                  convert<float4>(yp0[xs2]),
-                                  convert<float4>(yp0[xs3]), xf);
-
-    float4 p1  = cubicInterpolate(convert<float4>(yp1[xs0]),
-                                  convert<float4>(yp1[xs1]),
-                                  convert<float4>(yp1[xs2]),
-                                  convert<float4>(yp1[xs3]), xf);
-
-    float4 p2  = cubicInterpolate(convert<float4>(yp2[xs0]),
-                                  convert<float4>(yp2[xs1]),
-                                  convert<float4>(yp2[xs2]),
-                                  convert<float4>(yp2[xs3]), xf);
-
-    float4 p3  = cubicInterpolate(convert<float4>(yp3[xs0]),
-                                  convert<float4>(yp3[xs1]),
-                                  convert<float4>(yp3[xs2]),
-                                  convert<float4>(yp3[xs3]), xf);
-
-    float4 p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    p = clamp(p + 0.5f, 0.f, 255.f);
-    return convert<uchar4>(p);
+static float lanczos3Filter(float x) {
+    return (x > -3.0f && x < 3.0f) ? sinc(x) * sinc(x / 3.0f) : 0.0f;
 }
 
-static uchar2 OneBiCubic(const uchar2 *yp0, const uchar2 *yp1, const uchar2 *yp2, const uchar2 *yp3,
-                         float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float2 p0  = cubicInterpolate(convert<float2>(yp0[xs0]),
-                                  convert<float2>(yp0[xs1]),
-                                  convert<float2>(yp0[xs2]),
-                                  convert<float2>(yp0[xs3]), xf);
-
-    float2 p1  = cubicInterpolate(convert<float2>(yp1[xs0]),
-                                  convert<float2>(yp1[xs1]),
-                                  convert<float2>(yp1[xs2]),
-                                  convert<float2>(yp1[xs3]), xf);
-
-    float2 p2  = cubicInterpolate(convert<float2>(yp2[xs0]),
-                                  convert<float2>(yp2[xs1]),
-                                  convert<float2>(yp2[xs2]),
-                                  convert<float2>(yp2[xs3]), xf);
-
-    float2 p3  = cubicInterpolate(convert<float2>(yp3[xs0]),
-                                  convert<float2>(yp3[xs1]),
-                                  convert<float2>(yp3[xs2]),
-                                  convert<float2>(yp3[xs3]), xf);
-
-    float2 p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    p = clamp(p + 0.5f, 0.f, 255.f);
-    return convert<uchar2>(p);
-}
+/**
+ * Computes the weights needed to resample an axis of inputSize pixels into outputSize pixels.
+ *
+ * When downscaling, the filter is stretched so that it covers all the input pixels that fall
+ * under an output pixel. This is what prevents aliasing at large scale factors; the BOX filter
+ * then becomes an area average.
+ */
+static void computeResampleAxis(ResampleAxis* axis, size_t inputSize, size_t outputSize,
+                                RenderScriptToolkit::ResizeFilter filter) {
+    float (*kernel)(float);
+    double support;
+    switch (filter) {
+        case RenderScriptToolkit::ResizeFilter::BILINEAR:
+            kernel = bilinearFilter;
+            support = 1.0;
+            break;
+        case RenderScriptToolkit::ResizeFilter::BOX:
+            kernel = boxFilter;
+            support = 0.5;
+            break;
+        case RenderScriptToolkit::ResizeFilter::LANCZOS3:
+            kernel = lanczos3Filter;
+            support = 3.0;
+            break;
+        case RenderScriptToolkit::ResizeFilter::BICUBIC:
+        default:
+            kernel = bicubicFilter;
+            support = 2.0;
+            break;
+    }
 
-static uchar OneBiCubic(const uchar *yp0, const uchar *yp1, const uchar *yp2, const uchar *yp3,
-                        float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float p0  = cubicInterpolate((float)yp0[xs0], (float)yp0[xs1],
-                                 (float)yp0[xs2], (float)yp0[xs3], xf);
-    float p1  = cubicInterpolate((float)yp1[xs0], (float)yp1[xs1],
-                                 (float)yp1[xs2], (float)yp1[xs3], xf);
-    float p2  = cubicInterpolate((float)yp2[xs0], (float)yp2[xs1],
-                                 (float)yp2[xs2], (float)yp2[xs3], xf);
-    float p3  = cubicInterpolate((float)yp3[xs0], (float)yp3[xs1],
-                                 (float)yp3[xs2], (float)yp3[xs3], xf);
-
-    float p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    p = clamp(p + 0.5f, 0.f, 255.f);
-    //ALOGI("CUC,%f,%u", p, (uchar)p);
-    return (uchar)p;
+    const double scale = static_cast<double>(inputSize) / outputSize;
+    const double filterScale = std::max(scale, 1.0);
+    const double scaledSupport = support * filterScale;
+
+    axis->taps = static_cast<int>(ceil(scaledSupport)) * 2 + 1;
+    axis->start.resize(outputSize);
+    axis->count.resize(outputSize);
+    axis->weights.assign(outputSize * axis->taps, 0.0f);
+
+    for (size_t i = 0; i < outputSize; i++) {
+        const double center = (i + 0.5) * scale;
+        int first = std::max(static_cast<int>(center - scaledSupport + 0.5), 0);
+        int last = std::min(static_cast<int>(center + scaledSupport + 0.5),
+                            static_cast<int>(inputSize));
+        float* w = &axis->weights[i * axis->taps];
+
+        // Skip the input pixels that would get a zero weight, e.g. the outer taps of the
+        // bicubic filter when the output pixel falls exactly on an input pixel.
+        while (first < last - 1 && kernel((first - center + 0.5) / filterScale) == 0.0f) {
+            first++;
+        }
+        while (last - 1 > first && kernel((last - 1 - center + 0.5) / filterScale) == 0.0f) {
+            last--;
+        }
+
+        float total = 0.0f;
+        for (int j = first; j < last; j++) {
+            w[j - first] = kernel((j - center + 0.5) / filterScale);
+            total += w[j - first];
+        }
+        if (total != 0.0f) {
+            for (int j = 0; j < last - first; j++) {
+                w[j] /= total;
+            }
+        }
+        axis->start[i] = first;
+        axis->count[i] = last - first;
+    }
 }
 
+#if defined(ARCH_ARM_USE_INTRINSICS)
 extern "C" uint64_t rsdIntrinsicResize_oscctl_K(uint32_t xinc);
 
 extern "C" void rsdIntrinsicResizeB4_K(
@@ -262,7 +192,6 @@ extern "C" void rsdIntrinsicResizeB1_K(
             uint64_t osc_ctl,
             int32_t const *yr);
 
-#if defined(ARCH_ARM_USE_INTRINSICS)
 static void mkYCoeff(int32_t *yr, float yf) {
     int32_t yf1 = rint(yf * 0x10000);
     int32_t yf2 = rint(yf * yf * 0x10000);
@@ -275,480 +204,329 @@ static void mkYCoeff(int32_t *yr, float yf) {
 }
 #endif
 
-#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_SUPPORTS_FLOAT
-static float4 OneBiCubic(const float4 *yp0, const float4 *yp1, const float4 *yp2, const float4 *yp3,
-                         float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float4 p0  = cubicInterpolate(yp0[xs0], yp0[xs1],
-                                  yp0[xs2], yp0[xs3], xf);
-    float4 p1  = cubicInterpolate(yp1[xs0], yp1[xs1],
-                                  yp1[xs2], yp1[xs3], xf);
-    float4 p2  = cubicInterpolate(yp2[xs0], yp2[xs1],
-                                  yp2[xs2], yp2[xs3], xf);
-    float4 p3  = cubicInterpolate(yp3[xs0], yp3[xs1],
-                                  yp3[xs2], yp3[xs3], xf);
-
-    float4 p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    return p;
-}
-
-static float2 OneBiCubic(const float2 *yp0, const float2 *yp1, const float2 *yp2, const float2 *yp3,
-                         float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float2 p0  = cubicInterpolate(yp0[xs0], yp0[xs1],
-                                  yp0[xs2], yp0[xs3], xf);
-    float2 p1  = cubicInterpolate(yp1[xs0], yp1[xs1],
-                                  yp1[xs2], yp1[xs3], xf);
-    float2 p2  = cubicInterpolate(yp2[xs0], yp2[xs1],
-                                  yp2[xs2], yp2[xs3], xf);
-    float2 p3  = cubicInterpolate(yp3[xs0], yp3[xs1],
-                                  yp3[xs2], yp3[xs3], xf);
-
-    float2 p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    return p;
-}
-
-static float OneBiCubic(const float *yp0, const float *yp1, const float *yp2, const float *yp3,
-                        float xf, float yf, int width) {
-    int startx = (int) floor(xf - 1);
-    xf = xf - floor(xf);
-    int maxx = width - 1;
-    int xs0 = std::max(0, startx + 0);
-    int xs1 = std::max(0, startx + 1);
-    int xs2 = std::min(maxx, startx + 2);
-    int xs3 = std::min(maxx, startx + 3);
-
-    float p0  = cubicInterpolate(yp0[xs0], yp0[xs1],
-                                 yp0[xs2], yp0[xs3], xf);
-    float p1  = cubicInterpolate(yp1[xs0], yp1[xs1],
-                                 yp1[xs2], yp1[xs3], xf);
-    float p2  = cubicInterpolate(yp2[xs0], yp2[xs1],
-                                 yp2[xs2], yp2[xs3], xf);
-    float p3  = cubicInterpolate(yp3[xs0], yp3[xs1],
-                                 yp3[xs2], yp3[xs3], xf);
-
-    float p  = cubicInterpolate(p0, p1, p2, p3, yf);
-    return p;
-}
-#endif
+/**
+ * Resizes an image using a selectable filter.
+ *
+ * The filter is applied as two separable passes. Each input row a tile needs is first filtered
+ * horizontally, once, into a ring of float rows. Every output row is then a weighted sum of the
+ * ring rows it covers. Adjacent output rows share most of their input rows, so a bicubic upscale
+ * costs about 4 + 4 taps per pixel rather than the 16 of a direct 2D kernel.
+ */
+class ResizeTask : public Task {
+    const uchar* mIn;
+    uchar* mOut;
+    size_t mInputSizeX;
+    size_t mInputSizeY;
+    ResampleAxis mAxisX;
+    ResampleAxis mAxisY;
+    // Whether RGBA pixels have straight alpha. They are then premultiplied as they're read, so
+    // that the filter averages premultiplied colors, and unpremultiplied as they're written.
+    bool mUnpremultiplied;
 
-void ResizeTask::kernelU4(uchar *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    const uchar *pin = mIn;
-    const int srcHeight = mInputSizeY;
-    const int srcWidth = mInputSizeX;
-    const size_t stride = mInputSizeX * paddedSize(mVectorSize);
+    // Working area to store the ring of horizontally filtered rows. There's one area per thread,
+    // cached here to avoid paying the allocation cost per tile.
+    std::vector<void*> mScratch;       // Pointers to the scratch areas, one per thread.
+    std::vector<size_t> mScratchSize;  // The size of the scratch areas in float4, one per thread.
 
+    template <typename PixelType, typename ComputationType>
+    void resampleTile(int threadIndex, size_t startX, size_t startY, size_t endX, size_t endY);
 
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f),
-                                          _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * mScaleY - 0.5f;
+#if defined(ARCH_ARM_USE_INTRINSICS)
+    // Whether the hand-written bicubic kernels can be used. They compute the same Catmull-Rom
+    // weights in fixed point, but only for upscales, where the filter isn't stretched, and they
+    // replicate the edge pixels rather than dropping the taps that fall outside the image.
+    bool mUseAssembly = false;
+    float mScaleX = 0.f;
+    float mScaleY = 0.f;
+    // The output columns whose four taps are all inside the input, with a pixel to spare for
+    // the fixed-point position that the kernels step along the row.
+    size_t mInteriorStartX = 0;
+    size_t mInteriorEndX = 0;
+
+    template <typename PixelType, typename ComputationType>
+    void resamplePixels(size_t startX, size_t endX, size_t y);
+    void resampleTileAssembly(size_t startX, size_t startY, size_t endX, size_t endY);
 #endif
 
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
 
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::max(0, starty + 1);
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const uchar4 *yp0 = (const uchar4 *)(pin + stride * ys0);
-    const uchar4 *yp1 = (const uchar4 *)(pin + stride * ys1);
-    const uchar4 *yp2 = (const uchar4 *)(pin + stride * ys2);
-    const uchar4 *yp3 = (const uchar4 *)(pin + stride * ys3);
-
-    uchar4 *out = ((uchar4 *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
+   public:
+    ResizeTask(const uchar* input, uchar* output, size_t inputSizeX, size_t inputSizeY,
+               size_t vectorSize, size_t outputSizeX, size_t outputSizeY, uint32_t threadCount,
+               RenderScriptToolkit::ResizeFilter filter, RenderScriptToolkit::AlphaType alphaType,
+               const Restriction* restriction)
+        : Task{outputSizeX, outputSizeY, vectorSize, false, restriction},
+          mIn{input},
+          mOut{output},
+          mInputSizeX{inputSizeX},
+          mInputSizeY{inputSizeY},
+          mUnpremultiplied{vectorSize == 4 &&
+                           alphaType == RenderScriptToolkit::AlphaType::UNPREMULTIPLIED},
+          mScratch{threadCount},
+          mScratchSize(threadCount) {
+        computeResampleAxis(&mAxisX, inputSizeX, outputSizeX, filter);
+        computeResampleAxis(&mAxisY, inputSizeY, outputSizeY, filter);
+        // Each tile starts with an empty ring. Make the tiles tall enough that filling it is a
+        // small part of the work, i.e. that a tile spans at least twice the vertical support.
+        // resize() rejects empty inputs; the guard keeps a bad call from dividing by zero.
+        mMinRowsPerTile = std::max<size_t>(
+                16, 2 * mAxisY.taps * outputSizeY / std::max<size_t>(mInputSizeY, 1));
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd && x2 > x1 && mScaleX < 4.0f) {
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
-        long xf16 = rint(xf * 0x10000);
-        uint32_t xinc16 = rint(mScaleX * 0x10000);
-
-        int xoff = (xf16 >> 16) - 1;
-        int xclip = std::max(0, xoff) - xoff;
-        int len = x2 - x1;
-
-        int32_t yr[4];
-        uint64_t osc_ctl = rsdIntrinsicResize_oscctl_K(xinc16);
-        mkYCoeff(yr, yf);
-
-        xoff += xclip;
-
-        rsdIntrinsicResizeB4_K(
-                out, len,
-                xf16 & 0xffff, xinc16,
-                yp0 + xoff, yp1 + xoff, yp2 + xoff, yp3 + xoff,
-                xclip, srcWidth - xoff + xclip,
-                osc_ctl, yr);
-        out += len;
-        x1 += len;
-    }
-#endif
-
-    while(x1 < x2) {
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
+        mUseAssembly = filter == RenderScriptToolkit::ResizeFilter::BICUBIC && !mUnpremultiplied &&
+                       inputSizeX <= outputSizeX && inputSizeY <= outputSizeY;
+        if (mUseAssembly) {
+            mScaleX = static_cast<float>(inputSizeX) / outputSizeX;
+            mScaleY = static_cast<float>(inputSizeY) / outputSizeY;
+            mInteriorStartX = outputSizeX;
+            for (size_t x = 0; x < outputSizeX; x++) {
+                const int first = (int)floorf((x + 0.5f) * mScaleX - 0.5f) - 1;
+                if (first >= 1 && first + 4 < (int)inputSizeX) {
+                    mInteriorStartX = std::min(mInteriorStartX, x);
+                    mInteriorEndX = x + 1;
+                }
+            }
+        }
 #endif
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
     }
-}
-
-void ResizeTask::kernelU2(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    const uchar *pin = mIn;
-    const int srcHeight = mInputSizeY;
-    const int srcWidth = mInputSizeX;
-    const size_t stride = mInputSizeX * mVectorSize;
-
-
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(
-            _mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f), _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * mScaleY - 0.5f;
-#endif
-
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::max(0, starty + 1);
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const uchar2 *yp0 = (const uchar2 *)(pin + stride * ys0);
-    const uchar2 *yp1 = (const uchar2 *)(pin + stride * ys1);
-    const uchar2 *yp2 = (const uchar2 *)(pin + stride * ys2);
-    const uchar2 *yp3 = (const uchar2 *)(pin + stride * ys3);
-
-    uchar2 *out = ((uchar2 *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
-#if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd && x2 > x1 && mScaleX < 4.0f) {
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
-        long xf16 = rint(xf * 0x10000);
-        uint32_t xinc16 = rint(mScaleX * 0x10000);
 
-        int xoff = (xf16 >> 16) - 1;
-        int xclip = std::max(0, xoff) - xoff;
-        int len = x2 - x1;
-
-        int32_t yr[4];
-        uint64_t osc_ctl = rsdIntrinsicResize_oscctl_K(xinc16);
-        mkYCoeff(yr, yf);
-
-        xoff += xclip;
-
-        rsdIntrinsicResizeB2_K(
-                out, len,
-                xf16 & 0xffff, xinc16,
-                yp0 + xoff, yp1 + xoff, yp2 + xoff, yp3 + xoff,
-                xclip, srcWidth - xoff + xclip,
-                osc_ctl, yr);
-        out += len;
-        x1 += len;
+    ~ResizeTask() {
+        for (size_t i = 0; i < mScratch.size(); i++) {
+            if (mScratch[i]) {
+                free(mScratch[i]);
+            }
+        }
     }
-#endif
-
-    while(x1 < x2) {
+};
 
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
-#endif
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
+template <typename PixelType, typename ComputationType>
+void ResizeTask::resampleTile(int threadIndex, size_t startX, size_t startY, size_t endX,
+                              size_t endY) {
+    const PixelType* in = reinterpret_cast<const PixelType*>(mIn);
+    PixelType* out = reinterpret_cast<PixelType*>(mOut);
+
+    const size_t width = endX - startX;
+    const int32_t* startsX = &mAxisX.start[startX];
+    const int32_t* countsX = &mAxisX.count[startX];
+    const float* weightsX = &mAxisX.weights[startX * mAxisX.taps];
+    const int32_t tapsX = mAxisX.taps;
+    // The input columns needed to compute the output columns of this tile.
+    const size_t firstColumn = startsX[0];
+    const size_t sourceWidth = startsX[width - 1] + countsX[width - 1] - firstColumn;
+
+    // The scratch area holds the ring, followed by one input row converted to floats, one
+    // row to accumulate the vertical pass into, and, for straight alpha, one premultiplied
+    // input row.
+    // Input row r is kept in slot r % ringSize of the ring. An output row never needs more than
+    // taps rows, so the rows it uses are all still in the ring.
+    const size_t ringSize = mAxisY.taps;
+    const size_t premultipliedSize = mUnpremultiplied ? divideRoundingUp(sourceWidth, 4) : 0;
+    const size_t needed = ringSize * width + sourceWidth + width + premultipliedSize;
+    if (needed > mScratchSize[threadIndex] || !mScratch[threadIndex]) {
+        mScratch[threadIndex] = realloc(mScratch[threadIndex], needed * sizeof(float4) + 15);
+        mScratchSize[threadIndex] = needed;
+    }
+    // Make sure the buffer is aligned so that the compiler can use aligned vector accesses.
+    ComputationType* ring =
+            reinterpret_cast<ComputationType*>((((intptr_t)mScratch[threadIndex]) + 15) & ~0xf);
+    ComputationType* source = ring + ringSize * width;
+    ComputationType* sum = source + sourceWidth;
+    // Only used for RGBA, where a float4 holds four uchar4.
+    uchar4* premultiplied = reinterpret_cast<uchar4*>(sum + width);
+
+    // The next input row to filter horizontally. Rows only ever move down, so the rows that
+    // were skipped over, e.g. when downscaling with a narrow filter, are never needed again.
+    int32_t nextRow = mAxisY.start[startY];
+    for (size_t y = startY; y < endY; y++) {
+        const int32_t firstRow = mAxisY.start[y];
+        const int32_t countY = mAxisY.count[y];
+
+        // Horizontal pass, for the input rows this output row needs that aren't in the ring yet.
+        for (int32_t r = std::max(nextRow, firstRow); r < firstRow + countY; r++) {
+            const PixelType* row = in + r * mInputSizeX + firstColumn;
+            if (mUnpremultiplied) {
+                premultiplyRow(reinterpret_cast<const uchar4*>(row), premultiplied, sourceWidth);
+                row = reinterpret_cast<const PixelType*>(premultiplied);
+            }
+            for (size_t i = 0; i < sourceWidth; i++) {
+                source[i] = convert<ComputationType>(row[i]);
+            }
+            ComputationType* filtered = ring + (r % ringSize) * width;
+            for (size_t i = 0; i < width; i++) {
+                const ComputationType* p = source + (startsX[i] - firstColumn);
+                const float* w = weightsX + i * tapsX;
+                ComputationType s = p[0] * w[0];
+                for (int32_t t = 1; t < countsX[i]; t++) {
+                    s += p[t] * w[t];
+                }
+                filtered[i] = s;
+            }
+        }
+        nextRow = std::max(nextRow, firstRow + countY);
+
+        // Vertical pass. We go through the ring rows one at a time so that the reads are
+        // sequential.
+        const float* wy = &mAxisY.weights[y * mAxisY.taps];
+        const ComputationType* filtered = ring + (firstRow % ringSize) * width;
+        const ComputationType* result = filtered;
+        if (countY > 1) {
+            for (size_t i = 0; i < width; i++) {
+                sum[i] = filtered[i] * wy[0];
+            }
+            for (int32_t t = 1; t < countY; t++) {
+                filtered = ring + ((firstRow + t) % ringSize) * width;
+                const float w = wy[t];
+                for (size_t i = 0; i < width; i++) {
+                    sum[i] += filtered[i] * w;
+                }
+            }
+            result = sum;
+        }
+        PixelType* o = out + y * mSizeX + startX;
+        for (size_t i = 0; i < width; i++) {
+            o[i] = convert<PixelType>(clamp(result[i] + 0.5f, 0.f, 255.f));
+        }
+        if (mUnpremultiplied) {
+            unpremultiplyRow(reinterpret_cast<uchar4*>(o), reinterpret_cast<uchar4*>(o), width);
+        }
     }
 }
 
-void ResizeTask::kernelU1(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    //ALOGI("TK kernelU1 xstart %u, xend %u, outstep %u", xstart, xend);
-    const uchar *pin = mIn;
-    const int srcHeight = mInputSizeY;
-    const int srcWidth = mInputSizeX;
-    const size_t stride = mInputSizeX * mVectorSize;
-
-    // ALOGI("Toolkit   ResizeU1 (%ux%u) by (%f,%f), xstart:%u to %u, stride %zu, out %p", srcWidth,
-    // srcHeight, scaleX, scaleY, xstart, xend, stride, outPtr);
-
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(
-            _mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f), _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * mScaleY - 0.5f;
-#endif
-
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::min(maxy, std::max(0, starty + 1));
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const uchar *yp0 = pin + stride * ys0;
-    const uchar *yp1 = pin + stride * ys1;
-    const uchar *yp2 = pin + stride * ys2;
-    const uchar *yp3 = pin + stride * ys3;
-
-    uchar *out = ((uchar *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd && x2 > x1 && mScaleX < 4.0f) {
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
-        long xf16 = rint(xf * 0x10000);
-        uint32_t xinc16 = rint(mScaleX * 0x10000);
-
-        int xoff = (xf16 >> 16) - 1;
-        int xclip = std::max(0, xoff) - xoff;
-        int len = x2 - x1;
-
-        int32_t yr[4];
-        uint64_t osc_ctl = rsdIntrinsicResize_oscctl_K(xinc16);
-        mkYCoeff(yr, yf);
-
-        // ALOGI("ys0 %d, ys1 %d, ys2 %d, ys3 %d, x1 %u, x2 %u, xf %f, xf16 %ld, xinc16 %u, xoff %d,
-        // xclip %d, len %d, osc_ctl %lu)",
-        //       ys0, ys1, ys2, ys3, x1, x2, xf, xf16, xinc16, xoff, xclip, len, (unsigned long)
-        //       osc_ctl);
-        // ALOGI("TK scaleX %f, xf %f, xf16 %ld, xinc16 %d, xoff %d, xclip %d, len %d", scaleX, xf,
-        // xf16, xinc16, xoff, xclip, len); ALOGI("TK xf16 & 0xffff %ld, ys0 %u, ys1 %u, ys2 %u, ys3
-        // %u, srcWidth - xoff + xclip %d", xf16 & 0xffff, ys0, ys1, ys2, ys3, srcWidth - xoff);
-
-        xoff += xclip;
-
-        rsdIntrinsicResizeB1_K(
-                out, len,
-                xf16 & 0xffff, xinc16,
-                yp0 + xoff, yp1 + xoff, yp2 + xoff, yp3 + xoff,
-                xclip, srcWidth - xoff + xclip,
-                osc_ctl, yr);
-        out += len;
-        x1 += len;
-    }
-#endif
-
-    while(x1 < x2) {
-
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * mScaleX - 0.5f;
-#endif
-
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
+/**
+ * Computes the output pixels [startX, endX) of row y directly from the weights, with the same
+ * operations as resampleTile. Used for the edges that the assembly kernels don't handle.
+ */
+template <typename PixelType, typename ComputationType>
+void ResizeTask::resamplePixels(size_t startX, size_t endX, size_t y) {
+    const PixelType* in = reinterpret_cast<const PixelType*>(mIn);
+    PixelType* out = reinterpret_cast<PixelType*>(mOut) + y * mSizeX;
+    const int32_t firstRow = mAxisY.start[y];
+    const int32_t countY = mAxisY.count[y];
+    const float* wy = &mAxisY.weights[y * mAxisY.taps];
+    for (size_t x = startX; x < endX; x++) {
+        const float* wx = &mAxisX.weights[x * mAxisX.taps];
+        ComputationType result = 0.f;
+        for (int32_t t = 0; t < countY; t++) {
+            const PixelType* p = in + (firstRow + t) * mInputSizeX + mAxisX.start[x];
+            ComputationType s = convert<ComputationType>(p[0]) * wx[0];
+            for (int32_t k = 1; k < mAxisX.count[x]; k++) {
+                s += convert<ComputationType>(p[k]) * wx[k];
+            }
+            result = countY > 1 ? result + s * wy[t] : s;
+        }
+        out[x] = convert<PixelType>(clamp(result + 0.5f, 0.f, 255.f));
     }
 }
 
-#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_SUPPORTS_FLOAT
-void ResizeTask::kernelF4(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    const uchar *pin = mIn;
-    const int srcHeight = inputSizeY;
-    const int srcWidth = inputSizeX;
-    const size_t stride = sizeX * vectorSize;
-
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(
-            _mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f), _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * scaleY - 0.5f;
-#endif
-
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::max(0, starty + 1);
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const float4 *yp0 = (const float4 *)(pin + stride * ys0);
-    const float4 *yp1 = (const float4 *)(pin + stride * ys1);
-    const float4 *yp2 = (const float4 *)(pin + stride * ys2);
-    const float4 *yp3 = (const float4 *)(pin + stride * ys3);
-
-    float4 *out = ((float4 *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
-    while(x1 < x2) {
-
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * scaleX - 0.5f;
-#endif
+void ResizeTask::resampleTileAssembly(size_t startX, size_t startY, size_t endX, size_t endY) {
+    const size_t stride = mInputSizeX * paddedSize(mVectorSize);
+    const size_t x1 = std::max(startX, mInteriorStartX);
+    const size_t x2 = std::min(endX, mInteriorEndX);
+    for (size_t y = startY; y < endY; y++) {
+        float yf = (y + 0.5f) * mScaleY - 0.5f;
+        const int starty = (int)floorf(yf) - 1;
+        yf = yf - floorf(yf);
+        // Rows and columns that would sample outside the input go through the generic weights.
+        size_t interiorStart = x1;
+        size_t interiorEnd = x2;
+        if (starty < 0 || starty + 3 >= (int)mInputSizeY || x1 >= x2) {
+            interiorStart = interiorEnd = endX;
+        }
+        switch (mVectorSize) {
+            case 4:
+            case 3:
+                resamplePixels<uchar4, float4>(startX, interiorStart, y);
+                resamplePixels<uchar4, float4>(interiorEnd, endX, y);
+                break;
+            case 2:
+                resamplePixels<uchar2, float2>(startX, interiorStart, y);
+                resamplePixels<uchar2, float2>(interiorEnd, endX, y);
+                break;
+            case 1:
+                resamplePixels<uchar, float>(startX, interiorStart, y);
+                resamplePixels<uchar, float>(interiorEnd, endX, y);
+                break;
+        }
+        if (interiorStart >= interiorEnd) {
+            continue;
+        }
 
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
+        const float xf = (interiorStart + 0.5f) * mScaleX - 0.5f;
+        const long xf16 = rint(xf * 0x10000);
+        const uint32_t xinc16 = rint(mScaleX * 0x10000);
+        const int xoff = (xf16 >> 16) - 1;
+        const size_t len = interiorEnd - interiorStart;
+        int32_t yr[4];
+        mkYCoeff(yr, yf);
+        const uint64_t osc_ctl = rsdIntrinsicResize_oscctl_K(xinc16);
+        const uchar* yp0 = mIn + stride * starty;
+        const uchar* yp1 = yp0 + stride;
+        const uchar* yp2 = yp1 + stride;
+        const uchar* yp3 = yp2 + stride;
+        const size_t offset = (mSizeX * y + interiorStart) * paddedSize(mVectorSize);
+        switch (mVectorSize) {
+            case 4:
+            case 3:
+                rsdIntrinsicResizeB4_K(
+                        (uchar4*)(mOut + offset), len, xf16 & 0xffff, xinc16,
+                        (const uchar4*)yp0 + xoff, (const uchar4*)yp1 + xoff,
+                        (const uchar4*)yp2 + xoff, (const uchar4*)yp3 + xoff, 0,
+                        mInputSizeX - xoff, osc_ctl, yr);
+                break;
+            case 2:
+                rsdIntrinsicResizeB2_K(
+                        (uchar2*)(mOut + offset), len, xf16 & 0xffff, xinc16,
+                        (const uchar2*)yp0 + xoff, (const uchar2*)yp1 + xoff,
+                        (const uchar2*)yp2 + xoff, (const uchar2*)yp3 + xoff, 0,
+                        mInputSizeX - xoff, osc_ctl, yr);
+                break;
+            case 1:
+                rsdIntrinsicResizeB1_K(
+                        mOut + offset, len, xf16 & 0xffff, xinc16, yp0 + xoff, yp1 + xoff,
+                        yp2 + xoff, yp3 + xoff, 0, mInputSizeX - xoff, osc_ctl, yr);
+                break;
+        }
     }
 }
-
-void ResizeTask::kernelF2(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    const uchar *pin = mIn;
-    const int srcHeight = inputSizeY;
-    const int srcWidth = inputSizeX;
-    const size_t stride = sizeX * vectorSize;
-
-
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f),
-                                          _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * scaleY - 0.5f;
-#endif
-
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::max(0, starty + 1);
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const float2 *yp0 = (const float2 *)(pin + stride * ys0);
-    const float2 *yp1 = (const float2 *)(pin + stride * ys1);
-    const float2 *yp2 = (const float2 *)(pin + stride * ys2);
-    const float2 *yp3 = (const float2 *)(pin + stride * ys3);
-
-    float2 *out = ((float2 *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
-    while(x1 < x2) {
-
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * scaleX - 0.5f;
 #endif
 
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
+void ResizeTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                             size_t endY) {
+#if defined(ARCH_ARM_USE_INTRINSICS)
+    if (mUsesSimd && mUseAssembly) {
+        resampleTileAssembly(startX, startY, endX, endY);
+        return;
     }
-}
-
-void ResizeTask::kernelF1(uchar* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    const uchar *pin = mIn;
-    const int srcHeight = inputSizeY;
-    const int srcWidth = inputSizeX;
-    const size_t stride = sizeX * vectorSize;
-
-
-#if defined(ARCH_X86_HAVE_AVX2)
-    float yf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(currentY + 0.5f),
-                                          _mm_set1_ps(scaleY), _mm_set1_ps(0.5f)));
-#else
-    float yf = (currentY + 0.5f) * scaleY - 0.5f;
-#endif
-
-    int starty = (int) floor(yf - 1);
-    yf = yf - floor(yf);
-    int maxy = srcHeight - 1;
-    int ys0 = std::max(0, starty + 0);
-    int ys1 = std::max(0, starty + 1);
-    int ys2 = std::min(maxy, starty + 2);
-    int ys3 = std::min(maxy, starty + 3);
-
-    const float *yp0 = (const float *)(pin + stride * ys0);
-    const float *yp1 = (const float *)(pin + stride * ys1);
-    const float *yp2 = (const float *)(pin + stride * ys2);
-    const float *yp3 = (const float *)(pin + stride * ys3);
-
-    float *out = ((float *)outPtr);
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
-    while(x1 < x2) {
-
-#if defined(ARCH_X86_HAVE_AVX2)
-        float xf = _mm_cvtss_f32(_mm_fmsub_ss(_mm_set1_ps(x1 + 0.5f) , _mm_set1_ps(scaleX) ,
-                                              _mm_set1_ps(0.5f)));
-#else
-        float xf = (x1 + 0.5f) * scaleX - 0.5f;
 #endif
-
-        *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
-        out++;
-        x1++;
-    }
-}
-
-void ResizeTask::preLaunch(uint32_t slot, const RsScriptCall *sc)
-{
-
-    //check the data type to determine F or U.
-    if (mAlloc->getType()->getElement()->getType() == RS_TYPE_UNSIGNED_8) {
-        switch(mAlloc->getType()->getElement()->getVectorSize()) {
-        case 1:
-            mRootPtr = &kernelU1;
-            break;
-        case 2:
-            mRootPtr = &kernelU2;
-            break;
-        case 3:
+    switch (mVectorSize) {
         case 4:
-            mRootPtr = &kernelU4;
-            break;
-        }
-    } else {
-        switch(mAlloc->getType()->getElement()->getVectorSize()) {
-        case 1:
-            mRootPtr = &kernelF1;
+        case 3:
+            resampleTile<uchar4, float4>(threadIndex, startX, startY, endX, endY);
             break;
         case 2:
-            mRootPtr = &kernelF2;
+            resampleTile<uchar2, float2>(threadIndex, startX, startY, endX, endY);
             break;
-        case 3:
-        case 4:
-            mRootPtr = &kernelF4;
+        case 1:
+            resampleTile<uchar, float>(threadIndex, startX, startY, endX, endY);
             break;
-        }
+        default:
+            ALOGE("Bad vector size %zd", mVectorSize);
     }
 }
-#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_SUPPORTS_FLOAT
 
 void RenderScriptToolkit::resize(const uint8_t* input, uint8_t* output, size_t inputSizeX,
                                  size_t inputSizeY, size_t vectorSize, size_t outputSizeX,
                                  size_t outputSizeY, const Restriction* restriction) {
+    resize(input, output, inputSizeX, inputSizeY, vectorSize, outputSizeX, outputSizeY,
+           ResizeFilter::BICUBIC, AlphaType::PREMULTIPLIED, restriction);
+}
+
+void RenderScriptToolkit::resize(const uint8_t* input, uint8_t* output, size_t inputSizeX,
+                                 size_t inputSizeY, size_t vectorSize, size_t outputSizeX,
+                                 size_t outputSizeY, ResizeFilter filter, AlphaType alphaType,
+                                 const Restriction* restriction) {
 #ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
     if (!validRestriction(LOG_TAG, outputSizeX, outputSizeY, restriction)) {
         return;
@@ -757,10 +535,16 @@ void RenderScriptToolkit::resize(const uint8_t* input, uint8_t* output, size_t i
         ALOGE("The vectorSize should be between 1 and 4. %zu provided.", vectorSize);
         return;
     }
+    if (inputSizeX == 0 || inputSizeY == 0 || outputSizeX == 0 || outputSizeY == 0) {
+        ALOGE("The input and output sizes should not be zero. %zu x %zu and %zu x %zu provided.",
+              inputSizeX, inputSizeY, outputSizeX, outputSizeY);
+        return;
+    }
 #endif
 
     ResizeTask task((const uchar*)input, (uchar*)output, inputSizeX, inputSizeY, vectorSize,
-                    outputSizeX, outputSizeY, restriction);
+                    outputSizeX, outputSizeY, processor->getNumberOfThreads(), filter, alphaType,
+                    restriction);
     processor->doTask(&task);
 }
 
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdint>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.RgbToYuv"
+
+namespace renderscript {
+
+// The coefficients are scaled by 2^kShift.
+static constexpr int kShift = 14;
+
+/**
+ * Converts RGBA to 4:2:0 YUV. Each cell of the task is a 2x2 block of pixels, i.e. one chroma
+ * sample, so that tiles never share chroma samples and can be converted independently.
+ */
+class RgbToYuvTask : public Task {
+    const uchar4* mIn;
+    RenderScriptToolkit::YuvOutputPlanes mPlanes;
+    // The width and height of the image in pixels. mSizeX and mSizeY count 2x2 blocks.
+    size_t mImageSizeX;
+    size_t mImageSizeY;
+    // The rows of the matrix, in fixed point, applied to (R, G, B, A).
+    int4 mToY;
+    int4 mToU;
+    int4 mToV;
+    int mOffsetY;
+
+    // Returns the luma of one pixel.
+    uint8_t luma(uchar4 pixel) const {
+        const int4 weighted = convert<int4>(pixel) * mToY;
+        const int y = (weighted[0] + weighted[1] + weighted[2] + mOffsetY) >> kShift;
+        return static_cast<uint8_t>(clamp(y, 0, 255));
+    }
+    // Returns the chroma of a block given the sum of its four pixels.
+    static uint8_t chroma(int4 sum, int4 coefficients) {
+        const int4 weighted = sum * coefficients;
+        // The sum of four pixels carries two more bits than one pixel.
+        const int c = (weighted[0] + weighted[1] + weighted[2] + (128 << (kShift + 2)) +
+                       (1 << (kShift + 1))) >> (kShift + 2);
+        return static_cast<uint8_t>(clamp(c, 0, 255));
+    }
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    RgbToYuvTask(const uint8_t* input, const RenderScriptToolkit::YuvOutputPlanes& planes,
+                 size_t sizeX, size_t sizeY, RenderScriptToolkit::YuvMatrix matrix,
+                 RenderScriptToolkit::YuvRange range)
+        : Task{(sizeX + 1) / 2, (sizeY + 1) / 2, 4, false, nullptr},
+          mIn{reinterpret_cast<const uchar4*>(input)},
+          mPlanes{planes},
+          mImageSizeX{sizeX},
+          mImageSizeY{sizeY} {
+        float kr, kb;
+        yuvLumaWeights(matrix, &kr, &kb);
+        const bool limited = range == RenderScriptToolkit::YuvRange::LIMITED;
+        const float scaleY = (limited ? 219.f / 255.f : 1.f) * (1 << kShift);
+        const float scaleUV = (limited ? 224.f / 255.f : 1.f) * (1 << kShift);
+        auto fixed = [](float f) { return static_cast<int>(f < 0.f ? f - 0.5f : f + 0.5f); };
+        // Derive one coefficient of each row from the others so that white and greys map
+        // exactly to the top of the luma range and to a neutral chroma.
+        const int yr = fixed(kr * scaleY);
+        const int yb = fixed(kb * scaleY);
+        mToY = int4{yr, fixed(scaleY) - yr - yb, yb, 0};
+        const int ur = fixed(-kr / (2.f * (1.f - kb)) * scaleUV);
+        const int ub = fixed(0.5f * scaleUV);
+        mToU = int4{ur, -ur - ub, ub, 0};
+        const int vr = fixed(0.5f * scaleUV);
+        const int vb = fixed(-kb / (2.f * (1.f - kr)) * scaleUV);
+        mToV = int4{vr, -vr - vb, vb, 0};
+        mOffsetY = ((limited ? 16 : 0) << kShift) + (1 << (kShift - 1));
+    }
+};
+
+void RgbToYuvTask::processData(int /* threadIndex */, size_t startX, size_t startY, size_t endX,
+                               size_t endY) {
+    const size_t pixelStrideUV = mPlanes.pixelStrideUV;
+    for (size_t blockY = startY; blockY < endY; blockY++) {
+        // For an odd height, the last row of blocks reuses its only row of pixels.
+        const size_t y0 = blockY * 2;
+        const size_t y1 = std::min(y0 + 1, mImageSizeY - 1);
+        const uchar4* in0 = mIn + y0 * mImageSizeX;
+        const uchar4* in1 = mIn + y1 * mImageSizeX;
+        uint8_t* outY0 = mPlanes.y + y0 * mPlanes.rowStrideY;
+        uint8_t* outY1 = mPlanes.y + y1 * mPlanes.rowStrideY;
+        uint8_t* outU = mPlanes.u + blockY * mPlanes.rowStrideUV;
+        uint8_t* outV = mPlanes.v + blockY * mPlanes.rowStrideUV;
+
+        for (size_t blockX = startX; blockX < endX; blockX++) {
+            const size_t x0 = blockX * 2;
+            const size_t x1 = std::min(x0 + 1, mImageSizeX - 1);
+            const uchar4 p00 = in0[x0];
+            const uchar4 p01 = in0[x1];
+            const uchar4 p10 = in1[x0];
+            const uchar4 p11 = in1[x1];
+            // When a block is clipped, the duplicated pixels are written twice, identically.
+            outY0[x0] = luma(p00);
+            outY0[x1] = luma(p01);
+            outY1[x0] = luma(p10);
+            outY1[x1] = luma(p11);
+
+            const int4 sum = convert<int4>(p00) + convert<int4>(p01) + convert<int4>(p10) +
+                             convert<int4>(p11);
+            outU[blockX * pixelStrideUV] = chroma(sum, mToU);
+            outV[blockX * pixelStrideUV] = chroma(sum, mToV);
+        }
+    }
+}
+
+void RenderScriptToolkit::rgbToYuv(const uint8_t* input, const YuvOutputPlanes& planes,
+                                   size_t sizeX, size_t sizeY, YuvMatrix matrix,
+                                   YuvRange range) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (sizeX == 0 || sizeY == 0) {
+        ALOGE("The image should not be empty. %zu x %zu provided.", sizeX, sizeY);
+        return;
+    }
+    if (matrix != YuvMatrix::BT601 && matrix != YuvMatrix::BT709 && matrix != YuvMatrix::BT2020) {
+        ALOGE("Unknown YUV matrix %d.", static_cast<int>(matrix));
+        return;
+    }
+    if (planes.pixelStrideUV == 0 || planes.rowStrideY < sizeX ||
+        planes.rowStrideUV < (sizeX + 1) / 2 * planes.pixelStrideUV) {
+        ALOGE("The YUV strides are too small for a width of %zu. %zu, %zu, and %zu provided.",
+              sizeX, planes.rowStrideY, planes.rowStrideUV, planes.pixelStrideUV);
+        return;
+    }
+#endif
+
+    RgbToYuvTask task(input, planes, sizeX, sizeY, matrix, range);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::rgbToYuv(const uint8_t* input, uint8_t* output, size_t sizeX,
+                                   size_t sizeY, YuvFormat format, YuvMatrix matrix,
+                                   YuvRange range) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (format != YuvFormat::NV21 && format != YuvFormat::YV12 && format != YuvFormat::NV12 &&
+        format != YuvFormat::I420) {
+        ALOGE("Unsupported YUV format %d. Only 8 bit formats can be produced.",
+              static_cast<int>(format));
+        return;
+    }
+#endif
+    // Same layout as when reading that format, but writable.
+    const YuvPlanes layout = yuvPlanesOf(output, sizeX, sizeY, format);
+    const YuvOutputPlanes planes{output,
+                                 output + (layout.u - output),
+                                 output + (layout.v - output),
+                                 layout.rowStrideY,
+                                 layout.rowStrideUV,
+                                 layout.pixelStrideUV};
+    rgbToYuv(input, planes, sizeX, sizeY, matrix, range);
+}
+
+}  // namespace renderscript
@@ -47,14 +47,17 @@ int Task::setTiling(unsigned int targetTileSizeInBytes) {
     }
 
     // We want rows as large as possible, as the SIMD code we have is more efficient with
-    // large rows.
-    mTilesPerRow = divideRoundingUp(cellsToProcessX, targetCellsPerTile);
+    // large rows. We only shorten them to give each tile the minimum number of rows requested.
+    const size_t minRowsPerTile = std::min(std::max<size_t>(mMinRowsPerTile, 1), cellsToProcessY);
+    const size_t targetCellsPerRow = std::max<size_t>(targetCellsPerTile / minRowsPerTile, 1);
+    mTilesPerRow = divideRoundingUp(cellsToProcessX, targetCellsPerRow);
     // Once we know the number of tiles per row, we divide that row evenly. We round up to make
     // sure all cells are included in the last tile of the row.
     mCellsPerTileX = divideRoundingUp(cellsToProcessX, mTilesPerRow);
 
     // We do the same thing for the Y direction.
-    size_t targetRowsPerTile = divideRoundingUp(targetCellsPerTile, mCellsPerTileX);
+    size_t targetRowsPerTile =
+            std::max(divideRoundingUp(targetCellsPerTile, mCellsPerTileX), minRowsPerTile);
     mTilesPerColumn = divideRoundingUp(cellsToProcessY, targetRowsPerTile);
     mCellsPerTileY = divideRoundingUp(cellsToProcessY, mTilesPerColumn);
 
@@ -72,6 +72,12 @@ class Task {
      * Whether the processor we're working on supports SIMD operations.
      */
     bool mUsesSimd = false;
+    /**
+     * The minimum number of rows a tile should have. Tasks that carry state from one row to the
+     * next, e.g. a cache of filtered input rows, can raise this so that the state is reused over
+     * more rows. The tiles get narrower to compensate. Set it in the constructor.
+     */
+    size_t mMinRowsPerTile = 1;
 
    private:
     /**
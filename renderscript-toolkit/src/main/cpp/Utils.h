@@ -20,6 +20,8 @@
 #include <android/log.h>
 #include <stddef.h>
 
+#include "RenderScriptToolkit.h"
+
 namespace renderscript {
 
 /* The Toolkit does not support floating point buffers but the original RenderScript Intrinsics
@@ -90,6 +92,16 @@ inline float convert(uchar i) {
     return (float)i;
 }
 
+template <>
+inline uchar convert(int i) {
+    return (uchar)i;
+}
+
+template <>
+inline int convert(uchar i) {
+    return (int)i;
+}
+
 inline int4 clamp(int4 amount, int low, int high) {
     int4 r;
     r.x = amount.x < low ? low : (amount.x > high ? high : amount.x);
@@ -130,6 +142,23 @@ inline float clamp(float amount, float low, float high) {
     return amount < low ? low : (amount > high ? high : amount);
 }
 
+/**
+ * Picks, lane by lane, a where condition is set and b elsewhere. condition is the result of a
+ * vector comparison, i.e. all bits set or all clear in each lane. There's no branch, so the
+ * compiler keeps the whole computation in vector registers.
+ */
+inline float4 select(int4 condition, float4 a, float4 b) {
+    return (float4)((condition & (int4)a) | (~condition & (int4)b));
+}
+
+inline float4 min(float4 a, float4 b) {
+    return select(a < b, a, b);
+}
+
+inline float4 max(float4 a, float4 b) {
+    return select(a > b, a, b);
+}
+
 #ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
 struct Restriction;
 
@@ -150,6 +179,36 @@ inline size_t paddedSize(size_t size) {
     return size == 3 ? 4 : size;
 }
 
+/**
+ * Describes where the planes of a buffer of the specified format are, as if they had been
+ * provided separately.
+ */
+RenderScriptToolkit::YuvPlanes yuvPlanesOf(const uint8_t* buffer, size_t sizeX, size_t sizeY,
+                                           RenderScriptToolkit::YuvFormat format);
+
+/**
+ * Returns the weights of red (kr) and blue (kb) in the luma of a YUV matrix. The weight of green
+ * is 1 - kr - kb.
+ */
+void yuvLumaWeights(RenderScriptToolkit::YuvMatrix matrix, float* kr, float* kb);
+
+/**
+ * Multiplies the color of length RGBA pixels by their alpha. in and out can be the same.
+ */
+void premultiplyRow(const uchar4* in, uchar4* out, size_t length);
+
+/**
+ * Divides the color of length premultiplied RGBA pixels by their alpha. Fully transparent pixels
+ * become transparent black. in and out can be the same.
+ */
+void unpremultiplyRow(const uchar4* in, uchar4* out, size_t length);
+
+/**
+ * Transforms length RGBA pixels using the 3D lookup table of lut3d, keeping their alpha.
+ */
+void lut3dRow(const uchar4* in, uchar4* out, size_t length, const uint8_t* cube,
+              int cubeSizeX, int cubeSizeY, int cubeSizeZ, bool usesSimd);
+
 }  // namespace renderscript
 
 #endif  // ANDROID_RENDERSCRIPT_TOOLKIT_UTILS_H
@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <vector>
 
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
@@ -28,88 +31,202 @@ inline size_t roundUpTo16(size_t val) {
     return (val + 15u) & ~15u;
 }
 
+using YuvPlanes = RenderScriptToolkit::YuvPlanes;
+
+YuvPlanes yuvPlanesOf(const uint8_t* input, size_t sizeX, size_t sizeY,
+                      RenderScriptToolkit::YuvFormat format) {
+    const size_t chromaSizeX = (sizeX + 1) / 2;
+    const size_t chromaSizeY = (sizeY + 1) / 2;
+    YuvPlanes planes{input, nullptr, nullptr, sizeX, 0};
+    switch (format) {
+        case RenderScriptToolkit::YuvFormat::NV21:
+            planes.rowStrideUV = chromaSizeX * 2;
+            planes.pixelStrideUV = 2;
+            planes.v = input + planes.rowStrideY * sizeY;
+            planes.u = planes.v + 1;
+            break;
+        case RenderScriptToolkit::YuvFormat::NV12:
+            planes.rowStrideUV = chromaSizeX * 2;
+            planes.pixelStrideUV = 2;
+            planes.u = input + planes.rowStrideY * sizeY;
+            planes.v = planes.u + 1;
+            break;
+        case RenderScriptToolkit::YuvFormat::YV12:
+            planes.rowStrideY = roundUpTo16(sizeX);
+            planes.rowStrideUV = roundUpTo16(planes.rowStrideY >> 1u);
+            planes.u = input + planes.rowStrideY * sizeY;
+            planes.v = planes.u + planes.rowStrideUV * chromaSizeY;
+            break;
+        case RenderScriptToolkit::YuvFormat::I420:
+            planes.rowStrideUV = chromaSizeX;
+            planes.u = input + planes.rowStrideY * sizeY;
+            planes.v = planes.u + planes.rowStrideUV * chromaSizeY;
+            break;
+        case RenderScriptToolkit::YuvFormat::P010:
+            planes.rowStrideY = sizeX * 2;
+            planes.pixelStrideY = 2;
+            planes.rowStrideUV = chromaSizeX * 4;
+            planes.pixelStrideUV = 4;
+            planes.bitsPerSample = 10;
+            planes.u = input + planes.rowStrideY * sizeY;
+            planes.v = planes.u + 2;
+            break;
+    }
+    return planes;
+}
+
+void yuvLumaWeights(RenderScriptToolkit::YuvMatrix matrix, float* kr, float* kb) {
+    switch (matrix) {
+        case RenderScriptToolkit::YuvMatrix::BT709:
+            *kr = 0.2126f;
+            *kb = 0.0722f;
+            break;
+        case RenderScriptToolkit::YuvMatrix::BT2020:
+            *kr = 0.2627f;
+            *kb = 0.0593f;
+            break;
+        case RenderScriptToolkit::YuvMatrix::BT601:
+        default:
+            *kr = 0.299f;
+            *kb = 0.114f;
+            break;
+    }
+}
+
+/**
+ * Reads the sample found offset bytes into a row. 8 bit samples are used as is. 16 bit samples
+ * are little endian P010 values, with the 10 significant bits in the high bits.
+ */
+template <typename Sample>
+inline int sampleAt(const uint8_t* row, size_t offset);
+
+template <>
+inline int sampleAt<uint8_t>(const uint8_t* row, size_t offset) {
+    return row[offset];
+}
+
+template <>
+inline int sampleAt<uint16_t>(const uint8_t* row, size_t offset) {
+    // The row stride may be odd, so don't assume the sample is aligned.
+    uint16_t sample;
+    memcpy(&sample, row + offset, sizeof(sample));
+    return sample >> 6;
+}
+
+/**
+ * The fixed point coefficients, scaled by 256, that convert 8 bit YUV samples to RGB:
+ *   R = y * (Y - offsetY) + vr * (V - 128)
+ *   G = y * (Y - offsetY) - ug * (U - 128) - vg * (V - 128)
+ *   B = y * (Y - offsetY) + ub * (U - 128)
+ */
+struct YuvCoefficients {
+    int y;
+    int vr;
+    int ug;
+    int vg;
+    int ub;
+    int offsetY;
+
+    bool operator==(const YuvCoefficients& other) const {
+        return y == other.y && vr == other.vr && ug == other.ug && vg == other.vg &&
+               ub == other.ub && offsetY == other.offsetY;
+    }
+};
+
+#if defined(ARCH_ARM_USE_INTRINSICS)
+// The coefficients baked in the assembly kernels.
+static constexpr YuvCoefficients kBt601LimitedCoefficients{298, 409, 100, 208, 516, 16};
+#endif
+
+/**
+ * Derives the coefficients from the luma weights of the matrix. Limited range samples are
+ * expanded from [16, 235] for luma and [16, 240] for chroma to the full [0, 255].
+ */
+static YuvCoefficients coefficientsOf(RenderScriptToolkit::YuvMatrix matrix,
+                                      RenderScriptToolkit::YuvRange range) {
+    float kr, kb;
+    yuvLumaWeights(matrix, &kr, &kb);
+    const float kg = 1.f - kr - kb;
+    const bool limited = range == RenderScriptToolkit::YuvRange::LIMITED;
+    const float scaleY = limited ? 255.f / 219.f : 1.f;
+    const float scaleUV = limited ? 255.f / 224.f : 1.f;
+    auto fixed = [](float f) { return static_cast<int>(f * 256.f + 0.5f); };
+    return YuvCoefficients{fixed(scaleY),
+                           fixed(2.f * (1.f - kr) * scaleUV),
+                           fixed(2.f * kb * (1.f - kb) / kg * scaleUV),
+                           fixed(2.f * kr * (1.f - kr) / kg * scaleUV),
+                           fixed(2.f * (1.f - kb) * scaleUV),
+                           limited ? 16 : 0};
+}
+
 class YuvToRgbTask : public Task {
     uchar4* mOut;
-    size_t mCstep;
-    size_t mStrideY;
-    size_t mStrideU;
-    size_t mStrideV;
-    const uchar* mInY;
-    const uchar* mInU;
-    const uchar* mInV;
-
-    void kernel(uchar4* out, uint32_t xstart, uint32_t xend, uint32_t currentY);
+    YuvPlanes mPlanes;
+    YuvCoefficients mCoefficients;
+
+    // Converts the pixels [x1, x2) of one row. The plane pointers are those of the row.
+    template <typename Sample>
+    void convertRow(uchar4* out, const uint8_t* y, const uint8_t* u, const uint8_t* v, size_t x1,
+                    size_t x2);
+    void convertRow8(uchar4* out, const uint8_t* y, const uint8_t* u, const uint8_t* v, size_t x1,
+                     size_t x2);
     // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
     void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
                      size_t endY) override;
 
    public:
-    YuvToRgbTask(const uint8_t* input, uint8_t* output, size_t sizeX, size_t sizeY,
-                 RenderScriptToolkit::YuvFormat format)
-        : Task{sizeX, sizeY, 4, false, nullptr}, mOut{reinterpret_cast<uchar4*>(output)} {
-        switch (format) {
-            case RenderScriptToolkit::YuvFormat::NV21:
-                mCstep = 2;
-                mStrideY = sizeX;
-                mStrideU = mStrideY;
-                mStrideV = mStrideY;
-                mInY = reinterpret_cast<const uchar*>(input);
-                mInV = reinterpret_cast<const uchar*>(input + mStrideY * sizeY);
-                mInU = mInV + 1;
-                break;
-            case RenderScriptToolkit::YuvFormat::YV12:
-                mCstep = 1;
-                mStrideY = roundUpTo16(sizeX);
-                mStrideU = roundUpTo16(mStrideY >> 1u);
-                mStrideV = mStrideU;
-                mInY = reinterpret_cast<const uchar*>(input);
-                mInU = reinterpret_cast<const uchar*>(input + mStrideY * sizeY);
-                mInV = mInU + mStrideV * sizeY / 2;
-                break;
-        }
-    }
+    YuvToRgbTask(const YuvPlanes& planes, uint8_t* output, size_t sizeX, size_t sizeY,
+                 RenderScriptToolkit::YuvMatrix matrix, RenderScriptToolkit::YuvRange range,
+                 const Restriction* restriction)
+        : Task{sizeX, sizeY, 4, false, restriction},
+          mOut{reinterpret_cast<uchar4*>(output)},
+          mPlanes{planes},
+          mCoefficients{coefficientsOf(matrix, range)} {}
 };
 
 void YuvToRgbTask::processData(int /* threadIndex */, size_t startX, size_t startY, size_t endX,
                                size_t endY) {
     for (size_t y = startY; y < endY; y++) {
-        size_t offset = mSizeX * y + startX;
-        uchar4* out = mOut + offset;
-        kernel(out, startX, endX, y);
+        const uint8_t* inY = mPlanes.y + y * mPlanes.rowStrideY;
+        const uint8_t* inU = mPlanes.u + (y >> 1) * mPlanes.rowStrideUV;
+        const uint8_t* inV = mPlanes.v + (y >> 1) * mPlanes.rowStrideUV;
+        uchar4* out = mOut + mSizeX * y + startX;
+        if (mPlanes.bitsPerSample == 10) {
+            convertRow<uint16_t>(out, inY, inU, inV, startX, endX);
+        } else {
+            convertRow8(out, inY, inU, inV, startX, endX);
+        }
     }
 }
 
-static uchar4 rsYuvToRGBA_uchar4(uchar y, uchar u, uchar v) {
-    int16_t Y = ((int16_t)y) - 16;
-    int16_t U = ((int16_t)u) - 128;
-    int16_t V = ((int16_t)v) - 128;
+template <typename Sample>
+void YuvToRgbTask::convertRow(uchar4* out, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                              size_t x1, size_t x2) {
+    // The coefficients are for 8 bit samples. Wider samples are scaled down by the final shift.
+    constexpr int kExtraBits = sizeof(Sample) == 1 ? 0 : 2;
+    constexpr int kShift = 8 + kExtraBits;
+    constexpr int kOffsetUV = 128 << kExtraBits;
+    const YuvCoefficients c = mCoefficients;
+    const int offsetY = c.offsetY << kExtraBits;
+    const size_t pixelStrideY = mPlanes.pixelStrideY;
+    const size_t pixelStrideUV = mPlanes.pixelStrideUV;
 
-    short4 p;
-    p.x = (Y * 298 + V * 409 + 128) >> 8;
-    p.y = (Y * 298 - U * 100 - V * 208 + 128) >> 8;
-    p.z = (Y * 298 + U * 516 + 128) >> 8;
-    p.w = 255;
-    if(p.x < 0) {
-        p.x = 0;
-    }
-    if(p.x > 255) {
-        p.x = 255;
-    }
-    if(p.y < 0) {
-        p.y = 0;
-    }
-    if(p.y > 255) {
-        p.y = 255;
-    }
-    if(p.z < 0) {
-        p.z = 0;
-    }
-    if(p.z > 255) {
-        p.z = 255;
+    size_t x = x1;
+    while (x < x2) {
+        const size_t cx = (x >> 1) * pixelStrideUV;
+        const int U = sampleAt<Sample>(u, cx) - kOffsetUV;
+        const int V = sampleAt<Sample>(v, cx) - kOffsetUV;
+        // Both pixels of a horizontal pair share their chroma.
+        const int4 chroma =
+                int4{V * c.vr, -U * c.ug - V * c.vg, U * c.ub, 0} + (1 << (kShift - 1));
+        const size_t pairEnd = std::min(x2, (x | 1) + 1);
+        for (; x < pairEnd; x++) {
+            const int Y = (sampleAt<Sample>(y, x * pixelStrideY) - offsetY) * c.y;
+            int4 p = clamp((Y + chroma) >> kShift, 0, 255);
+            p[3] = 255;
+            *out++ = convert<uchar4>(p);
+        }
     }
-
-    return (uchar4){static_cast<uchar>(p.x), static_cast<uchar>(p.y),
-                    static_cast<uchar>(p.z), static_cast<uchar>(p.w)};
 }
 
 extern "C" void rsdIntrinsicYuv_K(void *dst, const uchar *Y, const uchar *uv, uint32_t xstart,
@@ -119,120 +236,298 @@ extern "C" void rsdIntrinsicYuvR_K(void *dst, const uchar *Y, const uchar *uv, u
 extern "C" void rsdIntrinsicYuv2_K(void *dst, const uchar *Y, const uchar *u, const uchar *v,
                                    size_t xstart, size_t xend);
 
-void YuvToRgbTask::kernel(uchar4 *out, uint32_t xstart, uint32_t xend, uint32_t currentY) {
-    //ALOGI("kernel out %p, xstart=%u, xend=%u, currentY=%u", out, xstart, xend, currentY);
-
-    const uchar *y = mInY + (currentY * mStrideY);
-    const uchar *v = mInV + ((currentY >> 1) * mStrideV);
-    const uchar *u = mInU + ((currentY >> 1) * mStrideU);
-
-    //ALOGI("pinY %p, pinV %p, pinU %p", pinY, pinV, pinU);
-
-    uint32_t x1 = xstart;
-    uint32_t x2 = xend;
-
-    /*
-    ALOGE("pinY, %p, Y, %p, currentY, %d, strideY, %zu", pinY, y, currentY, mStrideY);
-    ALOGE("pinU, %p, U, %p, currentY, %d, strideU, %zu", pinU, u, currentY, mStrideU);
-    ALOGE("pinV, %p, V, %p, currentY, %d, strideV, %zu", pinV, v, currentY, mStrideV);
-    ALOGE("dimX, %d, dimY, %d", cp->alloc->mHal.drvState.lod[0].dimX,
-          cp->alloc->mHal.drvState.lod[0].dimY);
-    ALOGE("info->dim.x, %d, info->dim.y, %d", info->dim.x, info->dim.y);
-    uchar* pinY = (uchar*)mInY;
-    uchar* pinU = (uchar*)mInU;
-    uchar* pinV = (uchar*)mInV;
-    ALOGE("Y %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinY, pinY[0], pinY[1], pinY[2], pinY[3], pinY[4], pinY[5], pinY[6], pinY[7], pinY[8],
-          pinY[9], pinY[10], pinY[11], pinY[12], pinY[13], pinY[14], pinY[15]);
-    ALOGE("Y %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinY, pinY[16], pinY[17], pinY[18], pinY[19], pinY[20], pinY[21], pinY[22], pinY[23],
-          pinY[24], pinY[25], pinY[26], pinY[27], pinY[28], pinY[29], pinY[30], pinY[31]);
-    ALOGE("Y %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinY, pinY[32], pinY[33], pinY[34], pinY[35], pinY[36], pinY[37], pinY[38], pinY[39],
-          pinY[40], pinY[41], pinY[42], pinY[43], pinY[44], pinY[45], pinY[46], pinY[47]);
-
-    ALOGE("U %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinU, pinU[0], pinU[1], pinU[2], pinU[3], pinU[4], pinU[5], pinU[6], pinU[7], pinU[8],
-          pinU[9], pinU[10], pinU[11], pinU[12], pinU[13], pinU[14], pinU[15]);
-    ALOGE("U %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinU, pinU[16], pinU[17], pinU[18], pinU[19], pinU[20], pinU[21], pinU[22], pinU[23],
-          pinU[24], pinU[25], pinU[26], pinU[27], pinU[28], pinU[29], pinU[30], pinU[31]);
-    ALOGE("U %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinU, pinU[32], pinU[33], pinU[34], pinU[35], pinU[36], pinU[37], pinU[38], pinU[39],
-          pinU[40], pinU[41], pinU[42], pinU[43], pinU[44], pinU[45], pinU[46], pinU[47]);
-
-    ALOGE("V %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinV, pinV[0], pinV[1], pinV[2], pinV[3], pinV[4], pinV[5], pinV[6], pinV[7], pinV[8],
-          pinV[9], pinV[10], pinV[11], pinV[12], pinV[13], pinV[14], pinV[15]);
-    ALOGE("V %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinV, pinV[16], pinV[17], pinV[18], pinV[19], pinV[20], pinV[21], pinV[22], pinV[23],
-          pinV[24], pinV[25], pinV[26], pinV[27], pinV[28], pinV[29], pinV[30], pinV[31]);
-    ALOGE("V %p %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx "
-          "%02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx",
-          pinV, pinV[32], pinV[33], pinV[34], pinV[35], pinV[36], pinV[37], pinV[38], pinV[39],
-          pinV[40], pinV[41], pinV[42], pinV[43], pinV[44], pinV[45], pinV[46], pinV[47]);
-    */
-
-    /* If we start on an odd pixel then deal with it here and bump things along
-     * so that subsequent code can carry on with even-odd pairing assumptions.
-     */
-    if((x1 & 1) && (x2 > x1)) {
-        int cx = (x1 >> 1) * mCstep;
-        *out = rsYuvToRGBA_uchar4(y[x1], u[cx], v[cx]);
-        out++;
-        x1++;
-    }
-
+void YuvToRgbTask::convertRow8(uchar4* out, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                               size_t x1, size_t x2) {
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if((x2 > x1) && mUsesSimd) {
-        int32_t len = x2 - x1;
-        if (mCstep == 1) {
-            rsdIntrinsicYuv2_K(out, y, u, v, x1, x2);
-            x1 += len;
-            out += len;
-        } else if (mCstep == 2) {
-            // Check for proper interleave
-            intptr_t ipu = (intptr_t)u;
-            intptr_t ipv = (intptr_t)v;
-
-            if (ipu == (ipv + 1)) {
-                rsdIntrinsicYuv_K(out, y, v, x1, x2);
-                x1 += len;
-                out += len;
-            } else if (ipu == (ipv - 1)) {
-                rsdIntrinsicYuvR_K(out, y, u, x1, x2);
-                x1 += len;
-                out += len;
-            }
+    // The assembly kernels handle contiguous luma with planar or interleaved chroma, for the
+    // BT.601 limited range matrix only. They work on pairs of pixels starting on an even x.
+    if (mUsesSimd && mPlanes.pixelStrideY == 1 && mCoefficients == kBt601LimitedCoefficients &&
+        x2 > x1) {
+        if (x1 & 1) {
+            convertRow<uint8_t>(out, y, u, v, x1, x1 + 1);
+            out++;
+            x1++;
+        }
+        const size_t pairsEnd = x1 + ((x2 - x1) & ~size_t{1});
+        bool converted = true;
+        if (pairsEnd <= x1) {
+            converted = false;
+        } else if (mPlanes.pixelStrideUV == 1) {
+            rsdIntrinsicYuv2_K(out, y, u, v, x1, pairsEnd);
+        } else if (mPlanes.pixelStrideUV == 2 && u == v + 1) {
+            rsdIntrinsicYuv_K(out, y, v, x1, pairsEnd);
+        } else if (mPlanes.pixelStrideUV == 2 && v == u + 1) {
+            rsdIntrinsicYuvR_K(out, y, u, x1, pairsEnd);
+        } else {
+            converted = false;
+        }
+        if (converted) {
+            out += pairsEnd - x1;
+            x1 = pairsEnd;
         }
     }
 #endif
+    convertRow<uint8_t>(out, y, u, v, x1, x2);
+}
 
-    if(x2 > x1) {
-       // ALOGE("y %i  %i  %i", currentY, x1, x2);
-        while(x1 < x2) {
-            int cx = (x1 >> 1) * mCstep;
-            *out = rsYuvToRGBA_uchar4(y[x1], u[cx], v[cx]);
-            out++;
-            x1++;
-            *out = rsYuvToRGBA_uchar4(y[x1], u[cx], v[cx]);
-            out++;
-            x1++;
+/**
+ * The two samples that surround a position along one axis, and the weight of the second one,
+ * from 0 to 256. Positions outside of the plane use its edge.
+ */
+struct BilinearTap {
+    size_t first;
+    size_t second;
+    int weight;
+};
+
+static BilinearTap bilinearTap(float position, size_t size) {
+    if (position <= 0.f) {
+        return BilinearTap{0, 0, 0};
+    }
+    const size_t first = static_cast<size_t>(position);
+    if (first >= size - 1) {
+        return BilinearTap{size - 1, size - 1, 0};
+    }
+    const int weight = static_cast<int>((position - static_cast<float>(first)) * 256.f + 0.5f);
+    return BilinearTap{first, first + 1, weight};
+}
+
+// Returns the bilinear interpolation of four samples of a plane, scaled by 256.
+template <typename Sample>
+inline int sampleBilinear(const uint8_t* plane, size_t rowStride, size_t pixelStride,
+                          const BilinearTap& tx, const BilinearTap& ty) {
+    const uint8_t* row0 = plane + ty.first * rowStride;
+    const uint8_t* row1 = plane + ty.second * rowStride;
+    const int top = sampleAt<Sample>(row0, tx.first * pixelStride) * (256 - tx.weight) +
+                    sampleAt<Sample>(row0, tx.second * pixelStride) * tx.weight;
+    const int bottom = sampleAt<Sample>(row1, tx.first * pixelStride) * (256 - tx.weight) +
+                       sampleAt<Sample>(row1, tx.second * pixelStride) * tx.weight;
+    return (top * (256 - ty.weight) + bottom * ty.weight + 128) >> 8;
+}
+
+/**
+ * Converts YUV planes to RGB while resizing, rotating, and mirroring the image. Each output pixel
+ * is mapped back to a position of the source, where the Y, U, and V planes are sampled
+ * bilinearly, so the image is only converted once, at the output resolution.
+ *
+ * As the rotations are by multiples of 90 degrees, an output column always maps to the same
+ * source column, or source row when the image is turned sideways, and likewise for output rows.
+ * The taps are computed once per output column and per output row.
+ */
+class YuvToRgbTransformTask : public Task {
+    uchar4* mOut;
+    YuvPlanes mPlanes;
+    YuvCoefficients mCoefficients;
+    // True for the 90 and 270 degree rotations, when output rows come from source columns.
+    bool mSideways;
+    // The taps of the luma and chroma planes, for each output column and each output row.
+    std::vector<BilinearTap> mLumaTapsX;
+    std::vector<BilinearTap> mChromaTapsX;
+    std::vector<BilinearTap> mLumaTapsY;
+    std::vector<BilinearTap> mChromaTapsY;
+
+    // Converts the pixels [startX, endX) of the row y.
+    template <typename Sample>
+    void convertRow(uchar4* out, size_t startX, size_t endX, size_t y);
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    YuvToRgbTransformTask(const YuvPlanes& planes, size_t inputSizeX, size_t inputSizeY,
+                          uint8_t* output, size_t outputSizeX, size_t outputSizeY,
+                          RenderScriptToolkit::Rotation rotation, bool mirror,
+                          RenderScriptToolkit::YuvMatrix matrix,
+                          RenderScriptToolkit::YuvRange range, const Restriction* restriction);
+};
+
+/**
+ * Computes the taps of the output pixels [0, count), whose centers are at origin + i * step
+ * along a source axis of the specified size.
+ */
+static void computeTaps(float origin, float step, size_t count, size_t size,
+                        std::vector<BilinearTap>* lumaTaps, std::vector<BilinearTap>* chromaTaps) {
+    lumaTaps->resize(count);
+    chromaTaps->resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const float position = origin + static_cast<float>(i) * step;
+        const BilinearTap luma = bilinearTap(position, size);
+        (*lumaTaps)[i] = luma;
+        // Like yuvToRgb, each chroma sample is replicated over the 2x2 luma samples it covers,
+        // so the chroma is interpolated between the samples of the two luma taps. Without
+        // resizing, the output then matches yuvToRgb.
+        (*chromaTaps)[i] = BilinearTap{luma.first / 2, luma.second / 2, luma.weight};
+    }
+}
+
+YuvToRgbTransformTask::YuvToRgbTransformTask(
+        const YuvPlanes& planes, size_t inputSizeX, size_t inputSizeY, uint8_t* output,
+        size_t outputSizeX, size_t outputSizeY, RenderScriptToolkit::Rotation rotation,
+        bool mirror, RenderScriptToolkit::YuvMatrix matrix, RenderScriptToolkit::YuvRange range,
+        const Restriction* restriction)
+    : Task{outputSizeX, outputSizeY, 4, false, restriction},
+      mOut{reinterpret_cast<uchar4*>(output)},
+      mPlanes{planes},
+      mCoefficients{coefficientsOf(matrix, range)},
+      mSideways{rotation == RenderScriptToolkit::Rotation::CW_90 ||
+                rotation == RenderScriptToolkit::Rotation::CW_270} {
+    // The size of the source once rotated, which is what gets scaled to the output.
+    const size_t rotatedSizeX = mSideways ? inputSizeY : inputSizeX;
+    const size_t rotatedSizeY = mSideways ? inputSizeX : inputSizeY;
+    // Position (u, v) in the rotated source of the output pixel (x, y):
+    //   u = u0 + x * du, v = v0 + y * dv
+    float du = static_cast<float>(rotatedSizeX) / static_cast<float>(outputSizeX);
+    float dv = static_cast<float>(rotatedSizeY) / static_cast<float>(outputSizeY);
+    float u0 = 0.5f * du - 0.5f;
+    float v0 = 0.5f * dv - 0.5f;
+    if (mirror) {
+        u0 = static_cast<float>(rotatedSizeX) - 1.f - u0;
+        du = -du;
+    }
+    // Undo the rotation. Going clockwise, (u, v) comes from the source position
+    //   90: (v, lastY - u), 180: (lastX - u, lastY - v), 270: (lastX - v, u)
+    // so u is reversed for 90 and 180, and v for 180 and 270.
+    if (rotation == RenderScriptToolkit::Rotation::CW_90 ||
+        rotation == RenderScriptToolkit::Rotation::CW_180) {
+        u0 = static_cast<float>(rotatedSizeX) - 1.f - u0;
+        du = -du;
+    }
+    if (rotation == RenderScriptToolkit::Rotation::CW_180 ||
+        rotation == RenderScriptToolkit::Rotation::CW_270) {
+        v0 = static_cast<float>(rotatedSizeY) - 1.f - v0;
+        dv = -dv;
+    }
+    computeTaps(u0, du, outputSizeX, rotatedSizeX, &mLumaTapsX, &mChromaTapsX);
+    computeTaps(v0, dv, outputSizeY, rotatedSizeY, &mLumaTapsY, &mChromaTapsY);
+}
+
+void YuvToRgbTransformTask::processData(int /* threadIndex */, size_t startX, size_t startY,
+                                        size_t endX, size_t endY) {
+    for (size_t y = startY; y < endY; y++) {
+        uchar4* out = mOut + mSizeX * y + startX;
+        if (mPlanes.bitsPerSample == 10) {
+            convertRow<uint16_t>(out, startX, endX, y);
+        } else {
+            convertRow<uint8_t>(out, startX, endX, y);
         }
     }
 }
 
+template <typename Sample>
+void YuvToRgbTransformTask::convertRow(uchar4* out, size_t startX, size_t endX, size_t y) {
+    // The samples are interpolated with 8 more bits of precision, removed by the final shift.
+    constexpr int kExtraBits = sizeof(Sample) == 1 ? 0 : 2;
+    constexpr int kShift = 16 + kExtraBits;
+    constexpr int kOffsetUV = 128 << (kExtraBits + 8);
+    const YuvCoefficients c = mCoefficients;
+    const int offsetY = c.offsetY << (kExtraBits + 8);
+
+    const BilinearTap& lumaRow = mLumaTapsY[y];
+    const BilinearTap& chromaRow = mChromaTapsY[y];
+    for (size_t x = startX; x < endX; x++) {
+        // Sideways, the output row indexes the source columns and the output column the rows.
+        const BilinearTap& lumaX = mSideways ? lumaRow : mLumaTapsX[x];
+        const BilinearTap& lumaY = mSideways ? mLumaTapsX[x] : lumaRow;
+        const BilinearTap& chromaX = mSideways ? chromaRow : mChromaTapsX[x];
+        const BilinearTap& chromaY = mSideways ? mChromaTapsX[x] : chromaRow;
+
+        const int Y = sampleBilinear<Sample>(mPlanes.y, mPlanes.rowStrideY, mPlanes.pixelStrideY,
+                                             lumaX, lumaY) - offsetY;
+        const int U = sampleBilinear<Sample>(mPlanes.u, mPlanes.rowStrideUV,
+                                             mPlanes.pixelStrideUV, chromaX, chromaY) - kOffsetUV;
+        const int V = sampleBilinear<Sample>(mPlanes.v, mPlanes.rowStrideUV,
+                                             mPlanes.pixelStrideUV, chromaX, chromaY) - kOffsetUV;
+        const int4 chroma =
+                int4{V * c.vr, -U * c.ug - V * c.vg, U * c.ub, 0} + (1 << (kShift - 1));
+        int4 p = clamp((Y * c.y + chroma) >> kShift, 0, 255);
+        p[3] = 255;
+        *out++ = convert<uchar4>(p);
+    }
+}
+
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+static bool validPlanes(const YuvPlanes& planes, size_t sizeX) {
+    if (planes.bitsPerSample != 8 && planes.bitsPerSample != 10) {
+        ALOGE("The YUV samples should be 8 or 10 bits. %zu provided.", planes.bitsPerSample);
+        return false;
+    }
+    const size_t sampleSize = planes.bitsPerSample == 8 ? 1 : 2;
+    if (planes.pixelStrideY < sampleSize || planes.pixelStrideUV < sampleSize) {
+        ALOGE("The YUV pixel strides should be at least %zu. %zu and %zu provided.", sampleSize,
+              planes.pixelStrideY, planes.pixelStrideUV);
+        return false;
+    }
+    if (planes.rowStrideY < sizeX * planes.pixelStrideY ||
+        planes.rowStrideUV < (sizeX + 1) / 2 * planes.pixelStrideUV) {
+        ALOGE("The YUV row strides are too small for a width of %zu. %zu and %zu provided.",
+              sizeX, planes.rowStrideY, planes.rowStrideUV);
+        return false;
+    }
+    return true;
+}
+
+static bool validMatrix(RenderScriptToolkit::YuvMatrix matrix) {
+    if (matrix != RenderScriptToolkit::YuvMatrix::BT601 &&
+        matrix != RenderScriptToolkit::YuvMatrix::BT709 &&
+        matrix != RenderScriptToolkit::YuvMatrix::BT2020) {
+        ALOGE("Unknown YUV matrix %d.", static_cast<int>(matrix));
+        return false;
+    }
+    return true;
+}
+#endif
+
 void RenderScriptToolkit::yuvToRgb(const uint8_t* input, uint8_t* output, size_t sizeX,
-                                   size_t sizeY, YuvFormat format) {
-    YuvToRgbTask task(input, output, sizeX, sizeY, format);
+                                   size_t sizeY, YuvFormat format, YuvMatrix matrix,
+                                   YuvRange range, const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (format != YuvFormat::NV21 && format != YuvFormat::YV12 && format != YuvFormat::NV12 &&
+        format != YuvFormat::I420 && format != YuvFormat::P010) {
+        ALOGE("Unknown YUV format %d.", static_cast<int>(format));
+        return;
+    }
+#endif
+    yuvToRgb(yuvPlanesOf(input, sizeX, sizeY, format), output, sizeX, sizeY, matrix, range,
+             restriction);
+}
+
+void RenderScriptToolkit::yuvToRgb(const YuvPlanes& planes, uint8_t* output, size_t sizeX,
+                                   size_t sizeY, YuvMatrix matrix, YuvRange range,
+                                   const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction) || !validMatrix(matrix) ||
+        !validPlanes(planes, sizeX)) {
+        return;
+    }
+#endif
+
+    YuvToRgbTask task(planes, output, sizeX, sizeY, matrix, range, restriction);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::yuvToRgb(const YuvPlanes& planes, size_t inputSizeX,
+                                   size_t inputSizeY, uint8_t* output, size_t outputSizeX,
+                                   size_t outputSizeY, Rotation rotation, bool mirror,
+                                   YuvMatrix matrix, YuvRange range,
+                                   const Restriction* restriction) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, outputSizeX, outputSizeY, restriction) ||
+        !validMatrix(matrix) || !validPlanes(planes, inputSizeX)) {
+        return;
+    }
+    if (inputSizeX == 0 || inputSizeY == 0) {
+        ALOGE("The input image should not be empty. %zu x %zu provided.", inputSizeX, inputSizeY);
+        return;
+    }
+    if (rotation != Rotation::NONE && rotation != Rotation::CW_90 &&
+        rotation != Rotation::CW_180 && rotation != Rotation::CW_270) {
+        ALOGE("Unsupported rotation %d.", static_cast<int>(rotation));
+        return;
+    }
+#endif
+
+    YuvToRgbTransformTask task(planes, inputSizeX, inputSizeY, output, outputSizeX, outputSizeY,
+                               rotation, mirror, matrix, range, restriction);
     processor->doTask(&task);
 }
 
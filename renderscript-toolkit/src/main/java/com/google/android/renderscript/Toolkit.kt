@@ -17,7 +17,12 @@
 package com.google.android.renderscript
 
 import android.graphics.Bitmap
+import android.graphics.ImageFormat
+import android.hardware.DataSpace
+import android.media.Image
+import android.os.Build
 import java.lang.IllegalArgumentException
+import java.nio.ByteBuffer
 
 // This string is used for error messages.
 private const val externalName = "RenderScript Toolkit"
@@ -53,11 +58,14 @@ object Toolkit {
      *
      * Blends a source buffer and a destination buffer, placing the result in the destination
      * buffer. The blending is done pairwise between two corresponding RGBA values found in
-     * each buffer. The mode parameter specifies one of fifteen supported blending operations.
+     * each buffer. The mode parameter specifies one of twenty-five supported blending operations.
      * See {@link BlendingMode}.
      *
      * A variant of this method is also available to blend Bitmaps.
      *
+     * The source can be faded by an opacity and by a mask, one byte per pixel, before being
+     * blended. This composites a layer with its opacity and layer mask in one pass.
+     *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
      * of each buffer. If provided, the range must be wholly contained with the dimensions
      * described by sizeX and sizeY.
@@ -71,6 +79,9 @@ object Toolkit {
      * @param sizeX The width of both buffers, as a number of RGBA values.
      * @param sizeY The height of both buffers, as a number of RGBA values.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param opacity How much of the source is used, from 0 to 1.
+     * @param maskArray When not null, sizeX * sizeY bytes that scale the source, 255 being opaque.
+     * @param alphaType How both buffers store their alpha. See [AlphaType].
      */
     @JvmOverloads
     fun blend(
@@ -79,7 +90,10 @@ object Toolkit {
         destArray: ByteArray,
         sizeX: Int,
         sizeY: Int,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        opacity: Float = 1f,
+        maskArray: ByteArray? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
     ) {
         require(sourceArray.size >= sizeX * sizeY * 4) {
             "$externalName blend. sourceArray is too small for the given dimensions. " +
@@ -89,9 +103,27 @@ object Toolkit {
             "$externalName blend. sourceArray is too small for the given dimensions. " +
                     "$sizeX*$sizeY*4 < ${sourceArray.size}."
         }
+        require(opacity in 0f..1f) {
+            "$externalName blend. The opacity should be between 0 and 1. $opacity provided."
+        }
+        require(maskArray == null || maskArray.size >= sizeX * sizeY) {
+            "$externalName blend. maskArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY < ${maskArray?.size}."
+        }
         validateRestriction("blend", sizeX, sizeY, restriction)
 
-        nativeBlend(nativeHandle, mode.value, sourceArray, destArray, sizeX, sizeY, restriction)
+        nativeBlend(
+            nativeHandle,
+            mode.value,
+            sourceArray,
+            destArray,
+            sizeX,
+            sizeY,
+            opacity,
+            maskArray,
+            alphaType.value,
+            restriction
+        )
     }
 
     /**
@@ -99,13 +131,18 @@ object Toolkit {
      *
      * Blends a source bitmap and a destination bitmap, placing the result in the destination
      * bitmap. The blending is done pairwise between two corresponding RGBA values found in
-     * each bitmap. The mode parameter specify one of fifteen supported blending operations.
+     * each bitmap. The mode parameter specify one of twenty-five supported blending operations.
      * See {@link BlendingMode}.
      *
+     * The source can be faded by an opacity and by an ALPHA_8 mask bitmap of the same size
+     * before being blended.
+     *
      * A variant of this method is available to blend ByteArrays.
      *
      * The bitmaps should have identical width and height, and have a config of ARGB_8888.
      * Bitmaps with a stride different than width * vectorSize are not currently supported.
+     * Unpremultiplied bitmaps are premultiplied on the fly, so both bitmaps should be either
+     * premultiplied or not.
      *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
      * of each bitmap. If provided, the range must be wholly contained with the dimensions
@@ -115,13 +152,17 @@ object Toolkit {
      * @param sourceBitmap The RGBA input buffer.
      * @param destBitmap The destination buffer. Used for input and output.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param opacity How much of the source is used, from 0 to 1.
+     * @param maskBitmap When not null, an ALPHA_8 bitmap that scales the source.
      */
     @JvmOverloads
     fun blend(
         mode: BlendingMode,
         sourceBitmap: Bitmap,
         destBitmap: Bitmap,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        opacity: Float = 1f,
+        maskBitmap: Bitmap? = null
     ) {
         validateBitmap("blend", sourceBitmap)
         validateBitmap("blend", destBitmap)
@@ -137,9 +178,101 @@ object Toolkit {
             "RenderScript Toolkit blend. Source and destination bitmaps should have the same " +
                     "config. ${sourceBitmap.config} and ${destBitmap.config} provided."
         }
+        require(sourceBitmap.isPremultiplied == destBitmap.isPremultiplied) {
+            "$externalName blend. Source and destination bitmaps should both be premultiplied " +
+                    "or both be unpremultiplied."
+        }
+        require(opacity in 0f..1f) {
+            "$externalName blend. The opacity should be between 0 and 1. $opacity provided."
+        }
+        if (maskBitmap != null) {
+            validateBitmap("blend", maskBitmap)
+            require(
+                maskBitmap.config == Bitmap.Config.ALPHA_8 &&
+                        maskBitmap.width == sourceBitmap.width &&
+                        maskBitmap.height == sourceBitmap.height
+            ) {
+                "$externalName blend. The mask should be an ALPHA_8 bitmap of the same size " +
+                        "as the source. ${maskBitmap.config} " +
+                        "${maskBitmap.width}x${maskBitmap.height} provided."
+            }
+        }
         validateRestriction("blend", sourceBitmap.width, sourceBitmap.height, restriction)
 
-        nativeBlendBitmap(nativeHandle, mode.value, sourceBitmap, destBitmap, restriction)
+        nativeBlendBitmap(
+            nativeHandle,
+            mode.value,
+            sourceBitmap,
+            destBitmap,
+            opacity,
+            maskBitmap,
+            alphaTypeOf(destBitmap).value,
+            restriction
+        )
+    }
+
+    /**
+     * Composites a stack of layers into a destination bitmap.
+     *
+     * The layers are blended into the destination in order, the first layer being the bottom
+     * one. Each layer is faded by its opacity and mask, then blended using its mode, like
+     * [blend] would. A layer only affects the pixels of the destination it covers.
+     *
+     * This is equivalent to calling blend once per layer, but the destination is read and
+     * written only once, and the parts of the layers that are fully transparent are skipped.
+     *
+     * All bitmaps should have a config of ARGB_8888, except the masks which should be ALPHA_8.
+     * Bitmaps with a stride different than width * vectorSize are not currently supported.
+     *
+     * @param layers The layers to composite, bottom first.
+     * @param destBitmap The destination bitmap. Used for input and output.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    @JvmOverloads
+    fun composite(
+        layers: List<CompositeLayer>,
+        destBitmap: Bitmap,
+        restriction: Range2d? = null
+    ) {
+        validateBitmap("composite", destBitmap, alphaAllowed = false)
+        for (layer in layers) {
+            validateBitmap("composite", layer.bitmap, alphaAllowed = false)
+            require(layer.opacity in 0f..1f) {
+                "$externalName composite. The opacity should be between 0 and 1. " +
+                        "${layer.opacity} provided."
+            }
+            val mask = layer.mask
+            if (mask != null) {
+                validateBitmap("composite", mask)
+                require(
+                    mask.config == Bitmap.Config.ALPHA_8 &&
+                            mask.width == layer.bitmap.width &&
+                            mask.height == layer.bitmap.height
+                ) {
+                    "$externalName composite. The mask should be an ALPHA_8 bitmap of the same " +
+                            "size as its layer. ${mask.config} ${mask.width}x${mask.height} " +
+                            "provided."
+                }
+            }
+        }
+        validateRestriction("composite", destBitmap, restriction)
+
+        nativeCompositeBitmap(
+            nativeHandle,
+            layers.map { it.bitmap }.toTypedArray(),
+            layers.map { it.mask }.toTypedArray(),
+            IntArray(layers.size * 3) { i ->
+                val layer = layers[i / 3]
+                when (i % 3) {
+                    0 -> layer.offsetX
+                    1 -> layer.offsetY
+                    else -> layer.mode.value
+                }
+            },
+            FloatArray(layers.size) { layers[it].opacity },
+            destBitmap,
+            restriction
+        )
     }
 
     /**
@@ -170,6 +303,7 @@ object Toolkit {
      * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
      * @param radius The radius of the pixels used to blur, a value from 1 to 25.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaType How the RGBA buffers store their alpha. See [AlphaType].
      * @return The blurred pixels, a ByteArray of size.
      */
     @JvmOverloads
@@ -179,7 +313,8 @@ object Toolkit {
         sizeX: Int,
         sizeY: Int,
         radius: Int = 5,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
     ): ByteArray {
         require(vectorSize == 1 || vectorSize == 4) {
             "$externalName blur. The vectorSize should be 1 or 4. $vectorSize provided."
@@ -195,7 +330,15 @@ object Toolkit {
 
         val outputArray = ByteArray(inputArray.size)
         nativeBlur(
-            nativeHandle, inputArray, vectorSize, sizeX, sizeY, radius, outputArray, restriction
+            nativeHandle,
+            inputArray,
+            vectorSize,
+            sizeX,
+            sizeY,
+            radius,
+            outputArray,
+            alphaType.value,
+            restriction
         )
         return outputArray
     }
@@ -213,7 +356,7 @@ object Toolkit {
      *
      * This method supports input Bitmap of config ARGB_8888 and ALPHA_8. Bitmaps with a stride
      * different than width * vectorSize are not currently supported. The returned Bitmap has the
-     * same config.
+     * same config, and is premultiplied if the input is.
      *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
      * of each buffer. If provided, the range must be wholly contained with the dimensions
@@ -234,7 +377,14 @@ object Toolkit {
         validateRestriction("blur", inputBitmap.width, inputBitmap.height, restriction)
 
         val outputBitmap = createCompatibleBitmap(inputBitmap)
-        nativeBlurBitmap(nativeHandle, inputBitmap, outputBitmap, radius, restriction)
+        nativeBlurBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            radius,
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
         return outputBitmap
     }
 
@@ -423,14 +573,335 @@ object Toolkit {
         return outputBitmap
     }
 
+    /**
+     * Convert an image from one color space to another.
+     *
+     * Each color space is stored in the first three bytes of an RGBA pixel, the alpha being kept.
+     * See [ColorSpace] for the byte encoding of each space. The colors are taken as is, i.e.
+     * premultiplied pixels should be unpremultiplied first.
+     *
+     * An optional [Range2d] can be set to restrict the operation to a rectangular subset of
+     * each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param inputArray The RGBA buffer of the image to be converted.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param from The color space of the input.
+     * @param to The color space of the output.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted buffer.
+     */
+    @JvmOverloads
+    fun convertColorSpace(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        from: ColorSpace,
+        to: ColorSpace,
+        restriction: Range2d? = null
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName convertColorSpace. inputArray is too small for the given " +
+                    "dimensions. $sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validateRestriction("convertColorSpace", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativeConvertColorSpace(
+            nativeHandle,
+            inputArray,
+            sizeX,
+            sizeY,
+            outputArray,
+            from.value,
+            to.value,
+            restriction
+        )
+        return outputArray
+    }
+
+    /**
+     * Adjust an sRGB image in another color space.
+     *
+     * Each pixel is converted to the color space, where each channel c becomes
+     * c * scale + offset, then converted back to sRGB. The converted image is never stored, so
+     * this costs a single pass. For example, in [ColorSpace.HSV], an offset of 30 on the first
+     * channel rotates the hues by 30 degrees and a scale of 1.2 on the second one increases the
+     * saturation. In [ColorSpace.LAB], an offset on the third channel warms or cools the image.
+     *
+     * The channels are in natural units: hue in degrees, saturation, value, lightness, and
+     * linear values from 0 to 1, L from 0 to 100, and a and b from about -128 to 127. The hue
+     * wraps around, and the other channels are clamped to their range.
+     *
+     * @param inputArray The RGBA buffer of the image to be adjusted.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param space The color space in which to adjust the channels.
+     * @param scale Three factors, one per channel of the color space.
+     * @param offset Three values added to the channels after scaling.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaType How the buffer stores its alpha.
+     * @return The adjusted buffer.
+     */
+    @JvmOverloads
+    fun adjustInColorSpace(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        space: ColorSpace,
+        scale: FloatArray,
+        offset: FloatArray,
+        restriction: Range2d? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName adjustInColorSpace. inputArray is too small for the given " +
+                    "dimensions. $sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        require(scale.size == 3 && offset.size == 3) {
+            "$externalName adjustInColorSpace. scale and offset should have 3 entries. " +
+                    "${scale.size} and ${offset.size} provided."
+        }
+        validateRestriction("adjustInColorSpace", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativeAdjustInColorSpace(
+            nativeHandle,
+            inputArray,
+            sizeX,
+            sizeY,
+            outputArray,
+            space.value,
+            scale,
+            offset,
+            alphaType.value,
+            restriction
+        )
+        return outputArray
+    }
+
+    /**
+     * Adjust a Bitmap in another color space.
+     *
+     * See the ByteArray variant of adjustInColorSpace. The Bitmap must be ARGB_8888, and its
+     * premultiplied alpha is handled on the fly.
+     *
+     * @param inputBitmap The image to be adjusted.
+     * @param space The color space in which to adjust the channels.
+     * @param scale Three factors, one per channel of the color space.
+     * @param offset Three values added to the channels after scaling.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The adjusted Bitmap.
+     */
+    @JvmOverloads
+    fun adjustInColorSpace(
+        inputBitmap: Bitmap,
+        space: ColorSpace,
+        scale: FloatArray,
+        offset: FloatArray,
+        restriction: Range2d? = null
+    ): Bitmap {
+        validateBitmap("adjustInColorSpace", inputBitmap, alphaAllowed = false)
+        require(scale.size == 3 && offset.size == 3) {
+            "$externalName adjustInColorSpace. scale and offset should have 3 entries. " +
+                    "${scale.size} and ${offset.size} provided."
+        }
+        validateRestriction("adjustInColorSpace", inputBitmap, restriction)
+
+        val outputBitmap = createCompatibleBitmap(inputBitmap)
+        nativeAdjustInColorSpaceBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            space.value,
+            scale,
+            offset,
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
+        return outputBitmap
+    }
+
+    /**
+     * Apply the adjustment filters of the OpenGL editor in a single pass.
+     *
+     * Computes, without a GL context, what the chain of shaders of ComposeAdjustImageFilter
+     * outputs, with the standalone tone, color temperature, and clarity filters. See
+     * [Adjustments] for the filters and the order in which they're applied. Like the frame
+     * buffers between the shaders, the colors are rounded to 8 bits after each filter, so the
+     * result matches the GPU to within rounding.
+     *
+     * An optional [Range2d] can be set to restrict the operation to a rectangular subset of
+     * each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param inputArray The RGBA buffer of the image to be adjusted.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param adjustments The strength of each filter.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaType How the buffer stores its alpha.
+     * @return The adjusted buffer.
+     */
+    @JvmOverloads
+    fun adjustmentChain(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        adjustments: Adjustments,
+        restriction: Range2d? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName adjustmentChain. inputArray is too small for the given " +
+                    "dimensions. $sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validateAdjustments(adjustments)
+        validateRestriction("adjustmentChain", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativeAdjustmentChain(
+            nativeHandle,
+            inputArray,
+            sizeX,
+            sizeY,
+            outputArray,
+            adjustments.toFloatArray(),
+            alphaType.value,
+            restriction
+        )
+        return outputArray
+    }
+
+    /**
+     * Apply the adjustment filters of the OpenGL editor to a Bitmap in a single pass.
+     *
+     * See the ByteArray variant of adjustmentChain. The Bitmap must be ARGB_8888.
+     *
+     * @param inputBitmap The image to be adjusted.
+     * @param adjustments The strength of each filter.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The adjusted Bitmap.
+     */
+    @JvmOverloads
+    fun adjustmentChain(
+        inputBitmap: Bitmap,
+        adjustments: Adjustments,
+        restriction: Range2d? = null
+    ): Bitmap {
+        validateBitmap("adjustmentChain", inputBitmap, alphaAllowed = false)
+        validateAdjustments(adjustments)
+        validateRestriction("adjustmentChain", inputBitmap, restriction)
+
+        val outputBitmap = createCompatibleBitmap(inputBitmap)
+        nativeAdjustmentChainBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            adjustments.toFloatArray(),
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
+        return outputBitmap
+    }
+
+    /**
+     * Apply the AdjustImage shader of the OpenGL editor in a single pass.
+     *
+     * Computes, without a GL context, what AdjustImageFilter outputs for an AdjustImageInfo
+     * with the same values. Only the brightness, contrast, saturation, exposure, highlights,
+     * shadows, temperature, hue, sharpness, and vignette of [Adjustments] are used, the others
+     * must be left at their default. This shader differs from the chain of [adjustmentChain]
+     * in its saturation, exposure, and contrast, and sharpens first.
+     *
+     * The active adjustments are compiled into a short kernel: the per channel curves become
+     * lookup tables and the linear steps color matrices, so e.g. brightness, contrast, and
+     * exposure together cost a single table lookup per channel.
+     *
+     * @param inputArray The RGBA buffer of the image to be adjusted.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param adjustments The strength of each adjustment.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaType How the buffer stores its alpha.
+     * @return The adjusted buffer.
+     */
+    @JvmOverloads
+    fun adjustImage(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        adjustments: Adjustments,
+        restriction: Range2d? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName adjustImage. inputArray is too small for the given " +
+                    "dimensions. $sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validateAdjustImage(adjustments)
+        validateRestriction("adjustImage", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativeAdjustImage(
+            nativeHandle,
+            inputArray,
+            sizeX,
+            sizeY,
+            outputArray,
+            adjustments.toFloatArray(),
+            alphaType.value,
+            restriction
+        )
+        return outputArray
+    }
+
+    /**
+     * Apply the AdjustImage shader of the OpenGL editor to a Bitmap in a single pass.
+     *
+     * See the ByteArray variant of adjustImage. The Bitmap must be ARGB_8888.
+     *
+     * @param inputBitmap The image to be adjusted.
+     * @param adjustments The strength of each adjustment.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The adjusted Bitmap.
+     */
+    @JvmOverloads
+    fun adjustImage(
+        inputBitmap: Bitmap,
+        adjustments: Adjustments,
+        restriction: Range2d? = null
+    ): Bitmap {
+        validateBitmap("adjustImage", inputBitmap, alphaAllowed = false)
+        validateAdjustImage(adjustments)
+        validateRestriction("adjustImage", inputBitmap, restriction)
+
+        val outputBitmap = createCompatibleBitmap(inputBitmap)
+        nativeAdjustImageBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            adjustments.toFloatArray(),
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
+        return outputBitmap
+    }
+
     /**
      * Convolve a ByteArray.
      *
-     * Applies a 3x3 or 5x5 convolution to the input array using the provided coefficients.
+     * Applies a square convolution to the input array using the provided coefficients.
      * A variant of this method is available to convolve Bitmaps.
      *
-     * For 3x3 convolutions, 9 coefficients must be provided. For 5x5, 25 coefficients are needed.
-     * The coefficients should be provided in row-major format.
+     * The kernel can be of any odd size up to 25x25. For 3x3 convolutions, 9 coefficients must be
+     * provided, for 5x5, 25 coefficients, for 7x7, 49, and so on. The coefficients should be
+     * provided in row-major format.
+     *
+     * Kernels that are the product of a column and a row, e.g. box and Gaussian kernels, are
+     * applied as two one-dimensional passes. Other kernels have their coefficients rounded to
+     * multiples of 1/256 unless floatAccumulation is set.
      *
      * When the square extends past the edge, the edge values will be used as replacement for the
      * values that's are off boundary.
@@ -452,8 +923,9 @@ object Toolkit {
      * @param vectorSize The number of bytes in each cell, a value from 1 to 4.
      * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
      * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
-     * @param coefficients A FloatArray of size 9 or 25, containing the multipliers.
+     * @param coefficients A FloatArray of size 9, 25, 49, ..., 625, containing the multipliers.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param floatAccumulation Whether to compute non-separable kernels in floating point.
      * @return The convolved array.
      */
     @JvmOverloads
@@ -463,7 +935,8 @@ object Toolkit {
         sizeX: Int,
         sizeY: Int,
         coefficients: FloatArray,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        floatAccumulation: Boolean = false
     ): ByteArray {
         require(vectorSize in 1..4) {
             "$externalName convolve. The vectorSize should be between 1 and 4. " +
@@ -473,10 +946,7 @@ object Toolkit {
             "$externalName convolve. inputArray is too small for the given dimensions. " +
                     "$sizeX*$sizeY*$vectorSize < ${inputArray.size}."
         }
-        require(coefficients.size == 9 || coefficients.size == 25) {
-            "$externalName convolve. Only 3x3 or 5x5 convolutions are supported. " +
-                    "${coefficients.size} coefficients provided."
-        }
+        val kernelSize = convolveKernelSize(coefficients)
         validateRestriction("convolve", sizeX, sizeY, restriction)
 
         val outputArray = ByteArray(inputArray.size)
@@ -488,6 +958,8 @@ object Toolkit {
             sizeY,
             outputArray,
             coefficients,
+            kernelSize,
+            floatAccumulation,
             restriction
         )
         return outputArray
@@ -496,12 +968,17 @@ object Toolkit {
     /**
      * Convolve a Bitmap.
      *
-     * Applies a 3x3 or 5x5 convolution to the input Bitmap using the provided coefficients.
+     * Applies a square convolution to the input Bitmap using the provided coefficients.
      * A variant of this method is available to convolve ByteArrays. Bitmaps with a stride different
      * than width * vectorSize are not currently supported.
      *
-     * For 3x3 convolutions, 9 coefficients must be provided. For 5x5, 25 coefficients are needed.
-     * The coefficients should be provided in row-major format.
+     * The kernel can be of any odd size up to 25x25. For 3x3 convolutions, 9 coefficients must be
+     * provided, for 5x5, 25 coefficients, for 7x7, 49, and so on. The coefficients should be
+     * provided in row-major format.
+     *
+     * Kernels that are the product of a column and a row, e.g. box and Gaussian kernels, are
+     * applied as two one-dimensional passes. Other kernels have their coefficients rounded to
+     * multiples of 1/256 unless floatAccumulation is set.
      *
      * Each input cell can either be represented by one to four bytes. Each byte is multiplied
      * and accumulated independently of the other bytes of the cell.
@@ -512,25 +989,32 @@ object Toolkit {
      * section that's not convolved all set to 0. This is to stay compatible with RenderScript.
      *
      * @param inputBitmap The image to be blurred.
-     * @param coefficients A FloatArray of size 9 or 25, containing the multipliers.
+     * @param coefficients A FloatArray of size 9, 25, 49, ..., 625, containing the multipliers.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param floatAccumulation Whether to compute non-separable kernels in floating point.
      * @return The convolved Bitmap.
      */
     @JvmOverloads
     fun convolve(
         inputBitmap: Bitmap,
         coefficients: FloatArray,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        floatAccumulation: Boolean = false
     ): Bitmap {
         validateBitmap("convolve", inputBitmap)
-        require(coefficients.size == 9 || coefficients.size == 25) {
-            "$externalName convolve. Only 3x3 or 5x5 convolutions are supported. " +
-                    "${coefficients.size} coefficients provided."
-        }
+        val kernelSize = convolveKernelSize(coefficients)
         validateRestriction("convolve", inputBitmap, restriction)
 
         val outputBitmap = createCompatibleBitmap(inputBitmap)
-        nativeConvolveBitmap(nativeHandle, inputBitmap, outputBitmap, coefficients, restriction)
+        nativeConvolveBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            coefficients,
+            kernelSize,
+            floatAccumulation,
+            restriction
+        )
         return outputBitmap
     }
 
@@ -940,41 +1424,322 @@ object Toolkit {
     }
 
     /**
-     * Resize an image.
-     *
-     * Resizes an image using bicubic interpolation.
-     *
-     * This method supports elements of 1 to 4 bytes in length. Each byte of the element is
-     * interpolated independently from the others.
-     *
-     * An optional range parameter can be set to restrict the operation to a rectangular subset
-     * of the output buffer. The corresponding scaled range of the input will be used. If provided,
-     * the range must be wholly contained with the dimensions described by outputSizeX and
-     * outputSizeY.
-     *
-     * The input and output arrays have a row-major layout. The input array should be
-     * large enough for sizeX * sizeY * vectorSize bytes.
+     * Convert a LUT image made of tiles into a cube for lut3d.
+     *
+     * The LUT image of LUTImageFilter is 512x512, made of 8x8 tiles of 64x64 entries. Each tile
+     * is for one blue level, left to right then top to bottom, and within a tile the red level
+     * increases to the right and the green level downwards. Other sizes of this layout, like
+     * 64x64 images of 4x4 tiles or 4096x64 strips, are accepted as long as the image holds
+     * cubeSize^3 entries in tiles of cubeSize x cubeSize.
+     *
+     * lut3d with the returned cube renders what the LUT shader does. The intensity of the
+     * filter is baked into the cube, so that rendering costs the same at any intensity.
+     * Converting is meant to be done once per LUT and intensity: keep the returned cube and
+     * reuse it for every image or thumbnail the LUT is applied to.
+     *
+     * @param inputArray The RGBA buffer of the LUT image.
+     * @param sizeX The width of the LUT image.
+     * @param sizeY The height of the LUT image.
+     * @param intensity How much of the LUT is applied, between 0 and 1.
+     * @return The cube, with red along X, green along Y, and blue along Z.
+     */
+    @JvmOverloads
+    fun lut3dFromTiles(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        intensity: Float = 1f
+    ): Rgba3dArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName lut3dFromTiles. inputArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        val cubeSize = validateTiledLut(sizeX, sizeY, intensity)
+
+        val cube = ByteArray(cubeSize * cubeSize * cubeSize * 4)
+        nativeLut3dFromTiles(nativeHandle, inputArray, cube, sizeX, sizeY, intensity)
+        return Rgba3dArray(cube, cubeSize, cubeSize, cubeSize)
+    }
+
+    /**
+     * Convert a LUT image made of tiles into a cube for lut3d.
      *
-     * Like the RenderScript Intrinsics, vectorSize of size 3 are padded to occupy 4 bytes.
+     * See the ByteArray variant of lut3dFromTiles. The Bitmap must be ARGB_8888 and opaque.
      *
-     * @param inputArray The buffer of the image to be resized.
-     * @param vectorSize The number of bytes in each element of both buffers. A value from 1 to 4.
-     * @param inputSizeX The width of the input buffer, as a number of 1-4 byte elements.
-     * @param inputSizeY The height of the input buffer, as a number of 1-4 byte elements.
-     * @param outputSizeX The width of the output buffer, as a number of 1-4 byte elements.
-     * @param outputSizeY The height of the output buffer, as a number of 1-4 byte elements.
-     * @param restriction When not null, restricts the operation to a 2D range of pixels.
-     * @return An array that contains the rescaled image.
+     * @param inputBitmap The LUT image.
+     * @param intensity How much of the LUT is applied, between 0 and 1.
+     * @return The cube, with red along X, green along Y, and blue along Z.
      */
     @JvmOverloads
-    fun resize(
+    fun lut3dFromTiles(inputBitmap: Bitmap, intensity: Float = 1f): Rgba3dArray {
+        validateBitmap("lut3dFromTiles", inputBitmap, alphaAllowed = false)
+        val cubeSize = validateTiledLut(inputBitmap.width, inputBitmap.height, intensity)
+
+        val cube = ByteArray(cubeSize * cubeSize * cubeSize * 4)
+        nativeLut3dFromTilesBitmap(nativeHandle, inputBitmap, cube, intensity)
+        return Rgba3dArray(cube, cubeSize, cubeSize, cubeSize)
+    }
+
+    /**
+     * Bake a preset made of per channel curves into a cube for lut3d.
+     *
+     * Presets like ABIGAIL map each channel through one row of a curve map: red through the row
+     * at 1/6 of the height of the map, green at 1/2, and blue at 5/6. The preset is evaluated at
+     * every point of the cube grid, sampling the map like the shader does, and the grid is
+     * converted like lut3dFromTiles does. As with lut3dFromTiles, the intensity is baked into
+     * the cube, which is meant to be kept and reused.
+     *
+     * Presets that also depend on the position of the pixel can't be baked. AMELIA reads a map
+     * at the distance to the center of the image, and OLIVIA blends with a texture.
+     *
+     * @param mapArray The RGBA buffer of the curve map.
+     * @param sizeX The width of the curve map.
+     * @param sizeY The height of the curve map.
+     * @param intensity How much of the preset is applied, between 0 and 1.
+     * @param cubeSize The number of entries of the cube in each direction, between 2 and 256.
+     * @return The cube, with red along X, green along Y, and blue along Z.
+     */
+    @JvmOverloads
+    fun lut3dFromCurveMap(
+        mapArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        intensity: Float = 1f,
+        cubeSize: Int = 64
+    ): Rgba3dArray {
+        require(mapArray.size >= sizeX * sizeY * 4) {
+            "$externalName lut3dFromCurveMap. mapArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${mapArray.size}."
+        }
+        validateCurveMap(sizeX, sizeY, intensity, cubeSize)
+
+        val cube = ByteArray(cubeSize * cubeSize * cubeSize * 4)
+        nativeLut3dFromCurveMap(nativeHandle, mapArray, cube, sizeX, sizeY, cubeSize, intensity)
+        return Rgba3dArray(cube, cubeSize, cubeSize, cubeSize)
+    }
+
+    /**
+     * Bake a preset made of per channel curves into a cube for lut3d.
+     *
+     * See the ByteArray variant of lut3dFromCurveMap. The Bitmap must be ARGB_8888.
+     *
+     * @param mapBitmap The curve map.
+     * @param intensity How much of the preset is applied, between 0 and 1.
+     * @param cubeSize The number of entries of the cube in each direction, between 2 and 256.
+     * @return The cube, with red along X, green along Y, and blue along Z.
+     */
+    @JvmOverloads
+    fun lut3dFromCurveMap(
+        mapBitmap: Bitmap,
+        intensity: Float = 1f,
+        cubeSize: Int = 64
+    ): Rgba3dArray {
+        validateBitmap("lut3dFromCurveMap", mapBitmap, alphaAllowed = false)
+        validateCurveMap(mapBitmap.width, mapBitmap.height, intensity, cubeSize)
+
+        val cube = ByteArray(cubeSize * cubeSize * cubeSize * 4)
+        nativeLut3dFromCurveMapBitmap(nativeHandle, mapBitmap, cube, cubeSize, intensity)
+        return Rgba3dArray(cube, cubeSize, cubeSize, cubeSize)
+    }
+
+    /**
+     * Apply a list of presets to the same image, one output per preset.
+     *
+     * Each output is what lut3d or colorMatrix would return for its preset, e.g. to render the
+     * thumbnails of a strip of filters. All the presets are applied in a single native call:
+     * each tile of the input is read once and transformed by all the presets, and the tiles
+     * are spread over the threads. This is faster than calling lut3d once per preset, which
+     * reloads the input and waits for all the threads each time.
+     *
+     * The presets transform unpremultiplied colors. When the input is premultiplied, it's
+     * unpremultiplied once for all the presets and each output is premultiplied.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY. NOTE: The output arrays will still be full size, with the
+     * section that's not transformed all set to 0.
+     *
+     * @param inputArray The RGBA buffer of the image to be transformed.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param presets The presets to apply.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaType How the buffer stores its alpha.
+     * @return One transformed buffer per preset, in the same order.
+     */
+    @JvmOverloads
+    fun applyPresets(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        presets: List<ColorPreset>,
+        restriction: Range2d? = null,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
+    ): List<ByteArray> {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName applyPresets. inputArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validatePresets(presets)
+        validateRestriction("applyPresets", sizeX, sizeY, restriction)
+
+        val outputArrays = Array(presets.size) { ByteArray(inputArray.size) }
+        nativeApplyPresets(
+            nativeHandle,
+            inputArray,
+            sizeX,
+            sizeY,
+            presets.map { it.cube?.values }.toTypedArray(),
+            presetCubeSizes(presets),
+            presetMatrices(presets),
+            outputArrays,
+            alphaType.value,
+            restriction
+        )
+        return outputArrays.asList()
+    }
+
+    /**
+     * Apply a list of presets to the same Bitmap, one output per preset.
+     *
+     * See the ByteArray variant of applyPresets. The Bitmap must be ARGB_8888.
+     *
+     * @param inputBitmap The image to be transformed.
+     * @param presets The presets to apply.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return One transformed Bitmap per preset, in the same order.
+     */
+    @JvmOverloads
+    fun applyPresets(
+        inputBitmap: Bitmap,
+        presets: List<ColorPreset>,
+        restriction: Range2d? = null
+    ): List<Bitmap> {
+        validateBitmap("applyPresets", inputBitmap, alphaAllowed = false)
+        validatePresets(presets)
+        validateRestriction("applyPresets", inputBitmap, restriction)
+
+        val outputBitmaps = Array(presets.size) { createCompatibleBitmap(inputBitmap) }
+        nativeApplyPresetsBitmap(
+            nativeHandle,
+            inputBitmap,
+            presets.map { it.cube?.values }.toTypedArray(),
+            presetCubeSizes(presets),
+            presetMatrices(presets),
+            outputBitmaps,
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
+        return outputBitmaps.asList()
+    }
+
+    /**
+     * Premultiply an image.
+     *
+     * Multiplies the red, green, and blue channels of each RGBA pixel by its alpha, i.e.
+     * out.rgb = round(in.rgb * in.a / 255). The alpha is unchanged. Android bitmaps are
+     * premultiplied, and so should be the buffers given to blend, blur, and resize, unless they
+     * are told otherwise.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param inputArray The RGBA buffer of the image, with unpremultiplied alpha.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The premultiplied image.
+     */
+    @JvmOverloads
+    fun premultiply(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        restriction: Range2d? = null
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName premultiply. inputArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validateRestriction("premultiply", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativePremultiply(nativeHandle, inputArray, outputArray, sizeX, sizeY, restriction)
+        return outputArray
+    }
+
+    /**
+     * Unpremultiply an image.
+     *
+     * The inverse of premultiply: out.rgb = min(255, round(in.rgb * 255 / in.a)). Fully
+     * transparent pixels become transparent black. The division is replaced by a table of fixed
+     * point reciprocals.
+     *
+     * @param inputArray The RGBA buffer of the premultiplied image.
+     * @param sizeX The width of the buffer, as a number of RGBA values.
+     * @param sizeY The height of the buffer, as a number of RGBA values.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The image with unpremultiplied alpha.
+     */
+    @JvmOverloads
+    fun unpremultiply(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        restriction: Range2d? = null
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName unpremultiply. inputArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        validateRestriction("unpremultiply", sizeX, sizeY, restriction)
+
+        val outputArray = ByteArray(inputArray.size)
+        nativeUnpremultiply(nativeHandle, inputArray, outputArray, sizeX, sizeY, restriction)
+        return outputArray
+    }
+
+    /**
+     * Resize an image.
+     *
+     * Resizes an image using the specified filter, bicubic interpolation by default.
+     *
+     * This method supports elements of 1 to 4 bytes in length. Each byte of the element is
+     * interpolated independently from the others.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of the output buffer. The corresponding scaled range of the input will be used. If provided,
+     * the range must be wholly contained with the dimensions described by outputSizeX and
+     * outputSizeY.
+     *
+     * The input and output arrays have a row-major layout. The input array should be
+     * large enough for sizeX * sizeY * vectorSize bytes.
+     *
+     * Like the RenderScript Intrinsics, vectorSize of size 3 are padded to occupy 4 bytes.
+     *
+     * @param inputArray The buffer of the image to be resized.
+     * @param vectorSize The number of bytes in each element of both buffers. A value from 1 to 4.
+     * @param inputSizeX The width of the input buffer, as a number of 1-4 byte elements.
+     * @param inputSizeY The height of the input buffer, as a number of 1-4 byte elements.
+     * @param outputSizeX The width of the output buffer, as a number of 1-4 byte elements.
+     * @param outputSizeY The height of the output buffer, as a number of 1-4 byte elements.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param filter The filter used to compute the output pixels. See [ResizeFilter].
+     * @param alphaType How the buffers store their alpha when vectorSize is 4. See [AlphaType].
+     * @return An array that contains the rescaled image.
+     */
+    @JvmOverloads
+    fun resize(
         inputArray: ByteArray,
         vectorSize: Int,
         inputSizeX: Int,
         inputSizeY: Int,
         outputSizeX: Int,
         outputSizeY: Int,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        filter: ResizeFilter = ResizeFilter.BICUBIC,
+        alphaType: AlphaType = AlphaType.PREMULTIPLIED
     ): ByteArray {
         require(vectorSize in 1..4) {
             "$externalName resize. The vectorSize should be between 1 and 4. $vectorSize provided."
@@ -995,6 +1760,8 @@ object Toolkit {
             outputArray,
             outputSizeX,
             outputSizeY,
+            filter.value,
+            alphaType.value,
             restriction
         )
         return outputArray
@@ -1003,11 +1770,11 @@ object Toolkit {
     /**
      * Resize an image.
      *
-     * Resizes an image using bicubic interpolation.
+     * Resizes an image using the specified filter, bicubic interpolation by default.
      *
      * This method supports input Bitmap of config ARGB_8888 and ALPHA_8. The returned Bitmap
-     * has the same config. Bitmaps with a stride different than width * vectorSize are not
-     * currently supported.
+     * has the same config, and is premultiplied if the input is. Bitmaps with a stride different
+     * than width * vectorSize are not currently supported.
      *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
      * of the output buffer. The corresponding scaled range of the input will be used. If provided,
@@ -1018,6 +1785,7 @@ object Toolkit {
      * @param outputSizeX The width of the output buffer, as a number of 1-4 byte elements.
      * @param outputSizeY The height of the output buffer, as a number of 1-4 byte elements.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param filter The filter used to compute the output pixels. See [ResizeFilter].
      * @return A Bitmap that contains the rescaled image.
      */
     @JvmOverloads
@@ -1025,16 +1793,209 @@ object Toolkit {
         inputBitmap: Bitmap,
         outputSizeX: Int,
         outputSizeY: Int,
-        restriction: Range2d? = null
+        restriction: Range2d? = null,
+        filter: ResizeFilter = ResizeFilter.BICUBIC
     ): Bitmap {
         validateBitmap("resize", inputBitmap)
         validateRestriction("resize", outputSizeX, outputSizeY, restriction)
 
         val outputBitmap = Bitmap.createBitmap(outputSizeX, outputSizeY, Bitmap.Config.ARGB_8888)
-        nativeResizeBitmap(nativeHandle, inputBitmap, outputBitmap, restriction)
+        outputBitmap.isPremultiplied = inputBitmap.isPremultiplied
+        nativeResizeBitmap(
+            nativeHandle,
+            inputBitmap,
+            outputBitmap,
+            filter.value,
+            alphaTypeOf(inputBitmap).value,
+            restriction
+        )
         return outputBitmap
     }
 
+    /**
+     * Convert an image from RGB to YUV.
+     *
+     * Converts an RGBA buffer to a 4:2:0 YUV buffer of the specified format, the reverse of
+     * yuvToRgb. The alpha channel is ignored. Each chroma sample is computed from the average of
+     * the 2x2 pixels it covers.
+     *
+     * @param inputArray The RGBA buffer of the image to be converted.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param format The layout of the output buffer. P010 is not supported.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun rgbToYuv(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: YuvFormat,
+        matrix: YuvMatrix = YuvMatrix.BT601,
+        range: YuvRange = YuvRange.LIMITED
+    ): ByteArray {
+        require(inputArray.size >= sizeX * sizeY * 4) {
+            "$externalName rgbToYuv. inputArray is too small for the given dimensions. " +
+                    "$sizeX*$sizeY*4 < ${inputArray.size}."
+        }
+        require(format != YuvFormat.P010) {
+            "$externalName rgbToYuv. P010 is not supported."
+        }
+        val outputArray = ByteArray(yuvBufferSize("rgbToYuv", sizeX, sizeY, format))
+        nativeRgbToYuv(
+            nativeHandle, inputArray, outputArray, sizeX, sizeY, format.value, matrix.value,
+            range.value
+        )
+        return outputArray
+    }
+
+    /**
+     * Convert a Bitmap to YUV.
+     *
+     * Same as the rgbToYuv method that takes a ByteArray.
+     *
+     * @param inputBitmap The image to be converted.
+     * @param format The layout of the output buffer. P010 is not supported.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun rgbToYuv(
+        inputBitmap: Bitmap,
+        format: YuvFormat,
+        matrix: YuvMatrix = YuvMatrix.BT601,
+        range: YuvRange = YuvRange.LIMITED
+    ): ByteArray {
+        validateBitmap("rgbToYuv", inputBitmap, alphaAllowed = false)
+        require(format != YuvFormat.P010) {
+            "$externalName rgbToYuv. P010 is not supported."
+        }
+
+        val outputArray = ByteArray(
+            yuvBufferSize("rgbToYuv", inputBitmap.width, inputBitmap.height, format)
+        )
+        nativeRgbToYuvBitmap(
+            nativeHandle, inputBitmap, outputArray, format.value, matrix.value, range.value
+        )
+        return outputArray
+    }
+
+    /**
+     * Convert a Bitmap to YUV planes.
+     *
+     * Converts a Bitmap to 4:2:0 YUV, writing each plane in place into a direct buffer. The
+     * chroma planes can be planar or interleaved, in which case uPlane and vPlane are two views
+     * of the same memory, one byte apart. Each plane starts at the current position of its
+     * buffer.
+     *
+     * @param inputBitmap The image to be converted.
+     * @param yPlane The direct buffer that receives the luma samples.
+     * @param uPlane The direct buffer that receives the U (Cb) samples.
+     * @param vPlane The direct buffer that receives the V (Cr) samples.
+     * @param rowStrideY The number of bytes between the starts of two rows of the Y plane.
+     * @param rowStrideUV The number of bytes between the starts of two rows of the U and V planes.
+     * @param pixelStrideUV 1 for planar chroma, 2 for interleaved chroma.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     */
+    @JvmOverloads
+    fun rgbToYuv(
+        inputBitmap: Bitmap,
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideUV: Int = 1,
+        matrix: YuvMatrix = YuvMatrix.BT601,
+        range: YuvRange = YuvRange.LIMITED
+    ) {
+        validateBitmap("rgbToYuv", inputBitmap, alphaAllowed = false)
+        val sizeX = inputBitmap.width
+        val sizeY = inputBitmap.height
+        require(pixelStrideUV >= 1 && rowStrideY >= sizeX &&
+                rowStrideUV >= (sizeX + 1) / 2 * pixelStrideUV) {
+            "$externalName rgbToYuv. The strides are too small for a width of $sizeX. " +
+                    "$rowStrideY, $rowStrideUV, and $pixelStrideUV provided."
+        }
+        validateYuvPlane("rgbToYuv", "Y", yPlane, sizeX, sizeY, rowStrideY, 1, 1)
+        for ((name, plane) in listOf("U" to uPlane, "V" to vPlane)) {
+            validateYuvPlane(
+                "rgbToYuv", name, plane, (sizeX + 1) / 2, (sizeY + 1) / 2, rowStrideUV,
+                pixelStrideUV, 1
+            )
+        }
+
+        nativeRgbToYuvPlanes(
+            nativeHandle, inputBitmap, yPlane.slice(), uPlane.slice(), vPlane.slice(), rowStrideY,
+            rowStrideUV, pixelStrideUV, matrix.value, range.value
+        )
+    }
+
+    /**
+     * Convert a Bitmap into a YUV_420_888 Image.
+     *
+     * Writes into the planes of the image without intermediate copies, e.g. into the input Image
+     * of a video encoder. The image must have the same dimensions as the bitmap.
+     *
+     * @param inputBitmap The image to be converted.
+     * @param image The image that receives the converted samples.
+     * @param matrix The matrix to encode the image with.
+     * @param range The range of the samples to produce.
+     */
+    @JvmOverloads
+    fun rgbToYuv(
+        inputBitmap: Bitmap,
+        image: Image,
+        matrix: YuvMatrix = YuvMatrix.BT601,
+        range: YuvRange = YuvRange.LIMITED
+    ) {
+        require(image.format == ImageFormat.YUV_420_888) {
+            "$externalName rgbToYuv. Only YUV_420_888 images are supported. " +
+                    "${image.format} provided."
+        }
+        require(image.width == inputBitmap.width && image.height == inputBitmap.height) {
+            "$externalName rgbToYuv. The image should be ${inputBitmap.width}x" +
+                    "${inputBitmap.height}. ${image.width}x${image.height} provided."
+        }
+        val (y, u, v) = image.planes
+        require(y.pixelStride == 1) {
+            "$externalName rgbToYuv. Only images with a contiguous Y plane are supported."
+        }
+        rgbToYuv(
+            inputBitmap, y.buffer, u.buffer, v.buffer, y.rowStride, u.rowStride, u.pixelStride,
+            matrix, range
+        )
+    }
+
+    /**
+     * Convert an image from YUV to RGB.
+     *
+     * Same as the yuvToRgb method that takes a matrix, for BT.601 limited range images.
+     *
+     * @param inputArray The buffer of the image to be converted.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param format The layout of the input buffer.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image as a byte array.
+     */
+    @JvmOverloads
+    fun yuvToRgb(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: YuvFormat,
+        restriction: Range2d? = null
+    ): ByteArray {
+        return yuvToRgb(
+            inputArray, sizeX, sizeY, format, YuvMatrix.BT601, YuvRange.LIMITED, restriction
+        )
+    }
+
     /**
      * Convert an image from YUV to RGB.
      *
@@ -1044,23 +2005,66 @@ object Toolkit {
      * Note that for YV12 and a sizeX that's not a multiple of 32, the RenderScript Intrinsic may
      * not have converted the image correctly. This Toolkit method should.
      *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY. The pixels of the output outside the range are left
+     * untouched.
+     *
      * @param inputArray The buffer of the image to be converted.
      * @param sizeX The width in pixels of the image.
      * @param sizeY The height in pixels of the image.
-     * @param format Either YV12 or NV21.
+     * @param format The layout of the input buffer.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
      * @return The converted image as a byte array.
      */
-    fun yuvToRgb(inputArray: ByteArray, sizeX: Int, sizeY: Int, format: YuvFormat): ByteArray {
-        require(sizeX % 2 == 0 && sizeY % 2 == 0) {
-            "$externalName yuvToRgb. Non-even dimensions are not supported. " +
-                    "$sizeX and $sizeY were provided."
-        }
+    @JvmOverloads
+    fun yuvToRgb(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: YuvFormat,
+        matrix: YuvMatrix,
+        range: YuvRange = YuvRange.LIMITED,
+        restriction: Range2d? = null
+    ): ByteArray {
+        validateYuvArray("yuvToRgb", inputArray, sizeX, sizeY, format)
+        validateRestriction("yuvToRgb", sizeX, sizeY, restriction)
 
         val outputArray = ByteArray(sizeX * sizeY * 4)
-        nativeYuvToRgb(nativeHandle, inputArray, outputArray, sizeX, sizeY, format.value)
+        nativeYuvToRgb(
+            nativeHandle, inputArray, outputArray, sizeX, sizeY, format.value, matrix.value,
+            range.value, restriction
+        )
         return outputArray
     }
 
+    /**
+     * Convert an image from YUV to an RGB Bitmap.
+     *
+     * Same as the yuvToRgbBitmap method that takes a matrix, for BT.601 limited range images.
+     *
+     * @param inputArray The buffer of the image to be converted.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param format The layout of the input buffer.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: YuvFormat,
+        restriction: Range2d? = null
+    ): Bitmap {
+        return yuvToRgbBitmap(
+            inputArray, sizeX, sizeY, format, YuvMatrix.BT601, YuvRange.LIMITED, restriction
+        )
+    }
+
     /**
      * Convert an image from YUV to an RGB Bitmap.
      *
@@ -1070,20 +2074,287 @@ object Toolkit {
      * Note that for YV12 and a sizeX that's not a multiple of 32, the RenderScript Intrinsic may
      * not have converted the image correctly. This Toolkit method should.
      *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of each buffer. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY. The pixels of the output outside the range are left
+     * untouched.
+     *
      * @param inputArray The buffer of the image to be converted.
      * @param sizeX The width in pixels of the image.
      * @param sizeY The height in pixels of the image.
-     * @param format Either YV12 or NV21.
+     * @param format The layout of the input buffer.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
      * @return The converted image.
      */
-    fun yuvToRgbBitmap(inputArray: ByteArray, sizeX: Int, sizeY: Int, format: YuvFormat): Bitmap {
-        require(sizeX % 2 == 0 && sizeY % 2 == 0) {
-            "$externalName yuvToRgbBitmap. Non-even dimensions are not supported. " +
-                    "$sizeX and $sizeY were provided."
-        }
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: YuvFormat,
+        matrix: YuvMatrix,
+        range: YuvRange = YuvRange.LIMITED,
+        restriction: Range2d? = null
+    ): Bitmap {
+        validateYuvArray("yuvToRgbBitmap", inputArray, sizeX, sizeY, format)
+        validateRestriction("yuvToRgbBitmap", sizeX, sizeY, restriction)
 
         val outputBitmap = Bitmap.createBitmap(sizeX, sizeY, Bitmap.Config.ARGB_8888)
-        nativeYuvToRgbBitmap(nativeHandle, inputArray, sizeX, sizeY, outputBitmap, format.value)
+        nativeYuvToRgbBitmap(
+            nativeHandle, inputArray, sizeX, sizeY, outputBitmap, format.value, matrix.value,
+            range.value, restriction
+        )
+        return outputBitmap
+    }
+
+    /**
+     * Convert YUV planes to an RGB Bitmap.
+     *
+     * Same as the yuvToRgbBitmap method that takes planes and a matrix, for BT.601 limited range
+     * images.
+     *
+     * @param yPlane The direct buffer holding the luma samples.
+     * @param uPlane The direct buffer holding the U (Cb) samples.
+     * @param vPlane The direct buffer holding the V (Cr) samples.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param rowStrideY The number of bytes between the starts of two rows of the Y plane.
+     * @param rowStrideUV The number of bytes between the starts of two rows of the U and V planes.
+     * @param pixelStrideY The number of bytes between two samples of a row of the Y plane.
+     * @param pixelStrideUV The number of bytes between two samples of a row of the U and V planes.
+     * @param bitsPerSample 8, or 10 for P010 planes of 16 bit samples.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        sizeX: Int,
+        sizeY: Int,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideY: Int = 1,
+        pixelStrideUV: Int = 1,
+        bitsPerSample: Int = 8,
+        restriction: Range2d? = null
+    ): Bitmap {
+        return yuvToRgbBitmap(
+            yPlane, uPlane, vPlane, sizeX, sizeY, rowStrideY, rowStrideUV, pixelStrideY,
+            pixelStrideUV, bitsPerSample, YuvMatrix.BT601, YuvRange.LIMITED, restriction
+        )
+    }
+
+    /**
+     * Convert YUV planes to an RGB Bitmap.
+     *
+     * Converts a 4:2:0 image whose Y, U, and V planes are held in separate direct buffers, each
+     * with its own strides. This is how camera frames are received from an ImageReader. The
+     * planes are read in place, so there's no need to repack them first. Each plane starts at
+     * the current position of its buffer. The output is RGBA; the alpha channel will be set to
+     * 255.
+     *
+     * The chroma planes are ((sizeX + 1) / 2) by ((sizeY + 1) / 2) samples. They can be planar,
+     * like I420, or interleaved, like NV12 and NV21, in which case uPlane and vPlane are two
+     * views of the same memory, one byte apart.
+     *
+     * An optional range parameter can be set to restrict the operation to a rectangular subset
+     * of the image. If provided, the range must be wholly contained with the dimensions
+     * described by sizeX and sizeY.
+     *
+     * @param yPlane The direct buffer holding the luma samples.
+     * @param uPlane The direct buffer holding the U (Cb) samples.
+     * @param vPlane The direct buffer holding the V (Cr) samples.
+     * @param sizeX The width in pixels of the image.
+     * @param sizeY The height in pixels of the image.
+     * @param rowStrideY The number of bytes between the starts of two rows of the Y plane.
+     * @param rowStrideUV The number of bytes between the starts of two rows of the U and V planes.
+     * @param pixelStrideY The number of bytes between two samples of a row of the Y plane.
+     * @param pixelStrideUV The number of bytes between two samples of a row of the U and V planes.
+     * @param bitsPerSample 8, or 10 for P010 planes of 16 bit samples.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        sizeX: Int,
+        sizeY: Int,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideY: Int = 1,
+        pixelStrideUV: Int = 1,
+        bitsPerSample: Int = 8,
+        matrix: YuvMatrix,
+        range: YuvRange = YuvRange.LIMITED,
+        restriction: Range2d? = null
+    ): Bitmap {
+        validateYuvPlanes(
+            "yuvToRgbBitmap", yPlane, uPlane, vPlane, sizeX, sizeY, rowStrideY, rowStrideUV,
+            pixelStrideY, pixelStrideUV, bitsPerSample
+        )
+        validateRestriction("yuvToRgbBitmap", sizeX, sizeY, restriction)
+
+        val outputBitmap = Bitmap.createBitmap(sizeX, sizeY, Bitmap.Config.ARGB_8888)
+        nativeYuvPlanesToRgbBitmap(
+            nativeHandle, yPlane.slice(), uPlane.slice(), vPlane.slice(), sizeX, sizeY,
+            rowStrideY, rowStrideUV, pixelStrideY, pixelStrideUV, bitsPerSample, matrix.value,
+            range.value, outputBitmap, restriction
+        )
+        return outputBitmap
+    }
+
+    /**
+     * Convert a camera frame to an RGB Bitmap.
+     *
+     * Converts an Image in the YUV_420_888 or YCBCR_P010 format, as produced by an ImageReader,
+     * without copying its planes. See the yuvToRgbBitmap method that takes planes for details.
+     *
+     * The matrix and range are taken from the dataspace of the image. When it doesn't specify
+     * them, or before Android 13, YUV_420_888 images are treated as camera frames, which are
+     * BT.601 full range. P010 images have no such convention: for those, use the method that
+     * takes a matrix.
+     *
+     * @param image The frame to be converted.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(image: Image, restriction: Range2d? = null): Bitmap {
+        val (matrix, range) = yuvEncodingOf("yuvToRgbBitmap", image)
+        return yuvToRgbBitmap(image, matrix, range, restriction)
+    }
+
+    /**
+     * Convert a camera frame to an RGB Bitmap.
+     *
+     * Same as the yuvToRgbBitmap method that takes an Image, with the matrix and range given
+     * explicitly. Camera frames are usually BT.601 and full range, while decoded videos are
+     * usually BT.709 and limited range, or BT.2020 and limited range for 10 bit HDR.
+     *
+     * @param image The frame to be converted.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        image: Image,
+        matrix: YuvMatrix,
+        range: YuvRange,
+        restriction: Range2d? = null
+    ): Bitmap {
+        require(image.format == ImageFormat.YUV_420_888 || image.format == YuvFormat.P010.value) {
+            "$externalName yuvToRgbBitmap. Only YUV_420_888 and YCBCR_P010 images are " +
+                    "supported. ${image.format} provided."
+        }
+        val (y, u, v) = image.planes
+        return yuvToRgbBitmap(
+            y.buffer, u.buffer, v.buffer, image.width, image.height, y.rowStride, u.rowStride,
+            y.pixelStride, u.pixelStride, if (image.format == YuvFormat.P010.value) 10 else 8,
+            matrix, range, restriction
+        )
+    }
+
+    /**
+     * Convert a camera frame to a resized and rotated RGB Bitmap.
+     *
+     * Same as the yuvToRgbBitmap method that takes an Image and output dimensions, with the
+     * matrix and range taken from the dataspace of the image as described for the
+     * yuvToRgbBitmap method that takes only an Image.
+     *
+     * @param image The frame to be converted.
+     * @param outputSizeX The width in pixels of the output.
+     * @param outputSizeY The height in pixels of the output.
+     * @param rotationDegrees How much to rotate the image clockwise: 0, 90, 180, or 270.
+     * @param mirror Whether to flip the rotated image horizontally, e.g. for front cameras.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels of the
+     * output.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        image: Image,
+        outputSizeX: Int,
+        outputSizeY: Int,
+        rotationDegrees: Int = 0,
+        mirror: Boolean = false,
+        restriction: Range2d? = null
+    ): Bitmap {
+        val (matrix, range) = yuvEncodingOf("yuvToRgbBitmap", image)
+        return yuvToRgbBitmap(
+            image, outputSizeX, outputSizeY, rotationDegrees, mirror, matrix, range, restriction
+        )
+    }
+
+    /**
+     * Convert a camera frame to a resized and rotated RGB Bitmap.
+     *
+     * Converts an Image in the YUV_420_888 or YCBCR_P010 format, rotating it clockwise,
+     * mirroring it horizontally if requested, then resizing it to the requested dimensions. All
+     * of this is done in one pass over the output, reading the planes of the image in place,
+     * which makes it suitable for live previews. The source is sampled bilinearly.
+     *
+     * The dimensions of the output are the ones after rotation: to keep the full frame of a
+     * 4000x3000 image rotated by 90 degrees, ask for a portrait output like 960x1280.
+     *
+     * @param image The frame to be converted.
+     * @param outputSizeX The width in pixels of the output.
+     * @param outputSizeY The height in pixels of the output.
+     * @param rotationDegrees How much to rotate the image clockwise: 0, 90, 180, or 270.
+     * @param mirror Whether to flip the rotated image horizontally, e.g. for front cameras.
+     * @param matrix The matrix the image was encoded with.
+     * @param range The range of the samples of the image.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels of the
+     * output.
+     * @return The converted image.
+     */
+    @JvmOverloads
+    fun yuvToRgbBitmap(
+        image: Image,
+        outputSizeX: Int,
+        outputSizeY: Int,
+        rotationDegrees: Int,
+        mirror: Boolean,
+        matrix: YuvMatrix,
+        range: YuvRange,
+        restriction: Range2d? = null
+    ): Bitmap {
+        require(image.format == ImageFormat.YUV_420_888 || image.format == YuvFormat.P010.value) {
+            "$externalName yuvToRgbBitmap. Only YUV_420_888 and YCBCR_P010 images are " +
+                    "supported. ${image.format} provided."
+        }
+        require(rotationDegrees == 0 || rotationDegrees == 90 || rotationDegrees == 180 ||
+                rotationDegrees == 270) {
+            "$externalName yuvToRgbBitmap. The rotation should be 0, 90, 180, or 270 degrees. " +
+                    "$rotationDegrees provided."
+        }
+        require(outputSizeX > 0 && outputSizeY > 0) {
+            "$externalName yuvToRgbBitmap. The output dimensions should be positive. " +
+                    "$outputSizeX and $outputSizeY provided."
+        }
+        val (y, u, v) = image.planes
+        val bitsPerSample = if (image.format == YuvFormat.P010.value) 10 else 8
+        validateYuvPlanes(
+            "yuvToRgbBitmap", y.buffer, u.buffer, v.buffer, image.width, image.height,
+            y.rowStride, u.rowStride, y.pixelStride, u.pixelStride, bitsPerSample
+        )
+        validateRestriction("yuvToRgbBitmap", outputSizeX, outputSizeY, restriction)
+
+        val outputBitmap = Bitmap.createBitmap(outputSizeX, outputSizeY, Bitmap.Config.ARGB_8888)
+        nativeYuvPlanesToRgbTransformedBitmap(
+            nativeHandle, y.buffer.slice(), u.buffer.slice(), v.buffer.slice(), image.width,
+            image.height, y.rowStride, u.rowStride, y.pixelStride, u.pixelStride, bitsPerSample,
+            rotationDegrees, mirror, matrix.value, range.value, outputBitmap, restriction
+        )
         return outputBitmap
     }
 
@@ -1118,6 +2389,9 @@ object Toolkit {
         destArray: ByteArray,
         sizeX: Int,
         sizeY: Int,
+        opacity: Float,
+        maskArray: ByteArray?,
+        alphaType: Int,
         restriction: Range2d?
     )
 
@@ -1126,6 +2400,19 @@ object Toolkit {
         mode: Int,
         sourceBitmap: Bitmap,
         destBitmap: Bitmap,
+        opacity: Float,
+        maskBitmap: Bitmap?,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeCompositeBitmap(
+        nativeHandle: Long,
+        layerBitmaps: Array<Bitmap>,
+        maskBitmaps: Array<Bitmap?>,
+        offsetsAndModes: IntArray,
+        opacities: FloatArray,
+        destBitmap: Bitmap,
         restriction: Range2d?
     )
 
@@ -1137,6 +2424,7 @@ object Toolkit {
         sizeY: Int,
         radius: Int,
         outputArray: ByteArray,
+        alphaType: Int,
         restriction: Range2d?
     )
 
@@ -1145,6 +2433,7 @@ object Toolkit {
         inputBitmap: Bitmap,
         outputBitmap: Bitmap,
         radius: Int,
+        alphaType: Int,
         restriction: Range2d?
     )
 
@@ -1170,6 +2459,81 @@ object Toolkit {
         restriction: Range2d?
     )
 
+    private external fun nativeConvertColorSpace(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        outputArray: ByteArray,
+        from: Int,
+        to: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustInColorSpace(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        outputArray: ByteArray,
+        space: Int,
+        scale: FloatArray,
+        offset: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustInColorSpaceBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        outputBitmap: Bitmap,
+        space: Int,
+        scale: FloatArray,
+        offset: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustmentChain(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        outputArray: ByteArray,
+        adjustments: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustmentChainBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        outputBitmap: Bitmap,
+        adjustments: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustImage(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        outputArray: ByteArray,
+        adjustments: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeAdjustImageBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        outputBitmap: Bitmap,
+        adjustments: FloatArray,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
     private external fun nativeConvolve(
         nativeHandle: Long,
         inputArray: ByteArray,
@@ -1178,6 +2542,8 @@ object Toolkit {
         sizeY: Int,
         outputArray: ByteArray,
         coefficients: FloatArray,
+        kernelSize: Int,
+        floatAccumulation: Boolean,
         restriction: Range2d?
     )
 
@@ -1186,6 +2552,8 @@ object Toolkit {
         inputBitmap: Bitmap,
         outputBitmap: Bitmap,
         coefficients: FloatArray,
+        kernelSize: Int,
+        floatAccumulation: Boolean,
         restriction: Range2d?
     )
 
@@ -1273,6 +2641,82 @@ object Toolkit {
         restriction: Range2d?
     )
 
+    private external fun nativeLut3dFromTiles(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        cube: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        intensity: Float
+    )
+
+    private external fun nativeLut3dFromTilesBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        cube: ByteArray,
+        intensity: Float
+    )
+
+    private external fun nativeLut3dFromCurveMap(
+        nativeHandle: Long,
+        mapArray: ByteArray,
+        cube: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        cubeSize: Int,
+        intensity: Float
+    )
+
+    private external fun nativeLut3dFromCurveMapBitmap(
+        nativeHandle: Long,
+        mapBitmap: Bitmap,
+        cube: ByteArray,
+        cubeSize: Int,
+        intensity: Float
+    )
+
+    private external fun nativeApplyPresets(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        cubes: Array<ByteArray?>,
+        cubeSizes: IntArray,
+        matrices: FloatArray,
+        outputArrays: Array<ByteArray>,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeApplyPresetsBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        cubes: Array<ByteArray?>,
+        cubeSizes: IntArray,
+        matrices: FloatArray,
+        outputBitmaps: Array<Bitmap>,
+        alphaType: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativePremultiply(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        outputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeUnpremultiply(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        outputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        restriction: Range2d?
+    )
+
     private external fun nativeResize(
         nativeHandle: Long,
         inputArray: ByteArray,
@@ -1282,6 +2726,8 @@ object Toolkit {
         outputArray: ByteArray,
         outputSizeX: Int,
         outputSizeY: Int,
+        filter: Int,
+        alphaType: Int,
         restriction: Range2d?
     )
 
@@ -1289,6 +2735,8 @@ object Toolkit {
         nativeHandle: Long,
         inputBitmap: Bitmap,
         outputBitmap: Bitmap,
+        filter: Int,
+        alphaType: Int,
         restriction: Range2d?
     )
 
@@ -1298,7 +2746,10 @@ object Toolkit {
         outputArray: ByteArray,
         sizeX: Int,
         sizeY: Int,
-        format: Int
+        format: Int,
+        matrix: Int,
+        range: Int,
+        restriction: Range2d?
     )
 
     private external fun nativeYuvToRgbBitmap(
@@ -1307,7 +2758,81 @@ object Toolkit {
         sizeX: Int,
         sizeY: Int,
         outputBitmap: Bitmap,
-        value: Int
+        value: Int,
+        matrix: Int,
+        range: Int,
+        restriction: Range2d?
+    )
+
+    private external fun nativeRgbToYuv(
+        nativeHandle: Long,
+        inputArray: ByteArray,
+        outputArray: ByteArray,
+        sizeX: Int,
+        sizeY: Int,
+        format: Int,
+        matrix: Int,
+        range: Int
+    )
+
+    private external fun nativeRgbToYuvBitmap(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        outputArray: ByteArray,
+        format: Int,
+        matrix: Int,
+        range: Int
+    )
+
+    private external fun nativeRgbToYuvPlanes(
+        nativeHandle: Long,
+        inputBitmap: Bitmap,
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideUV: Int,
+        matrix: Int,
+        range: Int
+    )
+
+    private external fun nativeYuvPlanesToRgbTransformedBitmap(
+        nativeHandle: Long,
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        sizeX: Int,
+        sizeY: Int,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideY: Int,
+        pixelStrideUV: Int,
+        bitsPerSample: Int,
+        rotationDegrees: Int,
+        mirror: Boolean,
+        matrix: Int,
+        range: Int,
+        outputBitmap: Bitmap,
+        restriction: Range2d?
+    )
+
+    private external fun nativeYuvPlanesToRgbBitmap(
+        nativeHandle: Long,
+        yPlane: ByteBuffer,
+        uPlane: ByteBuffer,
+        vPlane: ByteBuffer,
+        sizeX: Int,
+        sizeY: Int,
+        rowStrideY: Int,
+        rowStrideUV: Int,
+        pixelStrideY: Int,
+        pixelStrideUV: Int,
+        bitsPerSample: Int,
+        matrix: Int,
+        range: Int,
+        outputBitmap: Bitmap,
+        restriction: Range2d?
     )
 }
 
@@ -1400,7 +2925,100 @@ enum class BlendingMode(val value: Int) {
     /**
      * dest = max(dest - src, 0.0)
      */
-    SUBTRACT(14)
+    SUBTRACT(14),
+
+    // The modes below follow the W3C Compositing and Blending definitions. The blended color
+    // B(Cs, Cd) is computed from the unpremultiplied source and destination colors, then
+    // composited with:
+    //     dest.rgb = (1 - dest.a) * src.rgb + (1 - src.a) * dest.rgb + src.a * dest.a * B
+    //     dest.a = src.a + dest.a - src.a * dest.a
+
+    /**
+     * B = Cs + Cd - Cs * Cd
+     */
+    SCREEN(15),
+
+    /**
+     * B = HARD_LIGHT(Cd, Cs), i.e. multiply or screen depending on the destination.
+     */
+    OVERLAY(16),
+
+    /**
+     * Darkens or lightens depending on the source, like a diffuse spotlight.
+     */
+    SOFT_LIGHT(17),
+
+    /**
+     * B = Cs <= 0.5 ? 2 * Cs * Cd : SCREEN(2 * Cs - 1, Cd)
+     */
+    HARD_LIGHT(18),
+
+    /**
+     * B = min(Cs, Cd)
+     */
+    DARKEN(19),
+
+    /**
+     * B = max(Cs, Cd)
+     */
+    LIGHTEN(20),
+
+    /**
+     * B = min(1, Cd / (1 - Cs))
+     */
+    COLOR_DODGE(21),
+
+    /**
+     * B = 1 - min(1, (1 - Cd) / Cs)
+     */
+    COLOR_BURN(22),
+
+    /**
+     * B = |Cs - Cd|
+     */
+    DIFFERENCE(23),
+
+    /**
+     * B = Cs + Cd - 2 * Cs * Cd
+     */
+    EXCLUSION(24)
+}
+
+/**
+ * A layer to be composited by [Toolkit.composite].
+ *
+ * @property bitmap The ARGB_8888 pixels of the layer.
+ * @property offsetX Where the left edge of the layer is placed in the destination.
+ * @property offsetY Where the top edge of the layer is placed in the destination.
+ * @property opacity How much of the layer is used, from 0 to 1.
+ * @property mode How the layer is blended with the layers below it.
+ * @property mask When not null, an ALPHA_8 bitmap of the size of the layer that scales it.
+ */
+class CompositeLayer @JvmOverloads constructor(
+    val bitmap: Bitmap,
+    val offsetX: Int = 0,
+    val offsetY: Int = 0,
+    val opacity: Float = 1f,
+    val mode: BlendingMode = BlendingMode.SRC_OVER,
+    val mask: Bitmap? = null
+)
+
+/**
+ * A color transform applied by [Toolkit.applyPresets]: either a cube, as used by lut3d, e.g. one
+ * returned by lut3dFromTiles, or a 4x4 color matrix and add vector, as used by colorMatrix.
+ */
+class ColorPreset private constructor(
+    val cube: Rgba3dArray?,
+    val matrix: FloatArray?,
+    val addVector: FloatArray
+) {
+    constructor(cube: Rgba3dArray) : this(cube, null, floatArrayOf(0f, 0f, 0f, 0f))
+
+    @JvmOverloads
+    constructor(
+        matrix: FloatArray,
+        addVector: FloatArray = floatArrayOf(0f, 0f, 0f, 0f)
+    ) : this(null, matrix, addVector)
 }
 
 /**
@@ -1417,12 +3035,107 @@ class LookupTable {
     var alpha = ByteArray(256) { it.toByte() }
 }
 
+/**
+ * The color spaces of convertColorSpace and adjustInColorSpace.
+ *
+ * Each space is stored in the first three bytes of an RGBA pixel, the alpha being kept.
+ */
+enum class ColorSpace(val value: Int) {
+    /** R, G, B as stored in Android bitmaps. */
+    SRGB(0),
+
+    /** R, G, B without the sRGB transfer function. */
+    LINEAR_SRGB(1),
+
+    /** Hue in 256 steps around the circle, then saturation and value scaled to 0-255. */
+    HSV(2),
+
+    /** Hue in 256 steps around the circle, then saturation and lightness scaled to 0-255. */
+    HSL(3),
+
+    /** CIE L*a*b* with a D65 white point. L is scaled to 0-255, a and b are offset by 128. */
+    LAB(4)
+}
+
+/**
+ * How the color of RGBA pixels relates to their alpha.
+ *
+ * Blending, blurring, and resizing average premultiplied colors, otherwise the color of
+ * transparent pixels bleeds into their neighbors. Buffers with unpremultiplied alpha are
+ * converted on the fly.
+ */
+enum class AlphaType(val value: Int) {
+    /** The color channels have been multiplied by the alpha, as in Android bitmaps. */
+    PREMULTIPLIED(0),
+
+    /** The color channels are independent of the alpha, also known as straight alpha. */
+    UNPREMULTIPLIED(1)
+}
+
+/**
+ * The filters that can be used by resize.
+ *
+ * When downscaling, the filters are stretched to cover all the input pixels that fall under an
+ * output pixel, which avoids aliasing.
+ */
+enum class ResizeFilter(val value: Int) {
+    /**
+     * Bicubic (Catmull-Rom) interpolation. Sharp, with a slight overshoot on edges.
+     */
+    BICUBIC(0),
+
+    /**
+     * Linear interpolation between the two nearest pixels in each direction.
+     */
+    BILINEAR(1),
+
+    /**
+     * Area average. Each output pixel is the mean of the input pixels it covers. This is the
+     * fastest filter for large downscales, e.g. thumbnails.
+     */
+    BOX(2),
+
+    /**
+     * Lanczos windowed sinc with three lobes. The highest quality, at a higher cost.
+     */
+    LANCZOS3(3)
+}
+
 /**
  * The YUV formats supported by yuvToRgb.
  */
 enum class YuvFormat(val value: Int) {
     NV21(0x11),
     YV12(0x32315659),
+    /** A Y plane followed by interleaved U and V samples. */
+    NV12(0x3231564E),
+    /** A Y plane followed by a U plane then a V plane. */
+    I420(0x30323449),
+    /** Like NV12, with 16 bit little endian samples holding 10 bits in their high bits. */
+    P010(0x36),
+}
+
+/**
+ * The matrices used to convert YUV to RGB, as defined by the ITU-R recommendations of the same
+ * name. See {@link RenderScriptToolkit::YuvMatrix}.
+ */
+enum class YuvMatrix(val value: Int) {
+    /** Standard definition content and most camera frames. */
+    BT601(0),
+    /** HD video. */
+    BT709(1),
+    /** UHD and HDR video. */
+    BT2020(2),
+}
+
+/**
+ * The range of YUV samples. See {@link RenderScriptToolkit::YuvRange}.
+ */
+enum class YuvRange(val value: Int) {
+    /** Luma in [16, 235] and chroma in [16, 240]. */
+    LIMITED(0),
+    /** All samples in [0, 255]. */
+    FULL(1),
 }
 
 /**
@@ -1445,6 +3158,50 @@ data class Range2d(
     constructor() : this(0, 0, 0, 0)
 }
 
+/**
+ * The strength of each filter of [Toolkit.adjustmentChain] and [Toolkit.adjustImage]. The
+ * defaults leave the image unchanged, and filters at their default are skipped.
+ *
+ * The values are the uniforms of the OpenGL filters, not the 0-1 progress of the sliders. The
+ * filters are applied in the order of the properties, except that the vignette comes last.
+ *
+ * @property brightness Added to the colors. The editor uses -0.15 to 0.15.
+ * @property contrast Scales the colors around 0.5. The editor uses 0.75 to 1.25.
+ * @property saturation 0 is grey, 1 is unchanged. The editor uses 0 to 2.
+ * @property exposure The colors are multiplied by 2^exposure. The editor uses -1 to 0.6.
+ * @property highlights Below 1 darkens the highlights, above 1 brightens them. Less than 2.
+ * @property shadows Below 1 darkens the shadows, above 1 lifts them. More than 0.
+ * @property temperature How much of a warm overlay is mixed in, from -1 to 1.
+ * @property hue Rotation of the hue in the YIQ space, in radians.
+ * @property colorTemperature Shifts red to blue. The editor uses -1.2 to 1.2.
+ * @property tone Rotation of the hue in the HSV space, in degrees. Makes the image opaque.
+ * @property sharpness Strength of a 3x3 sharpening, from 0 to 1.
+ * @property clarity Strength of a sharpening that spares the strong edges. Makes the image
+ * opaque. Can't be combined with sharpness.
+ * @property vignette Size of the darkened border, from 0 to 1.
+ */
+data class Adjustments(
+    val brightness: Float = 0f,
+    val contrast: Float = 1f,
+    val saturation: Float = 1f,
+    val exposure: Float = 0f,
+    val highlights: Float = 1f,
+    val shadows: Float = 1f,
+    val temperature: Float = 0f,
+    val hue: Float = 0f,
+    val colorTemperature: Float = 0f,
+    val tone: Float = 0f,
+    val sharpness: Float = 0f,
+    val clarity: Float = 0f,
+    val vignette: Float = 0f
+) {
+    // The order is the one expected by the native code.
+    internal fun toFloatArray() = floatArrayOf(
+        brightness, contrast, saturation, exposure, highlights, shadows, temperature, hue,
+        colorTemperature, tone, sharpness, clarity, vignette
+    )
+}
+
 class Rgba3dArray(val values: ByteArray, val sizeX: Int, val sizeY: Int, val sizeZ: Int) {
     init {
         require(values.size >= sizeX * sizeY * sizeZ * 4)
@@ -1471,6 +3228,111 @@ class Rgba3dArray(val values: ByteArray, val sizeX: Int, val sizeY: Int, val siz
     }
 }
 
+internal fun validateAdjustments(adjustments: Adjustments) {
+    require(adjustments.sharpness == 0f || adjustments.clarity == 0f) {
+        "$externalName adjustmentChain. sharpness and clarity can't be combined. " +
+                "${adjustments.sharpness} and ${adjustments.clarity} provided."
+    }
+    require(adjustments.highlights < 2f && adjustments.shadows > 0f) {
+        "$externalName adjustmentChain. highlights should be less than 2 and shadows more " +
+                "than 0. ${adjustments.highlights} and ${adjustments.shadows} provided."
+    }
+}
+
+internal fun validateAdjustImage(adjustments: Adjustments) {
+    require(
+        adjustments.colorTemperature == 0f && adjustments.tone == 0f &&
+                adjustments.clarity == 0f
+    ) {
+        "$externalName adjustImage. The AdjustImage shader has no color temperature, tone, " +
+                "or clarity. Use adjustmentChain."
+    }
+    require(adjustments.highlights < 2f && adjustments.shadows > 0f) {
+        "$externalName adjustImage. highlights should be less than 2 and shadows more " +
+                "than 0. ${adjustments.highlights} and ${adjustments.shadows} provided."
+    }
+}
+
+/**
+ * Returns the size of the cube of a LUT image of sizeX by sizeY made of tiles, as expected by
+ * lut3dFromTiles.
+ */
+internal fun validateTiledLut(sizeX: Int, sizeY: Int, intensity: Float): Int {
+    require(intensity in 0f..1f) {
+        "$externalName lut3dFromTiles. The intensity should be between 0 and 1. " +
+                "$intensity provided."
+    }
+    var cubeSize = 2
+    while (cubeSize.toLong() * cubeSize * cubeSize < sizeX.toLong() * sizeY) {
+        cubeSize++
+    }
+    require(
+        cubeSize <= 256 && cubeSize.toLong() * cubeSize * cubeSize == sizeX.toLong() * sizeY &&
+                sizeX % cubeSize == 0 && sizeY % cubeSize == 0
+    ) {
+        "$externalName lut3dFromTiles. A LUT image of ${sizeX}x$sizeY is not made of " +
+                "cubeSize x cubeSize tiles, one per blue level."
+    }
+    return cubeSize
+}
+
+internal fun validateCurveMap(sizeX: Int, sizeY: Int, intensity: Float, cubeSize: Int) {
+    require(sizeX > 0 && sizeY > 0) {
+        "$externalName lut3dFromCurveMap. The curve map should not be empty. " +
+                "${sizeX}x$sizeY provided."
+    }
+    require(intensity in 0f..1f) {
+        "$externalName lut3dFromCurveMap. The intensity should be between 0 and 1. " +
+                "$intensity provided."
+    }
+    require(cubeSize in 2..256) {
+        "$externalName lut3dFromCurveMap. The size of the cube should be between 2 and 256. " +
+                "$cubeSize provided."
+    }
+}
+
+internal fun validatePresets(presets: List<ColorPreset>) {
+    for (preset in presets) {
+        val cube = preset.cube
+        if (cube != null) {
+            require(
+                cube.sizeX >= 2 && cube.sizeY >= 2 && cube.sizeZ >= 2 &&
+                        cube.sizeX <= 256 && cube.sizeY <= 256 && cube.sizeZ <= 256
+            ) {
+                "$externalName applyPresets. The dimensions of the cube should be between 2 " +
+                        "and 256. (${cube.sizeX}, ${cube.sizeY}, ${cube.sizeZ}) provided."
+            }
+        } else {
+            require(preset.matrix?.size == 16 && preset.addVector.size == 4) {
+                "$externalName applyPresets. matrix should have 16 entries and addVector 4. " +
+                        "${preset.matrix?.size} and ${preset.addVector.size} provided."
+            }
+        }
+    }
+}
+
+/** The sizes of the cubes of applyPresets, three per preset, zeroes for the matrices. */
+internal fun presetCubeSizes(presets: List<ColorPreset>) = IntArray(presets.size * 3) { i ->
+    val cube = presets[i / 3].cube
+    when {
+        cube == null -> 0
+        i % 3 == 0 -> cube.sizeX
+        i % 3 == 1 -> cube.sizeY
+        else -> cube.sizeZ
+    }
+}
+
+/** The matrices and add vectors of applyPresets, 20 floats per preset, zeroes for the cubes. */
+internal fun presetMatrices(presets: List<ColorPreset>) = FloatArray(presets.size * 20) { i ->
+    val preset = presets[i / 20]
+    val index = i % 20
+    when {
+        preset.matrix == null -> 0f
+        index < 16 -> preset.matrix[index]
+        else -> preset.addVector[index - 16]
+    }
+}
+
 internal fun validateBitmap(
     function: String,
     inputBitmap: Bitmap,
@@ -1497,8 +3359,30 @@ internal fun validateBitmap(
     }
 }
 
-internal fun createCompatibleBitmap(inputBitmap: Bitmap) =
-    Bitmap.createBitmap(inputBitmap.width, inputBitmap.height, inputBitmap.config)
+internal fun createCompatibleBitmap(inputBitmap: Bitmap): Bitmap {
+    val bitmap = Bitmap.createBitmap(inputBitmap.width, inputBitmap.height, inputBitmap.config)
+    if (inputBitmap.config == Bitmap.Config.ARGB_8888) {
+        bitmap.isPremultiplied = inputBitmap.isPremultiplied
+    }
+    return bitmap
+}
+
+internal fun alphaTypeOf(bitmap: Bitmap) =
+    if (bitmap.isPremultiplied) AlphaType.PREMULTIPLIED else AlphaType.UNPREMULTIPLIED
+
+/**
+ * Returns the width of the square kernel described by the coefficients, checking that it's an odd
+ * number from 3 to 25.
+ */
+internal fun convolveKernelSize(coefficients: FloatArray): Int {
+    var kernelSize = 3
+    while (kernelSize * kernelSize < coefficients.size) kernelSize += 2
+    require(kernelSize * kernelSize == coefficients.size && kernelSize <= 25) {
+        "$externalName convolve. The coefficients should describe a square kernel of odd size " +
+                "from 3x3 to 25x25. ${coefficients.size} coefficients provided."
+    }
+    return kernelSize
+}
 
 internal fun validateHistogramDotCoefficients(
     coefficients: FloatArray?,
@@ -1522,6 +3406,132 @@ internal fun validateHistogramDotCoefficients(
     }
 }
 
+/**
+ * Returns the size of a buffer holding a sizeX by sizeY image in the specified format, as laid
+ * out by {@link RenderScriptToolkit::yuvToRgb}.
+ */
+internal fun yuvBufferSize(function: String, sizeX: Int, sizeY: Int, format: YuvFormat): Int {
+    require(sizeX % 2 == 0 && sizeY % 2 == 0) {
+        "$externalName $function. Non-even dimensions are not supported. " +
+                "$sizeX and $sizeY were provided."
+    }
+    return when (format) {
+        YuvFormat.YV12 -> {
+            val strideY = (sizeX + 15) and 15.inv()
+            val strideUV = (strideY / 2 + 15) and 15.inv()
+            strideY * sizeY + strideUV * sizeY
+        }
+        YuvFormat.P010 -> (sizeX * sizeY + sizeX * sizeY / 2) * 2
+        else -> sizeX * sizeY + sizeX * sizeY / 2
+    }
+}
+
+internal fun validateYuvArray(
+    function: String,
+    inputArray: ByteArray,
+    sizeX: Int,
+    sizeY: Int,
+    format: YuvFormat
+) {
+    val size = yuvBufferSize(function, sizeX, sizeY, format)
+    require(inputArray.size >= size) {
+        "$externalName $function. inputArray is too small for a ${sizeX}x$sizeY $format " +
+                "image. $size bytes are needed, ${inputArray.size} provided."
+    }
+}
+
+/**
+ * Returns the matrix and range an Image was encoded with, as described by its dataspace. When
+ * the dataspace doesn't say, or before Android 13, YUV_420_888 images are assumed to be camera
+ * frames, BT.601 full range. There's no such default for P010.
+ */
+internal fun yuvEncodingOf(function: String, image: Image): Pair<YuvMatrix, YuvRange> {
+    val isP010 = image.format == YuvFormat.P010.value
+    if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+        val dataSpace = image.dataSpace
+        val matrix = when (DataSpace.getStandard(dataSpace)) {
+            DataSpace.STANDARD_BT601_625, DataSpace.STANDARD_BT601_625_UNADJUSTED,
+            DataSpace.STANDARD_BT601_525, DataSpace.STANDARD_BT601_525_UNADJUSTED ->
+                YuvMatrix.BT601
+            DataSpace.STANDARD_BT709 -> YuvMatrix.BT709
+            DataSpace.STANDARD_BT2020, DataSpace.STANDARD_BT2020_CONSTANT_LUMINANCE ->
+                YuvMatrix.BT2020
+            else -> null
+        }
+        if (matrix != null) {
+            val range = when (DataSpace.getRange(dataSpace)) {
+                DataSpace.RANGE_FULL -> YuvRange.FULL
+                DataSpace.RANGE_LIMITED -> YuvRange.LIMITED
+                else -> if (isP010) YuvRange.LIMITED else YuvRange.FULL
+            }
+            return Pair(matrix, range)
+        }
+    }
+    require(!isP010) {
+        "$externalName $function. The dataspace of the P010 image doesn't specify its matrix. " +
+                "Provide the matrix and range explicitly."
+    }
+    return Pair(YuvMatrix.BT601, YuvRange.FULL)
+}
+
+internal fun validateYuvPlanes(
+    function: String,
+    yPlane: ByteBuffer,
+    uPlane: ByteBuffer,
+    vPlane: ByteBuffer,
+    sizeX: Int,
+    sizeY: Int,
+    rowStrideY: Int,
+    rowStrideUV: Int,
+    pixelStrideY: Int,
+    pixelStrideUV: Int,
+    bitsPerSample: Int
+) {
+    require(bitsPerSample == 8 || bitsPerSample == 10) {
+        "$externalName $function. bitsPerSample should be 8 or 10. $bitsPerSample provided."
+    }
+    val sampleSize = if (bitsPerSample == 8) 1 else 2
+    require(pixelStrideY >= sampleSize && pixelStrideUV >= sampleSize) {
+        "$externalName $function. The pixel strides should be at least $sampleSize. " +
+                "$pixelStrideY and $pixelStrideUV provided."
+    }
+    require(rowStrideY >= sizeX * pixelStrideY &&
+            rowStrideUV >= (sizeX + 1) / 2 * pixelStrideUV) {
+        "$externalName $function. The row strides are too small for a width of $sizeX. " +
+                "$rowStrideY and $rowStrideUV provided."
+    }
+    val chromaSizeX = (sizeX + 1) / 2
+    val chromaSizeY = (sizeY + 1) / 2
+    validateYuvPlane(function, "Y", yPlane, sizeX, sizeY, rowStrideY, pixelStrideY, sampleSize)
+    for ((name, plane) in listOf("U" to uPlane, "V" to vPlane)) {
+        validateYuvPlane(
+            function, name, plane, chromaSizeX, chromaSizeY, rowStrideUV, pixelStrideUV,
+            sampleSize
+        )
+    }
+}
+
+internal fun validateYuvPlane(
+    function: String,
+    plane: String,
+    buffer: ByteBuffer,
+    sizeX: Int,
+    sizeY: Int,
+    rowStride: Int,
+    pixelStride: Int,
+    sampleSize: Int
+) {
+    require(buffer.isDirect) {
+        "$externalName $function. The $plane plane should be a direct buffer."
+    }
+    // The last row of a plane is often not padded to the row stride.
+    val needed = rowStride.toLong() * (sizeY - 1) + pixelStride.toLong() * (sizeX - 1) + sampleSize
+    require(buffer.remaining() >= needed) {
+        "$externalName $function. The $plane plane should have at least $needed bytes. " +
+                "${buffer.remaining()} provided."
+    }
+}
+
 internal fun validateRestriction(tag: String, bitmap: Bitmap, restriction: Range2d? = null) {
     validateRestriction(tag, bitmap.width, bitmap.height, restriction)
 }